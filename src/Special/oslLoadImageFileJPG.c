@@ -1,15 +1,125 @@
 #include "../oslib.h"
-#include <jpeglib.h>
 #include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+int osl_jpgMaxSize = 512;
+
+#define OSL_JPG_BUFFER_SIZE 4096
+
+// libjpeg source manager reading straight from a virtual file
+typedef struct {
+    struct jpeg_source_mgr pub;
+    VIRTUAL_FILE *f;
+    JOCTET *buffer;
+} OSL_JPG_SOURCE;
+
+// Error manager returning to oslLoadImageFileJPG instead of calling exit()
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmpBuffer;
+} OSL_JPG_ERROR;
+
+static void oslJpgInitSource(j_decompress_ptr cinfo) {
+}
+
+static boolean oslJpgFillInputBuffer(j_decompress_ptr cinfo) {
+    OSL_JPG_SOURCE *src = (OSL_JPG_SOURCE *)cinfo->src;
+    int n = VirtualFileRead(src->buffer, 1, OSL_JPG_BUFFER_SIZE, src->f);
+
+    if (n <= 0) {
+        // Truncated file: insert a fake EOI marker, libjpeg will output what it has
+        src->buffer[0] = (JOCTET)0xFF;
+        src->buffer[1] = (JOCTET)JPEG_EOI;
+        n = 2;
+    }
+    src->pub.next_input_byte = src->buffer;
+    src->pub.bytes_in_buffer = n;
+    return TRUE;
+}
+
+static void oslJpgSkipInputData(j_decompress_ptr cinfo, long numBytes) {
+    OSL_JPG_SOURCE *src = (OSL_JPG_SOURCE *)cinfo->src;
+
+    if (numBytes <= 0)
+        return;
+    while (numBytes > (long)src->pub.bytes_in_buffer) {
+        numBytes -= (long)src->pub.bytes_in_buffer;
+        oslJpgFillInputBuffer(cinfo);
+    }
+    src->pub.next_input_byte += numBytes;
+    src->pub.bytes_in_buffer -= numBytes;
+}
+
+static void oslJpgTermSource(j_decompress_ptr cinfo) {
+}
+
+static void oslJpgSourceVirtualFile(j_decompress_ptr cinfo, VIRTUAL_FILE *f) {
+    OSL_JPG_SOURCE *src;
+
+    src = (OSL_JPG_SOURCE *)(*cinfo->mem->alloc_small)((j_common_ptr)cinfo, JPOOL_PERMANENT, sizeof(OSL_JPG_SOURCE));
+    src->buffer = (JOCTET *)(*cinfo->mem->alloc_small)((j_common_ptr)cinfo, JPOOL_PERMANENT, OSL_JPG_BUFFER_SIZE);
+    src->f = f;
+    src->pub.init_source = oslJpgInitSource;
+    src->pub.fill_input_buffer = oslJpgFillInputBuffer;
+    src->pub.skip_input_data = oslJpgSkipInputData;
+    src->pub.resync_to_restart = jpeg_resync_to_restart;
+    src->pub.term_source = oslJpgTermSource;
+    src->pub.bytes_in_buffer = 0;
+    src->pub.next_input_byte = NULL;
+    cinfo->src = &src->pub;
+}
+
+static void oslJpgErrorExit(j_common_ptr cinfo) {
+    OSL_JPG_ERROR *err = (OSL_JPG_ERROR *)cinfo->err;
+    longjmp(err->setjmpBuffer, 1);
+}
+
+static void oslJpgOutputMessage(j_common_ptr cinfo) {
+    // Warnings are not worth a message
+}
+
+// Writes one RGB scanline in the image pixel format (one loop per format, no per-pixel test)
+static void oslJpgConvertRow(void *dst, const JSAMPLE *src, int width, int pixelFormat) {
+    int x;
+
+    switch (pixelFormat) {
+        case OSL_PF_5650: {
+            u16 *d = (u16 *)dst;
+            for (x = 0; x < width; x++, src += 3)
+                d[x] = RGB16(src[0], src[1], src[2]);
+            break;
+        }
+        case OSL_PF_5551: {
+            u16 *d = (u16 *)dst;
+            for (x = 0; x < width; x++, src += 3)
+                d[x] = RGBA15(src[0], src[1], src[2], 0xff);
+            break;
+        }
+        case OSL_PF_4444: {
+            u16 *d = (u16 *)dst;
+            for (x = 0; x < width; x++, src += 3)
+                d[x] = RGBA12(src[0], src[1], src[2], 0xff);
+            break;
+        }
+        case OSL_PF_8888: {
+            u32 *d = (u32 *)dst;
+            for (x = 0; x < width; x++, src += 3)
+                d[x] = RGBA(src[0], src[1], src[2], 0xff);
+            break;
+        }
+    }
+}
 
 OSL_IMAGE *oslLoadImageFileJPG(char *filename, int location, int pixelFormat) {
     if (!filename) {
         return NULL;
     }
 
-    OSL_IMAGE *img = NULL;
-    const unsigned char *input = NULL, *input_free = NULL;
-    int input_size = 0;
+    // Kept out of the setjmp frame
+    OSL_IMAGE * volatile img = NULL;
+    JSAMPLE * volatile row = NULL;
+    int scale;
 
     // True color is mandatory for JPG!
     if (osl_pixelWidth[pixelFormat] <= 8) {
@@ -21,73 +131,82 @@ OSL_IMAGE *oslLoadImageFileJPG(char *filename, int location, int pixelFormat) {
 
     VIRTUAL_FILE *f = VirtualFileOpen((void*)filename, 0, VF_AUTO, VF_O_READ);
     if (!f) {
-        return NULL;
-    }
-
-    input = (const unsigned char *)oslReadEntireFileToMemory(f, &input_size);
-    input_free = input;
-    VirtualFileClose(f);
-
-    if (!input) {
-        return NULL;
-    }
-
-    FILE *infile = fmemopen((void *)input, input_size, "rb");
-    if (!infile) {
-        free((void*)input_free);
+        oslHandleLoadNoFailError(filename);
         return NULL;
     }
 
     struct jpeg_decompress_struct cinfo;
-    struct jpeg_error_mgr jerr;
+    OSL_JPG_ERROR jerr;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = oslJpgErrorExit;
+    jerr.pub.output_message = oslJpgOutputMessage;
+    if (setjmp(jerr.setjmpBuffer)) {
+        // Corrupted or unsupported file
+        if (img) {
+            oslDeleteImage(img);
+            img = NULL;
+        }
+        goto done;
+    }
 
-    cinfo.err = jpeg_std_error(&jerr);
     jpeg_create_decompress(&cinfo);
-    jpeg_stdio_src(&cinfo, infile);
+    oslJpgSourceVirtualFile(&cinfo, f);
     jpeg_read_header(&cinfo, TRUE);
 
-    // Create image structure
-    int width = cinfo.image_width;
-    int height = cinfo.image_height;
-    img = oslCreateImage(width, height, imgLocation, pixelFormat);
-
+    // Let the IDCT downscale pictures bigger than osl_jpgMaxSize (1/2, 1/4 or 1/8)
+    for (scale = 1; scale < 8; scale <<= 1) {
+        if ((int)(cinfo.image_width + scale - 1) / scale <= osl_jpgMaxSize && (int)(cinfo.image_height + scale - 1) / scale <= osl_jpgMaxSize)
+            break;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale;
+
+#ifdef JCS_ALPHA_EXTENSIONS
+    // libjpeg-turbo can write 8888 pixels itself
+    cinfo.out_color_space = pixelFormat == OSL_PF_8888 ? JCS_EXT_RGBA : JCS_RGB;
+#else
+    cinfo.out_color_space = JCS_RGB;
+#endif
+    jpeg_start_decompress(&cinfo);
+
+    img = oslCreateImage(cinfo.output_width, cinfo.output_height, imgLocation, pixelFormat);
     if (img) {
-        jpeg_start_decompress(&cinfo);
-        JSAMPROW row_pointer[1];
-        row_pointer[0] = (unsigned char *)malloc(cinfo.output_width * cinfo.num_components);
-
-        if (row_pointer[0]) {
-            int x;
-            while (cinfo.output_scanline < cinfo.image_height) {
-                jpeg_read_scanlines(&cinfo, row_pointer, 1);
-                for (x = 0; x < cinfo.image_width; x++) {
-                    unsigned int pixelValue = row_pointer[0][x * cinfo.num_components] |
-                                              (row_pointer[0][x * cinfo.num_components + 1] << 8) |
-                                              (row_pointer[0][x * cinfo.num_components + 2] << 16) |
-                                              (0xFF << 24); // Alpha channel
-                    oslSetImagePixel(img, x, cinfo.output_scanline - 1,
-                                     oslConvertColor(pixelFormat, OSL_PF_8888, pixelValue));
-                }
+        JSAMPROW rowPointer[1];
+        int direct = cinfo.out_color_space != JCS_RGB;
+
+        if (!direct) {
+            row = (JSAMPLE *)malloc(cinfo.output_width * cinfo.output_components);
+            if (!row) {
+                oslDeleteImage(img);
+                img = NULL;
+                goto done;
             }
-            free(row_pointer[0]);
-            jpeg_finish_decompress(&cinfo);
-        } else {
-            oslDeleteImage(img);
-            img = NULL;
         }
+
+        while (cinfo.output_scanline < cinfo.output_height) {
+            void *line = oslGetImageLine(img, cinfo.output_scanline);
+            rowPointer[0] = direct ? (JSAMPROW)line : row;
+            jpeg_read_scanlines(&cinfo, rowPointer, 1);
+            if (!direct)
+                oslJpgConvertRow(line, row, cinfo.output_width, pixelFormat);
+        }
+        jpeg_finish_decompress(&cinfo);
     }
 
+done:
     jpeg_destroy_decompress(&cinfo);
-    fclose(infile);
-    free((void*)input_free);
+    free(row);
+    VirtualFileClose(f);
 
     // Post-processing steps
     if (img != NULL && oslImageLocationIsSwizzled(location)) {
         oslSwizzleImage(img);
     }
-    oslUncacheImage(img);
 
-    if (!img) {
+    if (img) {
+        oslUncacheImage(img);
+    } else {
         oslHandleLoadNoFailError(filename);
     }
 
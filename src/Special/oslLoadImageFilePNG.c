@@ -15,6 +15,43 @@ void oslPngFlushFn(png_structp png_ptr) {
     // No operation
 }
 
+// How decoded PNG rows are turned into image rows
+typedef struct {
+    int width, pixelFormat;
+    int paletted;                                 // Indices copied as is (palette PNG loaded to a paletted format)
+    int gray;                                     // Gray images: black is transparent, other colors are opaque
+    int colorKey;                                 // Apply osl_colorKeyValue (images without alpha)
+} OSL_PNG_ROW_FORMAT;
+
+// Converts one decoded row (indices, or RGBA after libpng transforms) to the image pixel format
+static void oslPngConvertRow(const OSL_PNG_ROW_FORMAT *fmt, u8 *src, u8 *dst) {
+    int x;
+
+    if (fmt->paletted) {
+        if (fmt->pixelFormat == OSL_PF_8BIT)
+            memcpy(dst, src, fmt->width);
+        else {
+            // One index per byte (png_set_packing), even pixels go to the low nibble
+            for (x = 0; x < fmt->width; x += 2)
+                dst[x >> 1] = (src[x] & 15) | ((x + 1 < fmt->width ? src[x + 1] & 15 : 0) << 4);
+        }
+        return;
+    }
+
+    if (fmt->gray || fmt->colorKey) {
+        u32 *p = (u32 *)src, key = osl_colorKeyValue & 0x00ffffff;
+        for (x = 0; x < fmt->width; x++) {
+            u32 rgb = p[x] & 0x00ffffff;
+            if (fmt->gray)
+                p[x] = rgb ? rgb | 0xff000000 : 0;
+            else if (rgb == key)
+                p[x] = 0;
+        }
+    }
+
+    oslConvertImageRows(dst, 0, fmt->pixelFormat, src, 0, OSL_PF_8888, fmt->width, 1, NULL);
+}
+
 OSL_IMAGE *oslLoadImageFilePNG(char *filename, int location, int pixelFormat) {
     const size_t nSigSize = 8;
     u8 signature[nSigSize];
@@ -23,6 +60,12 @@ OSL_IMAGE *oslLoadImageFilePNG(char *filename, int location, int pixelFormat) {
     // We only keep the location bits
     int imgLocation = location & OSL_LOCATION_MASK;
     int i;
+    png_structp pPngStruct = NULL;
+    png_infop pPngInfo = NULL;
+    // Decoding buffers, kept out of the setjmp frame
+    u8 * volatile rowBuffer = NULL, * volatile band = NULL;
+    png_bytep * volatile rowTable = NULL;
+    OSL_IMAGE * volatile newImg = NULL;
 
     f = VirtualFileOpen((void *)filename, 0, VF_AUTO, VF_O_READ);
     if (!f) goto error;
@@ -31,10 +74,10 @@ OSL_IMAGE *oslLoadImageFilePNG(char *filename, int location, int pixelFormat) {
 
     if (!png_check_sig(signature, nSigSize)) goto error;
 
-    png_structp pPngStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    pPngStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!pPngStruct) goto error;
 
-    png_infop pPngInfo = png_create_info_struct(pPngStruct);
+    pPngInfo = png_create_info_struct(pPngStruct);
     if (!pPngInfo) {
         png_destroy_read_struct(&pPngStruct, NULL, NULL);
         goto error;
@@ -42,146 +85,140 @@ OSL_IMAGE *oslLoadImageFilePNG(char *filename, int location, int pixelFormat) {
 
     if (setjmp(png_jmpbuf(pPngStruct))) {
         png_destroy_read_struct(&pPngStruct, &pPngInfo, NULL);
+        free(rowBuffer);
+        free(band);
+        free(rowTable);
+        if (newImg) oslDeleteImage(newImg);
+        img = NULL;
         goto error;
     }
 
     png_set_read_fn(pPngStruct, f, oslPngReadFn);
     png_set_sig_bytes(pPngStruct, nSigSize);
-
-    if (osl_pixelWidth[pixelFormat] <= 8) {
-        png_read_png(pPngStruct, pPngInfo, PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_PACKING | PNG_TRANSFORM_BGR, NULL);
-    } else {
-        png_read_png(pPngStruct, pPngInfo, PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_PACKING | PNG_TRANSFORM_EXPAND | PNG_TRANSFORM_BGR, NULL);
-    }
+    png_read_info(pPngStruct, pPngInfo);
 
     png_uint_32 width = png_get_image_width(pPngStruct, pPngInfo);
     png_uint_32 height = png_get_image_height(pPngStruct, pPngInfo);
-    png_uint_32 depth = png_get_bit_depth(pPngStruct, pPngInfo);
     int color_type = png_get_color_type(pPngStruct, pPngInfo);
 
-    png_byte **pRowTable = png_get_rows(pPngStruct, pPngInfo);
-    png_colorp palette;
-    int num_palette;
+    png_colorp palette = NULL;
+    int num_palette = 0;
     png_get_PLTE(pPngStruct, pPngInfo, &palette, &num_palette);
 
+    OSL_PNG_ROW_FORMAT fmt;
     int wantedPixelFormat = pixelFormat;
 
+    fmt.width = width;
+    fmt.paletted = (color_type == PNG_COLOR_TYPE_PALETTE && num_palette && osl_pixelWidth[pixelFormat] <= 8);
+    fmt.gray = !(color_type & PNG_COLOR_MASK_COLOR);
+    fmt.colorKey = 0;
+
+    png_set_strip_16(pPngStruct);
+    png_set_packing(pPngStruct);
+    if (!fmt.paletted) {
+        // Everything else is decoded as RGBA, which is OSL_PF_8888 in memory
+        png_set_expand(pPngStruct);
+        png_set_gray_to_rgb(pPngStruct);
+        fmt.colorKey = osl_colorKeyEnabled && !fmt.gray && !(color_type & PNG_COLOR_MASK_ALPHA) && !png_get_valid(pPngStruct, pPngInfo, PNG_INFO_tRNS);
+        png_set_filler(pPngStruct, 0xff, PNG_FILLER_AFTER);
+    }
+    int passes = png_set_interlace_handling(pPngStruct);
+    png_read_update_info(pPngStruct, pPngInfo);
+
     // If we don't have a palette in the PNG but the pixel format requires one,
     // we load the image in 32-bit mode and convert it to paletted later with oslConvertImageTo.
-    if (!num_palette && osl_pixelWidth[pixelFormat] <= 8) {
+    if (!fmt.paletted && osl_pixelWidth[pixelFormat] <= 8) {
         pixelFormat = OSL_PF_8888;
-        img = oslCreateImage(width, height, OSL_IN_RAM, pixelFormat);
+        newImg = oslCreateImage(width, height, OSL_IN_RAM, pixelFormat);
     } else {
         // Otherwise, we create our image normally directly
-        img = oslCreateImage(width, height, imgLocation, pixelFormat);
+        newImg = oslCreateImage(width, height, imgLocation, pixelFormat);
     }
+    fmt.pixelFormat = pixelFormat;
 
-    if (img) {
+    if (newImg) {
         // If there is need for a palette ...
-        if (osl_pixelWidth[pixelFormat] <= 8) {
-            img->palette = oslCreatePalette(oslMin(num_palette, 1 << osl_paletteSizes[pixelFormat]), OSL_PF_8888);
-            if (img->palette) {
+        if (fmt.paletted) {
+            newImg->palette = oslCreatePalette(oslMin(num_palette, 1 << osl_paletteSizes[pixelFormat]), OSL_PF_8888);
+            if (newImg->palette) {
                 // Suggestion: consider num_trans?
-                for (i = 0; i < num_palette; i++) {
+                for (i = 0; i < (int)newImg->palette->nElements; i++) {
                     unsigned char r = palette[i].red;
                     unsigned char g = palette[i].green;
                     unsigned char b = palette[i].blue;
                     unsigned char a = 0xff;
                     // Color key?
                     if (osl_colorKeyEnabled && RGBA(r, g, b, 0) == (osl_colorKeyValue & 0x00ffffff)) a = 0;
-                    ((u32 *)img->palette->data)[i] = RGBA(r, g, b, a);
+                    ((u32 *)newImg->palette->data)[i] = RGBA(r, g, b, a);
                 }
-                oslUncachePalette(img->palette);
+                oslUncachePalette(newImg->palette);
             }
         }
 
-        u32 *p_dest4 = (u32 *)img->data;
-        u16 *p_dest2 = (u16 *)img->data;
-        u8 *p_dest1 = (u8 *)img->data;
-        int color_per_entry = 8 / depth;
-        int mask = (1 << depth) - 1;
-
-        for (u32 y = 0; y < height; ++y) {
-            const png_byte *pRow = pRowTable[y];
-            for (u32 x = 0; x < width; ++x) {
-                unsigned char r = 0, g = 0, b = 0, a = 0xff;
-                int pixel_value = 0;
-
-                switch (color_type) {
-                    case PNG_COLOR_TYPE_GRAY:
-                        r = g = b = *pRow++;
-                        if (!r && !g && !b) a = 0x00;
-                        break;
-                    case PNG_COLOR_TYPE_GRAY_ALPHA:
-                        r = g = b = *pRow++;
-                        if (!r && !g && !b) a = 0x00;
-                        pRow++;
-                        break;
-                    case PNG_COLOR_TYPE_RGB:
-                        b = *pRow++;
-                        g = *pRow++;
-                        r = *pRow++;
-                        if (osl_colorKeyEnabled && r == (osl_colorKeyValue & 0xff) && g == ((osl_colorKeyValue >> 8) & 0xff) && b == ((osl_colorKeyValue >> 16) & 0xff)) {
-                            a = r = g = b = 0;
-                        }
-                        break;
-                    case PNG_COLOR_TYPE_RGB_ALPHA:
-                        b = *pRow++;
-                        g = *pRow++;
-                        r = *pRow++;
-                        a = *pRow++;
-                        break;
-                    case PNG_COLOR_TYPE_PALETTE:
-                        pixel_value = (*pRow >> (8 - depth * ((x % color_per_entry) + 1))) & mask;
-                        // Last pixel for this byte
-                        if (x % color_per_entry == color_per_entry - 1) pRow++;
-                        if (img->palette) {
-                            r = ((u32 *)img->palette->data)[pixel_value] & 0xff;
-                            g = (((u32 *)img->palette->data)[pixel_value] >> 8) & 0xff;
-                            b = (((u32 *)img->palette->data)[pixel_value] >> 16) & 0xff;
-                            a = (((u32 *)img->palette->data)[pixel_value] >> 24) & 0xff;
-                        } else {
-                            b = palette[pixel_value].blue;
-                            g = palette[pixel_value].green;
-                            r = palette[pixel_value].red;
-                        }
-                        break;
-                }
+        size_t rowBytes = png_get_rowbytes(pPngStruct, pPngInfo);
+        int lineBytes = (newImg->realSizeX * osl_pixelWidth[pixelFormat]) >> 3;
+        // Swizzle each band of 8 rows as soon as it is decoded, unless the image is converted afterwards
+        int swizzle = oslImageLocationIsSwizzled(location) && wantedPixelFormat == pixelFormat;
+        u8 *dst = (u8 *)newImg->data;
+
+        if (passes > 1) {
+            // Interlaced images need all their rows until the last pass
+            rowTable = (png_bytep *)malloc(height * sizeof(png_bytep));
+            rowBuffer = (u8 *)malloc(height * rowBytes);
+            if (!rowTable || !rowBuffer) png_error(pPngStruct, "out of memory");
+            for (png_uint_32 y = 0; y < height; y++)
+                rowTable[y] = rowBuffer + y * rowBytes;
+            png_read_image(pPngStruct, rowTable);
+        } else {
+            rowBuffer = (u8 *)malloc(rowBytes);
+            if (!rowBuffer) png_error(pPngStruct, "out of memory");
+        }
 
-                if (pixelFormat == OSL_PF_8888) {
-                    p_dest4[x] = RGBA(r, g, b, a);
-                } else if (pixelFormat == OSL_PF_5650) {
-                    p_dest2[x] = RGB16(r, g, b);
-                } else if (pixelFormat == OSL_PF_5551) {
-                    p_dest2[x] = RGBA15(r, g, b, a);
-                } else if (pixelFormat == OSL_PF_4444) {
-                    p_dest2[x] = RGBA12(r, g, b, a);
-                } else if (pixelFormat == OSL_PF_8BIT) {
-                    p_dest1[x] = pixel_value;
-                } else if (pixelFormat == OSL_PF_4BIT) {
-                    p_dest1[x >> 1] &= ~(15 << ((x & 1) << 2));
-                    p_dest1[x >> 1] |= (pixel_value & 15) << ((x & 1) << 2);
-                }
-            }
+        if (swizzle) {
+            band = (u8 *)memalign(16, lineBytes * 8);
+            if (!band) png_error(pPngStruct, "out of memory");
+        }
 
-            p_dest1 += (img->realSizeX * osl_pixelWidth[pixelFormat]) >> 3;
-            p_dest2 += img->realSizeX;
-            p_dest4 += img->realSizeX;
+        for (png_uint_32 y = 0; y < newImg->realSizeY; y++) {
+            u8 *line = swizzle ? band + (y & 7) * lineBytes : dst + y * lineBytes;
+
+            if (y < height) {
+                u8 *src = rowBuffer;
+                if (passes > 1)
+                    src = rowTable[y];
+                else
+                    png_read_row(pPngStruct, src, NULL);
+                oslPngConvertRow(&fmt, src, line);
+            } else if (swizzle)
+                memset(line, 0, lineBytes);
+
+            if (swizzle && (y & 7) == 7)
+                oslSwizzleTexture(dst + (y & ~7) * lineBytes, band, lineBytes, 8);
         }
+        if (swizzle)
+            oslImageIsSwizzledSet(newImg, 1);
+
+        png_read_end(pPngStruct, NULL);
+        png_destroy_read_struct(&pPngStruct, &pPngInfo, NULL);
+        free(band);
+        free(rowTable);
+        free(rowBuffer);
+        img = newImg;
 
         // Finally convert to the paletted format
         if (wantedPixelFormat != pixelFormat) {
             img = oslConvertImageTo(img, imgLocation, wantedPixelFormat);
         }
 
-        png_destroy_read_struct(&pPngStruct, &pPngInfo, NULL);
-
-        if (oslImageLocationIsSwizzled(location)) {
+        if (img && oslImageLocationIsSwizzled(location)) {
             oslSwizzleImage(img);
         }
 
-        oslUncacheImage(img);
+        if (img)
+            oslUncacheImage(img);
     }
+    else
+        png_destroy_read_struct(&pPngStruct, &pPngInfo, NULL);
 
 error:
     if (f) VirtualFileClose(f);
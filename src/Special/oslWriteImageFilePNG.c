@@ -77,7 +77,7 @@ int oslWriteImageFilePNG(OSL_IMAGE *img, const char* filename, int flags) {
 
             switch (osl_pixelWidth[img->pixelFormat]) {
                 case 32:
-                    color = *(unsigned long*)ptr;
+                    color = *(u32*)ptr;
                     break;
                 case 16:
                     color = *(unsigned short*)ptr;
@@ -248,19 +248,43 @@ extern int osl_defaultVirtualFileSource;
 /** @brief Name of the temporary virtual file. */
 extern const char *osl_tempFileName;
 
+/**
+ * \brief Returns the size of a file.
+ *
+ * The size is found by seeking to the end of the file; the file position is restored afterwards.
+ *
+ * \param f Pointer to the virtual file.
+ *
+ * \return The size of the file in bytes, or -1 if its source cannot seek.
+ */
+extern int VirtualFileGetSize(VIRTUAL_FILE *f);
+
 /**
  * \brief Reads an entire file into memory.
  *
- * The memory block is allocated in steps of 4kB, so even a 1kB file will occupy 16kB.
- * This function is not recommended for opening a lot of small files.
+ * The file is read from the current position to its end. When the size of the file is known (see #VirtualFileGetSize), the
+ * memory block is allocated once; otherwise it starts at 4kB and doubles each time it is full.
  *
  * \param f Pointer to the virtual file.
  * \param size Pointer to an integer that will store the number of bytes read.
  *
- * \return A pointer to the memory block containing the file data.
+ * \return A pointer to the memory block containing the file data (free it with free), or NULL if there is not enough memory.
  */
 extern void *oslReadEntireFileToMemory(VIRTUAL_FILE *f, int *size);
 
+/**
+ * \brief Reads an entire file into a memory block provided by the caller.
+ *
+ * Same as #oslReadEntireFileToMemory but nothing is allocated, which is useful to load many files into one arena.
+ *
+ * \param f Pointer to the virtual file.
+ * \param buffer Memory block receiving the data.
+ * \param bufferSize Size of the block, in bytes.
+ *
+ * \return The number of bytes read, or -1 if the file does not fit in the block (its contents are then undefined).
+ */
+extern int oslReadEntireFileToBuffer(VIRTUAL_FILE *f, void *buffer, int bufferSize);
+
 /* Memory-based source handlers */
 extern int vfsMemOpen(void *param1, int param2, int type, int mode, VIRTUAL_FILE* f);
 extern int vfsMemClose(VIRTUAL_FILE *f);
@@ -0,0 +1,108 @@
+#include "oslib.h"
+
+/*
+    Sprite batching.
+    Sprites drawn with the same texture, palette and GE state are kept here and sent with a single sceGuDrawArray.
+    Anything that emits other GE commands (state changes, other primitives, oslEndDrawing) flushes the batch first,
+    so the drawing order is never changed.
+    Rotated images are triangle strips instead of sprites: consecutive strips are sent as one strip, joined by
+    degenerate (empty) triangles.
+*/
+
+#define OSL_BATCH_MAX_SPRITES 512
+// Room for 2 vertices per sprite of up to 16 bytes (fewer OSL_PRECISE_VERTEX, which are 20 bytes)
+#define OSL_BATCH_SIZE (OSL_BATCH_MAX_SPRITES * 2 * 16)
+
+int osl_spriteBatchEnabled = 0;
+int osl_spriteBatchCount = 0;
+int osl_drawCallCount = 0;
+
+static int osl_spriteBatchPrim, osl_spriteBatchVertexType, osl_spriteBatchVertexSize;
+// Slot waiting for a copy of the first vertex of the last strip (filled once the caller has written it), or -1
+static int osl_spriteBatchJoin = -1;
+static u32 osl_spriteBatchVertices[OSL_BATCH_SIZE / 4] __attribute__((aligned(16)));
+
+static void oslJoinBatchStrip() {
+    u8 *slot;
+
+    if (osl_spriteBatchJoin < 0)
+        return;
+    slot = (u8*)osl_spriteBatchVertices + osl_spriteBatchJoin * osl_spriteBatchVertexSize;
+    memcpy(slot, slot + osl_spriteBatchVertexSize, osl_spriteBatchVertexSize);
+    osl_spriteBatchJoin = -1;
+}
+
+void oslDrawSpriteBatch() {
+    int size = osl_spriteBatchCount * osl_spriteBatchVertexSize;
+    void *vertices;
+
+    if (!osl_spriteBatchCount)
+        return;
+
+    oslJoinBatchStrip();
+    vertices = sceGuGetMemory(size);
+    memcpy(vertices, osl_spriteBatchVertices, size);
+    sceKernelDcacheWritebackRange(vertices, size);
+
+    osl_drawCallCount++;
+    sceGuDrawArray(osl_spriteBatchPrim, osl_spriteBatchVertexType | GU_TRANSFORM_2D, osl_spriteBatchCount, 0, vertices);
+    osl_spriteBatchCount = 0;
+}
+
+void *oslAddBatchSprites(int vertexType, int vertexSize, int count) {
+    void *vertices;
+
+    // More sprites than the whole batch can hold are drawn by the caller
+    if (!osl_spriteBatchEnabled || count * 2 * vertexSize > OSL_BATCH_SIZE)
+        return NULL;
+
+    // Same primitive and vertex layout and room for the new vertices?
+    if (osl_spriteBatchCount && (osl_spriteBatchPrim != GU_SPRITES || vertexType != osl_spriteBatchVertexType
+            || (osl_spriteBatchCount + count * 2) * vertexSize > OSL_BATCH_SIZE))
+        oslDrawSpriteBatch();
+
+    osl_spriteBatchPrim = GU_SPRITES;
+    osl_spriteBatchVertexType = vertexType;
+    osl_spriteBatchVertexSize = vertexSize;
+    vertices = (u8*)osl_spriteBatchVertices + osl_spriteBatchCount * vertexSize;
+    osl_spriteBatchCount += count * 2;
+    return vertices;
+}
+
+void *oslAddBatchSprite(int vertexType, int vertexSize) {
+    return oslAddBatchSprites(vertexType, vertexSize, 1);
+}
+
+void *oslAddBatchStrip(int vertexType, int vertexSize, int count) {
+    u8 *base = (u8*)osl_spriteBatchVertices;
+    void *vertices;
+
+    // A strip bigger than the whole batch is drawn by the caller
+    if (!osl_spriteBatchEnabled || count * vertexSize > OSL_BATCH_SIZE)
+        return NULL;
+
+    // Same primitive and vertex layout and room for the strip and the two joining vertices?
+    if (osl_spriteBatchCount && (osl_spriteBatchPrim != GU_TRIANGLE_STRIP || vertexType != osl_spriteBatchVertexType
+            || (osl_spriteBatchCount + 2 + count) * vertexSize > OSL_BATCH_SIZE))
+        oslDrawSpriteBatch();
+
+    oslJoinBatchStrip();
+    if (osl_spriteBatchCount) {
+        // Repeat the last vertex of the previous strip, then the first one of this strip: the triangles in between are empty
+        memcpy(base + osl_spriteBatchCount * vertexSize, base + (osl_spriteBatchCount - 1) * vertexSize, vertexSize);
+        osl_spriteBatchJoin = osl_spriteBatchCount + 1;
+        osl_spriteBatchCount += 2;
+    }
+
+    osl_spriteBatchPrim = GU_TRIANGLE_STRIP;
+    osl_spriteBatchVertexType = vertexType;
+    osl_spriteBatchVertexSize = vertexSize;
+    vertices = base + osl_spriteBatchCount * vertexSize;
+    osl_spriteBatchCount += count;
+    return vertices;
+}
+
+void oslSetSpriteBatching(int enabled) {
+    oslFlushSpriteBatch();
+    osl_spriteBatchEnabled = enabled;
+}
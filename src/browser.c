@@ -72,6 +72,7 @@ void oslDrawBrowser()
 	case PSP_UTILITY_DIALOG_INIT:
 		break;                                                          //<-- STAS: We shouldn't show the browser in its INIT status!
 	case PSP_UTILITY_DIALOG_VISIBLE:
+		oslFlushSpriteBatch();
 		sceGuFinish();
 		sceGuSync(0,0);
 		sceUtilityHtmlViewerUpdate(1);
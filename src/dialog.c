@@ -109,6 +109,7 @@ void oslDrawDialog() {
 	switch (status) {
 	case PSP_UTILITY_DIALOG_INIT:
 	case PSP_UTILITY_DIALOG_VISIBLE:
+		oslFlushSpriteBatch();
 		sceGuFinish();
 		sceGuSync(0, 0);
 		if (dialogType == OSL_DIALOG_MESSAGE || dialogType == OSL_DIALOG_ERROR) {
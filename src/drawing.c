@@ -53,11 +53,11 @@ void oslSetAlpha2(u32 effect, u32 coeff1, u32 coeff2) {
 		effet = effect & ~OSL_FX_COLOR;
 
 		if (effet == OSL_FX_RGBA) {
-			sceGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_ONE_MINUS_SRC_ALPHA, 0, 0);
-			sceGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
-			sceGuAmbientColor(0xFFFFFFFF);
+			oslGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_ONE_MINUS_SRC_ALPHA, 0, 0);
+			oslGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
+			oslGuAmbientColor(0xFFFFFFFF);
 			osl_currentAlphaCoeff = 0xFFFFFFFF;
-			sceGuEnable(GU_BLEND);
+			oslGuEnable(GU_BLEND);
 			return;
 		}
 
@@ -67,51 +67,50 @@ void oslSetAlpha2(u32 effect, u32 coeff1, u32 coeff2) {
 
 		if (effet == OSL_FX_ALPHA) {
 			// Regular alpha blending
-			sceGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_ONE_MINUS_SRC_ALPHA, 0, 0);
-			sceGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
-			sceGuAmbientColor(coeff1);
+			oslGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_ONE_MINUS_SRC_ALPHA, 0, 0);
+			oslGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
+			oslGuAmbientColor(coeff1);
 			osl_currentAlphaCoeff = coeff1;
 		} else if (effet == OSL_FX_ADD) {
 			// Additive blending
-			sceGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_FIX, 0, coeff2);
-			sceGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
-			sceGuAmbientColor(coeff1);
+			oslGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_FIX, 0, coeff2);
+			oslGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
+			oslGuAmbientColor(coeff1);
 			osl_currentAlphaCoeff = coeff1;
 			osl_currentAlphaCoeff2 = coeff2;
 		} else if (effet == OSL_FX_SUB) {
 			// Subtractive blending
-			sceGuBlendFunc(GU_REVERSE_SUBTRACT, GU_SRC_ALPHA, GU_FIX, 0, coeff2);
-			sceGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
-			sceGuAmbientColor(coeff1);
+			oslGuBlendFunc(GU_REVERSE_SUBTRACT, GU_SRC_ALPHA, GU_FIX, 0, coeff2);
+			oslGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
+			oslGuAmbientColor(coeff1);
 			osl_currentAlphaCoeff = coeff1;
 			osl_currentAlphaCoeff2 = coeff2;
 		}
 
-		sceGuEnable(GU_BLEND);
+		oslGuEnable(GU_BLEND);
 	} else {
 		// Disable blending
 		osl_currentAlphaCoeff = 0xFFFFFFFF;
-		sceGuDisable(GU_BLEND);
+		oslGuDisable(GU_BLEND);
 	}
 }
 
 void oslSetAlphaWrite(int action, int value1, int value2) {
-#ifdef PSP
 	if (action == OSL_FXAW_SET) {
 		// Set the stencil function to always pass and replace the stencil buffer value with value1
+		oslFlushSpriteBatch();
 		sceGuStencilFunc(GU_ALWAYS, value1, 0xFF);
 		sceGuStencilOp(GU_KEEP, GU_REPLACE, GU_REPLACE);
-		sceGuEnable(GU_STENCIL_TEST);
+		oslGuEnable(GU_STENCIL_TEST);
 	} else if (action == OSL_FXAW_NONE) {
 		// Disable stencil testing, leaving the alpha channel unchanged
-		sceGuDisable(GU_STENCIL_TEST);
+		oslGuDisable(GU_STENCIL_TEST);
 	}
-#endif
 }
 
 void oslDisableTransparentColor() {
 	osl_colorKeyEnabled = 0;
-	sceGuDisable(GU_COLOR_TEST);
+	oslGuDisable(GU_COLOR_TEST);
 }
 
 void oslSetTransparentColor(OSL_COLOR color) {
@@ -119,8 +118,8 @@ void oslSetTransparentColor(OSL_COLOR color) {
 	osl_colorKeyValue = color;
 
 	// Set the color test function to mask out the specified color
-	sceGuColorFunc(GU_NOTEQUAL, color, 0xFFFFFFFF);
-	sceGuEnable(GU_COLOR_TEST);
+	oslGuColorFunc(GU_NOTEQUAL, color, 0xFFFFFFFF);
+	oslGuEnable(GU_COLOR_TEST);
 }
 
 int oslConvertColor(int pfDst, int pfSrc, int color) {
@@ -238,8 +237,10 @@ int oslConvertColorEx(OSL_PALETTE *p, int pfDst, int pfSrc, int color) {
 }
 
 void oslDrawTile(int u, int v, int x, int y, int tX, int tY) {
-	// Allocate memory for two vertices (bottom-left and top-right of the tile)
-	OSL_FAST_VERTEX *vertices = (OSL_FAST_VERTEX*)sceGuGetMemory(2 * sizeof(OSL_FAST_VERTEX));
+	// Add the tile to the batch, or allocate memory for two vertices (bottom-left and top-right of the tile)
+	OSL_FAST_VERTEX *vertices = (OSL_FAST_VERTEX*)oslAddBatchSprite(GU_TEXTURE_16BIT | GU_VERTEX_16BIT, sizeof(OSL_FAST_VERTEX));
+	if (vertices == NULL)
+		vertices = (OSL_FAST_VERTEX*)sceGuGetMemory(2 * sizeof(OSL_FAST_VERTEX));
 
 	// Set the properties for the first vertex (top-left corner of the tile)
 	vertices[0].u = u;
@@ -255,8 +256,9 @@ void oslDrawTile(int u, int v, int x, int y, int tX, int tY) {
 	vertices[1].y = y + tY;
 	vertices[1].z = 0;
 
-	// Draw the tile using the GU_SPRITES primitive, with texture and vertex data in 16-bit mode
-	sceGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
+	// Draw the tile using the GU_SPRITES primitive, with texture and vertex data in 16-bit mode (unless it is batched)
+	if (!osl_spriteBatchEnabled)
+		oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
 }
 
 void oslStartDrawing() {
@@ -266,6 +268,8 @@ void oslStartDrawing() {
 	}
 
 	osl_isDrawingStarted = 1;
+	osl_spriteBatchCount = 0;
+	osl_geSavedCommandCount = 0;
 	osl_curTexture = NULL;
 	osl_curPalette = NULL;
 	sceGuStart(GU_DIRECT, osl_list);
@@ -278,15 +282,22 @@ void oslEndDrawing() {
 	if (!osl_isDrawingStarted) {
 		return;
 	}
+	oslFlushSpriteBatch();
 	sceGuFinish();
 	sceGuSync(0, 0);
+	osl_residencyEpoch++;
+	// The GPU is done: intraFont may now replace the glyphs drawn so far
+	intraFontSetCacheFrame(osl_residencyEpoch);
 	osl_isDrawingStarted = 0;
 }
 
 void oslSyncDrawing() {
 	if (osl_isDrawingStarted) {
+		oslFlushSpriteBatch();
 		sceGuFinish();
 		sceGuSync(0, 0);
+		osl_residencyEpoch++;
+		intraFontSetCacheFrame(osl_residencyEpoch);
 		sceGuStart(GU_DIRECT, osl_list);
 	}
 }
@@ -320,7 +331,7 @@ void oslInitGfx(int pixelFormat, int bDoubleBuffer) {
 	sceGuDrawBuffer(pixelFormat, (void*)0, 512);
 
 	if (bDoubleBuffer) {
-		sceGuDispBuffer(480, 272, (void*)((0x22000 * osl_pixelWidth[pixelFormat]) >> 3), 512);
+		sceGuDispBuffer(480, 272, (void*)(uintptr_t)((0x22000 * osl_pixelWidth[pixelFormat]) >> 3), 512);
 		baseAdr = (u8*)(OSL_UVRAM_BASE + ((0x22000 * 2 * osl_pixelWidth[pixelFormat]) >> 3));
 		osl_curDrawBuf = (void*)OSL_UVRAM_BASE;
 		osl_curDispBuf = (void*)(OSL_UVRAM_BASE + ((0x22000 * osl_pixelWidth[pixelFormat]) >> 3));
@@ -332,8 +343,8 @@ void oslInitGfx(int pixelFormat, int bDoubleBuffer) {
 	}
 
 	// Set up depth buffer and other graphical settings
-	sceGuDepthBuffer((void*)((u32)baseAdr - (u32)OSL_UVRAM_BASE), 512);
-	baseAdr = (u8*)((u32)baseAdr + 0x22000 * 2);
+	sceGuDepthBuffer((void*)(baseAdr - OSL_UVRAM_BASE), 512);
+	baseAdr += 0x22000 * 2;
 	sceGuOffset(2048 - 480 / 2, 2048 - 272 / 2);
 	sceGuViewport(2048, 2048, 480, 272);
 	sceGuDepthRange(65535, 0);
@@ -345,22 +356,24 @@ void oslInitGfx(int pixelFormat, int bDoubleBuffer) {
 	sceGuShadeModel(GU_SMOOTH);
 	sceGuEnable(GU_CULL_FACE);
 	sceGuEnable(GU_CLIP_PLANES);
-	sceGuEnable(GU_BLEND);
-	sceGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_ONE_MINUS_SRC_ALPHA, 0, 0);
+
+	// The GE state is unknown (reinit or states set by someone else): send everything
+	oslInvalidateGeState();
+	oslGuEnable(GU_BLEND);
+	oslGuBlendFunc(GU_ADD, GU_SRC_ALPHA, GU_ONE_MINUS_SRC_ALPHA, 0, 0);
 
 	// Set texture and alpha settings
-	sceGuEnable(GU_TEXTURE_2D);
-	osl_textureEnabled = 1;
-	sceGuDisable(GU_ALPHA_TEST);
+	oslEnableTexturing();
+	oslGuDisable(GU_ALPHA_TEST);
 	osl_alphaTestEnabled = 0;
-	sceGuDisable(GU_DITHER);
+	oslGuDisable(GU_DITHER);
 	osl_ditheringEnabled = 0;
 	osl_bilinearFilterEnabled = 0;
 	oslSetTextureWrap(OSL_TW_REPEAT, OSL_TW_REPEAT);
 
 	// Initialize VRAM manager
 	oslVramMgrInit();
-	oslVramMgrSetParameters((void*)baseAdr, (u32)OSL_UVRAM_END - (u32)baseAdr);
+	oslVramMgrSetParameters((void*)baseAdr, OSL_UVRAM_END - baseAdr);
 
 	osl_isDrawingStarted = 0;
 
@@ -398,6 +411,11 @@ void oslInitGfx(int pixelFormat, int bDoubleBuffer) {
 
 void oslSwapBuffers()
 {
+#ifndef PSP
+	// The headless backend counts the GE work per frame
+	emuEndFrame();
+#endif
+
 	// Reset the user's draw buffer to OSL_DEFAULT_BUFFER if it's not already set
 	if (osl_curBuf != OSL_DEFAULT_BUFFER) {
 		oslSetDrawBuffer(OSL_DEFAULT_BUFFER);
@@ -422,6 +440,7 @@ void oslSwapBuffers()
 
 void oslSetBilinearFilter(int enabled)
 {
+	oslFlushSpriteBatch();
 	osl_bilinearFilterEnabled = enabled;
 	int filterMode = enabled ? GU_LINEAR : GU_NEAREST;
 	sceGuTexFilter(filterMode, filterMode);
@@ -430,38 +449,33 @@ void oslSetBilinearFilter(int enabled)
 void oslSetDithering(int enabled)
 {
 	osl_ditheringEnabled = enabled;
-	if (enabled) {
-		sceGuEnable(GU_DITHER);
-	} else {
-		sceGuDisable(GU_DITHER);
-	}
+	oslGuSetState(GU_DITHER, enabled);
 }
 
 void oslSetAlphaTest(int condition, int value)
 {
-	if (!osl_alphaTestEnabled) {
-		sceGuAlphaFunc(condition, value, 0xFF);
-		sceGuEnable(GU_ALPHA_TEST);
-		osl_alphaTestEnabled = 1;
-	}
+	// Always set the function: a new condition must apply even if the test is already enabled
+	oslGuAlphaFunc(condition, value, 0xFF);
+	oslGuEnable(GU_ALPHA_TEST);
+	osl_alphaTestEnabled = 1;
 }
 
 void oslDisableAlphaTest()
 {
-	if (osl_alphaTestEnabled) {
-		sceGuDisable(GU_ALPHA_TEST);
-		osl_alphaTestEnabled = 0;
-	}
+	oslGuDisable(GU_ALPHA_TEST);
+	osl_alphaTestEnabled = 0;
 }
 
 void oslClearScreen(int backColor)
 {
+	oslFlushSpriteBatch();
 	sceGuClearColor(backColor);
 	sceGuClear(GU_COLOR_BUFFER_BIT);
 }
 
 void oslSetScreenClipping(int x0, int y0, int x1, int y1)
 {
+	oslFlushSpriteBatch();
 	sceGuScissor(x0, y0, x1, y1);
 	sceGuEnable(GU_SCISSOR_TEST);
 }
@@ -478,10 +492,5 @@ void oslEndGfx()
 
 void oslSetDepthTest(int enabled)
 {
-	if (enabled) {
-		sceGuEnable(GU_DEPTH_TEST);
-	} else {
-		sceGuDisable(GU_DEPTH_TEST);
-	}
-	osl_alphaTestEnabled = enabled;
+	oslGuSetState(GU_DEPTH_TEST, enabled);
 }
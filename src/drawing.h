@@ -24,7 +24,7 @@ extern "C"
 /** \ingroup drawing_color
  * Represents a true color value in OSLib.
  */
-typedef unsigned long OSL_COLOR;
+typedef u32 OSL_COLOR;
 
 /** @defgroup drawing_main Main
  *
@@ -823,7 +823,7 @@ extern void oslDrawTile(int u, int v, int x, int y, int tX, int tY);
         @note The alignment ensures that the data structure is properly aligned in memory, which can be important for certain hardware optimizations.
 
  */
-	#define OSL_PALETTEDATA32 unsigned long __attribute__((aligned(16)))
+	#define OSL_PALETTEDATA32 u32 __attribute__((aligned(16)))
 
 /** @brief Structure representing a palette.
 
@@ -864,9 +864,12 @@ enum OSL_IMAGE_FLAGS
 {
 	OSL_IMAGE_SWIZZLED = 1,         ///< Image is swizzled
 	OSL_IMAGE_COPY = 2,                     ///< Image is a copy
-	OSL_IMAGE_AUTOSTRIP = 4         ///< Image can be automatically stripped (let it one)
+	OSL_IMAGE_AUTOSTRIP = 4,        ///< Image can be automatically stripped (let it one)
+	OSL_IMAGE_MANAGED = 8           ///< Image location is managed by the residency cache (OSL_IN_AUTO)
 };
 
+struct OSL_IMAGE_RESIDENCY;
+
 /** @brief Structure representing an image loaded in memory.
 
         This structure defines an image in OSLib, including various properties like dimensions, raw data, pixel format, and additional attributes used for drawing and transforming the image.
@@ -948,6 +951,7 @@ typedef struct
 	int centerX, centerY;              ///< Rotation center
 	int angle;                         ///< Angle (rotation) in degrees
 
+	struct OSL_IMAGE_RESIDENCY *residency;         ///< Residency cache entry (OSL_IN_AUTO images only)
 } OSL_IMAGE;
 
 /** @brief Flags indicating the memory location of an image and optional swizzling.
@@ -961,6 +965,8 @@ typedef struct
                 Places the image in VRAM (Video RAM), typically used for faster rendering.
         @param OSL_IN_RAM
                 Places the image in RAM (main system memory), offering more flexibility but potentially slower access.
+        @param OSL_IN_AUTO
+                Lets OSLib choose: the image starts in RAM, is promoted to VRAM when it is drawn often and is evicted back to RAM when VRAM is needed by more recently drawn images. See #OSL_IMAGE_RESIDENCY.
         @param OSL_LOCATION_MASK
                 A mask value that covers all potential locations, ensuring compatibility with future location types.
         @param OSL_SWIZZLED
@@ -974,6 +980,7 @@ typedef enum OSL_LOCATION_FLAGS
 	OSL_IN_NONE = 0,                ///< Doesn't exist
 	OSL_IN_VRAM = 1,                ///< In VRAM
 	OSL_IN_RAM = 2,                 ///< In RAM
+	OSL_IN_AUTO = 3,                ///< Managed: in RAM or VRAM depending on how often it is drawn. Never stored in OSL_IMAGE::location, which is always the current place.
 	OSL_LOCATION_MASK = 7,          ///< There will probably never be more than 8 locations...
 	OSL_SWIZZLED = 8,               ///< Directly swizzle image (only works for oslLoadImage[...] functions!)
 	OSL_UNSWIZZLED = 16             ///< Force no swizzling (oslLoadImage[...])
@@ -1112,8 +1119,7 @@ extern OSL_IMAGE *oslLoadImageFilePNG(char *filename, int location, int pixelFor
 /**
  * @brief Loads an image from a JPG file.
  *
- * This function loads an image from a specified JPG file, with options to select the memory location and pixel format. It is optimized for JPG files, but the decompression is limited and may not support
- * high-quality JPGs.
+ * This function loads an image from a specified JPG file, with options to select the memory location and pixel format. JPG images are always true color, paletted formats are not supported.
  *
  * @param filename
  *        The path to the JPG file to be loaded.
@@ -1125,20 +1131,26 @@ extern OSL_IMAGE *oslLoadImageFilePNG(char *filename, int location, int pixelFor
  *        The pixel format for the image. This determines the color depth and memory usage of the loaded image.
  *
  * @return
- *        Returns a pointer to an `OSL_IMAGE` structure representing the loaded JPG image. If the image fails to load (e.g., due to an invalid file path, unsupported format, or high-quality JPG),
+ *        Returns a pointer to an `OSL_IMAGE` structure representing the loaded JPG image. If the image fails to load (e.g., due to an invalid file path, unsupported format, or corrupted file),
  *        the function returns `NULL`.
  *
  * @note
  * Always check if the returned image pointer is `NULL` before using it to avoid crashes. Display a user-friendly message if the image fails to load, advising the user to check their files.
  *
- * @warning
- * The JPG decompressor in this function is simple and does not support JPG files with a quality factor higher than 90%. Loading such files may cause the function to crash. Ensure that users are aware of
- * this limitation in your instructions.
+ * @note
+ * Pictures wider or taller than `osl_jpgMaxSize` (512 by default) are decoded at 1/2, 1/4 or 1/8 of their size, whichever is the first to fit. The file is decoded as it is read, it is never
+ * loaded entirely in memory.
  *
- * @see oslLoadImageFile
+ * @see oslLoadImageFile, oslSetJpgMaxSize
  */
 extern OSL_IMAGE *oslLoadImageFileJPG(char *filename, int location, int pixelFormat);
 
+/** Largest width or height of a JPG image before #oslLoadImageFileJPG decodes it at a reduced scale. 512 by default, the biggest texture the PSP supports. */
+extern int osl_jpgMaxSize;
+
+/** Sets the size above which JPG images are decoded at 1/2, 1/4 or 1/8 of their size (see #oslLoadImageFileJPG). */
+#define oslSetJpgMaxSize(size) (osl_jpgMaxSize = (size))
+
 /**
  * @brief Loads an image from a GIF file.
  *
@@ -1272,7 +1284,12 @@ extern void oslFreeImageData(OSL_IMAGE *img);
  *    \endcode
  *    This will result in `vramAddress` being `0x12345678 | 0x04000000`.
  */
+	#ifdef PSP
 	#define oslAddVramPrefixPtr(adr) ((void *)((int)(adr) | 0x04000000))
+	#else
+	// The host VRAM is a plain buffer at OSL_UVRAM_BASE: GE addresses are offsets in it
+	#define oslAddVramPrefixPtr(adr) ((void *)((uintptr_t)(adr) < OSL_UVRAM_SIZE ? OSL_UVRAM_BASE + (uintptr_t)(adr) : (u8 *)(adr)))
+	#endif
 
 /**
  * @brief Removes the VRAM prefix from an address.
@@ -1291,7 +1308,11 @@ extern void oslFreeImageData(OSL_IMAGE *img);
  *    \endcode
  *    This will result in `originalAddress` being `0x12345678`.
  */
+	#ifdef PSP
 	#define oslRemoveVramPrefixPtr(adr) ((void *)((int)(adr) & (~0x04000000)))
+	#else
+	#define oslRemoveVramPrefixPtr(adr) ((void *)((u8 *)(adr) >= OSL_UVRAM_BASE && (u8 *)(adr) < OSL_UVRAM_END ? (uintptr_t)((u8 *)(adr) - OSL_UVRAM_BASE) : (uintptr_t)(adr)))
+	#endif
 
 /**
  * @brief Checks if an image location is swizzled.
@@ -1309,6 +1330,55 @@ extern void oslFreeImageData(OSL_IMAGE *img);
  */
 extern int oslImageLocationIsSwizzled(int location);
 
+/** @brief Residency cache entry of an image created with #OSL_IN_AUTO.
+
+        Images created in #OSL_IN_AUTO are kept in a list sorted by last use. oslSetTexture counts a hit when the image is already in VRAM and a miss when it is drawn from RAM;
+        once it has been drawn in #osl_residencyPromoteThreshold different frames, it is moved to VRAM. When VRAM is full (for any image allocation), the least recently drawn
+        managed images are moved back to RAM to make room. Images drawn since the last GE synchronization (i.e. in the current frame) are never evicted.
+
+        \code
+        OSL_IMAGE *img = oslLoadImageFilePNG("sprite.png", OSL_IN_AUTO, OSL_PF_5551);
+        [...]
+        oslDebug("hits: %i, misses: %i", img->residency->hits, img->residency->misses);
+        \endcode
+ */
+typedef struct OSL_IMAGE_RESIDENCY
+{
+	OSL_IMAGE *img;                                 ///< Original image (copies made with oslCreateImageTile share this entry)
+	struct OSL_IMAGE_RESIDENCY *prev, *next;        ///< LRU list, most recently used first
+	u32 lastUse;                                    ///< Value of osl_residencyEpoch when the image was last drawn
+	u32 useCount;                                   ///< Number of frames where the image was drawn from RAM since its last eviction
+	u32 hits;                                       ///< Number of times the image has been set as texture from VRAM
+	u32 misses;                                     ///< Number of times the image has been set as texture from RAM
+	u32 promotions;                                 ///< Number of times the image has been moved to VRAM
+	u32 evictions;                                  ///< Number of times the image has been moved back to RAM
+} OSL_IMAGE_RESIDENCY;
+
+/** Number of frames an #OSL_IN_AUTO image must be drawn in before it is promoted to VRAM (2 by default). */
+extern int osl_residencyPromoteThreshold;
+
+/** Sets #osl_residencyPromoteThreshold. 1 promotes images as soon as they are drawn. */
+	#define oslSetResidencyPromoteThreshold(frames) (osl_residencyPromoteThreshold = (frames))
+
+/** Incremented each time the GE has finished executing the display list (oslEndDrawing, oslSyncDrawing). Images last drawn before can be moved safely. */
+extern u32 osl_residencyEpoch;
+
+/** Returns a nonzero value if the location of the image is managed by the residency cache. */
+	#define oslImageIsManaged(img) ((img)->flags & OSL_IMAGE_MANAGED)
+
+/** Adds an image to the residency cache. For internal use, called by oslAllocImageData for #OSL_IN_AUTO. */
+extern int oslRegisterManagedImage(OSL_IMAGE *img);
+
+/** Removes an image from the residency cache. For internal use, called by oslDeleteImage. */
+extern void oslUnregisterManagedImage(OSL_IMAGE *img);
+
+/** Records a use of a managed image and promotes it to VRAM if needed. For internal use, called by oslSetTexture. */
+extern void oslTouchManagedImage(OSL_IMAGE *img);
+
+/** Moves the least recently used managed images back to RAM until a block of the given size can be allocated in VRAM.
+        @return 1 if such a block is available, 0 otherwise. */
+extern int oslEvictManagedImages(int size);
+
 /** @defgroup image_drawing Drawing images
  *
  * Image support in OSLib.
@@ -2042,6 +2112,77 @@ extern OSL_IMAGE *oslCreateImageTileSize(OSL_IMAGE *img, int offsetX0, int offse
  */
 extern OSL_IMAGE *oslConvertImageTo(OSL_IMAGE *imgOriginal, int newLocation, int newFormat);
 
+/** Converts a rectangle of raw pixels from one pixel format to another.
+
+        @param dst
+                Destination pixels.
+        @param dstPitch
+                Distance in bytes between two rows of the destination.
+        @param pfDst
+                Pixel format of the destination.
+        @param src
+                Source pixels. Must not overlap the destination unless both formats have the same size.
+        @param srcPitch
+                Distance in bytes between two rows of the source.
+        @param pfSrc
+                Pixel format of the source.
+        @param width, height
+                Size of the rectangle, in pixels.
+        @param palette
+                Palette of the source if it is paletted (OSL_PF_4BIT / OSL_PF_8BIT), or of the destination if only the destination is paletted. May be NULL.
+
+        Each pair of pixel formats has its own row routine, so this is much faster than calling #oslConvertColor for each pixel, and gives the same results.
+        A paletted source is expanded through its palette; a truecolor source converted to a paletted format uses the index of the exact color in the palette
+        (0 if it is not present). 4-bit rows must start on an even pixel. The data is accessed through the cache, so call oslUncacheData on the destination
+        if the GPU will read it.
+*/
+extern void oslConvertImageRows(void *dst, int dstPitch, int pfDst, const void *src, int srcPitch, int pfSrc, int width, int height, OSL_PALETTE *palette);
+
+/** Reads pixels of a row of an image and converts them to a given pixel format.
+
+        @param img
+                Image to read from. Can be swizzled.
+        @param x, y
+                Position of the first pixel to read.
+        @param count
+                Number of pixels to read. The part outside of the image is skipped.
+        @param dst
+                Linear buffer receiving the pixels.
+        @param pfDst
+                Pixel format of the buffer. A paletted image is expanded through its own palette.
+
+        This is the bulk equivalent of #oslGetImagePixel + #oslConvertColor, see #oslConvertImageRows. The data is read through the cache: if the GPU
+        has drawn to the image, call #oslUncacheImage first.
+*/
+extern void oslReadImageRow(OSL_IMAGE *img, int x, int y, int count, void *dst, int pfDst);
+
+/** Converts pixels to the format of an image and writes them to one of its rows. Pixels falling outside of the image are skipped.
+The image can be swizzled. The data goes through the cache, so call #oslUncacheImage when you're done writing to it. */
+extern void oslWriteImageRow(OSL_IMAGE *img, int x, int y, int count, const void *src, int pfSrc);
+
+/** Fills a paletted image and its palette from another image.
+
+        @param dst
+                Destination image, in OSL_PF_4BIT or OSL_PF_8BIT, not swizzled, at least as large as src, with an OSL_PF_8888 palette.
+        @param src
+                Source image, in any format.
+        @param dither
+                If the colors have to be reduced, spreads the error with Floyd-Steinberg dithering instead of just taking the nearest color.
+
+        If src has no more colors than the palette can hold, each of them gets its own entry. Otherwise a palette is computed with a median cut (alpha
+        included) and each pixel uses the nearest entry. This is what #oslConvertImageTo uses for paletted formats.
+
+        @return
+                1 on success, 0 if dst is not suitable or memory ran out.
+*/
+extern int oslQuantizeImage(OSL_IMAGE *dst, OSL_IMAGE *src, int dither);
+
+/** Whether #oslConvertImageTo dithers images which have more colors than the target palette. Disabled by default. */
+extern int osl_quantizeDithering;
+
+/** Enables or disables dithering when #oslConvertImageTo has to reduce the number of colors of an image. */
+#define oslSetQuantizeDithering(enabled) (osl_quantizeDithering = (enabled))
+
 /** Creates a copy of an image.
 
         @param src
@@ -2295,6 +2436,7 @@ extern void oslResetImageProperties(OSL_IMAGE *img);
                 The height of the scaled source image.
 
         This function scales the source image (srcImg) and draws it onto the destination image (dstImg) at the specified position and with the specified dimensions.
+        Each destination pixel is the average of the source area it covers (#OSL_SCALE_BOX); use #oslScaleImageEx for other filters.
 
         Example usage:
         \code
@@ -2306,6 +2448,40 @@ extern void oslResetImageProperties(OSL_IMAGE *img);
  */
 extern void oslScaleImage(OSL_IMAGE *dstImg, OSL_IMAGE *srcImg, int newX, int newY, int newWidth, int newHeight);
 
+/** Resampling filters for #oslScaleImageEx and #oslCreateImageMipChain. */
+enum OSL_SCALE_FILTERS
+{
+	OSL_SCALE_BOX = 0,                 ///< Average of the covered area. Sharp when enlarging, the reference for shrinking.
+	OSL_SCALE_BILINEAR,                ///< Triangle filter. Smooth, a bit blurry.
+	OSL_SCALE_BICUBIC,                 ///< Catmull-Rom cubic. Sharper than bilinear.
+	OSL_SCALE_LANCZOS2                 ///< Lanczos with 2 lobes. Sharpest, may ring slightly on hard edges.
+};
+
+/** Same as #oslScaleImage, with a choice of resampling filter (one of #OSL_SCALE_FILTERS).
+
+        The scaler is separable and works in fixed point on whole rows: each source row is read once, scaled horizontally, then combined with its
+        neighbours vertically. When shrinking, filters are widened so that every source pixel contributes.
+ */
+extern void oslScaleImageEx(OSL_IMAGE *dstImg, OSL_IMAGE *srcImg, int newX, int newY, int newWidth, int newHeight, int filter);
+
+/** Creates the mipmaps of an image: each level is half the size of the previous one, down to 1x1.
+
+        @param img
+                Source image (level 0, not modified).
+        @param levels
+                Receives the created images, starting from the half-size one.
+        @param maxLevels
+                Maximum number of levels to create (8 covers a 512x512 image down to 2x2).
+        @param location
+                Location of the new levels, may include OSL_SWIZZLED.
+        @param filter
+                Resampling filter, OSL_SCALE_BOX gives the usual 2x2 average.
+
+        @return
+                Number of levels created. They are normal images that you have to delete with #oslDeleteImage. Paletted images get a new palette per level.
+ */
+extern int oslCreateImageMipChain(OSL_IMAGE *img, OSL_IMAGE **levels, int maxLevels, int location, int filter);
+
 /** Creates a scaled copy of an image.
 
         @param img
@@ -3212,28 +3388,115 @@ static inline void oslImageSetAutoStrip(OSL_IMAGE *img, bool enabled)
         As you can see, drawing with GU is straightforward if you are familiar with it. For those new to GU, it is recommended to review tutorials and examples available on ps2dev.org for a deeper understanding.
  */
 
-	#ifdef PSP
-/** Disables texturing, making the image opaque and drawn using vertex colors. */
-	#define oslEnableTexturing() ({ if (!osl_textureEnabled)  sceGuEnable(GU_TEXTURE_2D), osl_textureEnabled = 1; })
+/** @defgroup drawing_lowlev_batch Sprite batching
 
-/** Enables texturing. This function should not be called directly; it is managed by oslSetTexture. */
-	#define oslDisableTexturing() ({ if (osl_textureEnabled)  sceGuDisable(GU_TEXTURE_2D), osl_textureEnabled = 0; })
+        When sprite batching is enabled, #oslDrawImage (rotated or not), #oslDrawImageSimple, #oslDrawTile and text drawn with
+        OFT fonts don't send a draw command per sprite. Consecutive sprites sharing the same texture, palette and GE state are
+        accumulated and sent with a single sceGuDrawArray, when the state changes or at #oslEndDrawing.
 
-	#else
-/** Disables texturing, making the image opaque and drawn using vertex colors. */
-	#define oslEnableTexturing()                                    \
-		{                                                           \
-			if (!osl_textureEnabled)                                \
-			sceGuEnable(GU_TEXTURE_2D), osl_textureEnabled = 1; \
-		}
+        Every OSLib function which sends GE commands flushes the pending sprites first, and so do the intraFont print functions. If you send GE commands yourself
+        (sceGu* functions) while batching is enabled, call #oslFlushSpriteBatch before, else the pending sprites would be
+        drawn after your commands.
+
+        \code
+        oslSetSpriteBatching(1);
+        oslStartDrawing();
+        osl_drawCallCount = 0;
+        for (i = 0; i < nbSprites; i++)
+                oslDrawImageXY(sprite, spriteX[i], spriteY[i]);
+        oslEndDrawing();
+        // osl_drawCallCount is now 1 instead of nbSprites
+        \endcode
+        @{
+*/
+
+/** Enables or disables sprite batching. Disabled by default. */
+extern void oslSetSpriteBatching(int enabled);
+
+/** Sends the pending sprites to the GE. Only needed before sending GE commands yourself. */
+#define oslFlushSpriteBatch() ({ if (osl_spriteBatchCount) oslDrawSpriteBatch(); })
+
+/** Number of draw commands (sceGuDrawArray) sent by OSLib. It is never reset by OSLib, set it to 0 at the beginning of a frame to count the commands of that frame. */
+extern int osl_drawCallCount;
+
+/** Whether sprite batching is enabled (read only, use #oslSetSpriteBatching). */
+extern int osl_spriteBatchEnabled;
+
+/** Number of vertices waiting in the sprite batch (read only). */
+extern int osl_spriteBatchCount;
+
+/** Sends the pending sprites. Use #oslFlushSpriteBatch instead. */
+extern void oslDrawSpriteBatch();
+
+/** Reserves room for the two vertices of a sprite in the batch. vertexType is the sceGuDrawArray vertex description (without GU_TRANSFORM_2D)
+        and vertexSize the size of one vertex. Returns NULL if batching is disabled; the sprite must then be drawn normally. */
+extern void *oslAddBatchSprite(int vertexType, int vertexSize);
+
+/** Same as #oslAddBatchSprite for count sprites (2 * count vertices). Returns NULL if batching is disabled or if they don't fit in the batch. */
+extern void *oslAddBatchSprites(int vertexType, int vertexSize, int count);
+
+/** Reserves room for a triangle strip of count vertices in the batch; count must be even so that all strips keep the same facing.
+        Consecutive strips are sent as a single strip. Returns NULL if batching is disabled or if the strip doesn't fit in the batch;
+        the strip must then be drawn normally. */
+extern void *oslAddBatchStrip(int vertexType, int vertexSize, int count);
+
+/** sceGuDrawArray for OSLib drawing functions: flushes the pending sprites and counts the command in #osl_drawCallCount. */
+#define oslGuDrawArray(prim, vtype, count, indices, vertices) ({ oslFlushSpriteBatch(); osl_drawCallCount++; sceGuDrawArray(prim, vtype, count, indices, vertices); })
+
+/** @} */ // end of drawing_lowlev_batch
+
+/** @defgroup drawing_lowlev_state GE state cache
+
+        OSLib remembers the last value it sent for the render states it uses (texturing, blending, alpha, color and depth test, texture
+        function, texture and palette mode...). Setting a state to the value it already has sends nothing: no command is written
+        to the display list and the sprite batch isn't interrupted. The number of commands spared this way is counted in
+        #osl_geSavedCommandCount.
+
+        The functions below are the sceGu functions of the same name going through this cache. If you change one of these states
+        with the sceGu functions yourself (or with another library), call #oslInvalidateGeState afterwards so that OSLib sends them
+        again the next time it needs them. The intraFont print functions do it themselves.
+
+        Shapes (#oslDrawLine, #oslDrawRect, #oslDrawFillRect, #oslDrawGradientRect...) and text backgrounds disable texturing and leave it
+        disabled, while the OSLib functions that draw textures enable it again. Before drawing textured primitives with the sceGu functions
+        after an OSLib shape, call #oslEnableTexturing.
+        @{
+*/
+
+/** Number of GE commands which were not sent because the state was already set. #oslStartDrawing resets it, so after #oslEndDrawing
+        it holds the commands saved while drawing that frame. */
+extern int osl_geSavedCommandCount;
+
+/** Forgets the cached state: everything will be sent again the next time it is set. Call it after changing GE states yourself. */
+extern void oslInvalidateGeState();
+
+/** sceGuEnable / sceGuDisable through the cache. */
+extern void oslGuSetState(int state, int enabled);
+/** sceGuEnable through the cache. */
+#define oslGuEnable(state)              oslGuSetState(state, 1)
+/** sceGuDisable through the cache. */
+#define oslGuDisable(state)             oslGuSetState(state, 0)
+/** sceGuBlendFunc through the cache. The fixed colors are only compared when GU_FIX is used. */
+extern void oslGuBlendFunc(int op, int src, int dest, u32 srcFix, u32 destFix);
+/** sceGuAlphaFunc through the cache. */
+extern void oslGuAlphaFunc(int func, int value, int mask);
+/** sceGuColorFunc through the cache. */
+extern void oslGuColorFunc(int func, u32 color, u32 mask);
+/** sceGuTexFunc through the cache. */
+extern void oslGuTexFunc(int tfx, int tcc);
+/** sceGuAmbientColor through the cache. */
+extern void oslGuAmbientColor(u32 color);
+/** sceGuTexMode through the cache. */
+extern void oslGuTexMode(int psm, int maxMips, int a2, int swizzle);
+/** sceGuClutMode through the cache. */
+extern void oslGuClutMode(u32 psm, u32 shift, u32 mask, u32 a3);
+
+/** @} */ // end of drawing_lowlev_state
 
 /** Enables texturing. This function should not be called directly; it is managed by oslSetTexture. */
-	#define oslDisableTexturing()                                    \
-		{                                                            \
-			if (osl_textureEnabled)                                  \
-			sceGuDisable(GU_TEXTURE_2D), osl_textureEnabled = 0; \
-		}
-	#endif
+#define oslEnableTexturing() oslGuEnable(GU_TEXTURE_2D)
+
+/** Disables texturing, making the image opaque and drawn using vertex colors. */
+#define oslDisableTexturing() oslGuDisable(GU_TEXTURE_2D)
 
 /**
  * Defines the maximum width of an image stripe for efficient drawing.
@@ -3286,6 +3549,7 @@ extern int osl_currentTexWrapV;
  */
 static inline void oslSetTextureWrap(int u, int v)
 {
+	oslFlushSpriteBatch();
 	sceGuTexWrap(u, v);                   // Set texture wrapping modes
 	osl_currentTexWrapU = u;              // Update current U wrap mode
 	osl_currentTexWrapV = v;              // Update current V wrap mode
@@ -3445,7 +3709,7 @@ typedef struct
 typedef struct
 {
 	unsigned short u, v;          ///< Texture coordinates (16-bit)
-	unsigned long color;          ///< Color value (32-bit)
+	u32 color;          ///< Color value (32-bit)
 	short x, y, z;          ///< Spatial coordinates (16-bit)
 } OSL_FAST_VERTEX_COLOR32;
 
@@ -3456,7 +3720,7 @@ typedef struct
  */
 typedef struct
 {
-	unsigned long color;          ///< Color value (32-bit)
+	u32 color;          ///< Color value (32-bit)
 	short x, y, z;          ///< Spatial coordinates (16-bit)
 } OSL_LINE_VERTEX;
 
@@ -3467,7 +3731,7 @@ typedef struct
  */
 typedef struct
 {
-	unsigned long color;          ///< Color value (32-bit)
+	u32 color;          ///< Color value (32-bit)
 	short x, y, z;          ///< Spatial coordinates (16-bit)
 } OSL_LINE_VERTEX_COLOR32;
 
@@ -0,0 +1,392 @@
+#ifndef _OSL_EMU_H_
+#define _OSL_EMU_H_
+
+/*
+    Headless host backend.
+    Included by oslib.h when PSP is not defined. It provides the PSPSDK types, constants and functions used by OSLib;
+    the sceGu* functions don't draw anything but write the display list and count what the GE would have to process,
+    so that the drawing code can be profiled on a PC (see emu/emuGu.c).
+*/
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <sys/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+    PSPSDK types
+*/
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef int SceUID;
+typedef unsigned int SceSize;
+typedef int SceMode;
+typedef s64 SceOff;
+
+typedef struct ScePspFVector2 { float x, y; } ScePspFVector2;
+typedef struct ScePspFVector3 { float x, y, z; } ScePspFVector3;
+typedef struct ScePspFVector4 { float x, y, z, w; } __attribute__((aligned(16))) ScePspFVector4;
+typedef struct ScePspIVector4 { int x, y, z, w; } __attribute__((aligned(16))) ScePspIVector4;
+typedef struct ScePspFMatrix4 { ScePspFVector4 x, y, z, w; } __attribute__((aligned(16))) ScePspFMatrix4;
+
+typedef struct SceCtrlData {
+    unsigned int TimeStamp;
+    unsigned int Buttons;
+    unsigned char Lx;
+    unsigned char Ly;
+    unsigned char Rsrv[6];
+} SceCtrlData;
+
+/* Only needed to declare OSL_OSK; the on-screen keyboard is not available on the host */
+typedef struct SceUtilityOskParams {
+    unsigned int size;
+} SceUtilityOskParams;
+
+/* Module declarations of the samples */
+#define PSP_MODULE_INFO(name, attributes, major, minor)
+#define PSP_MAIN_THREAD_ATTR(attr)
+#define PSP_HEAP_SIZE_KB(size_kb)
+#define PSP_THREAD_ATTR_USER 0x80000000
+#define PSP_THREAD_ATTR_VFPU 0x00004000
+
+#define PSP_CTRL_HOME 0x010000
+
+#define PSP_O_RDONLY 0x0001
+#define PSP_O_WRONLY 0x0002
+#define PSP_O_RDWR   (PSP_O_RDONLY | PSP_O_WRONLY)
+#define PSP_O_APPEND 0x0100
+#define PSP_O_CREAT  0x0200
+#define PSP_O_TRUNC  0x0400
+
+#define PSP_SEEK_SET 0
+#define PSP_SEEK_CUR 1
+#define PSP_SEEK_END 2
+
+#define PSP_UTILITY_DIALOG_NONE     0
+#define PSP_UTILITY_DIALOG_INIT     1
+#define PSP_UTILITY_DIALOG_VISIBLE  2
+#define PSP_UTILITY_DIALOG_QUIT     3
+#define PSP_UTILITY_DIALOG_FINISHED 4
+
+#define PSP_UTILITY_OSK_RESULT_UNCHANGED 0
+#define PSP_UTILITY_OSK_RESULT_CANCELLED 1
+#define PSP_UTILITY_OSK_RESULT_CHANGED   2
+
+#define PSP_USB_CONNECTION_ESTABLISHED 0x002
+#define PSP_USB_CABLE_CONNECTED        0x020
+#define PSP_USB_ACTIVATED              0x200
+
+#define PSP_NET_APCTL_STATE_DISCONNECTED 0
+#define PSP_NET_APCTL_STATE_SCANNING     1
+#define PSP_NET_APCTL_STATE_JOINING      2
+#define PSP_NET_APCTL_STATE_GETTING_IP   3
+#define PSP_NET_APCTL_STATE_GOT_IP       4
+#define PSP_NET_APCTL_STATE_EAP_AUTH     5
+#define PSP_NET_APCTL_STATE_KEY_EXCHANGE 6
+
+/*
+    GU constants (same values as pspgu.h)
+*/
+#define GU_PI ((float)3.141593f)
+
+#define GU_POINTS         0
+#define GU_LINES          1
+#define GU_LINE_STRIP     2
+#define GU_TRIANGLES      3
+#define GU_TRIANGLE_STRIP 4
+#define GU_TRIANGLE_FAN   5
+#define GU_SPRITES        6
+
+#define GU_ALPHA_TEST         0
+#define GU_DEPTH_TEST         1
+#define GU_SCISSOR_TEST       2
+#define GU_STENCIL_TEST       3
+#define GU_BLEND              4
+#define GU_CULL_FACE          5
+#define GU_DITHER             6
+#define GU_FOG                7
+#define GU_CLIP_PLANES        8
+#define GU_TEXTURE_2D         9
+#define GU_LIGHTING           10
+#define GU_LIGHT0             11
+#define GU_LIGHT1             12
+#define GU_LIGHT2             13
+#define GU_LIGHT3             14
+#define GU_LINE_SMOOTH        15
+#define GU_PATCH_CULL_FACE    16
+#define GU_COLOR_TEST         17
+#define GU_COLOR_LOGIC_OP     18
+#define GU_FACE_NORMAL_REVERSE 19
+#define GU_PATCH_FACE         20
+#define GU_FRAGMENT_2X        21
+
+#define GU_TEXTURE_SHIFT(n) ((n) << 0)
+#define GU_TEXTURE_8BIT     GU_TEXTURE_SHIFT(1)
+#define GU_TEXTURE_16BIT    GU_TEXTURE_SHIFT(2)
+#define GU_TEXTURE_32BITF   GU_TEXTURE_SHIFT(3)
+#define GU_TEXTURE_BITS     GU_TEXTURE_SHIFT(3)
+
+#define GU_COLOR_SHIFT(n) ((n) << 2)
+#define GU_COLOR_5650     GU_COLOR_SHIFT(4)
+#define GU_COLOR_5551     GU_COLOR_SHIFT(5)
+#define GU_COLOR_4444     GU_COLOR_SHIFT(6)
+#define GU_COLOR_8888     GU_COLOR_SHIFT(7)
+#define GU_COLOR_BITS     GU_COLOR_SHIFT(7)
+
+#define GU_NORMAL_SHIFT(n) ((n) << 5)
+#define GU_NORMAL_8BIT     GU_NORMAL_SHIFT(1)
+#define GU_NORMAL_16BIT    GU_NORMAL_SHIFT(2)
+#define GU_NORMAL_32BITF   GU_NORMAL_SHIFT(3)
+#define GU_NORMAL_BITS     GU_NORMAL_SHIFT(3)
+
+#define GU_VERTEX_SHIFT(n) ((n) << 7)
+#define GU_VERTEX_8BIT     GU_VERTEX_SHIFT(1)
+#define GU_VERTEX_16BIT    GU_VERTEX_SHIFT(2)
+#define GU_VERTEX_32BITF   GU_VERTEX_SHIFT(3)
+#define GU_VERTEX_BITS     GU_VERTEX_SHIFT(3)
+
+#define GU_WEIGHT_SHIFT(n) ((n) << 9)
+#define GU_WEIGHT_BITS     GU_WEIGHT_SHIFT(3)
+#define GU_INDEX_SHIFT(n)  ((n) << 11)
+#define GU_INDEX_8BIT      GU_INDEX_SHIFT(1)
+#define GU_INDEX_16BIT     GU_INDEX_SHIFT(2)
+#define GU_INDEX_BITS      GU_INDEX_SHIFT(3)
+#define GU_WEIGHTS(n)      ((((n) - 1) & 7) << 14)
+#define GU_VERTICES(n)     ((((n) - 1) & 7) << 18)
+
+#define GU_TRANSFORM_SHIFT(n) ((n) << 23)
+#define GU_TRANSFORM_3D       GU_TRANSFORM_SHIFT(0)
+#define GU_TRANSFORM_2D       GU_TRANSFORM_SHIFT(1)
+
+#define GU_PSM_5650 0
+#define GU_PSM_5551 1
+#define GU_PSM_4444 2
+#define GU_PSM_8888 3
+#define GU_PSM_T4   4
+#define GU_PSM_T8   5
+#define GU_PSM_T16  6
+#define GU_PSM_T32  7
+#define GU_PSM_DXT1 8
+#define GU_PSM_DXT3 9
+#define GU_PSM_DXT5 10
+
+#define GU_NEVER    0
+#define GU_ALWAYS   1
+#define GU_EQUAL    2
+#define GU_NOTEQUAL 3
+#define GU_LESS     4
+#define GU_LEQUAL   5
+#define GU_GREATER  6
+#define GU_GEQUAL   7
+
+#define GU_COLOR_BUFFER_BIT   1
+#define GU_STENCIL_BUFFER_BIT 2
+#define GU_DEPTH_BUFFER_BIT   4
+#define GU_FAST_CLEAR_BIT     16
+
+#define GU_CW  0
+#define GU_CCW 1
+
+#define GU_FLAT   0
+#define GU_SMOOTH 1
+
+#define GU_NEAREST 0
+#define GU_LINEAR  1
+
+#define GU_REPEAT 0
+#define GU_CLAMP  1
+
+#define GU_TFX_MODULATE 0
+#define GU_TFX_DECAL    1
+#define GU_TFX_BLEND    2
+#define GU_TFX_REPLACE  3
+#define GU_TFX_ADD      4
+
+#define GU_TCC_RGB  0
+#define GU_TCC_RGBA 1
+
+#define GU_ADD              0
+#define GU_SUBTRACT         1
+#define GU_REVERSE_SUBTRACT 2
+#define GU_MIN              3
+#define GU_MAX              4
+#define GU_ABS              5
+
+#define GU_SRC_COLOR           0
+#define GU_ONE_MINUS_SRC_COLOR 1
+#define GU_SRC_ALPHA           2
+#define GU_ONE_MINUS_SRC_ALPHA 3
+#define GU_DST_COLOR           0
+#define GU_ONE_MINUS_DST_COLOR 1
+#define GU_DST_ALPHA           4
+#define GU_ONE_MINUS_DST_ALPHA 5
+#define GU_FIX                 10
+
+#define GU_KEEP     0
+#define GU_ZERO     1
+#define GU_REPLACE  2
+#define GU_INVERT   3
+#define GU_INCR     4
+#define GU_DECR     5
+
+#define GU_DIRECT 0
+#define GU_CALL   1
+#define GU_SEND   2
+
+#define GU_TAIL 0
+#define GU_HEAD 1
+
+/*
+    Recording GU (emu/emuGu.c)
+*/
+extern void sceGuInit(void);
+extern void sceGuTerm(void);
+extern void sceGuStart(int cid, void *list);
+extern int sceGuFinish(void);
+extern int sceGuSync(int mode, int what);
+extern void *sceGuGetMemory(int size);
+extern void sceGuDrawArray(int prim, int vtype, int count, const void *indices, const void *vertices);
+extern void sceGuEnable(int state);
+extern void sceGuDisable(int state);
+extern void sceGuDisplay(int state);
+extern void sceGuDrawBuffer(int psm, void *fbp, int fbw);
+extern void sceGuDispBuffer(int width, int height, void *dispbp, int dispbw);
+extern void sceGuDepthBuffer(void *zbp, int zbw);
+extern void *sceGuSwapBuffers(void);
+extern void sceGuOffset(unsigned int x, unsigned int y);
+extern void sceGuViewport(int cx, int cy, int width, int height);
+extern void sceGuDepthRange(int near, int far);
+extern void sceGuDepthFunc(int function);
+extern void sceGuScissor(int x, int y, int w, int h);
+extern void sceGuFrontFace(int order);
+extern void sceGuShadeModel(int mode);
+extern void sceGuBlendFunc(int op, int src, int dest, unsigned int srcfix, unsigned int destfix);
+extern void sceGuAlphaFunc(int func, int value, int mask);
+extern void sceGuColorFunc(int func, unsigned int color, unsigned int mask);
+extern void sceGuStencilFunc(int func, int ref, int mask);
+extern void sceGuStencilOp(int fail, int zfail, int zpass);
+extern void sceGuAmbientColor(unsigned int color);
+extern void sceGuColor(unsigned int color);
+extern void sceGuClearColor(unsigned int color);
+extern void sceGuClearDepth(unsigned int depth);
+extern void sceGuClearStencil(unsigned int stencil);
+extern void sceGuClear(int flags);
+extern void sceGuTexMode(int tpsm, int maxmips, int a2, int swizzle);
+extern void sceGuTexImage(int mipmap, int width, int height, int tbw, const void *tbp);
+extern void sceGuTexFunc(int tfx, int tcc);
+extern void sceGuTexEnvColor(unsigned int color);
+extern void sceGuTexFilter(int min, int mag);
+extern void sceGuTexWrap(int u, int v);
+extern void sceGuTexOffset(float u, float v);
+extern void sceGuTexScale(float u, float v);
+extern void sceGuTexFlush(void);
+extern void sceGuTexSync(void);
+extern void sceGuClutMode(unsigned int cpsm, unsigned int shift, unsigned int mask, unsigned int a3);
+extern void sceGuClutLoad(int num_blocks, const void *cbp);
+extern void sceGuCopyImage(int psm, int sx, int sy, int width, int height, int srcw, void *src, int dx, int dy, int destw, void *dest);
+
+/** Counters for one frame of GE work. A frame ends when oslSwapBuffers is called. */
+typedef struct {
+    int commands;       //!< GE command words written to the display list (sceGuGetMemory jumps included)
+    int drawCalls;      //!< sceGuDrawArray calls
+    int vertices;       //!< Vertices sent by those calls
+    int textureBinds;   //!< sceGuTexImage calls
+    int clutLoads;      //!< sceGuClutLoad calls
+    int listBytes;      //!< Display list bytes: commands plus the sceGuGetMemory blocks
+    int savedCommands;  //!< GE command words OSLib didn't send because the state was already set (see osl_geSavedCommandCount)
+} EMU_GU_STATS;
+
+/** Frame being recorded */
+extern EMU_GU_STATS emu_guStats;
+/** Last complete frame */
+extern EMU_GU_STATS emu_guLastFrameStats;
+/** Number of frames completed so far */
+extern int emu_frameCount;
+
+/** Closes the current frame: emu_guStats goes to emu_guLastFrameStats and is cleared.
+    If the OSL_EMU_STATS environment variable names a file, one line per frame is appended to it;
+    if OSL_EMU_FRAMES is set, osl_quit is raised after that many frames so that samples end by themselves. */
+extern void emuEndFrame(void);
+
+/*
+    Reference rasterizer (emu/emuRaster.c)
+*/
+/** Renders the draws into the draw buffers (VRAM or OSL_IMAGE in RAM) instead of only recording them.
+    Set it before oslInitGfx, or set the OSL_EMU_RASTER environment variable to 1. */
+extern int emu_rasterEnabled;
+/** Number of rendering threads; 0 (default) uses one per CPU. Overridden by OSL_EMU_THREADS. */
+extern int emu_rasterThreads;
+/** Number of frames that didn't match their golden image.
+    If OSL_EMU_GOLDEN names a directory, each frame is compared with <dir>/frameNNNN.png when it exists (at most
+    OSL_EMU_GOLDEN_TOLERANCE of difference per component) and written there otherwise. sceKernelExitGame returns 1 if
+    this counter isn't 0. */
+extern int emu_goldenFailures;
+
+/*
+    Kernel, display and input (emu/emuKernel.c)
+*/
+#define sceKernelDcacheWritebackAll()                  ((void)0)
+#define sceKernelDcacheWritebackInvalidateAll()        ((void)0)
+#define sceKernelDcacheWritebackRange(p, s)            ((void)(p), (void)(s))
+#define sceKernelDcacheWritebackInvalidateRange(p, s)  ((void)(p), (void)(s))
+#define sceKernelDcacheInvalidateRange(p, s)           ((void)(p), (void)(s))
+#define scePowerTick(type)                             ((void)(type))
+#define sceHprmIsRemoteExist()                         0
+#define sceHprmPeekCurrentKey(key)                     (*(key) = 0)
+#define sceCtrlSetSamplingCycle(cycle)                 ((void)(cycle))
+#define sceCtrlSetSamplingMode(mode)                   ((void)(mode))
+
+/* Functions rather than macros: their result is often ignored, and a bare 0 would be a statement with no effect */
+static inline int sceKernelNotifyCallback(SceUID cb, int arg) { (void)cb; (void)arg; return 0; }
+static inline int sceKernelSleepThreadCB(void) { return 0; }
+
+extern int sceCtrlPeekBufferPositive(SceCtrlData *pad_data, int count);
+extern int sceCtrlReadBufferPositive(SceCtrlData *pad_data, int count);
+extern int sceDisplayWaitVblankStart(void);
+extern int sceKernelDelayThread(unsigned int delay);
+extern void sceKernelExitGame(void);
+extern SceUID sceIoOpen(const char *file, int flags, SceMode mode);
+extern int sceIoClose(SceUID fd);
+extern int sceIoRead(SceUID fd, void *data, SceSize size);
+extern int sceIoWrite(SceUID fd, const void *data, SceSize size);
+extern int sceIoLseek32(SceUID fd, int offset, int whence);
+
+extern void emuInitGfx(void);
+extern void emuStartDrawing(void);
+extern void emuInitGL(void);
+
+/* There is no OpenGL window to mirror the draw buffer to */
+#define emuConfigure2DTransfer(enable)                          ((void)0)
+#define emuGlReadPixels(x, y, w, h, format, pf, data)           ((void)0)
+#define glIsEnabled(cap)                                        0
+#define glEnable(cap)                                           ((void)0)
+#define glDisable(cap)                                          ((void)0)
+#define glReadBuffer(mode)                                      ((void)0)
+#define glDrawBuffer(mode)                                      ((void)0)
+#define glRasterPos2i(x, y)                                     ((void)0)
+#define glPixelZoom(x, y)                                       ((void)0)
+#define glDrawPixels(w, h, format, type, data)                  ((void)0)
+#define GL_TEXTURE_2D 0
+#define GL_BLEND 0
+#define GL_RGBA 0
+#define GL_FRONT 0
+#define GL_BACK 0
+#define emu_pixelPhysFormats ((int *)0)
+
+#define _alloca __builtin_alloca
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+#include "../oslib.h"
+
+/*
+    Silent audio for the headless host build.
+    Sounds are "loaded" when their file exists, so that programs behave as on the PSP, but nothing is ever played.
+*/
+
+int osl_audioDefaultNumSamples = 512;
+
+int oslInitAudio() {
+    return 1;
+}
+
+void oslDeinitAudio() {
+}
+
+void oslInitAudioME(int formats) {
+}
+
+OSL_SOUND *oslLoadSoundFile(const char *filename, int stream) {
+    OSL_SOUND *s;
+    VIRTUAL_FILE *f;
+
+    if (!filename)
+        return NULL;
+
+    f = VirtualFileOpen((void*)filename, 0, VF_AUTO, VF_O_READ);
+    if (!f) {
+        oslHandleLoadNoFailError(filename);
+        return NULL;
+    }
+    VirtualFileClose(f);
+
+    s = (OSL_SOUND*)malloc(sizeof(OSL_SOUND));
+    if (s) {
+        memset(s, 0, sizeof(OSL_SOUND));
+        strncpy(s->filename, filename, sizeof(s->filename) - 1);
+        s->isStreamed = stream;
+        s->volumeLeft = s->volumeRight = 0x8000;
+    }
+    return s;
+}
+
+OSL_SOUND *oslLoadSoundFileWAV(const char *filename, int stream) {
+    return oslLoadSoundFile(filename, stream);
+}
+
+OSL_SOUND *oslLoadSoundFileBGM(const char *filename, int stream) {
+    return oslLoadSoundFile(filename, stream);
+}
+
+void oslPlaySound(OSL_SOUND *s, int voice) {
+}
+
+void oslStopSound(OSL_SOUND *s) {
+}
+
+void oslPauseSound(OSL_SOUND *s, int pause) {
+}
+
+void oslDeleteSound(OSL_SOUND *s) {
+    free(s);
+}
+
+void oslAudioVSync() {
+}
+
+int oslGetSoundChannel(OSL_SOUND *s) {
+    return -1;
+}
+
+int oslSoundLoopFunc(OSL_SOUND *s, int voice) {
+    return 1;
+}
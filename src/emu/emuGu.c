@@ -0,0 +1,497 @@
+#include "../oslib.h"
+#include "emuRaster.h"
+
+/*
+    Recording GU for the headless host build.
+    Every sceGu* function writes the same number of command words as the PSPSDK libgu implementation, in the list given
+    to sceGuStart, and sceGuGetMemory reserves its block in that list just like on the PSP (jump over the data). Nothing
+    is drawn unless the reference rasterizer is enabled (emuRaster.c): the state it needs is kept in emu_geState and the
+    draws are handed to it.
+*/
+
+#define GE_CMD(cmd, arg) (((cmd) << 24) | ((arg) & 0xffffff))
+
+EMU_GU_STATS emu_guStats;
+EMU_GU_STATS emu_guLastFrameStats;
+int emu_frameCount = 0;
+
+static u32 *emu_guList, *emu_guListCur;
+static int emu_guScissorEnabled;
+static int emu_guScissor[4];
+static u32 emu_guDrawBuffer, emu_guDispBuffer, emu_guDrawBufferWidth;
+static int emu_guDispWidth = 480, emu_guDispHeight = 272;
+static u32 emu_guClearColor, emu_guClearStencil;
+
+EMU_GE_STATE emu_geState;
+int emu_geStateDirty = 1;
+
+static inline void emuGuSend(int cmd, u32 arg) {
+    *emu_guListCur++ = GE_CMD(cmd, arg);
+    emu_guStats.commands++;
+    emu_guStats.listBytes += 4;
+}
+
+static inline void emuGuSendf(int cmd, float arg) {
+    union { float f; u32 i; } v;
+    v.f = arg;
+    emuGuSend(cmd, v.i >> 8);
+}
+
+static inline u32 emuGuAdr(const void *p) {
+    return (u32)(uintptr_t)oslRemoveVramPrefixPtr(p);
+}
+
+// GE addresses are VRAM offsets, anything else is already a CPU pointer
+static inline u8 *emuGuCpuPtr(const void *p) {
+    return (uintptr_t)p < OSL_UVRAM_SIZE ? OSL_UVRAM_BASE + (uintptr_t)p : (u8 *)p;
+}
+
+static inline void emuGuSetScissorState(void) {
+    if (emu_guScissorEnabled)
+        memcpy(emu_geState.scissor, emu_guScissor, sizeof(emu_guScissor));
+    else {
+        emu_geState.scissor[0] = emu_geState.scissor[1] = 0;
+        emu_geState.scissor[2] = 479;
+        emu_geState.scissor[3] = 271;
+    }
+    emu_geStateDirty = 1;
+}
+
+static int emuGuExp(int val) {
+    int i;
+    for (i = 9; i > 0 && !((val >> i) & 1); i--);
+    return i;
+}
+
+void sceGuInit(void) {
+    emu_guScissorEnabled = 0;
+    emu_guDrawBuffer = emu_guDispBuffer = emu_guDrawBufferWidth = 0;
+
+    memset(&emu_geState, 0, sizeof(emu_geState));
+    emu_geState.materialColor = 0xffffffff;
+    emu_geState.shadeSmooth = 1;
+    emu_geState.texWidth = emu_geState.texHeight = 1;
+    emu_geState.clutMask = 0xff;
+    emu_geState.clutIndex = -1;
+    emu_geState.alphaMask = emu_geState.stencilMask = 0xff;
+    emu_geState.colorMask = 0xffffff;
+    emu_geState.alphaFunc = emu_geState.colorFunc = emu_geState.stencilFunc = GU_ALWAYS;
+    emuGuSetScissorState();
+    emuRasterInit();
+}
+
+void sceGuTerm(void) {
+}
+
+void sceGuStart(int cid, void *list) {
+    emu_guList = emu_guListCur = (u32 *)list;
+    // libgu sets the draw buffer again at the start of each list
+    if (emu_guDrawBufferWidth) {
+        emu_geState.drawBuffer = emuGuCpuPtr((void *)(uintptr_t)emu_guDrawBuffer);
+        emu_geStateDirty = 1;
+        emuGuSend(156, emu_guDrawBuffer);
+        emuGuSend(157, ((emu_guDrawBuffer & 0xff000000) >> 8) | emu_guDrawBufferWidth);
+    }
+}
+
+int sceGuFinish(void) {
+    // The list is complete: this is where the GE would execute it
+    emuRasterFlush();
+    emuGuSend(15, 0);
+    emuGuSend(12, 0);
+    return (u8 *)emu_guListCur - (u8 *)emu_guList;
+}
+
+int sceGuSync(int mode, int what) {
+    return 0;
+}
+
+void *sceGuGetMemory(int size) {
+    u32 *block;
+
+    size = (size + 3) & ~3;
+    block = emu_guListCur + 2;
+    emuGuSend(16, (emuGuAdr(block + size / 4) >> 8) & 0xf0000);
+    emuGuSend(8, emuGuAdr(block + size / 4));
+    emu_guListCur = block + size / 4;
+    emu_guStats.listBytes += size;
+    return block;
+}
+
+void sceGuDrawArray(int prim, int vtype, int count, const void *indices, const void *vertices) {
+    if (vtype)
+        emuGuSend(18, vtype);
+    if (indices) {
+        emuGuSend(16, (emuGuAdr(indices) >> 8) & 0xf0000);
+        emuGuSend(2, emuGuAdr(indices));
+    }
+    emuGuSend(16, (emuGuAdr(vertices) >> 8) & 0xf0000);
+    emuGuSend(1, emuGuAdr(vertices));
+    emuGuSend(4, (prim << 16) | count);
+    emu_guStats.drawCalls++;
+    emu_guStats.vertices += count;
+    emuRasterQueue(prim, vtype, count, indices, vertices);
+}
+
+static void emuGuSetState(int state, int enabled) {
+    // Command used by libgu for each state (0 = none)
+    static const u8 stateCommands[22] = {
+        34, 35, 0, 36, 33, 29, 32, 31, 28, 30, 23, 24, 25, 26, 27, 37, 38, 39, 40, 81, 56, 0
+    };
+
+    if (state == GU_SCISSOR_TEST) {
+        emu_guScissorEnabled = enabled;
+        emuGuSetScissorState();
+        emuGuSend(212, enabled ? (emu_guScissor[1] << 10) | emu_guScissor[0] : 0);
+        emuGuSend(213, enabled ? (emu_guScissor[3] << 10) | emu_guScissor[2] : (479 | (271 << 10)));
+        return;
+    }
+    if (state >= 0 && state < 22 && stateCommands[state])
+        emuGuSend(stateCommands[state], enabled);
+
+    switch (state) {
+        case GU_ALPHA_TEST:     emu_geState.alphaTestEnabled = enabled; break;
+        case GU_STENCIL_TEST:   emu_geState.stencilTestEnabled = enabled; break;
+        case GU_BLEND:          emu_geState.blendEnabled = enabled; break;
+        case GU_DITHER:         emu_geState.ditherEnabled = enabled; break;
+        case GU_TEXTURE_2D:     emu_geState.textureEnabled = enabled; break;
+        case GU_COLOR_TEST:     emu_geState.colorTestEnabled = enabled; break;
+        default:                return;
+    }
+    emu_geStateDirty = 1;
+}
+
+void sceGuEnable(int state) {
+    emuGuSetState(state, 1);
+}
+
+void sceGuDisable(int state) {
+    emuGuSetState(state, 0);
+}
+
+void sceGuDisplay(int state) {
+}
+
+void sceGuDrawBuffer(int psm, void *fbp, int fbw) {
+    // The former draw buffer may be used as a texture from now on
+    emuRasterFlush();
+    emu_geState.drawBuffer = emuGuCpuPtr(fbp);
+    emu_geState.drawBufferPsm = psm;
+    emu_geState.drawBufferWidth = fbw;
+    emu_geStateDirty = 1;
+    emu_guDrawBuffer = (u32)(uintptr_t)fbp;
+    emu_guDrawBufferWidth = fbw;
+    emuGuSend(210, psm);
+    emuGuSend(156, emu_guDrawBuffer);
+    emuGuSend(157, ((emu_guDrawBuffer & 0xff000000) >> 8) | fbw);
+    emuGuSend(158, 0);
+    emuGuSend(159, 0);
+}
+
+void sceGuDispBuffer(int width, int height, void *dispbp, int dispbw) {
+    emu_guDispBuffer = (u32)(uintptr_t)dispbp;
+    emu_guDispWidth = width;
+    emu_guDispHeight = height;
+}
+
+void sceGuDepthBuffer(void *zbp, int zbw) {
+    emuGuSend(158, (u32)(uintptr_t)zbp);
+    emuGuSend(159, (((u32)(uintptr_t)zbp & 0xff000000) >> 8) | zbw);
+}
+
+void *sceGuSwapBuffers(void) {
+    u32 tmp = emu_guDrawBuffer;
+    emu_guDrawBuffer = emu_guDispBuffer;
+    emu_guDispBuffer = tmp;
+    // The caller wants a CPU pointer (see oslSwapBuffers)
+    return OSL_UVRAM_BASE + emu_guDrawBuffer;
+}
+
+void sceGuOffset(unsigned int x, unsigned int y) {
+    emuGuSend(76, x << 4);
+    emuGuSend(77, y << 4);
+}
+
+void sceGuViewport(int cx, int cy, int width, int height) {
+    emuGuSendf(66, (float)(width >> 1));
+    emuGuSendf(67, (float)(-(height >> 1)));
+    emuGuSendf(69, (float)cx);
+    emuGuSendf(70, (float)cy);
+}
+
+void sceGuDepthRange(int near, int far) {
+    emuGuSendf(68, (float)(far - near) * 0.5f);
+    emuGuSendf(71, (float)(far + near) * 0.5f);
+    emuGuSend(214, near < far ? near : far);
+    emuGuSend(215, near < far ? far : near);
+}
+
+void sceGuDepthFunc(int function) {
+    emuGuSend(222, function);
+}
+
+void sceGuScissor(int x, int y, int w, int h) {
+    emu_guScissor[0] = x;
+    emu_guScissor[1] = y;
+    emu_guScissor[2] = w - 1;
+    emu_guScissor[3] = h - 1;
+    emuGuSetScissorState();
+    if (emu_guScissorEnabled) {
+        emuGuSend(212, (emu_guScissor[1] << 10) | emu_guScissor[0]);
+        emuGuSend(213, (emu_guScissor[3] << 10) | emu_guScissor[2]);
+    }
+}
+
+void sceGuFrontFace(int order) {
+    emuGuSend(155, order ? 0 : 1);
+}
+
+void sceGuShadeModel(int mode) {
+    emu_geState.shadeSmooth = mode ? 1 : 0;
+    emu_geStateDirty = 1;
+    emuGuSend(80, mode ? 1 : 0);
+}
+
+void sceGuBlendFunc(int op, int src, int dest, unsigned int srcfix, unsigned int destfix) {
+    emu_geState.blendOp = op;
+    emu_geState.blendSrc = src;
+    emu_geState.blendDst = dest;
+    emu_geState.blendFixSrc = srcfix;
+    emu_geState.blendFixDst = destfix;
+    emu_geStateDirty = 1;
+    emuGuSend(223, src | (dest << 4) | (op << 8));
+    if (src >= GU_FIX)
+        emuGuSend(224, srcfix);
+    if (dest >= GU_FIX)
+        emuGuSend(225, destfix);
+}
+
+void sceGuAlphaFunc(int func, int value, int mask) {
+    emu_geState.alphaFunc = func;
+    emu_geState.alphaRef = value & 0xff;
+    emu_geState.alphaMask = mask & 0xff;
+    emu_geStateDirty = 1;
+    emuGuSend(219, func | ((value & 0xff) << 8) | ((mask & 0xff) << 16));
+}
+
+void sceGuColorFunc(int func, unsigned int color, unsigned int mask) {
+    emu_geState.colorFunc = func & 0x03;
+    emu_geState.colorRef = color;
+    emu_geState.colorMask = mask;
+    emu_geStateDirty = 1;
+    emuGuSend(216, func & 0x03);
+    emuGuSend(217, color);
+    emuGuSend(218, mask);
+}
+
+void sceGuStencilFunc(int func, int ref, int mask) {
+    emu_geState.stencilFunc = func;
+    emu_geState.stencilRef = ref & 0xff;
+    emu_geState.stencilMask = mask & 0xff;
+    emu_geStateDirty = 1;
+    emuGuSend(220, func | ((ref & 0xff) << 8) | ((mask & 0xff) << 16));
+}
+
+void sceGuStencilOp(int fail, int zfail, int zpass) {
+    emu_geState.stencilFail = fail;
+    emu_geState.stencilZFail = zfail;
+    emu_geState.stencilZPass = zpass;
+    emu_geStateDirty = 1;
+    emuGuSend(221, fail | (zfail << 8) | (zpass << 16));
+}
+
+void sceGuAmbientColor(unsigned int color) {
+    // Material ambient color: the color of vertices that don't have one
+    emu_geState.materialColor = color;
+    emu_geStateDirty = 1;
+    emuGuSend(85, color & 0xffffff);
+    emuGuSend(88, color >> 24);
+}
+
+void sceGuColor(unsigned int color) {
+    // sceGuMaterial(7, color): ambient, diffuse and specular
+    emu_geState.materialColor = color;
+    emu_geStateDirty = 1;
+    emuGuSend(85, color & 0xffffff);
+    emuGuSend(88, color >> 24);
+    emuGuSend(86, color & 0xffffff);
+    emuGuSend(87, color & 0xffffff);
+}
+
+void sceGuClearColor(unsigned int color) {
+    emu_guClearColor = color;
+}
+
+void sceGuClearDepth(unsigned int depth) {
+}
+
+void sceGuClearStencil(unsigned int stencil) {
+    emu_guClearStencil = stencil;
+}
+
+void sceGuClear(int flags) {
+    // libgu clears with 64 pixel wide sprites (color + 16-bit position = 12 bytes per vertex)
+    struct { u32 color; u16 x, y, z, pad; } *vertices;
+    int count = (emu_guDispWidth + 63) / 64 * 2, i;
+    u32 filter;
+
+    switch (emu_geState.drawBufferPsm) {
+        case GU_PSM_5650: filter = emu_guClearColor & 0xffffff; break;
+        case GU_PSM_5551: filter = (emu_guClearColor & 0xffffff) | (emu_guClearStencil << 31); break;
+        case GU_PSM_4444: filter = (emu_guClearColor & 0xffffff) | (emu_guClearStencil << 28); break;
+        default: filter = (emu_guClearColor & 0xffffff) | (emu_guClearStencil << 24); break;
+    }
+    vertices = sceGuGetMemory(count * sizeof(*vertices));
+    for (i = 0; i < count; i++) {
+        vertices[i].color = filter;
+        vertices[i].x = ((i >> 1) + (i & 1)) << 6;
+        vertices[i].y = (i & 1) * emu_guDispHeight;
+        vertices[i].z = vertices[i].pad = 0;
+    }
+
+    emuGuSend(211, ((flags & 7) << 8) | 1);
+    emu_geState.clearMode = 1;
+    emu_geState.clearFlags = flags & 7;
+    emu_geStateDirty = 1;
+    sceGuDrawArray(GU_SPRITES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, count, 0, vertices);
+    emuGuSend(211, 0);
+    emu_geState.clearMode = 0;
+    emu_geStateDirty = 1;
+}
+
+void sceGuTexMode(int tpsm, int maxmips, int a2, int swizzle) {
+    emu_geState.texPsm = tpsm;
+    emu_geState.texSwizzle = swizzle;
+    emu_geStateDirty = 1;
+    emuGuSend(194, (maxmips << 16) | (a2 << 8) | swizzle);
+    emuGuSend(195, tpsm);
+    sceGuTexFlush();
+}
+
+void sceGuTexImage(int mipmap, int width, int height, int tbw, const void *tbp) {
+    u32 adr = emuGuAdr(tbp);
+
+    if (mipmap == 0) {
+        emu_geState.texData = emuGuCpuPtr(tbp);
+        emu_geState.texBufferWidth = tbw;
+        emu_geState.texWidth = 1 << emuGuExp(width);
+        emu_geState.texHeight = 1 << emuGuExp(height);
+        emu_geStateDirty = 1;
+    }
+    emuGuSend(160 + mipmap, adr);
+    emuGuSend(168 + mipmap, ((adr >> 8) & 0x0f0000) | tbw);
+    emuGuSend(184 + mipmap, (emuGuExp(height) << 8) | emuGuExp(width));
+    sceGuTexFlush();
+    emu_guStats.textureBinds++;
+}
+
+void sceGuTexFunc(int tfx, int tcc) {
+    emu_geState.texFunc = tfx;
+    emu_geState.texAlpha = tcc;
+    emu_geStateDirty = 1;
+    emuGuSend(201, (tcc << 8) | tfx);
+}
+
+void sceGuTexEnvColor(unsigned int color) {
+    emu_geState.texEnvColor = color;
+    emu_geStateDirty = 1;
+    emuGuSend(202, color & 0xffffff);
+}
+
+void sceGuTexFilter(int min, int mag) {
+    emu_geState.texMinFilter = min;
+    emu_geState.texMagFilter = mag;
+    emu_geStateDirty = 1;
+    emuGuSend(198, (mag << 8) | min);
+}
+
+void sceGuTexWrap(int u, int v) {
+    emu_geState.texWrapU = u;
+    emu_geState.texWrapV = v;
+    emu_geStateDirty = 1;
+    emuGuSend(199, (v << 8) | u);
+}
+
+void sceGuTexOffset(float u, float v) {
+    emuGuSendf(74, u);
+    emuGuSendf(75, v);
+}
+
+void sceGuTexScale(float u, float v) {
+    emuGuSendf(72, u);
+    emuGuSendf(73, v);
+}
+
+void sceGuTexFlush(void) {
+    emuGuSend(203, 0);
+}
+
+void sceGuTexSync(void) {
+    emuGuSend(204, 0);
+}
+
+void sceGuClutMode(unsigned int cpsm, unsigned int shift, unsigned int mask, unsigned int a3) {
+    emu_geState.clutPsm = cpsm;
+    emu_geState.clutShift = shift;
+    emu_geState.clutMask = mask;
+    emu_geState.clutStart = a3;
+    emu_geStateDirty = 1;
+    emuGuSend(197, cpsm | (shift << 2) | (mask << 8) | (a3 << 16));
+}
+
+void sceGuClutLoad(int num_blocks, const void *cbp) {
+    u32 adr = emuGuAdr(cbp);
+
+    emuGuSend(176, adr);
+    emuGuSend(177, (adr >> 8) & 0xf0000);
+    emuGuSend(196, num_blocks);
+    emu_guStats.clutLoads++;
+    emuRasterLoadClut(emuGuCpuPtr(cbp), num_blocks * 32);
+}
+
+void sceGuCopyImage(int psm, int sx, int sy, int width, int height, int srcw, void *src, int dx, int dy, int destw, void *dest) {
+    u32 srcAdr = emuGuAdr(src), destAdr = emuGuAdr(dest);
+
+    emuGuSend(178, srcAdr);
+    emuGuSend(179, ((srcAdr & 0xff000000) >> 8) | srcw);
+    emuGuSend(235, (sy << 10) | sx);
+    emuGuSend(180, destAdr);
+    emuGuSend(181, ((destAdr & 0xff000000) >> 8) | destw);
+    emuGuSend(236, (dy << 10) | dx);
+    emuGuSend(238, ((height - 1) << 10) | (width - 1));
+    emuGuSend(234, (psm ^ 0x03) ? 0 : 1);
+    emuRasterCopyImage(psm, sx, sy, width, height, srcw, emuGuCpuPtr(src), dx, dy, destw, emuGuCpuPtr(dest));
+}
+
+void emuEndFrame(void) {
+    static FILE *statsFile = NULL;
+    static int statsFileChecked = 0, maxFrames = 0;
+
+    if (!statsFileChecked) {
+        const char *env = getenv("OSL_EMU_STATS");
+        if (env && *env)
+            statsFile = fopen(env, "w");
+        if (statsFile)
+            fprintf(statsFile, "frame commands drawCalls vertices textureBinds clutLoads listBytes savedCommands\n");
+        env = getenv("OSL_EMU_FRAMES");
+        if (env)
+            maxFrames = atoi(env);
+        statsFileChecked = 1;
+    }
+
+    emuRasterCheckFrame(emu_frameCount);
+    emu_guStats.savedCommands = osl_geSavedCommandCount;
+    emu_guLastFrameStats = emu_guStats;
+    memset(&emu_guStats, 0, sizeof(emu_guStats));
+
+    if (statsFile) {
+        fprintf(statsFile, "%d %d %d %d %d %d %d %d\n", emu_frameCount, emu_guLastFrameStats.commands, emu_guLastFrameStats.drawCalls,
+                emu_guLastFrameStats.vertices, emu_guLastFrameStats.textureBinds, emu_guLastFrameStats.clutLoads, emu_guLastFrameStats.listBytes,
+                emu_guLastFrameStats.savedCommands);
+        fflush(statsFile);
+    }
+
+    emu_frameCount++;
+    if (maxFrames > 0 && emu_frameCount >= maxFrames)
+        osl_quit = 1;
+}
@@ -0,0 +1,94 @@
+#include "../oslib.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+    Kernel, display, input and file functions for the headless host build.
+    There is no hardware behind them: the pad is never pressed, vblanks don't wait and files are regular host files.
+*/
+
+static u8 emu_vram[OSL_UVRAM_SIZE] __attribute__((aligned(16)));
+u8 *OSL_UVRAM_BASE = emu_vram;
+
+int sceCtrlPeekBufferPositive(SceCtrlData *pad_data, int count) {
+    memset(pad_data, 0, sizeof(SceCtrlData) * count);
+    pad_data->Lx = pad_data->Ly = 128;
+    return count;
+}
+
+int sceCtrlReadBufferPositive(SceCtrlData *pad_data, int count) {
+    return sceCtrlPeekBufferPositive(pad_data, count);
+}
+
+int sceDisplayWaitVblankStart(void) {
+    return 0;
+}
+
+int sceKernelDelayThread(unsigned int delay) {
+    return 0;
+}
+
+int sceDmacMemcpy(void *dest, const void *source, unsigned int size) {
+    memcpy(dest, source, size);
+    return 0;
+}
+
+int sceDmacTryMemcpy(void *dest, const void *source, unsigned int size) {
+    return sceDmacMemcpy(dest, source, size);
+}
+
+void sceKernelExitGame(void) {
+    exit(emu_goldenFailures ? 1 : 0);
+}
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode) {
+    int hostFlags = 0;
+
+    if ((flags & PSP_O_RDWR) == PSP_O_RDWR)
+        hostFlags = O_RDWR;
+    else if (flags & PSP_O_WRONLY)
+        hostFlags = O_WRONLY;
+    else
+        hostFlags = O_RDONLY;
+    if (flags & PSP_O_APPEND)
+        hostFlags |= O_APPEND;
+    if (flags & PSP_O_CREAT)
+        hostFlags |= O_CREAT;
+    if (flags & PSP_O_TRUNC)
+        hostFlags |= O_TRUNC;
+    return open(file, hostFlags, mode);
+}
+
+int sceIoClose(SceUID fd) {
+    return close(fd);
+}
+
+int sceIoRead(SceUID fd, void *data, SceSize size) {
+    return read(fd, data, size);
+}
+
+int sceIoWrite(SceUID fd, const void *data, SceSize size) {
+    return write(fd, data, size);
+}
+
+int sceIoLseek32(SceUID fd, int offset, int whence) {
+    return lseek(fd, offset, whence);
+}
+
+void emuInitGfx(void) {
+    memset(emu_vram, 0, sizeof(emu_vram));
+}
+
+void emuStartDrawing(void) {
+}
+
+void emuInitGL(void) {
+}
+
+void Debug(const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
@@ -0,0 +1,940 @@
+#include "../oslib.h"
+#include "emuRaster.h"
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+    Reference rasterizer for the headless host build.
+    It covers what OSLib sends to the GE: 2D (GU_TRANSFORM_2D) points, lines, triangles and sprites, 16/32-bit and 4/8-bit
+    paletted textures (swizzled or not), the texture functions, the color, alpha and stencil tests, blending and
+    dithering. Draws are queued with a copy of the state and rendered when the list is finished, like the GE would.
+    The draw buffer is cut in bands of 8 lines dealt to the threads in turn: every thread walks the whole queue but only
+    touches its own lines, so the order of the draws is kept without any locking and the image doesn't depend on the
+    number of threads.
+*/
+
+#define EMU_BAND_SHIFT 3
+#define EMU_CLUT_SIZE 1024
+#define EMU_MAX_THREADS 64
+
+#define EMU_MUL(a, b) (((a) * (b) + 127) / 255)
+#define EMU_CLAMP(v) ((v) < 0 ? 0 : (v) > 255 ? 255 : (v))
+#define EMU_MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
+#define EMU_MAX3(a, b, c) ((a) > (b) ? ((a) > (c) ? (a) : (c)) : ((b) > (c) ? (b) : (c)))
+
+typedef struct {
+    int r, g, b, a;
+} EMU_COLOR;
+
+typedef struct {
+    float x, y, u, v;
+    EMU_COLOR color;
+} EMU_VERTEX;
+
+typedef struct {
+    int size;
+    int texType, texOffset;
+    int colorType, colorOffset;
+    int posType, posOffset;
+    int indexType;
+} EMU_VERTEX_FORMAT;
+
+typedef struct {
+    int state;
+    int prim, vtype, count;
+    const void *indices, *vertices;
+} EMU_RASTER_DRAW;
+
+typedef struct {
+    const EMU_GE_STATE *s;
+    const u8 *clut;
+    int clip[4];                            // x0, y0, x1, y1 (exclusive)
+    int linearFilter;
+    int band, bandCount;
+} EMU_RASTER_CTX;
+
+int emu_rasterEnabled = 0;
+int emu_rasterThreads = 0;
+int emu_goldenFailures = 0;
+
+static EMU_GE_STATE *emu_rasterStates;
+static int emu_rasterStateCount, emu_rasterStateMax;
+static EMU_RASTER_DRAW *emu_rasterDraws;
+static int emu_rasterDrawCount, emu_rasterDrawMax;
+static u8 *emu_rasterCluts;
+static int emu_rasterClutCount, emu_rasterClutMax;
+
+static const char *emu_goldenDir;
+static int emu_goldenTolerance;
+
+static pthread_mutex_t emu_rasterMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t emu_rasterStartCond = PTHREAD_COND_INITIALIZER, emu_rasterDoneCond = PTHREAD_COND_INITIALIZER;
+static int emu_rasterGeneration, emu_rasterPending, emu_rasterWorkersStarted;
+
+// Default dither matrix set by libgu
+static const int emu_ditherMatrix[16] = {
+    -4, 0, -3, 1,
+    2, -2, 3, -1,
+    -3, 1, -4, 0,
+    3, -1, 2, -2
+};
+
+static void *emuRasterGrow(void *array, int *max, int needed, int elementSize) {
+    if (needed > *max) {
+        *max = needed > *max * 2 ? needed : *max * 2;
+        array = realloc(array, *max * elementSize);
+        if (!array) {
+            fprintf(stderr, "emuRaster: out of memory\n");
+            exit(1);
+        }
+    }
+    return array;
+}
+
+void emuRasterInit(void) {
+    const char *env;
+
+    env = getenv("OSL_EMU_RASTER");
+    if (env && *env)
+        emu_rasterEnabled = atoi(env) != 0;
+    env = getenv("OSL_EMU_GOLDEN");
+    if (env && *env) {
+        emu_goldenDir = env;
+        emu_rasterEnabled = 1;
+    }
+    env = getenv("OSL_EMU_GOLDEN_TOLERANCE");
+    if (env)
+        emu_goldenTolerance = atoi(env);
+    env = getenv("OSL_EMU_THREADS");
+    if (env && *env)
+        emu_rasterThreads = atoi(env);
+    if (emu_rasterThreads <= 0)
+        emu_rasterThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (emu_rasterThreads < 1)
+        emu_rasterThreads = 1;
+    if (emu_rasterThreads > EMU_MAX_THREADS)
+        emu_rasterThreads = EMU_MAX_THREADS;
+}
+
+/*
+    Vertices
+*/
+static inline int emuAlign(int offset, int size) {
+    return (offset + size - 1) & ~(size - 1);
+}
+
+// Component order and alignment of the GE: weights, texture, color, normal, position
+static void emuVertexFormat(int vtype, EMU_VERTEX_FORMAT *f) {
+    static const int sizes[4] = {0, 1, 2, 4};
+    static const int colorSizes[8] = {0, 0, 0, 0, 2, 2, 2, 4};
+    int weightType = (vtype >> 9) & 3, normalType = (vtype >> 5) & 3;
+    int offset = 0, align = 1, size;
+
+    if (weightType) {
+        size = sizes[weightType];
+        offset = size * (((vtype >> 14) & 7) + 1);
+        align = size;
+    }
+    f->texType = vtype & 3;
+    if (f->texType) {
+        size = sizes[f->texType];
+        f->texOffset = offset = emuAlign(offset, size);
+        offset += size * 2;
+        if (size > align)
+            align = size;
+    }
+    f->colorType = (vtype >> 2) & 7;
+    if (colorSizes[f->colorType]) {
+        size = colorSizes[f->colorType];
+        f->colorOffset = offset = emuAlign(offset, size);
+        offset += size;
+        if (size > align)
+            align = size;
+    }
+    if (normalType) {
+        size = sizes[normalType];
+        offset = emuAlign(offset, size) + size * 3;
+        if (size > align)
+            align = size;
+    }
+    f->posType = (vtype >> 7) & 3;
+    if (f->posType) {
+        size = sizes[f->posType];
+        f->posOffset = offset = emuAlign(offset, size);
+        offset += size * 3;
+        if (size > align)
+            align = size;
+    }
+    f->size = emuAlign(offset, align);
+    f->indexType = (vtype >> 11) & 3;
+}
+
+static inline int emuExpand5(int c) {
+    return (c << 3) | (c >> 2);
+}
+
+static inline int emuExpand6(int c) {
+    return (c << 2) | (c >> 4);
+}
+
+// 16-bit pixel to 32-bit ABGR
+static inline u32 emuUnpack(int psm, u32 c) {
+    switch (psm) {
+        case GU_PSM_5650:
+            return emuExpand5(c & 31) | (emuExpand6((c >> 5) & 63) << 8) | (emuExpand5((c >> 11) & 31) << 16) | 0xff000000;
+        case GU_PSM_5551:
+            return emuExpand5(c & 31) | (emuExpand5((c >> 5) & 31) << 8) | (emuExpand5((c >> 10) & 31) << 16) | ((c & 0x8000) ? 0xff000000 : 0);
+        case GU_PSM_4444:
+            return ((c & 15) * 17) | (((c >> 4) & 15) * 17 << 8) | (((c >> 8) & 15) * 17 << 16) | ((u32)((c >> 12) & 15) * 17 << 24);
+    }
+    return c;
+}
+
+static inline EMU_COLOR emuColor(u32 c) {
+    EMU_COLOR col;
+    col.r = c & 0xff;
+    col.g = (c >> 8) & 0xff;
+    col.b = (c >> 16) & 0xff;
+    col.a = c >> 24;
+    return col;
+}
+
+static void emuFetchVertex(const EMU_RASTER_CTX *c, const EMU_RASTER_DRAW *d, const EMU_VERTEX_FORMAT *f, int i, EMU_VERTEX *v) {
+    const u8 *p;
+
+    if (f->indexType == 1)
+        i = ((const u8 *)d->indices)[i];
+    else if (f->indexType == 2)
+        i = ((const u16 *)d->indices)[i];
+    p = (const u8 *)d->vertices + i * f->size;
+
+    // In 2D mode the texture coordinates are in texels and positions in pixels
+    switch (f->texType) {
+        case 1:
+            v->u = p[f->texOffset];
+            v->v = p[f->texOffset + 1];
+            break;
+        case 2:
+            v->u = ((const u16 *)(p + f->texOffset))[0];
+            v->v = ((const u16 *)(p + f->texOffset))[1];
+            break;
+        case 3:
+            v->u = ((const float *)(p + f->texOffset))[0];
+            v->v = ((const float *)(p + f->texOffset))[1];
+            break;
+        default:
+            v->u = v->v = 0.0f;
+            break;
+    }
+
+    switch (f->colorType) {
+        case 4:
+        case 5:
+        case 6:
+            v->color = emuColor(emuUnpack(f->colorType - 4, *(const u16 *)(p + f->colorOffset)));
+            break;
+        case 7:
+            v->color = emuColor(*(const u32 *)(p + f->colorOffset));
+            break;
+        default:
+            v->color = emuColor(c->s->materialColor);
+            break;
+    }
+
+    switch (f->posType) {
+        case 1:
+            v->x = ((const s8 *)(p + f->posOffset))[0];
+            v->y = ((const s8 *)(p + f->posOffset))[1];
+            break;
+        case 2:
+            v->x = ((const s16 *)(p + f->posOffset))[0];
+            v->y = ((const s16 *)(p + f->posOffset))[1];
+            break;
+        default:
+            v->x = ((const float *)(p + f->posOffset))[0];
+            v->y = ((const float *)(p + f->posOffset))[1];
+            break;
+    }
+}
+
+/*
+    Textures
+*/
+static u32 emuTexel(const EMU_RASTER_CTX *c, int tx, int ty) {
+    static const int bits[8] = {16, 16, 16, 32, 4, 8, 16, 32};
+    const EMU_GE_STATE *s = c->s;
+    int bpp = bits[s->texPsm & 7], rowBytes = (s->texBufferWidth * bpp) >> 3, byteX, offset;
+    const u8 *p;
+    u32 index;
+
+    if (s->texWrapU == GU_CLAMP)
+        tx = tx < 0 ? 0 : tx >= s->texWidth ? s->texWidth - 1 : tx;
+    else
+        tx &= s->texWidth - 1;
+    if (s->texWrapV == GU_CLAMP)
+        ty = ty < 0 ? 0 : ty >= s->texHeight ? s->texHeight - 1 : ty;
+    else
+        ty &= s->texHeight - 1;
+
+    // Swizzled textures are stored in blocks of 16 bytes x 8 lines
+    byteX = (tx * bpp) >> 3;
+    if (s->texSwizzle)
+        offset = (((ty >> 3) * (rowBytes >> 4) + (byteX >> 4)) << 7) + ((ty & 7) << 4) + (byteX & 15);
+    else
+        offset = ty * rowBytes + byteX;
+    p = s->texData + offset;
+
+    switch (s->texPsm) {
+        case GU_PSM_5650:
+        case GU_PSM_5551:
+        case GU_PSM_4444:
+            return emuUnpack(s->texPsm, *(const u16 *)p);
+        case GU_PSM_8888:
+            return *(const u32 *)p;
+        case GU_PSM_T4:
+            index = (*p >> ((tx & 1) << 2)) & 15;
+            break;
+        case GU_PSM_T8:
+            index = *p;
+            break;
+        case GU_PSM_T16:
+            index = *(const u16 *)p;
+            break;
+        case GU_PSM_T32:
+            index = *(const u32 *)p;
+            break;
+        default:
+            return 0;
+    }
+
+    if (!c->clut)
+        return 0;
+    index = ((index >> s->clutShift) & s->clutMask) | ((s->clutStart & 0x1f) << 4);
+    if (s->clutPsm == GU_PSM_8888)
+        return ((const u32 *)c->clut)[index & 255];
+    return emuUnpack(s->clutPsm, ((const u16 *)c->clut)[index & 511]);
+}
+
+static EMU_COLOR emuSampleTexture(const EMU_RASTER_CTX *c, float u, float v) {
+    EMU_COLOR t00, t10, t01, t11, col;
+    int fu, fv, tx, ty, wx, wy;
+
+    if (!c->linearFilter)
+        return emuColor(emuTexel(c, (int)floorf(u), (int)floorf(v)));
+
+    // Bilinear: the four texels around the sample point, weights in 1/256
+    fu = (int)floorf((u - 0.5f) * 256.0f);
+    fv = (int)floorf((v - 0.5f) * 256.0f);
+    tx = fu >> 8;
+    ty = fv >> 8;
+    wx = fu & 255;
+    wy = fv & 255;
+    t00 = emuColor(emuTexel(c, tx, ty));
+    t10 = emuColor(emuTexel(c, tx + 1, ty));
+    t01 = emuColor(emuTexel(c, tx, ty + 1));
+    t11 = emuColor(emuTexel(c, tx + 1, ty + 1));
+#define EMU_LERP2(ch) ((((t00.ch * (256 - wx) + t10.ch * wx) * (256 - wy)) + ((t01.ch * (256 - wx) + t11.ch * wx) * wy)) >> 16)
+    col.r = EMU_LERP2(r);
+    col.g = EMU_LERP2(g);
+    col.b = EMU_LERP2(b);
+    col.a = EMU_LERP2(a);
+#undef EMU_LERP2
+    return col;
+}
+
+static EMU_COLOR emuTextureFunction(const EMU_GE_STATE *s, EMU_COLOR t, EMU_COLOR c) {
+    EMU_COLOR out, env;
+
+    switch (s->texFunc) {
+        case GU_TFX_DECAL:
+            if (s->texAlpha) {
+                out.r = (c.r * (255 - t.a) + t.r * t.a + 127) / 255;
+                out.g = (c.g * (255 - t.a) + t.g * t.a + 127) / 255;
+                out.b = (c.b * (255 - t.a) + t.b * t.a + 127) / 255;
+            }
+            else {
+                out.r = t.r;
+                out.g = t.g;
+                out.b = t.b;
+            }
+            out.a = c.a;
+            return out;
+        case GU_TFX_BLEND:
+            env = emuColor(s->texEnvColor);
+            out.r = (c.r * (255 - t.r) + env.r * t.r + 127) / 255;
+            out.g = (c.g * (255 - t.g) + env.g * t.g + 127) / 255;
+            out.b = (c.b * (255 - t.b) + env.b * t.b + 127) / 255;
+            break;
+        case GU_TFX_REPLACE:
+            out = t;
+            if (!s->texAlpha)
+                out.a = c.a;
+            return out;
+        case GU_TFX_ADD:
+            out.r = t.r + c.r > 255 ? 255 : t.r + c.r;
+            out.g = t.g + c.g > 255 ? 255 : t.g + c.g;
+            out.b = t.b + c.b > 255 ? 255 : t.b + c.b;
+            break;
+        default:
+            out.r = EMU_MUL(t.r, c.r);
+            out.g = EMU_MUL(t.g, c.g);
+            out.b = EMU_MUL(t.b, c.b);
+            break;
+    }
+    out.a = s->texAlpha ? EMU_MUL(t.a, c.a) : c.a;
+    return out;
+}
+
+/*
+    Per-fragment operations
+*/
+static inline int emuCompare(int func, int a, int b) {
+    switch (func) {
+        case GU_NEVER:      return 0;
+        case GU_ALWAYS:     return 1;
+        case GU_EQUAL:      return a == b;
+        case GU_NOTEQUAL:   return a != b;
+        case GU_LESS:       return a < b;
+        case GU_LEQUAL:     return a <= b;
+        case GU_GREATER:    return a > b;
+        default:            return a >= b;
+    }
+}
+
+static inline int emuStencilOp(int op, int ref, int stencil) {
+    switch (op) {
+        case GU_ZERO:       return 0;
+        case GU_REPLACE:    return ref;
+        case GU_INVERT:     return ~stencil & 0xff;
+        case GU_INCR:       return stencil < 255 ? stencil + 1 : 255;
+        case GU_DECR:       return stencil > 0 ? stencil - 1 : 0;
+        default:            return stencil;
+    }
+}
+
+// "other" is the destination color for the source factor and the source color for the destination factor
+static inline int emuBlendFactor(int factor, int other, int srcAlpha, int dstAlpha, int fix) {
+    switch (factor) {
+        case 0:     return other;
+        case 1:     return 255 - other;
+        case 2:     return srcAlpha;
+        case 3:     return 255 - srcAlpha;
+        case 4:     return dstAlpha;
+        case 5:     return 255 - dstAlpha;
+        case 6:     return 2 * srcAlpha;
+        case 7:     return srcAlpha > 127 ? 0 : 255 - 2 * srcAlpha;
+        case 8:     return 2 * dstAlpha;
+        case 9:     return dstAlpha > 127 ? 0 : 255 - 2 * dstAlpha;
+        default:    return fix;
+    }
+}
+
+static inline int emuBlendChannel(const EMU_GE_STATE *s, int src, int dst, int srcAlpha, int dstAlpha, int fixSrc, int fixDst) {
+    int a = emuBlendFactor(s->blendSrc, dst, srcAlpha, dstAlpha, fixSrc);
+    int b = emuBlendFactor(s->blendDst, src, srcAlpha, dstAlpha, fixDst);
+    int v;
+
+    switch (s->blendOp) {
+        case GU_SUBTRACT:           v = (src * a - dst * b) / 255; break;
+        case GU_REVERSE_SUBTRACT:   v = (dst * b - src * a) / 255; break;
+        case GU_MIN:                v = src < dst ? src : dst; break;
+        case GU_MAX:                v = src > dst ? src : dst; break;
+        case GU_ABS:                v = src > dst ? src - dst : dst - src; break;
+        default:                    v = (src * a + dst * b + 127) / 255; break;
+    }
+    return EMU_CLAMP(v);
+}
+
+static inline void emuWritePixel(u8 *p, int psm, EMU_COLOR c) {
+    switch (psm) {
+        case GU_PSM_5650:
+            *(u16 *)p = (c.r >> 3) | ((c.g >> 2) << 5) | ((c.b >> 3) << 11);
+            break;
+        case GU_PSM_5551:
+            *(u16 *)p = (c.r >> 3) | ((c.g >> 3) << 5) | ((c.b >> 3) << 10) | ((c.a >> 7) << 15);
+            break;
+        case GU_PSM_4444:
+            *(u16 *)p = (c.r >> 4) | ((c.g >> 4) << 4) | ((c.b >> 4) << 8) | ((c.a >> 4) << 12);
+            break;
+        default:
+            *(u32 *)p = c.r | (c.g << 8) | (c.b << 16) | ((u32)c.a << 24);
+            break;
+    }
+}
+
+static void emuFragment(const EMU_RASTER_CTX *c, int x, int y, EMU_COLOR col, float u, float v) {
+    const EMU_GE_STATE *s = c->s;
+    int psm = s->drawBufferPsm, stencil;
+    u8 *p = s->drawBuffer + (y * s->drawBufferWidth + x) * (psm == GU_PSM_8888 ? 4 : 2);
+    EMU_COLOR dst = emuColor(psm == GU_PSM_8888 ? *(u32 *)p : emuUnpack(psm, *(u16 *)p));
+
+    // The stencil buffer is the alpha of the draw buffer (none in 5650)
+    if (psm == GU_PSM_5650)
+        dst.a = 0;
+    stencil = dst.a;
+
+    if (s->clearMode) {
+        if (s->clearFlags & GU_COLOR_BUFFER_BIT) {
+            dst.r = col.r;
+            dst.g = col.g;
+            dst.b = col.b;
+        }
+        if (s->clearFlags & GU_STENCIL_BUFFER_BIT)
+            dst.a = col.a;
+        emuWritePixel(p, psm, dst);
+        return;
+    }
+
+    if (s->textureEnabled && s->texData)
+        col = emuTextureFunction(s, emuSampleTexture(c, u, v), col);
+
+    if (s->colorTestEnabled) {
+        u32 rgb = col.r | (col.g << 8) | (col.b << 16);
+        if (!emuCompare(s->colorFunc, rgb & s->colorMask & 0xffffff, s->colorRef & s->colorMask & 0xffffff))
+            return;
+    }
+
+    if (s->alphaTestEnabled && !emuCompare(s->alphaFunc, col.a & s->alphaMask, s->alphaRef & s->alphaMask))
+        return;
+
+    if (s->stencilTestEnabled) {
+        if (!emuCompare(s->stencilFunc, s->stencilRef & s->stencilMask, stencil & s->stencilMask)) {
+            dst.a = emuStencilOp(s->stencilFail, s->stencilRef, stencil);
+            emuWritePixel(p, psm, dst);
+            return;
+        }
+        // No depth test in 2D: the fragment passes it
+        stencil = emuStencilOp(s->stencilZPass, s->stencilRef, stencil);
+    }
+
+    if (s->blendEnabled) {
+        EMU_COLOR fixSrc = emuColor(s->blendFixSrc), fixDst = emuColor(s->blendFixDst);
+        col.r = emuBlendChannel(s, col.r, dst.r, col.a, dst.a, fixSrc.r, fixDst.r);
+        col.g = emuBlendChannel(s, col.g, dst.g, col.a, dst.a, fixSrc.g, fixDst.g);
+        col.b = emuBlendChannel(s, col.b, dst.b, col.a, dst.a, fixSrc.b, fixDst.b);
+    }
+
+    if (s->ditherEnabled && psm != GU_PSM_8888) {
+        int d = emu_ditherMatrix[((y & 3) << 2) | (x & 3)];
+        col.r = EMU_CLAMP(col.r + d);
+        col.g = EMU_CLAMP(col.g + d);
+        col.b = EMU_CLAMP(col.b + d);
+    }
+
+    col.a = stencil;
+    emuWritePixel(p, psm, col);
+}
+
+/*
+    Primitives. A pixel is covered when its center is inside the primitive.
+*/
+static inline int emuOwnsLine(const EMU_RASTER_CTX *c, int y) {
+    return ((y >> EMU_BAND_SHIFT) % c->bandCount) == c->band;
+}
+
+static inline int emuPixelStart(float coord) {
+    return (int)ceilf(coord - 0.5f);
+}
+
+static void emuDrawSprite(EMU_RASTER_CTX *c, const EMU_VERTEX *v0, const EMU_VERTEX *v1) {
+    float dx = v1->x - v0->x, dy = v1->y - v0->y;
+    float du = dx != 0.0f ? (v1->u - v0->u) / dx : 0.0f, dv = dy != 0.0f ? (v1->v - v0->v) / dy : 0.0f;
+    int x0 = emuPixelStart(dx > 0.0f ? v0->x : v1->x), x1 = emuPixelStart(dx > 0.0f ? v1->x : v0->x);
+    int y0 = emuPixelStart(dy > 0.0f ? v0->y : v1->y), y1 = emuPixelStart(dy > 0.0f ? v1->y : v0->y);
+    int x, y;
+
+    if (x0 < c->clip[0]) x0 = c->clip[0];
+    if (y0 < c->clip[1]) y0 = c->clip[1];
+    if (x1 > c->clip[2]) x1 = c->clip[2];
+    if (y1 > c->clip[3]) y1 = c->clip[3];
+
+    // Minification filter when more than one texel per pixel
+    c->linearFilter = ((fabsf(du) > 1.0f || fabsf(dv) > 1.0f) ? c->s->texMinFilter : c->s->texMagFilter) & 1;
+
+    // Sprites take the color of their second vertex
+    for (y = y0; y < y1; y++) {
+        float v;
+        if (!emuOwnsLine(c, y))
+            continue;
+        v = v0->v + ((float)y + 0.5f - v0->y) * dv;
+        for (x = x0; x < x1; x++)
+            emuFragment(c, x, y, v1->color, v0->u + ((float)x + 0.5f - v0->x) * du, v);
+    }
+}
+
+static inline long long emuEdge(long long ax, long long ay, long long bx, long long by, long long px, long long py) {
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+// Pixels exactly on an edge belong to only one of the two triangles sharing it
+static inline int emuInsideEdge(long long w, long long dx, long long dy) {
+    return w > 0 || (w == 0 && (dy < 0 || (dy == 0 && dx > 0)));
+}
+
+static void emuDrawTriangle(EMU_RASTER_CTX *c, const EMU_VERTEX *va, const EMU_VERTEX *vb, const EMU_VERTEX *vc) {
+    const EMU_VERTEX *provoking = vc;
+    long long ax, ay, bx, by, cx, cy, area, w0, w1, w2;
+    int x0, y0, x1, y1, x, y;
+    float invArea;
+
+    // 12.4 fixed point like the GE
+    ax = lrintf(va->x * 16.0f); ay = lrintf(va->y * 16.0f);
+    bx = lrintf(vb->x * 16.0f); by = lrintf(vb->y * 16.0f);
+    cx = lrintf(vc->x * 16.0f); cy = lrintf(vc->y * 16.0f);
+    area = emuEdge(ax, ay, bx, by, cx, cy);
+    if (area == 0)
+        return;
+    if (area < 0) {
+        const EMU_VERTEX *tmpV = vb;
+        long long tmp;
+        vb = vc; vc = tmpV;
+        tmp = bx; bx = cx; cx = tmp;
+        tmp = by; by = cy; cy = tmp;
+        area = -area;
+    }
+    invArea = 1.0f / (float)area;
+
+    // Bounding box of the pixel centers
+    x0 = (int)((EMU_MIN3(ax, bx, cx) - 8 + 15) >> 4);
+    y0 = (int)((EMU_MIN3(ay, by, cy) - 8 + 15) >> 4);
+    x1 = (int)((EMU_MAX3(ax, bx, cx) - 8) >> 4) + 1;
+    y1 = (int)((EMU_MAX3(ay, by, cy) - 8) >> 4) + 1;
+    if (x0 < c->clip[0]) x0 = c->clip[0];
+    if (y0 < c->clip[1]) y0 = c->clip[1];
+    if (x1 > c->clip[2]) x1 = c->clip[2];
+    if (y1 > c->clip[3]) y1 = c->clip[3];
+
+    c->linearFilter = c->s->texMagFilter & 1;
+
+    for (y = y0; y < y1; y++) {
+        long long py = y * 16 + 8;
+        if (!emuOwnsLine(c, y))
+            continue;
+        for (x = x0; x < x1; x++) {
+            long long px = x * 16 + 8;
+            EMU_COLOR col;
+            float l0, l1, l2;
+
+            w0 = emuEdge(bx, by, cx, cy, px, py);
+            w1 = emuEdge(cx, cy, ax, ay, px, py);
+            w2 = emuEdge(ax, ay, bx, by, px, py);
+            if (!emuInsideEdge(w0, cx - bx, cy - by) || !emuInsideEdge(w1, ax - cx, ay - cy) || !emuInsideEdge(w2, bx - ax, by - ay))
+                continue;
+
+            l0 = (float)w0 * invArea;
+            l1 = (float)w1 * invArea;
+            l2 = (float)w2 * invArea;
+            if (c->s->shadeSmooth) {
+                col.r = (int)(l0 * va->color.r + l1 * vb->color.r + l2 * vc->color.r + 0.5f);
+                col.g = (int)(l0 * va->color.g + l1 * vb->color.g + l2 * vc->color.g + 0.5f);
+                col.b = (int)(l0 * va->color.b + l1 * vb->color.b + l2 * vc->color.b + 0.5f);
+                col.a = (int)(l0 * va->color.a + l1 * vb->color.a + l2 * vc->color.a + 0.5f);
+            }
+            else
+                col = provoking->color;
+            emuFragment(c, x, y, col, l0 * va->u + l1 * vb->u + l2 * vc->u, l0 * va->v + l1 * vb->v + l2 * vc->v);
+        }
+    }
+}
+
+// The last pixel of a line is not drawn so that line strips don't draw their joints twice
+static void emuDrawLine(EMU_RASTER_CTX *c, const EMU_VERTEX *va, const EMU_VERTEX *vb) {
+    float dx = vb->x - va->x, dy = vb->y - va->y;
+    int steps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dy))), i;
+
+    c->linearFilter = c->s->texMagFilter & 1;
+    for (i = 0; i < steps; i++) {
+        float t = (float)i / (float)steps;
+        int x = (int)floorf(va->x + dx * t), y = (int)floorf(va->y + dy * t);
+        EMU_COLOR col;
+
+        if (x < c->clip[0] || x >= c->clip[2] || y < c->clip[1] || y >= c->clip[3] || !emuOwnsLine(c, y))
+            continue;
+        if (c->s->shadeSmooth) {
+            col.r = (int)(va->color.r + (vb->color.r - va->color.r) * t + 0.5f);
+            col.g = (int)(va->color.g + (vb->color.g - va->color.g) * t + 0.5f);
+            col.b = (int)(va->color.b + (vb->color.b - va->color.b) * t + 0.5f);
+            col.a = (int)(va->color.a + (vb->color.a - va->color.a) * t + 0.5f);
+        }
+        else
+            col = vb->color;
+        emuFragment(c, x, y, col, va->u + (vb->u - va->u) * t, va->v + (vb->v - va->v) * t);
+    }
+}
+
+static void emuDrawPoint(EMU_RASTER_CTX *c, const EMU_VERTEX *v) {
+    int x = (int)floorf(v->x), y = (int)floorf(v->y);
+
+    c->linearFilter = c->s->texMagFilter & 1;
+    if (x >= c->clip[0] && x < c->clip[2] && y >= c->clip[1] && y < c->clip[3] && emuOwnsLine(c, y))
+        emuFragment(c, x, y, v->color, v->u, v->v);
+}
+
+static void emuRasterDraw(EMU_RASTER_CTX *c, const EMU_RASTER_DRAW *d) {
+    const EMU_GE_STATE *s = &emu_rasterStates[d->state];
+    EMU_VERTEX_FORMAT f;
+    EMU_VERTEX v[3];
+    int i;
+
+    if (!s->drawBuffer)
+        return;
+    emuVertexFormat(d->vtype, &f);
+    if (!f.posType || (f.indexType && !d->indices))
+        return;
+
+    c->s = s;
+    c->clut = s->clutIndex >= 0 ? emu_rasterCluts + s->clutIndex * EMU_CLUT_SIZE : NULL;
+    c->clip[0] = s->scissor[0] > 0 ? s->scissor[0] : 0;
+    c->clip[1] = s->scissor[1] > 0 ? s->scissor[1] : 0;
+    c->clip[2] = s->scissor[2] + 1 < s->drawBufferWidth ? s->scissor[2] + 1 : s->drawBufferWidth;
+    c->clip[3] = s->scissor[3] + 1;
+
+    switch (d->prim) {
+        case GU_POINTS:
+            for (i = 0; i < d->count; i++) {
+                emuFetchVertex(c, d, &f, i, &v[0]);
+                emuDrawPoint(c, &v[0]);
+            }
+            break;
+        case GU_LINES:
+            for (i = 0; i + 1 < d->count; i += 2) {
+                emuFetchVertex(c, d, &f, i, &v[0]);
+                emuFetchVertex(c, d, &f, i + 1, &v[1]);
+                emuDrawLine(c, &v[0], &v[1]);
+            }
+            break;
+        case GU_LINE_STRIP:
+            emuFetchVertex(c, d, &f, 0, &v[0]);
+            for (i = 1; i < d->count; i++) {
+                emuFetchVertex(c, d, &f, i, &v[i & 1]);
+                emuDrawLine(c, &v[(i - 1) & 1], &v[i & 1]);
+            }
+            break;
+        case GU_TRIANGLES:
+            for (i = 0; i + 2 < d->count; i += 3) {
+                emuFetchVertex(c, d, &f, i, &v[0]);
+                emuFetchVertex(c, d, &f, i + 1, &v[1]);
+                emuFetchVertex(c, d, &f, i + 2, &v[2]);
+                emuDrawTriangle(c, &v[0], &v[1], &v[2]);
+            }
+            break;
+        case GU_TRIANGLE_STRIP:
+            if (d->count >= 2) {
+                emuFetchVertex(c, d, &f, 0, &v[0]);
+                emuFetchVertex(c, d, &f, 1, &v[1]);
+            }
+            for (i = 2; i < d->count; i++) {
+                emuFetchVertex(c, d, &f, i, &v[i % 3]);
+                emuDrawTriangle(c, &v[(i - 2) % 3], &v[(i - 1) % 3], &v[i % 3]);
+            }
+            break;
+        case GU_TRIANGLE_FAN:
+            if (d->count >= 2) {
+                emuFetchVertex(c, d, &f, 0, &v[0]);
+                emuFetchVertex(c, d, &f, 1, &v[1]);
+            }
+            for (i = 2; i < d->count; i++) {
+                emuFetchVertex(c, d, &f, i, &v[2]);
+                emuDrawTriangle(c, &v[0], &v[1], &v[2]);
+                v[1] = v[2];
+            }
+            break;
+        case GU_SPRITES:
+            for (i = 0; i + 1 < d->count; i += 2) {
+                emuFetchVertex(c, d, &f, i, &v[0]);
+                emuFetchVertex(c, d, &f, i + 1, &v[1]);
+                emuDrawSprite(c, &v[0], &v[1]);
+            }
+            break;
+    }
+}
+
+/*
+    Queue and threads
+*/
+static void emuRasterRun(int band) {
+    EMU_RASTER_CTX ctx;
+    int i;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.band = band;
+    ctx.bandCount = emu_rasterThreads;
+    for (i = 0; i < emu_rasterDrawCount; i++)
+        emuRasterDraw(&ctx, &emu_rasterDraws[i]);
+}
+
+static void *emuRasterWorker(void *arg) {
+    int band = (int)(intptr_t)arg, generation = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&emu_rasterMutex);
+        while (emu_rasterGeneration == generation)
+            pthread_cond_wait(&emu_rasterStartCond, &emu_rasterMutex);
+        generation = emu_rasterGeneration;
+        pthread_mutex_unlock(&emu_rasterMutex);
+
+        emuRasterRun(band);
+
+        pthread_mutex_lock(&emu_rasterMutex);
+        if (--emu_rasterPending == 0)
+            pthread_cond_signal(&emu_rasterDoneCond);
+        pthread_mutex_unlock(&emu_rasterMutex);
+    }
+    return NULL;
+}
+
+void emuRasterQueue(int prim, int vtype, int count, const void *indices, const void *vertices) {
+    static int warned = 0;
+    EMU_RASTER_DRAW *d;
+
+    if (!emu_rasterEnabled || count <= 0 || !vertices)
+        return;
+    if (!(vtype & GU_TRANSFORM_2D)) {
+        if (!warned)
+            fprintf(stderr, "emuRaster: 3D draws are not rendered\n");
+        warned = 1;
+        return;
+    }
+
+    if (emu_geStateDirty || !emu_rasterStateCount) {
+        emu_rasterStates = emuRasterGrow(emu_rasterStates, &emu_rasterStateMax, emu_rasterStateCount + 1, sizeof(EMU_GE_STATE));
+        emu_rasterStates[emu_rasterStateCount++] = emu_geState;
+        emu_geStateDirty = 0;
+    }
+
+    emu_rasterDraws = emuRasterGrow(emu_rasterDraws, &emu_rasterDrawMax, emu_rasterDrawCount + 1, sizeof(EMU_RASTER_DRAW));
+    d = &emu_rasterDraws[emu_rasterDrawCount++];
+    d->state = emu_rasterStateCount - 1;
+    d->prim = prim;
+    d->vtype = vtype;
+    d->count = count;
+    d->indices = indices;
+    d->vertices = vertices;
+}
+
+void emuRasterLoadClut(const void *data, int size) {
+    u8 *block;
+
+    if (!emu_rasterEnabled)
+        return;
+    if (size > EMU_CLUT_SIZE)
+        size = EMU_CLUT_SIZE;
+    emu_rasterCluts = emuRasterGrow(emu_rasterCluts, &emu_rasterClutMax, (emu_rasterClutCount + 1) * EMU_CLUT_SIZE, 1);
+    block = emu_rasterCluts + emu_rasterClutCount * EMU_CLUT_SIZE;
+    memcpy(block, data, size);
+    memset(block + size, 0, EMU_CLUT_SIZE - size);
+    emu_geState.clutIndex = emu_rasterClutCount++;
+    emu_geStateDirty = 1;
+}
+
+void emuRasterFlush(void) {
+    int i;
+
+    if (!emu_rasterDrawCount)
+        return;
+
+    if (emu_rasterThreads > 1) {
+        if (!emu_rasterWorkersStarted) {
+            for (i = 1; i < emu_rasterThreads; i++) {
+                pthread_t thread;
+                if (pthread_create(&thread, NULL, emuRasterWorker, (void *)(intptr_t)i)) {
+                    fprintf(stderr, "emuRaster: can't create the rendering threads\n");
+                    exit(1);
+                }
+                pthread_detach(thread);
+            }
+            emu_rasterWorkersStarted = 1;
+        }
+        pthread_mutex_lock(&emu_rasterMutex);
+        emu_rasterPending = emu_rasterThreads - 1;
+        emu_rasterGeneration++;
+        pthread_cond_broadcast(&emu_rasterStartCond);
+        pthread_mutex_unlock(&emu_rasterMutex);
+
+        emuRasterRun(0);
+
+        pthread_mutex_lock(&emu_rasterMutex);
+        while (emu_rasterPending)
+            pthread_cond_wait(&emu_rasterDoneCond, &emu_rasterMutex);
+        pthread_mutex_unlock(&emu_rasterMutex);
+    }
+    else
+        emuRasterRun(0);
+
+    emu_rasterDrawCount = 0;
+    emu_rasterStateCount = 0;
+    // Keep only the palette currently loaded
+    if (emu_geState.clutIndex > 0) {
+        memmove(emu_rasterCluts, emu_rasterCluts + emu_geState.clutIndex * EMU_CLUT_SIZE, EMU_CLUT_SIZE);
+        emu_geState.clutIndex = 0;
+    }
+    emu_rasterClutCount = emu_geState.clutIndex + 1;
+    emu_geStateDirty = 1;
+}
+
+void emuRasterCopyImage(int psm, int sx, int sy, int width, int height, int srcw, const u8 *src, int dx, int dy, int destw, u8 *dest) {
+    int bpp = psm == GU_PSM_8888 ? 4 : 2, y;
+
+    if (!emu_rasterEnabled)
+        return;
+    // The transfer sees the draws queued before it
+    emuRasterFlush();
+    for (y = 0; y < height; y++)
+        memmove(dest + ((dy + y) * destw + dx) * bpp, src + ((sy + y) * srcw + sx) * bpp, width * bpp);
+}
+
+/*
+    Golden images
+*/
+static int emuCompareImageFile(OSL_IMAGE *img, const char *filename, int tolerance) {
+    OSL_IMAGE *ref = oslLoadImageFilePNG((char *)filename, OSL_IN_RAM | OSL_UNSWIZZLED, OSL_PF_8888);
+    int x, y, differences = 0;
+
+    if (!ref)
+        return -1;
+    if (ref->sizeX != img->sizeX || ref->sizeY != img->sizeY)
+        differences = img->sizeX * img->sizeY;
+    else {
+        for (y = 0; y < img->sizeY; y++) {
+            for (x = 0; x < img->sizeX; x++) {
+                EMU_COLOR a = emuColor(oslConvertColor(OSL_PF_8888, img->pixelFormat, oslGetImagePixel(img, x, y)));
+                EMU_COLOR b = emuColor(oslGetImagePixel(ref, x, y));
+                if (abs(a.r - b.r) > tolerance || abs(a.g - b.g) > tolerance || abs(a.b - b.b) > tolerance)
+                    differences++;
+            }
+        }
+    }
+    oslDeleteImage(ref);
+    return differences;
+}
+
+void emuRasterCheckFrame(int frame) {
+    char name[512], actual[512];
+    FILE *f;
+    int differences;
+
+    if (!emu_goldenDir)
+        return;
+
+    // Missing images are recorded, the others are compared (alpha is the stencil buffer and is ignored)
+    snprintf(name, sizeof(name), "%s/frame%04d.png", emu_goldenDir, frame);
+    f = fopen(name, "rb");
+    if (!f) {
+        if (!oslWriteImageFilePNG(OSL_DEFAULT_BUFFER, name, 0))
+            emu_goldenFailures++;
+        return;
+    }
+    fclose(f);
+
+    differences = emuCompareImageFile(OSL_DEFAULT_BUFFER, name, emu_goldenTolerance);
+    if (differences) {
+        snprintf(actual, sizeof(actual), "%s/frame%04d.actual.png", emu_goldenDir, frame);
+        oslWriteImageFilePNG(OSL_DEFAULT_BUFFER, actual, 0);
+        if (differences < 0)
+            fprintf(stderr, "%s: can't be read\n", name);
+        else
+            fprintf(stderr, "%s: %d pixels differ, see %s\n", name, differences, actual);
+        emu_goldenFailures++;
+    }
+}
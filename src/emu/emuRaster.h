@@ -0,0 +1,58 @@
+#ifndef _OSL_EMU_RASTER_H_
+#define _OSL_EMU_RASTER_H_
+
+/*
+    GE state shared by the recording GU (emuGu.c) and the reference rasterizer (emuRaster.c).
+    Addresses are CPU pointers; colors are 32-bit ABGR like on the PSP.
+*/
+
+typedef struct {
+    u8 *drawBuffer;
+    int drawBufferPsm, drawBufferWidth;
+    int scissor[4];                         // x0, y0, x1, y1 (inclusive)
+    int clearMode, clearFlags;
+    int shadeSmooth;
+    u32 materialColor;                      // Used by vertices without a color
+    int ditherEnabled;
+
+    int textureEnabled;
+    int texPsm, texSwizzle;
+    const u8 *texData;
+    int texBufferWidth, texWidth, texHeight;
+    int texMinFilter, texMagFilter, texWrapU, texWrapV;
+    int texFunc, texAlpha;
+    u32 texEnvColor;
+
+    int clutPsm, clutShift, clutMask, clutStart;
+    int clutIndex;                          // Copy made by sceGuClutLoad, -1 if none
+
+    int blendEnabled, blendOp, blendSrc, blendDst;
+    u32 blendFixSrc, blendFixDst;
+
+    int alphaTestEnabled, alphaFunc, alphaRef, alphaMask;
+    int colorTestEnabled, colorFunc;
+    u32 colorRef, colorMask;
+
+    int stencilTestEnabled, stencilFunc, stencilRef, stencilMask;
+    int stencilFail, stencilZFail, stencilZPass;
+} EMU_GE_STATE;
+
+/** Current state, updated by the sceGu* functions */
+extern EMU_GE_STATE emu_geState;
+/** Set when emu_geState changed since the last queued draw */
+extern int emu_geStateDirty;
+
+/** Reads OSL_EMU_RASTER, OSL_EMU_THREADS and OSL_EMU_GOLDEN (called by sceGuInit) */
+extern void emuRasterInit(void);
+/** Queues a draw with the current state */
+extern void emuRasterQueue(int prim, int vtype, int count, const void *indices, const void *vertices);
+/** Keeps a copy of the palette, as the GE does when executing the CLUT load */
+extern void emuRasterLoadClut(const void *data, int size);
+/** Renders the queued draws; returns when the draw buffers are up to date */
+extern void emuRasterFlush(void);
+/** Performs a sceGuCopyImage transfer after the queued draws */
+extern void emuRasterCopyImage(int psm, int sx, int sy, int width, int height, int srcw, const u8 *src, int dx, int dy, int destw, u8 *dest);
+/** Compares the frame with the golden image directory (called by emuEndFrame) */
+extern void emuRasterCheckFrame(int frame);
+
+#endif
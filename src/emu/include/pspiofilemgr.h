@@ -0,0 +1,2 @@
+/* Host build: the PSPSDK declarations come from the headless backend */
+#include "../../emu.h"
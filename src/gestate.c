@@ -0,0 +1,157 @@
+#include "oslib.h"
+
+/*
+    GE state cache.
+    OSLib sets the same states over and over (texturing around shapes and text, blending at each oslSetAlpha, texture
+    mode at each texture change...). The last value sent for each of them is kept here, and a change that wouldn't
+    change anything is dropped: it takes no room in the display list and doesn't interrupt the sprite batch.
+*/
+
+int osl_geSavedCommandCount = 0;
+
+static struct {
+    u32 statesKnown, statesEnabled;         // One bit per GU_* state
+    int blendKnown, blendOp, blendSrc, blendDest;
+    u32 blendSrcFix, blendDestFix;
+    int alphaFuncKnown, alphaFunc, alphaValue, alphaMask;
+    int colorFuncKnown, colorFunc;
+    u32 colorValue, colorMask;
+    int texFuncKnown, texFunc, texAlpha;
+    int ambientColorKnown;
+    u32 ambientColor;
+    int texModeKnown, texPsm, texMaxMips, texA2, texSwizzle;
+    int clutModeKnown;
+    u32 clutPsm, clutShift, clutMask, clutA3;
+} osl_geState;
+
+void oslInvalidateGeState() {
+    memset(&osl_geState, 0, sizeof(osl_geState));
+}
+
+void oslGuSetState(int state, int enabled) {
+    u32 bit = 1 << state;
+
+    enabled = enabled ? 1 : 0;
+    if (state == GU_TEXTURE_2D)
+        osl_textureEnabled = enabled;
+
+    if ((osl_geState.statesKnown & bit) && !(osl_geState.statesEnabled & bit) == !enabled) {
+        osl_geSavedCommandCount++;
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    if (enabled)
+        sceGuEnable(state);
+    else
+        sceGuDisable(state);
+    osl_geState.statesKnown |= bit;
+    if (enabled)
+        osl_geState.statesEnabled |= bit;
+    else
+        osl_geState.statesEnabled &= ~bit;
+}
+
+void oslGuBlendFunc(int op, int src, int dest, u32 srcFix, u32 destFix) {
+    // The fixed colors are only sent (and only matter) with GU_FIX
+    if (osl_geState.blendKnown && osl_geState.blendOp == op && osl_geState.blendSrc == src && osl_geState.blendDest == dest
+            && (src != GU_FIX || osl_geState.blendSrcFix == srcFix) && (dest != GU_FIX || osl_geState.blendDestFix == destFix)) {
+        osl_geSavedCommandCount += 1 + (src == GU_FIX) + (dest == GU_FIX);
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    sceGuBlendFunc(op, src, dest, srcFix, destFix);
+    osl_geState.blendKnown = 1;
+    osl_geState.blendOp = op;
+    osl_geState.blendSrc = src;
+    osl_geState.blendDest = dest;
+    osl_geState.blendSrcFix = srcFix;
+    osl_geState.blendDestFix = destFix;
+}
+
+void oslGuAlphaFunc(int func, int value, int mask) {
+    if (osl_geState.alphaFuncKnown && osl_geState.alphaFunc == func && osl_geState.alphaValue == value && osl_geState.alphaMask == mask) {
+        osl_geSavedCommandCount++;
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    sceGuAlphaFunc(func, value, mask);
+    osl_geState.alphaFuncKnown = 1;
+    osl_geState.alphaFunc = func;
+    osl_geState.alphaValue = value;
+    osl_geState.alphaMask = mask;
+}
+
+void oslGuColorFunc(int func, u32 color, u32 mask) {
+    if (osl_geState.colorFuncKnown && osl_geState.colorFunc == func && osl_geState.colorValue == color && osl_geState.colorMask == mask) {
+        osl_geSavedCommandCount += 3;
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    sceGuColorFunc(func, color, mask);
+    osl_geState.colorFuncKnown = 1;
+    osl_geState.colorFunc = func;
+    osl_geState.colorValue = color;
+    osl_geState.colorMask = mask;
+}
+
+void oslGuTexFunc(int tfx, int tcc) {
+    if (osl_geState.texFuncKnown && osl_geState.texFunc == tfx && osl_geState.texAlpha == tcc) {
+        osl_geSavedCommandCount++;
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    sceGuTexFunc(tfx, tcc);
+    osl_geState.texFuncKnown = 1;
+    osl_geState.texFunc = tfx;
+    osl_geState.texAlpha = tcc;
+}
+
+void oslGuAmbientColor(u32 color) {
+    if (osl_geState.ambientColorKnown && osl_geState.ambientColor == color) {
+        osl_geSavedCommandCount += 2;
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    sceGuAmbientColor(color);
+    osl_geState.ambientColorKnown = 1;
+    osl_geState.ambientColor = color;
+}
+
+void oslGuTexMode(int psm, int maxMips, int a2, int swizzle) {
+    // sceGuTexMode also flushes the texture cache, which sceGuTexImage does anyway
+    if (osl_geState.texModeKnown && osl_geState.texPsm == psm && osl_geState.texMaxMips == maxMips && osl_geState.texA2 == a2
+            && osl_geState.texSwizzle == swizzle) {
+        osl_geSavedCommandCount += 3;
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    sceGuTexMode(psm, maxMips, a2, swizzle);
+    osl_geState.texModeKnown = 1;
+    osl_geState.texPsm = psm;
+    osl_geState.texMaxMips = maxMips;
+    osl_geState.texA2 = a2;
+    osl_geState.texSwizzle = swizzle;
+}
+
+void oslGuClutMode(u32 psm, u32 shift, u32 mask, u32 a3) {
+    if (osl_geState.clutModeKnown && osl_geState.clutPsm == psm && osl_geState.clutShift == shift && osl_geState.clutMask == mask
+            && osl_geState.clutA3 == a3) {
+        osl_geSavedCommandCount++;
+        return;
+    }
+
+    oslFlushSpriteBatch();
+    sceGuClutMode(psm, shift, mask, a3);
+    osl_geState.clutModeKnown = 1;
+    osl_geState.clutPsm = psm;
+    osl_geState.clutShift = shift;
+    osl_geState.clutMask = mask;
+    osl_geState.clutA3 = a3;
+}
@@ -95,6 +95,7 @@ _error:
 void oslDeleteImage(OSL_IMAGE *img)
 {
 	if (!oslImageIsCopy(img))                       {
+		oslUnregisterManagedImage(img);
 		oslFreeImageData(img);
 		if (img->palette)
 			oslDeletePalette(img->palette);
@@ -124,6 +125,27 @@ void oslFreeImageData(OSL_IMAGE *img)           {
 	}
 }
 
+/*
+        Called by oslVramMgrCompact when the data of an image in VRAM has been moved.
+ */
+static void oslImageVramRelocate(void *owner, void *oldAddress, void *newAddress)             {
+	OSL_IMAGE *img = (OSL_IMAGE*)owner;
+	img->data = newAddress;
+	//Force the texture to be set again
+	if (osl_curTexture == oldAddress)
+		osl_curTexture = NULL;
+	//The GE draws to the old address
+	if (img == osl_curBuf)          {
+		if (osl_isDrawingStarted)
+			oslSetDrawBuffer(img);
+		else            {
+			oslStartDrawing();
+			oslSetDrawBuffer(img);
+			oslEndDrawing();
+		}
+	}
+}
+
 /*
         Returns NULL in case of error.
 
@@ -144,12 +166,28 @@ void *oslAllocImageData(OSL_IMAGE *img, int location)           {
 	switch (location)                       {
 	case OSL_IN_VRAM:
 		img->data = oslVramMgrAllocBlock(img->totalSize);
+		//VRAM full: make room by sending least recently used managed images back to RAM
+		if (!img->data && oslEvictManagedImages(img->totalSize))
+			img->data = oslVramMgrAllocBlock(img->totalSize);
+		//Let oslVramMgrCompact move it
+		if (img->data)
+			oslVramMgrSetBlockOwner(img->data, img, oslImageVramRelocate);
 		break;
 
 	case OSL_IN_RAM:
 		img->data = memalign(16, img->totalSize);
 		break;
 
+	case OSL_IN_AUTO:
+		//Managed images start in RAM, oslSetTexture promotes them to VRAM when they are drawn often
+		img->data = memalign(16, img->totalSize);
+		if (img->data && !oslImageIsManaged(img) && !oslRegisterManagedImage(img))              {
+			free(img->data);
+			img->data = NULL;
+		}
+		location = OSL_IN_RAM;
+		break;
+
 	default:
 		img->data = NULL;
 		break;
@@ -301,7 +339,7 @@ int oslVerifyStripBlit(OSL_IMAGE *img)          {
 			vertices[3].y = img->y + img->stretchY;
 			vertices[3].z = 0;
 
-			sceGuDrawArray(GU_TRIANGLE_STRIP,GU_TEXTURE_32BITF|GU_VERTEX_32BITF|GU_TRANSFORM_2D,4,0,vertices);
+			oslGuDrawArray(GU_TRIANGLE_STRIP,GU_TEXTURE_32BITF|GU_VERTEX_32BITF|GU_TRANSFORM_2D,4,0,vertices);
 		}
 		return 1;
 	}
@@ -311,27 +349,38 @@ int oslVerifyStripBlit(OSL_IMAGE *img)          {
 
 
 void oslSetTexture(OSL_IMAGE *img)              {
-	//int wasEnable = osl_textureEnabled;
+	if (oslImageIsManaged(img))
+		oslTouchManagedImage(img);
 	oslEnableTexturing();
 	if (img->palette && osl_curPalette != img->palette)             {
+		//Les sprites en attente utilisent l'ancienne palette
+		oslFlushSpriteBatch();
 		osl_curPalette = img->palette;
 		//Change la palette
-		sceGuClutMode(img->palette->pixelFormat,0,0xff,0);
+		oslGuClutMode(img->palette->pixelFormat,0,0xff,0);
 		//Uploade la palette
 		sceGuClutLoad((img->palette->nElements>>3), img->palette->data);
 	}
 	if (osl_curTexture != img->data)                {
+		oslFlushSpriteBatch();
 		osl_curTexture = img->data;
 		//Change la texture
-		sceGuTexMode(img->pixelFormat, 0, 0, oslImageIsSwizzled(img));
+		oslGuTexMode(img->pixelFormat, 0, 0, oslImageIsSwizzled(img));
 //		sceGuTexFunc(GU_TFX_REPLACE, img->pixelFormat==OSL_PF_5650?GU_TCC_RGB:GU_TCC_RGBA);
 		sceGuTexImage(0, img->sysSizeX, img->sysSizeY, img->realSizeX, img->data);
 	}
-	/*if (!wasEnable)
-	    oslDisableTexturing();*/
 }
 
 
+/*
+        Tiles share the data of the original image, but oslVramMgrCompact would only patch the original: its block must stay in place.
+        Managed images can keep moving, their tiles follow the original when they are drawn.
+ */
+static void oslPinSharedImageData(OSL_IMAGE *img)               {
+	if (img->location == OSL_IN_VRAM && !oslImageIsManaged(img))
+		oslVramMgrSetBlockOwner(img->data, NULL, NULL);
+}
+
 OSL_IMAGE *oslCreateImageTile(OSL_IMAGE *img, int offsetX0, int offsetY0, int offsetX1, int offsetY1)
 {
 	OSL_IMAGE *newImg;
@@ -341,6 +390,7 @@ OSL_IMAGE *oslCreateImageTile(OSL_IMAGE *img, int offsetX0, int offsetY0, int of
 	memcpy(newImg, img, sizeof(OSL_IMAGE));
 	oslImageIsCopySet(newImg, 1);
 	oslSetImageTile(newImg, offsetX0, offsetY0, offsetX1, offsetY1);
+	oslPinSharedImageData(img);
 	return newImg;
 }
 
@@ -353,6 +403,7 @@ OSL_IMAGE *oslCreateImageTileSize(OSL_IMAGE *img, int offsetX0, int offsetY0, in
 	memcpy(newImg, img, sizeof(OSL_IMAGE));
 	oslImageIsCopySet(newImg, 1);
 	oslSetImageTileSize(newImg, offsetX0, offsetY0, width, height);
+	oslPinSharedImageData(img);
 	return newImg;
 }
 
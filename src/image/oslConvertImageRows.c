@@ -0,0 +1,318 @@
+#include "oslib.h"
+
+/*
+    Bulk pixel conversion.
+    Every (source format, destination format) pair has its own row converter, so the format dispatch is done once per
+    row instead of once per pixel. Truecolor results are identical to oslConvertColor. Paletted sources are expanded
+    through a table holding the palette already converted to the destination format.
+*/
+
+typedef void (*OSL_ROW_CONVERTER)(void *dst, const void *src, int count, const u32 *lut);
+
+typedef struct {
+    OSL_ROW_CONVERTER convert;                    // NULL: generic per-pixel path
+    int pfDst, pfSrc;
+    OSL_PALETTE *palette;
+    u32 lut[256];                                 // Palette converted to pfDst (paletted source only)
+} OSL_ROW_CONVERSION;
+
+// Truecolor pixel <-> 8888, with the same rounding as oslConvertColor
+static inline u32 oslDecode8888(u32 c) {
+    return c;
+}
+
+static inline u32 oslDecode5650(u32 c) {
+    int r, g, b;
+    oslRgbGet5650f(c, r, g, b);
+    return RGBA(r, g, b, 0xff);
+}
+
+static inline u32 oslDecode5551(u32 c) {
+    int r, g, b, a;
+    oslRgbaGet5551f(c, r, g, b, a);
+    return RGBA(r, g, b, a);
+}
+
+static inline u32 oslDecode4444(u32 c) {
+    int r, g, b, a;
+    oslRgbaGet4444f(c, r, g, b, a);
+    return RGBA(r, g, b, a);
+}
+
+static inline u32 oslEncode8888(u32 c) {
+    return c;
+}
+
+static inline u32 oslEncode5650(u32 c) {
+    return RGB16(c & 0xff, (c >> 8) & 0xff, (c >> 16) & 0xff);
+}
+
+static inline u32 oslEncode5551(u32 c) {
+    return RGBA15(c & 0xff, (c >> 8) & 0xff, (c >> 16) & 0xff, c >> 24);
+}
+
+static inline u32 oslEncode4444(u32 c) {
+    return RGBA12(c & 0xff, (c >> 8) & 0xff, (c >> 16) & 0xff, c >> 24);
+}
+
+#define OSL_DEFINE_ROW_CONVERTER(from, to, srcType, dstType)                                        \
+    static void oslConvertRow##from##To##to(void *dst, const void *src, int count, const u32 *lut) { \
+        const srcType *s = (const srcType*)src;                                                       \
+        dstType *d = (dstType*)dst;                                                                   \
+        (void)lut;                                                                                    \
+        while (count-- > 0)                                                                           \
+            *d++ = (dstType)oslEncode##to(oslDecode##from(*s++));                                     \
+    }
+
+OSL_DEFINE_ROW_CONVERTER(8888, 5650, u32, u16)
+OSL_DEFINE_ROW_CONVERTER(8888, 5551, u32, u16)
+OSL_DEFINE_ROW_CONVERTER(8888, 4444, u32, u16)
+OSL_DEFINE_ROW_CONVERTER(5650, 8888, u16, u32)
+OSL_DEFINE_ROW_CONVERTER(5650, 5551, u16, u16)
+OSL_DEFINE_ROW_CONVERTER(5650, 4444, u16, u16)
+OSL_DEFINE_ROW_CONVERTER(5551, 8888, u16, u32)
+OSL_DEFINE_ROW_CONVERTER(5551, 5650, u16, u16)
+OSL_DEFINE_ROW_CONVERTER(5551, 4444, u16, u16)
+OSL_DEFINE_ROW_CONVERTER(4444, 8888, u16, u32)
+OSL_DEFINE_ROW_CONVERTER(4444, 5650, u16, u16)
+OSL_DEFINE_ROW_CONVERTER(4444, 5551, u16, u16)
+
+// Same format: plain copies
+static void oslCopyRow32(void *dst, const void *src, int count, const u32 *lut) {
+    (void)lut;
+    memcpy(dst, src, count * 4);
+}
+
+static void oslCopyRow16(void *dst, const void *src, int count, const u32 *lut) {
+    (void)lut;
+    memcpy(dst, src, count * 2);
+}
+
+static void oslCopyRow8(void *dst, const void *src, int count, const u32 *lut) {
+    (void)lut;
+    memcpy(dst, src, count);
+}
+
+static void oslCopyRow4(void *dst, const void *src, int count, const u32 *lut) {
+    (void)lut;
+    memcpy(dst, src, count >> 1);
+    // Odd count: the upper nibble of the last byte belongs to the next pixel
+    if (count & 1) {
+        u8 *d = (u8*)dst + (count >> 1);
+        *d = (*d & 0xf0) | (((const u8*)src)[count >> 1] & 0x0f);
+    }
+}
+
+// Paletted to truecolor, through the converted palette
+static void oslLutRow8To32(void *dst, const void *src, int count, const u32 *lut) {
+    const u8 *s = (const u8*)src;
+    u32 *d = (u32*)dst;
+    while (count-- > 0)
+        *d++ = lut[*s++];
+}
+
+static void oslLutRow8To16(void *dst, const void *src, int count, const u32 *lut) {
+    const u8 *s = (const u8*)src;
+    u16 *d = (u16*)dst;
+    while (count-- > 0)
+        *d++ = (u16)lut[*s++];
+}
+
+static void oslLutRow4To32(void *dst, const void *src, int count, const u32 *lut) {
+    const u8 *s = (const u8*)src;
+    u32 *d = (u32*)dst;
+    // Even pixels are in the low nibble
+    for (; count >= 2; count -= 2) {
+        *d++ = lut[*s & 15];
+        *d++ = lut[*s++ >> 4];
+    }
+    if (count)
+        *d = lut[*s & 15];
+}
+
+static void oslLutRow4To16(void *dst, const void *src, int count, const u32 *lut) {
+    const u8 *s = (const u8*)src;
+    u16 *d = (u16*)dst;
+    for (; count >= 2; count -= 2) {
+        *d++ = (u16)lut[*s & 15];
+        *d++ = (u16)lut[*s++ >> 4];
+    }
+    if (count)
+        *d = (u16)lut[*s & 15];
+}
+
+// [source format][destination format], in OSL_PF_* order
+static const OSL_ROW_CONVERTER osl_rowConverters[6][6] = {
+    /* 5650 */ { oslCopyRow16, oslConvertRow5650To5551, oslConvertRow5650To4444, oslConvertRow5650To8888, NULL, NULL },
+    /* 5551 */ { oslConvertRow5551To5650, oslCopyRow16, oslConvertRow5551To4444, oslConvertRow5551To8888, NULL, NULL },
+    /* 4444 */ { oslConvertRow4444To5650, oslConvertRow4444To5551, oslCopyRow16, oslConvertRow4444To8888, NULL, NULL },
+    /* 8888 */ { oslConvertRow8888To5650, oslConvertRow8888To5551, oslConvertRow8888To4444, oslCopyRow32, NULL, NULL },
+    /* 4BIT */ { oslLutRow4To16, oslLutRow4To16, oslLutRow4To16, oslLutRow4To32, oslCopyRow4, NULL },
+    /* 8BIT */ { oslLutRow8To16, oslLutRow8To16, oslLutRow8To16, oslLutRow8To32, NULL, oslCopyRow8 },
+};
+
+static u32 oslGetRawPixel(const u8 *row, int pf, int i) {
+    switch (osl_pixelWidth[pf]) {
+        case 32:
+            return ((const u32*)row)[i];
+        case 16:
+            return ((const u16*)row)[i];
+        case 8:
+            return row[i];
+        default:
+            return (row[i >> 1] >> ((i & 1) << 2)) & 15;
+    }
+}
+
+static void oslSetRawPixel(u8 *row, int pf, int i, u32 value) {
+    switch (osl_pixelWidth[pf]) {
+        case 32:
+            ((u32*)row)[i] = value;
+            break;
+        case 16:
+            ((u16*)row)[i] = (u16)value;
+            break;
+        case 8:
+            row[i] = (u8)value;
+            break;
+        default:
+            row[i >> 1] &= ~(15 << ((i & 1) << 2));
+            row[i >> 1] |= (value & 15) << ((i & 1) << 2);
+            break;
+    }
+}
+
+static void oslBeginRowConversion(OSL_ROW_CONVERSION *conv, int pfDst, int pfSrc, OSL_PALETTE *palette) {
+    conv->convert = osl_rowConverters[pfSrc][pfDst];
+    conv->pfDst = pfDst;
+    conv->pfSrc = pfSrc;
+    conv->palette = palette;
+
+    // Convert the palette once for the whole operation
+    if (osl_pixelWidth[pfSrc] <= 8 && osl_pixelWidth[pfDst] > 8) {
+        int i, n = 1 << osl_paletteSizes[pfSrc];
+        for (i = 0; i < n; i++) {
+            if (palette && i < (int)palette->nElements)
+                conv->lut[i] = oslConvertColor(pfDst, palette->pixelFormat, oslGetPaletteColor(palette, i));
+            else
+                conv->lut[i] = 0;
+        }
+    }
+}
+
+// Pairs without a specialized converter: truecolor to paletted (exact match in the palette) and 4 <-> 8 bit indices
+static void oslConvertRowGeneric(OSL_ROW_CONVERSION *conv, u8 *dst, const u8 *src, int count) {
+    OSL_PALETTE *palette = conv->palette;
+    int i, lastIndex = 0;
+    u32 lastColor = 0, value;
+    int hasLast = 0;
+
+    for (i = 0; i < count; i++) {
+        value = oslGetRawPixel(src, conv->pfSrc, i);
+        if (osl_pixelWidth[conv->pfSrc] <= 8) {
+            // Index to index
+        } else if (hasLast && value == lastColor) {
+            value = lastIndex;
+        } else {
+            u32 j, color = oslConvertColor(palette ? palette->pixelFormat : OSL_PF_8888, conv->pfSrc, value);
+            lastColor = value;
+            hasLast = 1;
+            value = 0;
+            if (palette) {
+                for (j = 0; j < palette->nElements; j++) {
+                    if ((u32)oslGetPaletteColor(palette, j) == color) {
+                        value = j;
+                        break;
+                    }
+                }
+            }
+            lastIndex = value;
+        }
+        oslSetRawPixel(dst, conv->pfDst, i, value);
+    }
+}
+
+static void oslConvertSpan(OSL_ROW_CONVERSION *conv, void *dst, const void *src, int count) {
+    if (conv->convert)
+        conv->convert(dst, src, count, conv->lut);
+    else
+        oslConvertRowGeneric(conv, (u8*)dst, (const u8*)src, count);
+}
+
+void oslConvertImageRows(void *dst, int dstPitch, int pfDst, const void *src, int srcPitch, int pfSrc, int width, int height, OSL_PALETTE *palette) {
+    OSL_ROW_CONVERSION conv;
+
+    oslBeginRowConversion(&conv, pfDst, pfSrc, palette);
+    while (height-- > 0) {
+        oslConvertSpan(&conv, dst, src, width);
+        dst = (u8*)dst + dstPitch;
+        src = (const u8*)src + srcPitch;
+    }
+}
+
+// Moves pixels between one row of an image and a linear buffer, clipped to the image
+static void oslTransferImageRow(OSL_IMAGE *img, int x, int y, int count, u8 *buffer, int pfBuffer, OSL_PALETTE *palette, int write) {
+    OSL_ROW_CONVERSION conv;
+    int bitsImg = osl_pixelWidth[img->pixelFormat], bitsBuffer = osl_pixelWidth[pfBuffer];
+    int bufferX = 0, n;
+    u8 *pixels, *bufferPixels;
+
+    if (y < 0 || y >= img->sizeY)
+        return;
+    if (x < 0) {
+        bufferX = -x;
+        count += x;
+        x = 0;
+    }
+    if (x + count > img->sizeX)
+        count = img->sizeX - x;
+    if (count <= 0)
+        return;
+
+    if (write)
+        oslBeginRowConversion(&conv, img->pixelFormat, pfBuffer, palette);
+    else
+        oslBeginRowConversion(&conv, pfBuffer, img->pixelFormat, palette);
+
+    while (count > 0) {
+        n = count;
+        if (oslImageIsSwizzled(img)) {
+            // A row is made of 16-byte pieces, one per block
+            int blockPixels = 128 / bitsImg;
+            pixels = (u8*)oslGetSwizzledPixelAddr(img, x, y);
+            n = oslMin(n, blockPixels - x % blockPixels);
+        } else
+            pixels = (u8*)oslGetImagePixelAddr(img, x, y);
+        bufferPixels = buffer + ((bufferX * bitsBuffer) >> 3);
+
+        if (((x * bitsImg) | (bufferX * bitsBuffer)) & 7) {
+            // A 4-bit pixel in the middle of a byte: move it alone
+            u32 in = 0, out = 0;
+            n = 1;
+            if (write) {
+                oslSetRawPixel((u8*)&in, pfBuffer, 0, oslGetRawPixel(bufferPixels, pfBuffer, bufferX & 1));
+                oslConvertSpan(&conv, &out, &in, 1);
+                oslSetRawPixel(pixels, img->pixelFormat, x & 1, oslGetRawPixel((u8*)&out, img->pixelFormat, 0));
+            } else {
+                oslSetRawPixel((u8*)&in, img->pixelFormat, 0, oslGetRawPixel(pixels, img->pixelFormat, x & 1));
+                oslConvertSpan(&conv, &out, &in, 1);
+                oslSetRawPixel(bufferPixels, pfBuffer, bufferX & 1, oslGetRawPixel((u8*)&out, pfBuffer, 0));
+            }
+        } else if (write)
+            oslConvertSpan(&conv, pixels, bufferPixels, n);
+        else
+            oslConvertSpan(&conv, bufferPixels, pixels, n);
+
+        x += n;
+        bufferX += n;
+        count -= n;
+    }
+}
+
+void oslReadImageRow(OSL_IMAGE *img, int x, int y, int count, void *dst, int pfDst) {
+    oslTransferImageRow(img, x, y, count, (u8*)dst, pfDst, img->palette, 0);
+}
+
+void oslWriteImageRow(OSL_IMAGE *img, int x, int y, int count, const void *src, int pfSrc) {
+    oslTransferImageRow(img, x, y, count, (u8*)src, pfSrc, img->palette, 1);
+}
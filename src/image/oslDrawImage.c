@@ -1,6 +1,8 @@
 #include "oslib.h"
 #include "vfpu.h"
 
+#define OSL_IS_INTEGER(f) ((f) == (float)(int)(f))
+
 void oslDrawImage(OSL_IMAGE *img) {
     // Use the simple routine if no rotation is needed
     if (img->angle == 0 && img->centerX == 0 && img->centerY == 0) {
@@ -14,59 +16,98 @@ void oslDrawImage(OSL_IMAGE *img) {
 
     oslSetTexture(img);
 
-    float angleRadians = img->angle * (3.141592653f / 180.f);
+    float width = oslAbs(img->offsetX1 - img->offsetX0);
     float cX = (-img->centerX * img->stretchX) / (float)(img->offsetX1 - img->offsetX0);
     float cY = (-img->centerY * img->stretchY) / (float)(img->offsetY1 - img->offsetY0);
     float tmpY = cY + img->stretchY;
 
     // Determine the U coefficient based on whether the image is mirrored
     float uCoeff = (img->offsetX1 >= img->offsetX0) ? 64.0f : -64.0f;
-    
+
     // Calculate the X scaling coefficient (pixels per stripe)
-    float xCoeff = uCoeff / ((float)oslAbs(img->offsetX1 - img->offsetX0) / img->stretchX);
-    
+    float xCoeff = uCoeff / (width / img->stretchX);
+
+    // The image is drawn as one triangle strip: a bottom and a top vertex at each stripe boundary
+    int nStripes = (int)ceilf(width / 64.0f);
+    int count = 2 * (nStripes + 1);
+    if (nStripes <= 0)
+        return;
+
+    // The rotation is the same for all the stripes: compute its basis once. Quarter turns are exact, and if all the
+    // coordinates are then whole numbers, 16-bit vertices give the same result with half the size.
+    float cosA, sinA;
+    int fast = 0;
+    if (img->angle % 90 == 0) {
+        static const float quarterCos[4] = {1.0f, 0.0f, -1.0f, 0.0f};
+        int quarter = ((img->angle / 90) % 4 + 4) % 4;
+        cosA = quarterCos[quarter];
+        sinA = quarterCos[(quarter + 3) % 4];
+        fast = OSL_IS_INTEGER(cX) && OSL_IS_INTEGER(cY) && OSL_IS_INTEGER(xCoeff)
+            && OSL_IS_INTEGER(img->offsetX0) && OSL_IS_INTEGER(img->offsetX1) && OSL_IS_INTEGER(img->offsetY0) && OSL_IS_INTEGER(img->offsetY1);
+    } else {
+        float angleRadians = img->angle * (3.141592653f / 180.f);
+        cosA = oslVfpu_cosf(angleRadians, 1.0f);
+        sinA = oslVfpu_sinf(angleRadians, 1.0f);
+    }
+
+    // Rotated offsets of the top and bottom edges
+    float topX = sinA * cY, topY = cosA * cY;
+    float bottomX = sinA * tmpY, bottomY = cosA * tmpY;
+
+    int vertexType = fast ? GU_TEXTURE_16BIT | GU_VERTEX_16BIT : GU_TEXTURE_32BITF | GU_VERTEX_32BITF;
+    int vertexSize = fast ? sizeof(OSL_FAST_VERTEX) : sizeof(OSL_PRECISE_VERTEX);
+    void *vertices = oslAddBatchStrip(vertexType, vertexSize, count);
+    int batched = (vertices != NULL);
+    if (!batched)
+        vertices = sceGuGetMemory(count * vertexSize);
+
     float uVal = img->offsetX0;
     float xVal = cX;
+    int i;
+
+    for (i = 0; i <= nStripes; i++) {
+        if (i > 0) {
+            uVal += uCoeff;
+            xVal += xCoeff;
 
-    while (uVal != img->offsetX1) {
-        OSL_PRECISE_VERTEX *vertices = (OSL_PRECISE_VERTEX*)sceGuGetMemory(4 * sizeof(OSL_PRECISE_VERTEX));
-
-        // Calculate vertex 0
-        vertices[0].u = uVal;
-        vertices[0].v = img->offsetY0;
-        vertices[0].x = oslVfpu_cosf(angleRadians, xVal) - oslVfpu_sinf(angleRadians, cY) + img->x;
-        vertices[0].y = oslVfpu_sinf(angleRadians, xVal) + oslVfpu_cosf(angleRadians, cY) + img->y;
-        vertices[0].z = 0;
-
-        // Calculate vertex 2
-        vertices[2].u = uVal;
-        vertices[2].v = img->offsetY1;
-        vertices[2].x = oslVfpu_cosf(angleRadians, xVal) - oslVfpu_sinf(angleRadians, tmpY) + img->x;
-        vertices[2].y = oslVfpu_sinf(angleRadians, xVal) + oslVfpu_cosf(angleRadians, tmpY) + img->y;
-        vertices[2].z = 0;
-
-        uVal += uCoeff;
-        xVal += xCoeff;
-
-        if (uVal > img->offsetX1) {
-            xVal = cX + img->stretchX;
-            uVal = img->offsetX1;
+            // The last stripe is narrower
+            if (i == nStripes && uVal != img->offsetX1) {
+                xVal = cX + (uCoeff > 0 ? img->stretchX : -img->stretchX);
+                uVal = img->offsetX1;
+            }
         }
 
-        // Calculate vertex 1
-        vertices[1].u = uVal;
-        vertices[1].v = img->offsetY0;
-        vertices[1].x = oslVfpu_cosf(angleRadians, xVal) - oslVfpu_sinf(angleRadians, cY) + img->x;
-        vertices[1].y = oslVfpu_sinf(angleRadians, xVal) + oslVfpu_cosf(angleRadians, cY) + img->y;
-        vertices[1].z = 0;
-
-        // Calculate vertex 3
-        vertices[3].u = uVal;
-        vertices[3].v = img->offsetY1;
-        vertices[3].x = oslVfpu_cosf(angleRadians, xVal) - oslVfpu_sinf(angleRadians, tmpY) + img->x;
-        vertices[3].y = oslVfpu_sinf(angleRadians, xVal) + oslVfpu_cosf(angleRadians, tmpY) + img->y;
-        vertices[3].z = 0;
-
-        sceGuDrawArray(GU_TRIANGLE_STRIP, GU_TEXTURE_32BITF | GU_VERTEX_32BITF | GU_TRANSFORM_2D, 4, 0, vertices);
+        float dX = cosA * xVal, dY = sinA * xVal;
+        if (fast) {
+            OSL_FAST_VERTEX *v = (OSL_FAST_VERTEX*)vertices + 2 * i;
+            v[0].u = uVal;
+            v[0].v = img->offsetY1;
+            v[0].x = dX - bottomX + img->x;
+            v[0].y = dY + bottomY + img->y;
+            v[0].z = 0;
+            v[1].u = uVal;
+            v[1].v = img->offsetY0;
+            v[1].x = dX - topX + img->x;
+            v[1].y = dY + topY + img->y;
+            v[1].z = 0;
+        } else {
+            OSL_PRECISE_VERTEX *v = (OSL_PRECISE_VERTEX*)vertices + 2 * i;
+            v[0].u = uVal;
+            v[0].v = img->offsetY1;
+            v[0].x = dX - bottomX + img->x;
+            v[0].y = dY + bottomY + img->y;
+            v[0].z = 0;
+            v[1].u = uVal;
+            v[1].v = img->offsetY0;
+            v[1].x = dX - topX + img->x;
+            v[1].y = dY + topY + img->y;
+            v[1].z = 0;
+        }
+    }
+
+    // Draw the strip (unless it is batched)
+    if (!batched) {
+        sceKernelDcacheWritebackRange(vertices, count * vertexSize);
+        oslGuDrawArray(GU_TRIANGLE_STRIP, vertexType | GU_TRANSFORM_2D, count, 0, vertices);
     }
 }
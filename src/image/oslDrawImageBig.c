@@ -7,30 +7,31 @@
 #define TEXSIZEY_LIMITF 512.0f
 
 void oslSetTexturePart(OSL_IMAGE *img, int x, int y) {
-	u8 *data = (u8*)img->data;
+	u8 *data;
+
+	if (oslImageIsManaged(img))
+		oslTouchManagedImage(img);
 
 	// Adjust the texture offset when swizzling is enabled
-#ifdef PSP
 	int swizzleScaleFactor = oslImageIsSwizzled(img) ? 8 : 1;
-#else
-	int swizzleScaleFactor = 1;
-#endif
 
 	oslEnableTexturing();
 
 	if (img->palette && osl_curPalette != img->palette) {
+		oslFlushSpriteBatch();
 		osl_curPalette = img->palette;
 		// Update the palette
-		sceGuClutMode(img->palette->pixelFormat, 0, 0xff, 0);
+		oslGuClutMode(img->palette->pixelFormat, 0, 0xff, 0);
 		sceGuClutLoad((img->palette->nElements >> 3), img->palette->data);
 	}
 
 	data = (u8*)oslGetImagePixelAdr(img, x * swizzleScaleFactor, y);
 
 	if (osl_curTexture != data) {
+		oslFlushSpriteBatch();
 		osl_curTexture = data;
 		// Update the texture
-		sceGuTexMode(img->pixelFormat, 0, 0, oslImageIsSwizzled(img));
+		oslGuTexMode(img->pixelFormat, 0, 0, oslImageIsSwizzled(img));
 		sceGuTexImage(0, TEXSIZEX_LIMIT, TEXSIZEY_LIMIT, img->realSizeX, data);
 	}
 }
@@ -160,7 +161,7 @@ void oslDrawImageBig(OSL_IMAGE *img) {
 					vertices[3].y = oslVfpu_sinf(angleRadians, xVal) + oslVfpu_cosf(angleRadians, tmpY) + img->y;
 					vertices[3].z = 0;
 
-					sceGuDrawArray(GU_TRIANGLE_STRIP, GU_TEXTURE_32BITF | GU_VERTEX_32BITF | GU_TRANSFORM_2D, 4, 0, vertices);
+					oslGuDrawArray(GU_TRIANGLE_STRIP, GU_TEXTURE_32BITF | GU_VERTEX_32BITF | GU_TRANSFORM_2D, 4, 0, vertices);
 				}
 			}
 
@@ -24,8 +24,10 @@ void oslDrawImageSimple(OSL_IMAGE *img) {
             return;  // Return early if strip blit is verified and completed
     }
 
-    // Allocate memory for two vertices
-    vertices = (OSL_UVFLOAT_VERTEX*)sceGuGetMemory(2 * sizeof(OSL_UVFLOAT_VERTEX));
+    // Add the sprite to the batch, or allocate memory for two vertices
+    vertices = (OSL_UVFLOAT_VERTEX*)oslAddBatchSprite(GU_TEXTURE_32BITF | GU_VERTEX_16BIT, sizeof(OSL_UVFLOAT_VERTEX));
+    if (vertices == NULL)
+        vertices = (OSL_UVFLOAT_VERTEX*)sceGuGetMemory(2 * sizeof(OSL_UVFLOAT_VERTEX));
 
     // Define the top-left vertex of the image
     vertices[0].u = img->offsetX0;
@@ -41,6 +43,7 @@ void oslDrawImageSimple(OSL_IMAGE *img) {
     vertices[1].y = y + img->stretchY;
     vertices[1].z = 0;
 
-    // Draw the image as a 2D sprite
-    sceGuDrawArray(GU_SPRITES, GU_TEXTURE_32BITF | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
+    // Draw the image as a 2D sprite (unless it is batched)
+    if (!osl_spriteBatchEnabled)
+        oslGuDrawArray(GU_SPRITES, GU_TEXTURE_32BITF | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
 }
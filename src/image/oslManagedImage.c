@@ -0,0 +1,112 @@
+#include "oslib.h"
+
+/*
+    Residency cache for OSL_IN_AUTO images.
+    The list is kept sorted by last use (most recent first), so eviction candidates are taken from the tail.
+*/
+
+int osl_residencyPromoteThreshold = 2;
+u32 osl_residencyEpoch = 1;
+
+static OSL_IMAGE_RESIDENCY *osl_residencyFirst = NULL, *osl_residencyLast = NULL;
+
+static void oslResidencyUnlink(OSL_IMAGE_RESIDENCY *res) {
+    if (res->prev)
+        res->prev->next = res->next;
+    else
+        osl_residencyFirst = res->next;
+
+    if (res->next)
+        res->next->prev = res->prev;
+    else
+        osl_residencyLast = res->prev;
+
+    res->prev = res->next = NULL;
+}
+
+static void oslResidencyPushFront(OSL_IMAGE_RESIDENCY *res) {
+    res->prev = NULL;
+    res->next = osl_residencyFirst;
+    if (osl_residencyFirst)
+        osl_residencyFirst->prev = res;
+    else
+        osl_residencyLast = res;
+    osl_residencyFirst = res;
+}
+
+int oslRegisterManagedImage(OSL_IMAGE *img) {
+    OSL_IMAGE_RESIDENCY *res = (OSL_IMAGE_RESIDENCY*)malloc(sizeof(OSL_IMAGE_RESIDENCY));
+    if (!res)
+        return 0;
+
+    memset(res, 0, sizeof(OSL_IMAGE_RESIDENCY));
+    res->img = img;
+    img->residency = res;
+    img->flags |= OSL_IMAGE_MANAGED;
+    oslResidencyPushFront(res);
+    return 1;
+}
+
+void oslUnregisterManagedImage(OSL_IMAGE *img) {
+    if (!oslImageIsManaged(img) || !img->residency)
+        return;
+
+    oslResidencyUnlink(img->residency);
+    free(img->residency);
+    img->residency = NULL;
+    img->flags &= ~OSL_IMAGE_MANAGED;
+}
+
+int oslEvictManagedImages(int size) {
+    OSL_IMAGE_RESIDENCY *res = osl_residencyLast, *prev;
+
+    // Without the VRAM manager, blocks can't be freed in any order
+    if (!osl_useVramManager)
+        return 0;
+
+    while (oslVramMgrGetLargestFreeBlock() < size) {
+        // Find the least recently used image that is in VRAM
+        while (res && res->img->location != OSL_IN_VRAM)
+            res = res->prev;
+
+        // The GE may still read images drawn in the current frame, and everything before them in the list is more recent
+        if (!res || res->lastUse == osl_residencyEpoch)
+            return 0;
+
+        prev = res->prev;
+        if (!oslMoveImageTo(res->img, OSL_IN_RAM))
+            return 0;
+        res->evictions++;
+        res->useCount = 0;
+        res = prev;
+    }
+    return 1;
+}
+
+void oslTouchManagedImage(OSL_IMAGE *img) {
+    OSL_IMAGE_RESIDENCY *res = img->residency;
+    OSL_IMAGE *original = res->img;
+
+    // First use in this frame: the image can still be moved, nothing refers to its data yet
+    if (res->lastUse != osl_residencyEpoch) {
+        res->lastUse = osl_residencyEpoch;
+        oslResidencyUnlink(res);
+        oslResidencyPushFront(res);
+
+        if (original->location == OSL_IN_RAM && ++res->useCount >= osl_residencyPromoteThreshold) {
+            if (oslMoveImageTo(original, OSL_IN_VRAM))
+                res->promotions++;
+        }
+    }
+
+    if (original->location == OSL_IN_VRAM)
+        res->hits++;
+    else
+        res->misses++;
+
+    // Copies made with oslCreateImageTile follow the original
+    if (img != original) {
+        img->data = original->data;
+        img->location = original->location;
+    }
+}
@@ -21,9 +21,15 @@ bool oslMoveImageTo(OSL_IMAGE *img, int newLocation) {
     if (!oslAllocImageData(img, newLocation)) {
         // If allocation fails, restore the original data pointer and return failure.
         img->data = oldImage.data;
+        img->location = oldImage.location;
         return 0;
     }
 
+    // The old address may be reused by another texture with different parameters.
+    if (osl_curTexture == oldImage.data) {
+        osl_curTexture = NULL;
+    }
+
     // Copy the old image data to the new memory location.
     memcpy(img->data, oldImage.data, img->totalSize);
 
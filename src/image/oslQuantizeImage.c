@@ -0,0 +1,378 @@
+#include "oslib.h"
+
+/*
+    Conversion of an image to a paletted format.
+    Images with few enough colors get an exact palette, found through a small hash table. Otherwise the colors are
+    reduced with a median cut (Heckbert, as in gif/quantize.c, but with alpha) over a histogram of the image, and pixels
+    are mapped to the nearest palette entry, optionally with Floyd-Steinberg dithering.
+*/
+
+int osl_quantizeDithering = 0;
+
+// Maximum number of distinct colors in the histogram; the precision is reduced until the image fits
+#define OSL_QUANT_MAX_COLORS 8192
+#define OSL_QUANT_HASH_BITS 14
+#define OSL_QUANT_HASH_SIZE (1 << OSL_QUANT_HASH_BITS)
+
+typedef struct {
+    u32 key;                                      // Reduced RGBA, see oslQuantKey
+    u32 count;                                    // 0: free slot
+    int index;                                    // Palette entry, once the palette is built
+} OSL_QUANT_ENTRY;
+
+typedef struct {
+    u8 c[4];                                      // R, G, B, A
+    u32 count;
+} OSL_QUANT_COLOR;
+
+typedef struct {
+    int first, n;
+    u32 count;
+    int axis, range;                              // Channel with the widest range, and that range
+} OSL_QUANT_BOX;
+
+static inline u32 oslQuantHash(u32 key, int bits) {
+    return (key * 2654435761u) >> (32 - bits);
+}
+
+// Fully transparent pixels all count as the same color
+static inline u32 oslQuantNormalize(u32 color) {
+    return (color >> 24) ? color : 0;
+}
+
+static inline u32 oslQuantKey(u32 color, int bits) {
+    int shift = 8 - bits;
+    return ((color & 0xff) >> shift) | ((((color >> 8) & 0xff) >> shift) << bits) |
+           ((((color >> 16) & 0xff) >> shift) << (bits * 2)) | ((color >> 24 >> shift) << (bits * 3));
+}
+
+static OSL_QUANT_ENTRY *oslQuantFind(OSL_QUANT_ENTRY *table, u32 key) {
+    u32 i = oslQuantHash(key, OSL_QUANT_HASH_BITS);
+    while (table[i].count && table[i].key != key)
+        i = (i + 1) & (OSL_QUANT_HASH_SIZE - 1);
+    return &table[i];
+}
+
+// Counts colors at 'bits' bits per channel. Returns the number of distinct colors.
+static int oslQuantAddColor(OSL_QUANT_ENTRY *table, u32 key, u32 count, int nColors) {
+    OSL_QUANT_ENTRY *e = oslQuantFind(table, key);
+    if (!e->count) {
+        e->key = key;
+        nColors++;
+    }
+    e->count += count;
+    return nColors;
+}
+
+// Drops one bit of precision of every color in the histogram
+static int oslQuantReduce(OSL_QUANT_ENTRY *table, OSL_QUANT_COLOR *scratch, int bits) {
+    int i, n = 0, nColors = 0;
+    u32 mask = (1 << bits) - 1;
+
+    for (i = 0; i < OSL_QUANT_HASH_SIZE; i++) {
+        if (table[i].count) {
+            u32 key = table[i].key;
+            scratch[n].c[0] = (key & mask) >> 1;
+            scratch[n].c[1] = ((key >> bits) & mask) >> 1;
+            scratch[n].c[2] = ((key >> (bits * 2)) & mask) >> 1;
+            scratch[n].c[3] = ((key >> (bits * 3)) & mask) >> 1;
+            scratch[n++].count = table[i].count;
+        }
+    }
+
+    memset(table, 0, OSL_QUANT_HASH_SIZE * sizeof(OSL_QUANT_ENTRY));
+    bits--;
+    for (i = 0; i < n; i++) {
+        u32 key = scratch[i].c[0] | (scratch[i].c[1] << bits) | (scratch[i].c[2] << (bits * 2)) | (scratch[i].c[3] << (bits * 3));
+        nColors = oslQuantAddColor(table, key, scratch[i].count, nColors);
+    }
+    return nColors;
+}
+
+static int osl_quantSortAxis;
+
+static int oslQuantCompare(const void *a, const void *b) {
+    return ((const OSL_QUANT_COLOR*)a)->c[osl_quantSortAxis] - ((const OSL_QUANT_COLOR*)b)->c[osl_quantSortAxis];
+}
+
+static void oslQuantMeasureBox(OSL_QUANT_BOX *box, const OSL_QUANT_COLOR *colors) {
+    int i, j, lo[4] = {255, 255, 255, 255}, hi[4] = {0, 0, 0, 0};
+
+    box->count = 0;
+    for (i = box->first; i < box->first + box->n; i++) {
+        for (j = 0; j < 4; j++) {
+            lo[j] = oslMin(lo[j], colors[i].c[j]);
+            hi[j] = oslMax(hi[j], colors[i].c[j]);
+        }
+        box->count += colors[i].count;
+    }
+
+    box->axis = 0;
+    box->range = -1;
+    for (j = 0; j < 4; j++) {
+        if (hi[j] - lo[j] > box->range) {
+            box->range = hi[j] - lo[j];
+            box->axis = j;
+        }
+    }
+}
+
+// Median cut: split the box covering the most pixels over the widest range until the palette is full
+static int oslQuantMedianCut(OSL_QUANT_COLOR *colors, int nColors, u32 *palette, int paletteSize) {
+    OSL_QUANT_BOX boxes[256];
+    int nBoxes = 1, i, j;
+
+    boxes[0].first = 0;
+    boxes[0].n = nColors;
+    oslQuantMeasureBox(&boxes[0], colors);
+
+    while (nBoxes < paletteSize) {
+        OSL_QUANT_BOX *box = NULL, *newBox;
+        u32 half, acc = 0;
+        float best = 0;
+
+        for (i = 0; i < nBoxes; i++) {
+            float score = (float)boxes[i].range * boxes[i].count;
+            if (boxes[i].n > 1 && score > best) {
+                best = score;
+                box = &boxes[i];
+            }
+        }
+        if (!box)
+            break;
+
+        osl_quantSortAxis = box->axis;
+        qsort(colors + box->first, box->n, sizeof(OSL_QUANT_COLOR), oslQuantCompare);
+
+        // Median weighted by the number of pixels, leaving at least one color on each side
+        half = box->count / 2;
+        for (j = 0; j < box->n - 1; j++) {
+            acc += colors[box->first + j].count;
+            if (acc >= half)
+                break;
+        }
+        if (j == box->n - 1)
+            j--;
+
+        newBox = &boxes[nBoxes++];
+        newBox->first = box->first + j + 1;
+        newBox->n = box->n - j - 1;
+        box->n = j + 1;
+        oslQuantMeasureBox(box, colors);
+        oslQuantMeasureBox(newBox, colors);
+    }
+
+    // Palette entries are the average of their box
+    for (i = 0; i < nBoxes; i++) {
+        u32 sum[4] = {0, 0, 0, 0}, count = boxes[i].count;
+        for (j = boxes[i].first; j < boxes[i].first + boxes[i].n; j++) {
+            sum[0] += colors[j].c[0] * colors[j].count;
+            sum[1] += colors[j].c[1] * colors[j].count;
+            sum[2] += colors[j].c[2] * colors[j].count;
+            sum[3] += colors[j].c[3] * colors[j].count;
+        }
+        palette[i] = RGBA((sum[0] + count / 2) / count, (sum[1] + count / 2) / count, (sum[2] + count / 2) / count, (sum[3] + count / 2) / count);
+    }
+    return nBoxes;
+}
+
+static int oslQuantNearest(const u32 *palette, int paletteSize, int r, int g, int b, int a) {
+    int i, best = 0, bestDist = 0x7fffffff;
+
+    for (i = 0; i < paletteSize; i++) {
+        u32 c = palette[i];
+        int dr = (int)(c & 0xff) - r, dg = (int)((c >> 8) & 0xff) - g, db = (int)((c >> 16) & 0xff) - b, da = (int)(c >> 24) - a;
+        int dist = dr * dr + dg * dg + db * db + da * da;
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = i;
+            if (!dist)
+                break;
+        }
+    }
+    return best;
+}
+
+static inline void oslQuantSetIndex(u8 *line, int pf, int x, int index) {
+    if (pf == OSL_PF_8BIT)
+        line[x] = index;
+    else {
+        line[x >> 1] &= ~(15 << ((x & 1) << 2));
+        line[x >> 1] |= index << ((x & 1) << 2);
+    }
+}
+
+// Tries to give every color of the image its own palette entry
+static int oslQuantizeExact(OSL_IMAGE *dst, OSL_IMAGE *src, u32 *row, u32 *palette, int paletteSize) {
+    u16 table[512];                               // Palette index + 1, 0 when free
+    int x, y, nColors = 0, bits = osl_paletteSizes[dst->pixelFormat] + 1;
+
+    memset(table, 0, sizeof(table));
+    for (y = 0; y < src->sizeY; y++) {
+        u8 *line = (u8*)oslGetImageLine(dst, y);
+        oslReadImageRow(src, 0, y, src->sizeX, row, OSL_PF_8888);
+
+        for (x = 0; x < src->sizeX; x++) {
+            u32 color = row[x], i = oslQuantHash(color, bits);
+            while (table[i] && palette[table[i] - 1] != color)
+                i = (i + 1) & ((1 << bits) - 1);
+
+            if (!table[i]) {
+                if (nColors >= paletteSize)
+                    return 0;
+                palette[nColors] = color;
+                table[i] = ++nColors;
+            }
+            oslQuantSetIndex(line, dst->pixelFormat, x, table[i] - 1);
+        }
+    }
+    return 1;
+}
+
+static int oslQuantizeReduced(OSL_IMAGE *dst, OSL_IMAGE *src, u32 *row, u32 *palette, int paletteSize, int dither) {
+    OSL_QUANT_ENTRY *table;
+    OSL_QUANT_COLOR *colors;
+    int x, y, i, n, nColors = 0, bits = 5;
+    int width = src->sizeX;
+
+    table = (OSL_QUANT_ENTRY*)malloc(OSL_QUANT_HASH_SIZE * sizeof(OSL_QUANT_ENTRY));
+    colors = (OSL_QUANT_COLOR*)malloc((OSL_QUANT_MAX_COLORS + 1) * sizeof(OSL_QUANT_COLOR));
+    if (!table || !colors) {
+        free(table);
+        free(colors);
+        return 0;
+    }
+    memset(table, 0, OSL_QUANT_HASH_SIZE * sizeof(OSL_QUANT_ENTRY));
+
+    // Histogram
+    for (y = 0; y < src->sizeY; y++) {
+        oslReadImageRow(src, 0, y, width, row, OSL_PF_8888);
+        for (x = 0; x < width; x++) {
+            nColors = oslQuantAddColor(table, oslQuantKey(oslQuantNormalize(row[x]), bits), 1, nColors);
+            while (nColors > OSL_QUANT_MAX_COLORS && bits > 1)
+                nColors = oslQuantReduce(table, colors, bits--);
+        }
+    }
+
+    // Median cut on the colors expanded back to 8 bits
+    for (i = 0, n = 0; i < OSL_QUANT_HASH_SIZE; i++) {
+        if (table[i].count) {
+            u32 key = table[i].key, mask = (1 << bits) - 1;
+            int c;
+            for (c = 0; c < 4; c++)
+                colors[n].c[c] = ((key >> (bits * c)) & mask) * 255 / mask;
+            colors[n++].count = table[i].count;
+        }
+    }
+    paletteSize = oslQuantMedianCut(colors, n, palette, paletteSize);
+    free(colors);
+
+    if (!dither) {
+        // Each histogram color maps to a single palette entry
+        for (i = 0; i < OSL_QUANT_HASH_SIZE; i++)
+            table[i].index = -1;
+
+        for (y = 0; y < src->sizeY; y++) {
+            u8 *line = (u8*)oslGetImageLine(dst, y);
+            oslReadImageRow(src, 0, y, width, row, OSL_PF_8888);
+            for (x = 0; x < width; x++) {
+                u32 color = oslQuantNormalize(row[x]);
+                OSL_QUANT_ENTRY *e = oslQuantFind(table, oslQuantKey(color, bits));
+                if (e->index < 0)
+                    e->index = oslQuantNearest(palette, paletteSize, color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, color >> 24);
+                oslQuantSetIndex(line, dst->pixelFormat, x, e->index);
+            }
+        }
+    } else {
+        // Floyd-Steinberg, with the nearest entry cached per 4444 color
+        u8 *cache = (u8*)malloc(65536 + 65536 / 8);
+        u8 *cacheValid = cache + 65536;
+        int *errors = (int*)malloc((width + 2) * 4 * 2 * sizeof(int));
+        int *cur, *next, transparent = oslQuantNearest(palette, paletteSize, 0, 0, 0, 0);
+
+        if (!cache || !errors) {
+            free(cache);
+            free(errors);
+            free(table);
+            return 0;
+        }
+        memset(errors, 0, (width + 2) * 4 * 2 * sizeof(int));
+        memset(cacheValid, 0, 65536 / 8);
+
+        for (y = 0; y < src->sizeY; y++) {
+            u8 *line = (u8*)oslGetImageLine(dst, y);
+            cur = errors + (y & 1) * (width + 2) * 4 + 4;
+            next = errors + ((y + 1) & 1) * (width + 2) * 4 + 4;
+            memset(next - 4, 0, (width + 2) * 4 * sizeof(int));
+            oslReadImageRow(src, 0, y, width, row, OSL_PF_8888);
+
+            for (x = 0; x < width; x++) {
+                u32 color = row[x], p;
+                int c[4], index, key;
+
+                // Transparent pixels neither receive nor spread any error
+                if (!(color >> 24)) {
+                    oslQuantSetIndex(line, dst->pixelFormat, x, transparent);
+                    continue;
+                }
+
+                for (i = 0; i < 4; i++)
+                    c[i] = oslMinMax((int)((color >> (i * 8)) & 0xff) + cur[x * 4 + i] / 16, 0, 255);
+
+                key = (c[0] >> 4) | ((c[1] >> 4) << 4) | ((c[2] >> 4) << 8) | ((c[3] >> 4) << 12);
+                if (cacheValid[key >> 3] & (1 << (key & 7)))
+                    index = cache[key];
+                else {
+                    index = oslQuantNearest(palette, paletteSize, c[0], c[1], c[2], c[3]);
+                    cache[key] = index;
+                    cacheValid[key >> 3] |= 1 << (key & 7);
+                }
+                oslQuantSetIndex(line, dst->pixelFormat, x, index);
+
+                p = palette[index];
+                for (i = 0; i < 4; i++) {
+                    int err = c[i] - (int)((p >> (i * 8)) & 0xff);
+                    cur[(x + 1) * 4 + i] += err * 7;
+                    next[(x - 1) * 4 + i] += err * 3;
+                    next[x * 4 + i] += err * 5;
+                    next[(x + 1) * 4 + i] += err;
+                }
+            }
+        }
+        free(errors);
+        free(cache);
+    }
+
+    free(table);
+    return 1;
+}
+
+int oslQuantizeImage(OSL_IMAGE *dst, OSL_IMAGE *src, int dither) {
+    u32 *palette, *row;
+    int paletteSize, ok;
+
+    if (osl_pixelWidth[dst->pixelFormat] > 8 || !dst->palette || dst->palette->pixelFormat != OSL_PF_8888 || oslImageIsSwizzled(dst)
+            || dst->sizeX < src->sizeX || dst->sizeY < src->sizeY)
+        return 0;
+
+    paletteSize = oslMin(1 << osl_paletteSizes[dst->pixelFormat], (int)dst->palette->nElements);
+    palette = (u32*)dst->palette->data;
+    row = (u32*)malloc(src->sizeX * sizeof(u32));
+    if (!row)
+        return 0;
+
+    // Rows are read through the cache
+    oslUncacheImageData(src);
+    memset(palette, 0, dst->palette->nElements * sizeof(u32));
+
+    ok = oslQuantizeExact(dst, src, row, palette, paletteSize);
+    if (!ok) {
+        memset(palette, 0, dst->palette->nElements * sizeof(u32));
+        ok = oslQuantizeReduced(dst, src, row, palette, paletteSize, dither);
+    }
+
+    free(row);
+    oslUncacheImage(dst);
+    oslUncachePalette(dst->palette);
+    return ok;
+}
@@ -1,240 +1,268 @@
 #include "oslib.h"
 
-/* source from pnmscale.c in netpbm
-**
-** modified by Kevin (sosaria at empal.com)
-**
-** blow is original copyright of netpbm
-** Copyright (C) 1989, 1991 by Jef Poskanzer.
-**
-** Permission to use, copy, modify, and distribute this software and its
-** documentation for any purpose and without fee is hereby granted, provided
-** that the above copyright notice appear in all copies and that both that
-** copyright notice and this permission notice appear in supporting
-** documentation.  This software is provided "as is" without express or
-** implied warranty.
-**
+/*
+    Separable fixed-point resampler.
+    For each axis a table gives, for every destination pixel, the first source pixel it reads and one fixed-point weight
+    per source pixel (the weights of a pixel always add up to 1.0). Source rows are first resampled horizontally into a
+    small ring of rows, which the vertical pass then combines into each destination row.
+
+    Filters without negative lobes (box, bilinear) use 0.8 weights: red and blue, then green and alpha, are filtered
+    together in one 32-bit multiply (a 255 * 256 sum still fits in 16 bits), and the result never needs clamping.
+    Bicubic and Lanczos, and box and bilinear past OSL_SCALE_PACKED_MAX_TAPS taps (large shrink ratios, where each
+    weight is only a few 1/256ths and their rounding errors add up), use 2.14 weights and one multiply per component.
 */
 
-#define RGBA_GETR(pixel)	((pixel)&0xff)
-#define RGBA_GETG(pixel)	(((pixel)>>8)&0xff)
-#define RGBA_GETB(pixel)	(((pixel)>>16)&0xff)
-#define RGBA_GETA(pixel)	(((pixel)>>24)&0xff)
-#ifndef MIN
-#define MIN(a, b)	((a) < (b) ? (a) : (b))
-#endif
+#define OSL_SCALE_FRAC_BITS 14
+#define OSL_SCALE_PACKED_BITS 8
+#define OSL_SCALE_PACKED_MAX_TAPS 16
 
-static void readRow(OSL_IMAGE *img, int row, unsigned int *xelrow)
-{
-	int x;
-	int pixel;
-	for( x = 0; x < img->sizeX; x++ ) {
-		pixel = oslGetImagePixel(img, x, row);
-		xelrow[x] = (unsigned int)oslConvertColor(OSL_PF_8888, img->pixelFormat, pixel );
-	}
+typedef struct {
+    int *first;                                   // First source pixel of each destination pixel
+    int *count;                                   // Number of source pixels
+    short *weights;                               // 'taps' weights per destination pixel
+    int taps;
+    int packed;                                   // Weights are 0.8 and never negative
+} OSL_SCALE_AXIS;
+
+static float oslScaleSinc(float x) {
+    if (x == 0.0f)
+        return 1.0f;
+    x *= GU_PI;
+    return sinf(x) / x;
 }
 
-static void writeRow(OSL_IMAGE *img, unsigned int *xelrow, int startx, int row, int width)
-{
-	int x;
-	int pixel;
-	for( x = 0; x < width; x++ ) {
-		pixel = oslConvertColor(img->pixelFormat, OSL_PF_8888, xelrow[x]);
-		oslSetImagePixel(img, x+startx, row, pixel);
-	}
+// Filter kernels, in source pixels (for magnification)
+static float oslScaleKernel(int filter, float x) {
+    if (x < 0)
+        x = -x;
+
+    switch (filter) {
+        case OSL_SCALE_BILINEAR:
+            return x < 1.0f ? 1.0f - x : 0.0f;
+
+        case OSL_SCALE_BICUBIC:
+            // Catmull-Rom
+            if (x < 1.0f)
+                return (1.5f * x - 2.5f) * x * x + 1.0f;
+            if (x < 2.0f)
+                return ((-0.5f * x + 2.5f) * x - 4.0f) * x + 2.0f;
+            return 0.0f;
+
+        case OSL_SCALE_LANCZOS2:
+            return x < 2.0f ? oslScaleSinc(x) * oslScaleSinc(x * 0.5f) : 0.0f;
+    }
+    return 0.0f;
 }
 
-static void zeroAccum(int col, float rs[], float gs[], float bs[], float as[])
-{
-	int x;
-	for( x = 0; x < col; x++ ) {
-		rs[x] = gs[x] = bs[x] = as[x] = 0.0;
-	}
+static float oslScaleSupport(int filter) {
+    switch (filter) {
+        case OSL_SCALE_BILINEAR:
+            return 1.0f;
+        case OSL_SCALE_BICUBIC:
+        case OSL_SCALE_LANCZOS2:
+            return 2.0f;
+    }
+    return 0.5f;
 }
-static void accumOutputRow(unsigned int* const xelrow, float const fraction,
-					float rs[], float gs[], float bs[], float as[], int const cols)
-{
-/*----------------------------------------------------------------------------
-   Take 'fraction' times the color in row xelrow and add it to
-   rs/gs/bs.  'fraction' is less than 1.0.
------------------------------------------------------------------------------*/
-	int x;
-
-	for( x = 0; x < cols; x++ ) {
-		rs[x] += fraction * RGBA_GETR(xelrow[x]);
-		gs[x] += fraction * RGBA_GETG(xelrow[x]);
-		bs[x] += fraction * RGBA_GETB(xelrow[x]);
-		as[x] += fraction * RGBA_GETA(xelrow[x]);
-	}
+
+static void oslScaleFreeAxis(OSL_SCALE_AXIS *axis) {
+    free(axis->first);
+    free(axis->count);
+    free(axis->weights);
 }
 
-static void horizontalScale(const float rs[], const float gs[], const float bs[], const float as[],
-							unsigned int newxelrow[], const int cols, const int newcols, const float xscale)
-{
-/*----------------------------------------------------------------------------
-   Take the input row rs[]/gs[]/bs[]/as[], which is 'cols' columns wide, and
-   scale it by a factor of 'xscale', to create
-   the output row newxelrow[], which is 'newcols' columns wide.
-
------------------------------------------------------------------------------*/
-    float r, g, b, a;
-    float fraccoltofill, fraccolleft;
-    unsigned int col;
-    unsigned int newcol;
-
-    newcol = 0;
-    fraccoltofill = 1.0;  /* Output column is "empty" now */
-    r = g = b = a = 0;          /* initial value */
-    for (col = 0; col < cols; ++col) {
-        /* Process one pixel from input ('inputxelrow') */
-        fraccolleft = xscale;
-        /* Output all columns, if any, that can be filled using information
-           from this input column, in addition to what's already in the output
-           column.
-        */
-        while (fraccolleft >= fraccoltofill) {
-            /* Generate one output pixel in 'newxelrow'.  It will consist
-               of anything accumulated from prior input pixels in 'r','g',
-               and 'b', plus a fraction of the current input pixel.
-            */
-			r += fraccoltofill * rs[col];
-			g += fraccoltofill * gs[col];
-			b += fraccoltofill * bs[col];
-			a += fraccoltofill * as[col];
-			newxelrow[newcol] = RGBA( MIN(0xff, (int)(r + 0.5) ),
-               						  MIN(0xff, (int)(g + 0.5) ),
-               						  MIN(0xff, (int)(b + 0.5) ),
-               						  MIN(0xff, (int)(a + 0.5) ) );
-            fraccolleft -= fraccoltofill;
-            /* Set up to start filling next output column */
-            newcol++;
-            fraccoltofill = 1.0;
-            r = g = b = 0.0;
+// Builds the table to resample srcSize pixels into dstSize
+static int oslScaleBuildAxis(OSL_SCALE_AXIS *axis, int srcSize, int dstSize, int filter) {
+    float scale = (float)dstSize / srcSize;
+    // When shrinking, the kernel is stretched to cover all the source pixels
+    float stretch = scale < 1.0f ? 1.0f / scale : 1.0f;
+    float support = filter == OSL_SCALE_BOX ? 0.5f / scale : oslScaleSupport(filter) * stretch;
+    float *w;
+    int i, j, k;
+
+    int one;
+
+    axis->taps = oslMin((int)(2.0f * support) + 3, srcSize);
+    axis->packed = (filter == OSL_SCALE_BOX || filter == OSL_SCALE_BILINEAR) && axis->taps <= OSL_SCALE_PACKED_MAX_TAPS;
+    one = 1 << (axis->packed ? OSL_SCALE_PACKED_BITS : OSL_SCALE_FRAC_BITS);
+    axis->first = (int*)malloc(dstSize * sizeof(int));
+    axis->count = (int*)malloc(dstSize * sizeof(int));
+    axis->weights = (short*)malloc(dstSize * axis->taps * sizeof(short));
+    w = (float*)malloc(axis->taps * sizeof(float));
+    if (!axis->first || !axis->count || !axis->weights || !w) {
+        oslScaleFreeAxis(axis);
+        free(w);
+        return 0;
+    }
+
+    for (i = 0; i < dstSize; i++) {
+        float center = (i + 0.5f) / scale, total = 0.0f;
+        int lo = (int)floorf(center - support), hi = (int)ceilf(center + support), n, sum;
+        float partial;
+        short *weights = axis->weights + i * axis->taps;
+
+        lo = oslMax(lo, 0);
+        hi = oslMin(hi, srcSize);
+        n = oslMin(hi - lo, axis->taps);
+
+        for (j = 0; j < n; j++) {
+            if (filter == OSL_SCALE_BOX) {
+                // Area covered by the source pixel in the destination pixel (same as the former pnmscale port)
+                float left = oslMax(lo + j, center - support), right = oslMin(lo + j + 1, center + support);
+                w[j] = right > left ? right - left : 0.0f;
+            } else
+                w[j] = oslScaleKernel(filter, (lo + j + 0.5f - center) / stretch);
+            total += w[j];
         }
-        /* There's not enough left in the current input pixel to fill up
-           a whole output column, so just accumulate the remainder of the
-           pixel into the current output column.
-        */
-        if (fraccolleft > 0.0) {
-			r += fraccolleft * rs[col];
-			g += fraccolleft * gs[col];
-			b += fraccolleft * bs[col];
-			a += fraccolleft * as[col];
-            fraccoltofill -= fraccolleft;
+        if (total <= 0.0f)
+            total = 1.0f;
+
+        // Skip the taps that don't contribute
+        while (n > 1 && w[n - 1] == 0.0f)
+            n--;
+        for (k = 0; n > 1 && w[k] == 0.0f; k++, n--)
+            lo++;
+        w += k;
+
+        // Normalize in fixed point. The running sum is rounded rather than each weight, so that the weights add up to
+        // exactly 1.0, each one is off by less than one unit and none turns negative.
+        sum = 0;
+        partial = 0.0f;
+        for (j = 0; j < n; j++) {
+            int next;
+            partial += w[j];
+            next = j == n - 1 ? one : (int)floorf(partial / total * one + 0.5f);
+            weights[j] = (short)(next - sum);
+            sum = next;
         }
+
+        axis->first[i] = lo;
+        axis->count[i] = n;
+        w -= k;
     }
+    free(w);
+    return 1;
+}
 
-    if (newcol < newcols ) {
-        /* We were still working on the last output column when we
-           ran out of input columns.  This would be because of rounding
-           down, and we should be missing only a tiny fraction of that
-           last output column.
-        */
-		r += fraccoltofill * rs[cols-1];
-		g += fraccoltofill * gs[cols-1];
-		b += fraccoltofill * bs[cols-1];
-		a += fraccoltofill * as[cols-1];
-		newxelrow[newcol] = RGBA( MIN(0xff, (int)(r + 0.5) ),
-								  MIN(0xff, (int)(g + 0.5) ),
-								  MIN(0xff, (int)(b + 0.5) ),
-								  MIN(0xff, (int)(a + 0.5) ) );
-	}
+static inline u32 oslScaleClamp(int value) {
+    value = (value + (1 << (OSL_SCALE_FRAC_BITS - 1))) >> OSL_SCALE_FRAC_BITS;
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
 }
 
-void oslScaleImage(OSL_IMAGE *dstImg, OSL_IMAGE *srcImg, int newX, int newY, int newWidth, int newHeight)
-{
-	float rowsleft;
-	/* The number of rows of output that need to be formed from the
-       current input row (the one in tuplerow[]), less the number that
-       have already been formed (either in accumulator[]
-       or output to the file).  This can be fractional because of the
-       way we define rows as having height.
-    */
-	float fracrowtofill;
-        /* The fraction of the current output row (the one in vertScaledRow[])
-           that hasn't yet been filled in from an input row.
-        */
-	int rowsread;
-		/* Number of rows of the input file that have been read */
-	int row;
-
-	unsigned int* orgxelrow;
-	unsigned int* newxelrow;
-	float* rs;
-	float* gs;
-	float* bs;
-	float* as;
-
-	float xscale = (float)newWidth / srcImg->sizeX;
-	float yscale = (float)newHeight / srcImg->sizeY;
-
-	rowsread = 0;
-	rowsleft = 0.0;
-	fracrowtofill = 1.0;
-
-	orgxelrow = malloc( srcImg->sizeX * sizeof(orgxelrow[0]) );
-	rs = malloc( srcImg->sizeX * sizeof(rs[0]) );
-	gs = malloc( srcImg->sizeX * sizeof(gs[0]) );
-	bs = malloc( srcImg->sizeX * sizeof(bs[0]) );
-	as = malloc( srcImg->sizeX * sizeof(bs[0]) );
-	newxelrow = malloc( newWidth * sizeof(newxelrow[0]) );
-
-	for( row = 0; row < newHeight; ++row ) {
-		/* First scane Y from orgxelrow[] into vertScanedRow[]. */
-
-		if ( newHeight == srcImg->sizeY ) { /* shortcut Y scaling if possible */
-			readRow( srcImg, row, orgxelrow );
-		}
-		else {
-			zeroAccum(srcImg->sizeX, rs, gs, bs, as);
-			while (fracrowtofill > 0) {
-				if (rowsleft <= 0.0) {
-					if (rowsread < srcImg->sizeY) {
-						readRow( srcImg, rowsread, orgxelrow );
-						++rowsread;
-					}
-					else {
-	                    /* We need another input row to fill up this
-	                       output row, but there aren't any more.
-	                       That's because of rounding down on our
-	                       scaling arithmetic.  So we go ahead with
-	                       the data from the last row we read, which
-	                       amounts to stretching out the last output
-	                       row.
-	                    */
-					}
-					rowsleft = yscale;
-				}
-				if (rowsleft < fracrowtofill) {
-					accumOutputRow(orgxelrow, rowsleft, rs, gs, bs, as, srcImg->sizeX);
-					fracrowtofill -= rowsleft;
-					rowsleft = 0.0;
-				}
-				else {
-					accumOutputRow(orgxelrow, fracrowtofill, rs, gs, bs, as, srcImg->sizeX);
-					rowsleft = rowsleft - fracrowtofill;
-					fracrowtofill = 0.0;
-				}
-			}
-			fracrowtofill = 1.0;
-		}
-
-        /* Now scale rs/gs/bs horizontally into newxelrow and write
-           it dstImg.
-        */
-
-		horizontalScale(rs, gs, bs, as, newxelrow, srcImg->sizeX, newWidth, xscale);
-		writeRow(dstImg, newxelrow, newX, newY + row, newWidth);
-
-	}
-	free( newxelrow );
-	free( as );
-	free( bs );
-	free( gs );
-	free( rs );
-	free( orgxelrow );
-
-	return;
+// Combines 'count' 8888 pixels, 'stride' pixels apart
+static inline u32 oslScaleFilterPixel(const u32 *src, int stride, const short *weights, int count) {
+    int r = 0, g = 0, b = 0, a = 0, k;
+
+    for (k = 0; k < count; k++, src += stride) {
+        u32 c = *src;
+        int w = weights[k];
+        r += (int)(c & 0xff) * w;
+        g += (int)((c >> 8) & 0xff) * w;
+        b += (int)((c >> 16) & 0xff) * w;
+        a += (int)(c >> 24) * w;
+    }
+    return RGBA(oslScaleClamp(r), oslScaleClamp(g), oslScaleClamp(b), oslScaleClamp(a));
+}
+
+// Same with 0.8 weights, two components per multiply
+static inline u32 oslScaleFilterPixelPacked(const u32 *src, int stride, const short *weights, int count) {
+    u32 rb = 0x00800080, ga = 0x00800080;
+    int k;
+
+    for (k = 0; k < count; k++, src += stride) {
+        u32 c = *src, w = weights[k];
+        rb += (c & 0x00ff00ff) * w;
+        ga += ((c >> 8) & 0x00ff00ff) * w;
+    }
+    return ((rb >> 8) & 0x00ff00ff) | (ga & 0xff00ff00);
+}
+
+static void oslScaleRow(u32 *dst, const u32 *src, const OSL_SCALE_AXIS *axis, int dstSize) {
+    const short *weights = axis->weights;
+    int x;
+
+    if (axis->packed) {
+        for (x = 0; x < dstSize; x++, weights += axis->taps)
+            dst[x] = oslScaleFilterPixelPacked(src + axis->first[x], 1, weights, axis->count[x]);
+    } else {
+        for (x = 0; x < dstSize; x++, weights += axis->taps)
+            dst[x] = oslScaleFilterPixel(src + axis->first[x], 1, weights, axis->count[x]);
+    }
+}
+
+// Vertical pass: combines 'count' consecutive rows of the ring, which are 'width' pixels apart
+static void oslScaleColumns(u32 *dst, const u32 *rows, const OSL_SCALE_AXIS *axis, const short *weights, int count, int width) {
+    int x;
+
+    if (count == 1)
+        memcpy(dst, rows, width * sizeof(u32));
+    else if (axis->packed) {
+        for (x = 0; x < width; x++)
+            dst[x] = oslScaleFilterPixelPacked(rows + x, width, weights, count);
+    } else {
+        for (x = 0; x < width; x++)
+            dst[x] = oslScaleFilterPixel(rows + x, width, weights, count);
+    }
+}
+
+void oslScaleImageEx(OSL_IMAGE *dstImg, OSL_IMAGE *srcImg, int newX, int newY, int newWidth, int newHeight, int filter) {
+    OSL_SCALE_AXIS axisX, axisY;
+    u32 *srcRow = NULL, *ring = NULL, *dstRow = NULL;
+    int ringSize, loaded, y;
+
+    if (newWidth <= 0 || newHeight <= 0 || srcImg->sizeX <= 0 || srcImg->sizeY <= 0)
+        return;
+
+    if (!oslScaleBuildAxis(&axisX, srcImg->sizeX, newWidth, filter))
+        return;
+    if (!oslScaleBuildAxis(&axisY, srcImg->sizeY, newHeight, filter)) {
+        oslScaleFreeAxis(&axisX);
+        return;
+    }
+
+    // Horizontally scaled rows that the current destination row may need. Each one is stored twice, ringSize rows apart,
+    // so that the rows of a window are always consecutive.
+    ringSize = axisY.taps;
+    srcRow = (u32*)malloc(srcImg->sizeX * sizeof(u32));
+    ring = (u32*)malloc(2 * ringSize * newWidth * sizeof(u32));
+    dstRow = (u32*)malloc(newWidth * sizeof(u32));
+    if (!srcRow || !ring || !dstRow)
+        goto done;
+
+    // Rows are read and written through the cache
+    oslUncacheImageData(srcImg);
+    oslUncacheImageData(dstImg);
+
+    loaded = 0;
+    for (y = 0; y < newHeight; y++) {
+        int first = axisY.first[y], count = axisY.count[y];
+
+        // The windows only move forward: a row slot is reused once it is behind the window
+        loaded = oslMax(loaded, first);
+        while (loaded < first + count) {
+            u32 *slot = ring + (loaded % ringSize) * newWidth;
+            oslReadImageRow(srcImg, 0, loaded, srcImg->sizeX, srcRow, OSL_PF_8888);
+            oslScaleRow(slot, srcRow, &axisX, newWidth);
+            memcpy(slot + ringSize * newWidth, slot, newWidth * sizeof(u32));
+            loaded++;
+        }
+
+        oslScaleColumns(dstRow, ring + (first % ringSize) * newWidth, &axisY, axisY.weights + y * axisY.taps, count, newWidth);
+        oslWriteImageRow(dstImg, newX, newY + y, newWidth, dstRow, OSL_PF_8888);
+    }
+
+    oslUncacheImageData(dstImg);
+
+done:
+    free(dstRow);
+    free(ring);
+    free(srcRow);
+    oslScaleFreeAxis(&axisY);
+    oslScaleFreeAxis(&axisX);
+}
+
+void oslScaleImage(OSL_IMAGE *dstImg, OSL_IMAGE *srcImg, int newX, int newY, int newWidth, int newHeight) {
+    oslScaleImageEx(dstImg, srcImg, newX, newY, newWidth, newHeight, OSL_SCALE_BOX);
 }
 
 OSL_IMAGE *oslScaleImageCreate(OSL_IMAGE *img, short newLocation, int newWidth, int newHeight, short newPixelFormat)
@@ -258,3 +286,48 @@ OSL_IMAGE *oslScaleImageCreate(OSL_IMAGE *img, short newLocation, int newWidth,
 
     return newImg;
 }
+
+int oslCreateImageMipChain(OSL_IMAGE *img, OSL_IMAGE **levels, int maxLevels, int location, int filter) {
+    OSL_IMAGE *prev = img, *level;
+    int n = 0, width = img->sizeX, height = img->sizeY;
+
+    while (n < maxLevels && (width > 1 || height > 1)) {
+        width = oslMax(width >> 1, 1);
+        height = oslMax(height >> 1, 1);
+
+        if (osl_pixelWidth[img->pixelFormat] <= 8) {
+            // Paletted levels get their own palette from a truecolor version
+            OSL_IMAGE *temp = oslCreateImage(width, height, OSL_IN_RAM, OSL_PF_8888);
+            if (!temp)
+                break;
+            oslScaleImageEx(temp, prev, 0, 0, width, height, filter);
+
+            level = oslCreateImage(width, height, location & OSL_LOCATION_MASK, img->pixelFormat);
+            if (level) {
+                level->palette = oslCreatePalette(1 << osl_paletteSizes[img->pixelFormat], OSL_PF_8888);
+                if (!level->palette || !oslQuantizeImage(level, temp, osl_quantizeDithering)) {
+                    oslDeleteImage(level);
+                    level = NULL;
+                }
+            }
+            oslDeleteImage(temp);
+        } else {
+            level = oslCreateImage(width, height, location & OSL_LOCATION_MASK, img->pixelFormat);
+            if (level)
+                oslScaleImageEx(level, prev, 0, 0, width, height, filter);
+        }
+        if (!level)
+            break;
+
+        // Each level is made from the previous one, unswizzled
+        if (prev != img && oslImageLocationIsSwizzled(location))
+            oslSwizzleImage(prev);
+        levels[n++] = prev = level;
+    }
+
+    if (n > 0 && oslImageLocationIsSwizzled(location))
+        oslSwizzleImage(levels[n - 1]);
+    for (int i = 0; i < n; i++)
+        oslUncacheImage(levels[i]);
+    return n;
+}
@@ -7,6 +7,9 @@
 	3. Writes the content of the new draw buffer to the GPU.
 */
 void oslSetDrawBuffer(OSL_IMAGE *img) {
+	// Pending sprites belong to the former buffer
+	oslFlushSpriteBatch();
+
 #ifdef PSP
 	// Set the current draw buffer on the PSP
 	osl_curBuf = img;
@@ -45,6 +48,7 @@ void oslSetDrawBuffer(OSL_IMAGE *img) {
 
 	// Update the current draw buffer to the new one
 	osl_curBuf = img;
+	sceGuDrawBuffer(img->pixelFormat, oslRemoveVramPrefixPtr(img->data), img->sysSizeX);
 
 	// Re-enable 2D texturing after the transfer
 	emuConfigure2DTransfer(0);
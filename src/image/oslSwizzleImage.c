@@ -1,27 +1,32 @@
 #include "oslib.h"
+#include "vfpu.h"
 
-// Swizzle a texture to optimize memory access patterns on the PSP
-void oslSwizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int height) {
-    unsigned int blockx, blocky, j;
-    unsigned int width_blocks = width / 16;
-    unsigned int height_blocks = height / 8;
-    unsigned int src_pitch = (width - 16) / 4;
-    unsigned int src_row = width * 8;
-    
-    const u8* ysrc = in;
-    u32* dst = (u32*)out;
+/*
+    A swizzled texture is made of blocks of 16 bytes x 8 rows, stored one after the other (each row of a block is contiguous).
+    A band of 8 rows of the linear texture therefore maps to the very same byte range once swizzled, which allows to swizzle
+    in place with a scratch buffer of a single band.
+*/
 
-#ifndef PSP
-    // On non-PSP platforms, simply copy the input to output
-    memcpy(out, in, width * height);
-    return;
-#endif
+// Swizzle one band of 8 rows of 'width' bytes; in and out must not overlap
+static void oslSwizzleBand(u8* out, const u8* in, unsigned int width) {
+    unsigned int blockx, j;
+    unsigned int width_blocks = width / 16;
 
-    // Swizzle the texture
-    for (blocky = 0; blocky < height_blocks; ++blocky) {
-        const u8* xsrc = ysrc;
+    // 128-bit copies when everything is quadword aligned (always the case for images)
+    if (!(((uintptr_t)out | (uintptr_t)in | width) & 15)) {
+        for (blockx = 0; blockx < width_blocks; ++blockx) {
+            const u8* src = in + blockx * 16;
+            for (j = 0; j < 8; ++j) {
+                oslVfpuCopyQuad(out, src);
+                out += 16;
+                src += width;
+            }
+        }
+    } else {
+        unsigned int src_pitch = (width - 16) / 4;
+        u32* dst = (u32*)out;
         for (blockx = 0; blockx < width_blocks; ++blockx) {
-            const u32* src = (const u32*)xsrc;
+            const u32* src = (const u32*)(in + blockx * 16);
             for (j = 0; j < 8; ++j) {
                 *(dst++) = *(src++);
                 *(dst++) = *(src++);
@@ -29,9 +34,22 @@ void oslSwizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int h
                 *(dst++) = *(src++);
                 src += src_pitch;
             }
-            xsrc += 16;
         }
-        ysrc += src_row;
+    }
+}
+
+// Swizzle a texture to optimize memory access patterns on the PSP
+void oslSwizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int height) {
+    unsigned int blocky;
+    unsigned int height_blocks = height / 8;
+    unsigned int src_row = width * 8;
+
+    // Swizzle the texture
+    for (blocky = 0; blocky < height_blocks; ++blocky) {
+        oslSwizzleBand(out, in, width);
+        in += src_row;
+        // Same as src_row, unless the width is not a multiple of 16 bytes
+        out += (width / 16) * 16 * 8;
     }
 }
 
@@ -59,19 +77,30 @@ void* oslGetSwizzledPixelAddr(OSL_IMAGE* img, unsigned int x, unsigned int y) {
     return (void*)((u8*)img->data + block_address + x + (y * 16));
 }
 
-// Swizzle an entire image
+// Swizzle an entire image, in place
 void oslSwizzleImage(OSL_IMAGE* img) {
+    unsigned int width, bandSize, blocky, height_blocks;
+    u8* data;
+
     // Check if the image is already swizzled
     if (oslImageIsSwizzled(img)) {
         return;
     }
 
-    // Allocate a temporary block of memory for swizzling
-    void* block = malloc(img->totalSize);
-    if (block) {
-        memcpy(block, img->data, img->totalSize);
-        oslSwizzleTexture((u8*)img->data, (u8*)block, (img->realSizeX * osl_pixelWidth[img->pixelFormat]) >> 3, img->realSizeY);
-        free(block);
+    width = (img->realSizeX * osl_pixelWidth[img->pixelFormat]) >> 3;
+    bandSize = width * 8;
+    height_blocks = img->realSizeY / 8;
+    data = (u8*)img->data;
+
+    // Only one band of 8 rows needs to be kept aside
+    void* band = memalign(16, bandSize);
+    if (band) {
+        for (blocky = 0; blocky < height_blocks; ++blocky) {
+            memcpy(band, data, bandSize);
+            oslSwizzleBand(data, (u8*)band, width);
+            data += bandSize;
+        }
+        free(band);
 
         oslUncacheImageData(img);
         oslImageIsSwizzledSet(img, 1);
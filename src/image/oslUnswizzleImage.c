@@ -1,28 +1,26 @@
 #include "oslib.h"
+#include "vfpu.h"
 
-void oslUnswizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int height) {
-    unsigned int blockX, blockY;
-    unsigned int rowOffset;
-
+// Unswizzle one band of 8 rows of 'width' bytes (see oslSwizzleImage.c); in and out must not overlap
+static void oslUnswizzleBand(u8* out, const u8* in, unsigned int width) {
+    unsigned int blockX, rowOffset;
     unsigned int widthBlocks = width / 16;
-    unsigned int heightBlocks = height / 8;
-
-    unsigned int dstPitch = (width - 16) / 4;
-    unsigned int dstRowSize = width * 8;
-
-    const u32* src = (const u32*)in;
-    u8* destRow = out;
-
-#ifndef PSP
-    // For non-PSP platforms, simply copy the data as is.
-    memcpy(out, in, width * height);
-    return;
-#endif
 
-    for (blockY = 0; blockY < heightBlocks; ++blockY) {
-        u8* destBlock = destRow;
+    // 128-bit copies when everything is quadword aligned (always the case for images)
+    if (!(((uintptr_t)out | (uintptr_t)in | width) & 15)) {
+        for (blockX = 0; blockX < widthBlocks; ++blockX) {
+            u8* dest = out + blockX * 16;
+            for (rowOffset = 0; rowOffset < 8; ++rowOffset) {
+                oslVfpuCopyQuad(dest, in);
+                in += 16;
+                dest += width;
+            }
+        }
+    } else {
+        unsigned int dstPitch = (width - 16) / 4;
+        const u32* src = (const u32*)in;
         for (blockX = 0; blockX < widthBlocks; ++blockX) {
-            u32* dest = (u32*)destBlock;
+            u32* dest = (u32*)(out + blockX * 16);
             for (rowOffset = 0; rowOffset < 8; ++rowOffset) {
                 *(dest++) = *(src++);
                 *(dest++) = *(src++);
@@ -30,34 +28,52 @@ void oslUnswizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int
                 *(dest++) = *(src++);
                 dest += dstPitch;
             }
-            destBlock += 16;
         }
-        destRow += dstRowSize;
+    }
+}
+
+void oslUnswizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int height) {
+    unsigned int blockY;
+    unsigned int heightBlocks = height / 8;
+    unsigned int dstRowSize = width * 8;
+
+    for (blockY = 0; blockY < heightBlocks; ++blockY) {
+        oslUnswizzleBand(out, in, width);
+        // Same as dstRowSize, unless the width is not a multiple of 16 bytes
+        in += (width / 16) * 16 * 8;
+        out += dstRowSize;
     }
 }
 
 void oslUnswizzleImage(OSL_IMAGE *img) {
+    unsigned int width, bandSize, blockY, heightBlocks;
+    u8 *data;
+
     // Check if the image is already unswizzled
     if (!oslImageIsSwizzled(img))
         return;
 
-    // Allocate memory for the temporary buffer
-    void *tempBuffer = malloc(img->totalSize);
-    if (!tempBuffer) {
+    width = (img->realSizeX * osl_pixelWidth[img->pixelFormat]) >> 3;
+    bandSize = width * 8;
+    heightBlocks = img->realSizeY / 8;
+    data = (u8*)img->data;
+
+    // Only one band of 8 rows needs to be kept aside
+    void *band = memalign(16, bandSize);
+    if (!band) {
         // Handle memory allocation failure
         return;
     }
 
-    // Copy image data to the temporary buffer
-    memcpy(tempBuffer, img->data, img->totalSize);
-
-    // Unswizzle the texture
-    oslUnswizzleTexture((u8*)img->data, (u8*)tempBuffer, 
-        (img->realSizeX * osl_pixelWidth[img->pixelFormat]) >> 3, 
-        img->realSizeY);
+    // Unswizzle the texture in place, band by band
+    for (blockY = 0; blockY < heightBlocks; ++blockY) {
+        memcpy(band, data, bandSize);
+        oslUnswizzleBand(data, (u8*)band, width);
+        data += bandSize;
+    }
 
     // Free the temporary buffer
-    free(tempBuffer);
+    free(band);
 
     // Update the image metadata
     oslUncacheImageData(img);
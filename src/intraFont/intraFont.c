@@ -40,19 +40,55 @@
 #include <malloc.h>
 #include <math.h>
 #include <intraFont.h>
-#if defined(_OSLIB_H_)
-#define OSLIB_FREE(a) free((a))
-#else 
+#if defined(_PSP)
+#include "../oslib.h"
+#endif
 #ifndef M_PI
 #define M_PI ((float)(3.14159265358979323846))
 #endif
 #ifndef GU_PI
 #define GU_PI ((float)M_PI)
 #endif
-#define OSLIB_FREE(a)
+
+//font files are opened through OSLib's virtual files when available
+#if defined(_OSLIB_H_)
+typedef VIRTUAL_FILE intraFontFile;
+#define intraFontFileOpen(name) VirtualFileOpen((void *)(name), 0, VF_AUTO, VF_O_READ)
+#define intraFontFileRead(f, buffer, size) (VirtualFileRead((buffer), 1, (size), (f)) == (int)(size))
+#define intraFontFileSeek(f, position) VirtualFileSeek((f), (position), SEEK_SET)
+#define intraFontFileSize(f) VirtualFileGetSize(f)
+#define intraFontFileClose(f) VirtualFileClose(f)
+#else
+typedef FILE intraFontFile;
+#define intraFontFileOpen(name) fopen((name), "rb")
+#define intraFontFileRead(f, buffer, size) (fread((buffer), (size), 1, (f)) == 1)
+#define intraFontFileSeek(f, position) fseek((f), (position), SEEK_SET)
+#define intraFontFileClose(f) fclose(f)
+static long intraFontFileSize(FILE *f)
+{
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	return size;
+}
 #endif
 
+//font file contents being parsed
+typedef struct
+{
+	const unsigned char *data;
+	unsigned long size, pos;
+} intraFontInput;
+
 static unsigned int __attribute__((aligned(16))) clut[16];
+static const unsigned char bw_shadow[] = {0x10, 0x11, 0x11, 0x01, 0x10, 0x22, 0x22, 0x01, 0x21, 0x43, 0x34, 0x12, 0x31, 0x75, 0x57, 0x13,
+										 0x31, 0x86, 0x68, 0x13, 0x31, 0x86, 0x68, 0x13, 0x31, 0x75, 0x57, 0x13, 0x21, 0x43, 0x34, 0x12,
+										 0x10, 0x22, 0x22, 0x01, 0x10, 0x11, 0x11, 0x01}; //shadow glyph of bwfon fonts
+static unsigned long intraFontFrame = 0; //current frame for the glyph caches (0: frames are not tracked)
+
+#define INTRAFONT_CACHE_CELL 4 //width of the glyph cache cells for pgf fonts (in pixels)
+#define GLYPH_DECODED 1        //intraFontUseGlyph: the glyph was written to the cache texture
+#define GLYPH_MISSING 2        //intraFontUseGlyph: no room for the glyph in the cache texture
 
 unsigned long intraFontGetV(unsigned long n, unsigned char *p, unsigned long *b)
 {
@@ -65,32 +101,170 @@ unsigned long intraFontGetV(unsigned long n, unsigned char *p, unsigned long *b)
 	return v;
 }
 
-unsigned long *intraFontGetTable(FILE *file, unsigned long n_elements, unsigned long bp_element)
+static int intraFontRead(intraFontInput *input, void *buffer, unsigned long size)
+{
+	if (input->pos > input->size || size > input->size - input->pos)
+		return 0;
+	memcpy(buffer, input->data + input->pos, size);
+	input->pos += size;
+	return 1;
+}
+
+static unsigned long *intraFontGetTable(intraFontInput *input, unsigned long n_elements, unsigned long bp_element)
 {
 	unsigned long len_table = ((n_elements * bp_element + 31) / 32) * 4;
-	unsigned char *raw_table = (unsigned char *)malloc(len_table * sizeof(unsigned char));
-	if (raw_table == NULL)
-		return NULL;
-	if (fread(raw_table, len_table * sizeof(unsigned char), 1, file) != 1)
-	{
-		free(raw_table);
+	if (input->pos > input->size || len_table > input->size - input->pos)
 		return NULL;
-	}
 	unsigned long *table = (unsigned long *)malloc(n_elements * sizeof(unsigned long));
 	if (table == NULL)
-	{
-		free(raw_table);
 		return NULL;
-	}
 	unsigned long i, j = 0;
 	for (i = 0; i < n_elements; i++)
 	{
-		table[i] = intraFontGetV(bp_element, raw_table, &j);
+		table[i] = intraFontGetV(bp_element, (unsigned char *)input->data + input->pos, &j);
 	}
-	free(raw_table);
+	input->pos += len_table;
 	return table;
 }
 
+static int intraFontCreateCache(intraFont *font)
+{
+	//a row fits the highest glyph, bwfon glyphs (all of the same size) use one cell each
+	unsigned int cellWidth = (font->fileType == FILETYPE_BWFON) ? (font->glyph[0].width + 1u) : INTRAFONT_CACHE_CELL;
+	unsigned int cellHeight = font->texYSize + 1u;
+	unsigned int cols = (font->texWidth - 1) / cellWidth, rows = (font->texHeight - 1) / cellHeight;
+	unsigned int size = sizeof(GlyphCache) + cols * rows * sizeof(GlyphCell);
+
+	GlyphCache *cache = (GlyphCache *)malloc(size);
+	if (!cache)
+		return 0;
+	memset(cache, 0, size); //all cells free
+	cache->cells = (GlyphCell *)(cache + 1);
+	cache->cols = cols;
+	cache->rows = rows;
+	cache->cellWidth = cellWidth;
+	cache->cellHeight = cellHeight;
+	cache->stats.cells = cols * rows;
+	font->cache = cache;
+	return 1;
+}
+
+//mark the glyph in the cells starting at head as used by the current print
+static void intraFontCacheTouch(GlyphCache *cache, GlyphCell *head)
+{
+	if (head->frame != intraFontFrame)
+	{ //first use in this frame
+		head->frame = intraFontFrame;
+		cache->frameCells += head->span;
+		if (cache->frameCells > cache->stats.peakFrameCells)
+			cache->stats.peakFrameCells = cache->frameCells;
+	}
+	head->lastUse = cache->clock;
+}
+
+static void intraFontCacheEvict(intraFont *font, unsigned int head)
+{
+	GlyphCache *cache = font->cache;
+	GlyphCell *cell = &(cache->cells[head]);
+	unsigned int i;
+
+	if (cell->type & PGF_CHARGLYPH)
+	{
+		if (font->fileType == FILETYPE_PGF)
+			font->glyph[cell->id].flags &= ~PGF_CACHED;
+		else
+			font->glyphBW[cell->id].flags &= ~PGF_CACHED;
+	}
+	else
+	{
+		font->shadowGlyph[(font->fileType == FILETYPE_PGF) ? cell->id : 0].flags &= ~PGF_CACHED;
+	}
+	cache->stats.evictions++;
+	if (intraFontFrame && cell->frame == intraFontFrame)
+		cache->stats.overwrites++; //the GPU may not have drawn it yet
+	for (i = 0; i < cell->span; i++)
+		cell[i].type = 0;
+}
+
+//find room for a glyph in the cache, evicting the least recently used glyphs (never those of the current print)
+static int intraFontCacheAlloc(intraFont *font, unsigned short id, unsigned char glyphtype, Glyph *glyph)
+{
+	GlyphCache *cache = font->cache;
+	unsigned int span = (glyph->width + cache->cellWidth) / cache->cellWidth; //glyph and the gap to the next one
+	unsigned int row, col, i, best = 0;
+	unsigned long use, bestUse = 0;
+	int inFrame, bestInFrame = 0, found = 0;
+
+	if (span > cache->cols || glyph->height >= cache->cellHeight)
+	{
+		cache->stats.failures++;
+		return 0;
+	}
+
+	//cost of a run of cells: does it hold glyphs of the current frame, and when was its most recent glyph used?
+	for (row = 0; row < cache->rows && !(found && bestUse == 0); row++)
+	{
+		GlyphCell *cells = &(cache->cells[row * cache->cols]);
+		for (col = 0; col + span <= cache->cols && !(found && bestUse == 0); col++)
+		{
+			use = 0;
+			inFrame = 0;
+			for (i = col; i < col + span; i++)
+			{
+				if (!cells[i].type)
+					continue;
+				GlyphCell *head = &(cache->cells[cells[i].head]);
+				if (head->lastUse == cache->clock)
+					break; //pinned by the current print
+				if (head->lastUse > use)
+					use = head->lastUse;
+				if (intraFontFrame && head->frame == intraFontFrame)
+					inFrame = 1;
+			}
+			if (i < col + span)
+			{
+				col = i; //no run can start before the pinned cell
+				continue;
+			}
+			if (!found || inFrame < bestInFrame || (inFrame == bestInFrame && use < bestUse))
+			{
+				found = 1;
+				best = row * cache->cols + col;
+				bestUse = use;
+				bestInFrame = inFrame;
+			}
+		}
+	}
+	if (!found)
+	{
+		cache->stats.failures++;
+		return 0;
+	}
+
+	for (i = best; i < best + span; i++)
+	{
+		if (cache->cells[i].type)
+			intraFontCacheEvict(font, cache->cells[i].head);
+	}
+	for (i = best; i < best + span; i++)
+	{
+		cache->cells[i].type = (glyphtype & PGF_CHARGLYPH) ? PGF_CHARGLYPH : PGF_SHADOWGLYPH;
+		cache->cells[i].head = best;
+	}
+	GlyphCell *head = &(cache->cells[best]);
+	head->id = id;
+	head->span = span;
+	head->lastUse = cache->clock;
+	head->frame = intraFontFrame;
+	cache->frameCells += span;
+	if (cache->frameCells > cache->stats.peakFrameCells)
+		cache->stats.peakFrameCells = cache->frameCells;
+
+	glyph->x = (best % cache->cols) * cache->cellWidth + 1;
+	glyph->y = (best / cache->cols) * cache->cellHeight + 1;
+	return 1;
+}
+
 int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 {
 	if (!font)
@@ -99,6 +273,7 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 		return 0; //swizzeled texture
 
 	Glyph *glyph;
+	unsigned char *data = font->fontdata, bwdata[36];
 	if (font->fileType == FILETYPE_PGF)
 	{
 		if (glyphtype & PGF_CHARGLYPH)
@@ -116,17 +291,28 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 		{
 			glyph = &(font->glyph[0]);
 			glyph->flags = font->glyphBW[id].flags | PGF_BMP_H_ROWS;
+			glyph->ptr = ((unsigned long)id) * 36; //36 bytes/char
 		}
 		else
 		{
 			glyph = &(font->shadowGlyph[0]);
+			glyph->ptr = 0;
+			data = (unsigned char *)bw_shadow;
 		}
-		glyph->ptr = ((unsigned long)id) * 36; //36 bytes/char
 	}
 
 	if (glyph->flags & PGF_CACHED)
 		return 1;
 
+	if (font->file && (glyphtype & PGF_CHARGLYPH))
+	{ //bwfon glyphs not kept in memory: read this one
+		intraFontFileSeek((intraFontFile *)font->file, glyph->ptr);
+		if (!intraFontFileRead((intraFontFile *)font->file, bwdata, 36))
+			return 0;
+		glyph->ptr = 0;
+		data = bwdata;
+	}
+
 	unsigned long b = glyph->ptr * 8;
 
 	#if DESKTOP
@@ -137,18 +323,28 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 	{
 		if (!(glyph->flags & PGF_BMP_H_ROWS) != !(glyph->flags & PGF_BMP_V_ROWS))
 		{ //H_ROWS xor V_ROWS (real glyph, no overlay)
-			if ((font->texX + glyph->width + 1u) > font->texWidth)
-			{
-				font->texY += font->texYSize + 1;
-				font->texX = 1;
+			if (font->cache)
+			{ //on-demand cache: take the least recently used cells
+				if (!intraFontCacheAlloc(font, id, glyphtype, glyph))
+					return 0; //no room left for this print
 			}
-			if ((font->texY + glyph->height + 1u) > font->texHeight)
-			{
-				font->texY = 1;
-				font->texX = 1;
+			else
+			{ //precache: pack the glyphs one after another
+				if ((font->texX + glyph->width + 1u) > font->texWidth)
+				{
+					font->texY += font->texYSize + 1;
+					font->texX = 1;
+				}
+				if ((font->texY + glyph->height + 1u) > font->texHeight)
+				{
+					font->texY = 1;
+					font->texX = 1;
+				}
+				glyph->x = font->texX;
+				glyph->y = font->texY;
+				font->texX += glyph->width + 1; //add empty gap to prevent interpolation artifacts from showing
 			}
-			glyph->x = font->texX;
-			glyph->y = font->texY;
+			unsigned int texX = glyph->x, texY = glyph->y;
 
 			//draw bmp
 			int i = 0, j, xx, yy;
@@ -157,13 +353,13 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 			{ //for compressed pgf format
 				while (i < (glyph->width * glyph->height))
 				{
-					nibble = intraFontGetV(4, font->fontdata, &b);
+					nibble = intraFontGetV(4, data, &b);
 					if (nibble < 8)
-						value = intraFontGetV(4, font->fontdata, &b);
+						value = intraFontGetV(4, data, &b);
 					for (j = 0; (j <= ((nibble < 8) ? (nibble) : (15 - nibble))) && (i < (glyph->width * glyph->height)); j++)
 					{
 						if (nibble >= 8)
-							value = intraFontGetV(4, font->fontdata, &b);
+							value = intraFontGetV(4, data, &b);
 						if (glyph->flags & PGF_BMP_H_ROWS)
 						{
 							xx = i % glyph->width;
@@ -175,18 +371,18 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 							yy = i % glyph->height;
 						}
 						#ifdef PSP
-						if ((font->texX + xx) & 1)
+						if ((texX + xx) & 1)
 						{
-							font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] &= 0x0F;
-							font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] |= (value << 4);
+							font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] &= 0x0F;
+							font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] |= (value << 4);
 						}
 						else
 						{
-							font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] &= 0xF0;
-							font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] |= (value);
+							font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] &= 0xF0;
+							font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] |= (value);
 						}
 						#else 
-						font_texture_p[((font->texX + xx) + (font->texY + yy) * font->texWidth)] = clut[value & 0xf];
+						font_texture_p[((texX + xx) + (texY + yy) * font->texWidth)] = clut[value & 0xf];
 						#endif
 						i++;
 					}
@@ -200,58 +396,58 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 					{
 						if (glyphtype & PGF_CHARGLYPH)
 						{
-							value = intraFontGetV(1, font->fontdata, &b) * 0x0f; //scale 1 bit/pix to 4 bit/pix
+							value = intraFontGetV(1, data, &b) * 0x0f; //scale 1 bit/pix to 4 bit/pix
 
 /* Simple anti-aliasing/blur for black pixels. Unfortunately, does not improve the result... */
 #if 0
 							if ((value == 0) && (xx > 0) && (yy > 0) && (xx < (glyph->width - 1)) && (yy < (glyph->height - 1)))
 							{
 								b -= 19;
-								value += intraFontGetV(1, font->fontdata, &b);
-								value += intraFontGetV(1, font->fontdata, &b);
-								value += intraFontGetV(1, font->fontdata, &b);
+								value += intraFontGetV(1, data, &b);
+								value += intraFontGetV(1, data, &b);
+								value += intraFontGetV(1, data, &b);
 								b += 13;
-								value += intraFontGetV(1, font->fontdata, &b);
-								value += intraFontGetV(1, font->fontdata, &b);
-								value += intraFontGetV(1, font->fontdata, &b);
+								value += intraFontGetV(1, data, &b);
+								value += intraFontGetV(1, data, &b);
+								value += intraFontGetV(1, data, &b);
 								b += 13;
-								value += intraFontGetV(1, font->fontdata, &b);
-								value += intraFontGetV(1, font->fontdata, &b);
-								value += intraFontGetV(1, font->fontdata, &b);
+								value += intraFontGetV(1, data, &b);
+								value += intraFontGetV(1, data, &b);
+								value += intraFontGetV(1, data, &b);
 								b -= 16;
 							}
 #endif
 							#ifdef PSP
-							if ((font->texX + (7 - (xx & 7) + (xx & 248))) & 1)
+							if ((texX + (7 - (xx & 7) + (xx & 248))) & 1)
 							{
-								font->texture[((font->texX + (7 - (xx & 7) + (xx & 248))) + (font->texY + yy) * font->texWidth) >> 1] &= 0x0F;
-								font->texture[((font->texX + (7 - (xx & 7) + (xx & 248))) + (font->texY + yy) * font->texWidth) >> 1] |= (value << 4);
+								font->texture[((texX + (7 - (xx & 7) + (xx & 248))) + (texY + yy) * font->texWidth) >> 1] &= 0x0F;
+								font->texture[((texX + (7 - (xx & 7) + (xx & 248))) + (texY + yy) * font->texWidth) >> 1] |= (value << 4);
 							}
 							else
 							{
-								font->texture[((font->texX + (7 - (xx & 7) + (xx & 248))) + (font->texY + yy) * font->texWidth) >> 1] &= 0xF0;
-								font->texture[((font->texX + (7 - (xx & 7) + (xx & 248))) + (font->texY + yy) * font->texWidth) >> 1] |= (value);
+								font->texture[((texX + (7 - (xx & 7) + (xx & 248))) + (texY + yy) * font->texWidth) >> 1] &= 0xF0;
+								font->texture[((texX + (7 - (xx & 7) + (xx & 248))) + (texY + yy) * font->texWidth) >> 1] |= (value);
 							}
 							#else
-							font_texture_p[((font->texX + (7 - (xx & 7) + (xx & 248))) + (font->texY + yy) * font->texWidth)] = clut[value & 0xf];
+							font_texture_p[((texX + (7 - (xx & 7) + (xx & 248))) + (texY + yy) * font->texWidth)] = clut[value & 0xf];
 							#endif
 						}
 						else
 						{ //PGF_SHADOWGLYPH
-							value = intraFontGetV(4, font->fontdata, &b);
+							value = intraFontGetV(4, data, &b);
 							#ifdef PSP
-							if ((font->texX + xx) & 1)
+							if ((texX + xx) & 1)
 							{
-								font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] &= 0x0F;
-								font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] |= (value << 4);
+								font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] &= 0x0F;
+								font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] |= (value << 4);
 							}
 							else
 							{
-								font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] &= 0xF0;
-								font->texture[((font->texX + xx) + (font->texY + yy) * font->texWidth) >> 1] |= (value);
+								font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] &= 0xF0;
+								font->texture[((texX + xx) + (texY + yy) * font->texWidth) >> 1] |= (value);
 							}
 							#else
-							font_texture_p[((font->texX + xx) + (font->texY + yy) * font->texWidth)] = clut[value & 0xf];
+							font_texture_p[((texX + xx) + (texY + yy) * font->texWidth)] = clut[value & 0xf];
 							#endif
 						}
 					}
@@ -260,67 +456,28 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 
 			//erase border around glyph
 			#ifdef PSP
-			for (i = font->texX / 2; i < (font->texX + glyph->width + 1) / 2; i++)
+			for (i = texX / 2; i < (texX + glyph->width + 1) / 2; i++)
 			{
-				font->texture[i + (font->texY - 1) * font->texWidth / 2] = 0;
-				font->texture[i + (font->texY + glyph->height) * font->texWidth / 2] = 0;
+				font->texture[i + (texY - 1) * font->texWidth / 2] = 0;
+				font->texture[i + (texY + glyph->height) * font->texWidth / 2] = 0;
 			}
-			for (i = font->texY - 1; i < (font->texY + glyph->height + 1); i++)
+			for (i = texY - 1; i < (texY + glyph->height + 1); i++)
 			{
-				font->texture[((font->texX - 1) + (i * font->texWidth)) >> 1] &= (font->texX & 1) ? 0xF0 : 0x0F;
-				font->texture[((font->texX + glyph->width) + (i * font->texWidth)) >> 1] &= ((font->texX + glyph->width) & 1) ? 0x0F : 0xF0;
+				font->texture[((texX - 1) + (i * font->texWidth)) >> 1] &= (texX & 1) ? 0xF0 : 0x0F;
+				font->texture[((texX + glyph->width) + (i * font->texWidth)) >> 1] &= ((texX + glyph->width) & 1) ? 0x0F : 0xF0;
 			}
 			#else 
-			for (i = font->texX; i < (font->texX + glyph->width + 1); i++)
+			for (i = texX; i < (texX + glyph->width + 1); i++)
 			{
-				font_texture_p[i + (font->texY - 1) * font->texWidth]  = 0;
-				font_texture_p[i + (font->texY + glyph->height) * font->texWidth] = 0;
+				font_texture_p[i + (texY - 1) * font->texWidth]  = 0;
+				font_texture_p[i + (texY + glyph->height) * font->texWidth] = 0;
 			}
-			for (i = font->texY - 1; i < (font->texY + glyph->height + 1); i++)
+			for (i = texY - 1; i < (texY + glyph->height + 1); i++)
 			{
-				font_texture_p[((font->texX - 1) + (i * font->texWidth))] = 0;
-				font_texture_p[((font->texX + glyph->width) + (i * font->texWidth))] = 0;
+				font_texture_p[((texX - 1) + (i * font->texWidth))] = 0;
+				font_texture_p[((texX + glyph->width) + (i * font->texWidth))] = 0;
 			}	
 			#endif
-			font->texX += glyph->width + 1; //add empty gap to prevent interpolation artifacts from showing
-
-			//mark dirty glyphs as uncached
-			if (font->fileType == FILETYPE_PGF)
-			{ //...for PGF glyphs
-				for (i = 0; i < font->n_chars; i++)
-				{
-					if ((font->glyph[i].flags & PGF_CACHED) && (font->glyph[i].y == glyph->y))
-					{
-						if ((font->glyph[i].x + font->glyph[i].width + 1) > glyph->x && font->glyph[i].x < (glyph->x + glyph->width + 1))
-						{
-							font->glyph[i].flags &= ~PGF_CACHED;
-						}
-					}
-				}
-			}
-			else
-			{ //...for BWFON glyphs
-				for (i = 0; i < font->n_chars; i++)
-				{
-					if ((font->glyphBW[i].flags & PGF_CACHED) && (font->glyphBW[i].y == glyph->y))
-					{
-						if ((font->glyphBW[i].x + font->glyph[0].width + 1) > glyph->x && font->glyphBW[i].x < (glyph->x + glyph->width + 1))
-						{
-							font->glyphBW[i].flags &= ~PGF_CACHED;
-						}
-					}
-				}
-			}
-			for (i = 0; i < font->n_shadows; i++)
-			{
-				if ((font->shadowGlyph[i].flags & PGF_CACHED) && (font->shadowGlyph[i].y == glyph->y))
-				{
-					if ((font->shadowGlyph[i].x + font->shadowGlyph[i].width + 1) > glyph->x && font->shadowGlyph[i].x < (glyph->x + glyph->width + 1))
-					{
-						font->shadowGlyph[i].flags &= ~PGF_CACHED;
-					}
-				}
-			}
 		}
 		else
 			return 0; //transposition=0 or overlay glyph
@@ -342,7 +499,90 @@ int intraFontGetBMP(intraFont *font, unsigned short id, unsigned char glyphtype)
 	return 1; //texture has changed
 }
 
-int intraFontGetGlyph(unsigned char *data, unsigned long *b, unsigned char glyphtype, signed long *advancemap, Glyph *glyph)
+//make sure a glyph is in the texture for the current print, returns GLYPH_DECODED and/or GLYPH_MISSING flags
+static int intraFontUseGlyph(intraFont *font, unsigned short id, unsigned char glyphtype)
+{
+	GlyphCache *cache = font->cache;
+	unsigned short x, y;
+	unsigned char flags;
+
+	if (font->fileType == FILETYPE_PGF)
+	{
+		Glyph *glyph = (glyphtype & PGF_CHARGLYPH) ? &(font->glyph[id]) : &(font->shadowGlyph[id]);
+		if (!(glyph->flags & PGF_BMP_H_ROWS) == !(glyph->flags & PGF_BMP_V_ROWS))
+			return 0; //transposition=0 or overlay glyph: nothing to cache
+		x = glyph->x;
+		y = glyph->y;
+		flags = glyph->flags;
+	}
+	else if (glyphtype & PGF_CHARGLYPH)
+	{
+		x = font->glyphBW[id].x;
+		y = font->glyphBW[id].y;
+		flags = font->glyphBW[id].flags;
+	}
+	else
+	{
+		x = font->shadowGlyph[0].x;
+		y = font->shadowGlyph[0].y;
+		flags = font->shadowGlyph[0].flags;
+	}
+
+	if (!cache)
+		return 0; //precached
+	if (flags & PGF_CACHED)
+	{
+		cache->stats.hits++;
+		if (x) //empty glyphs use no cells
+			intraFontCacheTouch(cache, &(cache->cells[cache->cells[((y - 1) / cache->cellHeight) * cache->cols + (x - 1) / cache->cellWidth].head]));
+		return 0;
+	}
+	cache->stats.misses++;
+	return intraFontGetBMP(font, id, glyphtype) ? GLYPH_DECODED : GLYPH_MISSING;
+}
+
+//start a print: its glyphs are pinned in the cache until the next one
+static void intraFontCacheBegin(intraFont *font)
+{
+	GlyphCache *cache = font->cache;
+	if (!cache)
+		return;
+	if (cache->frame != intraFontFrame)
+	{
+		cache->frame = intraFontFrame;
+		cache->frameCells = 0;
+	}
+	cache->clock++;
+}
+
+void intraFontSetCacheFrame(unsigned long frame)
+{
+	intraFontFrame = frame;
+}
+
+int intraFontGetCacheStats(intraFont *font, intraFontCacheStats *stats)
+{
+	if (!stats)
+		return 0;
+	if (!font || !font->cache)
+	{
+		memset(stats, 0, sizeof(intraFontCacheStats));
+		return 0;
+	}
+	*stats = font->cache->stats;
+	return 1;
+}
+
+void intraFontResetCacheStats(intraFont *font)
+{
+	if (!font || !font->cache)
+		return;
+	unsigned long cells = font->cache->stats.cells;
+	memset(&(font->cache->stats), 0, sizeof(intraFontCacheStats));
+	font->cache->stats.cells = cells;
+}
+
+int intraFontGetGlyph(unsigned char *data, unsigned long *b, unsigned char glyphtype, signed int *advancemap, Glyph *glyph)
 {
 	if (glyphtype & PGF_CHARGLYPH)
 	{
@@ -389,7 +629,7 @@ int intraFontGetGlyph(unsigned char *data, unsigned long *b, unsigned char glyph
 	return 1;
 }
 
-unsigned short intraFontGetID(intraFont *font, cccUCS2 ucs)
+static unsigned short intraFontScanID(intraFont *font, cccUCS2 ucs)
 {
 	unsigned short j, id = 0;
 	char found = 0;
@@ -415,6 +655,90 @@ unsigned short intraFontGetID(intraFont *font, cccUCS2 ucs)
 	return id;
 }
 
+//builds the two-level id table (256 pages of 256 ucs each) from the compressed charmap, with the same result as
+//intraFontScanID: pages without any char share one page of 65535
+static int intraFontBuildIDMap(intraFont *font)
+{
+	unsigned char used[256];
+	unsigned short j, n_pages = 1, *page;
+	unsigned long ucs, start, end, id;
+
+	memset(used, 0, sizeof(used));
+	for (j = 0; j < font->charmap_compr_len; j++)
+	{
+		start = font->charmap_compr[j * 2];
+		end = start + font->charmap_compr[j * 2 + 1];
+		for (ucs = start; ucs < end && ucs < 65536; ucs += 256 - (ucs & 255))
+			used[ucs >> 8] = 1;
+	}
+	for (j = 0; j < 256; j++)
+		n_pages += used[j];
+
+	font->idmap = (unsigned short **)malloc(256 * sizeof(unsigned short *) + n_pages * 256 * sizeof(unsigned short));
+	if (!font->idmap)
+		return 0;
+	page = (unsigned short *)(font->idmap + 256);
+	memset(page, 255, n_pages * 256 * sizeof(unsigned short));
+	for (j = 0; j < 256; j++)
+	{
+		font->idmap[j] = page + (used[j] ? (--n_pages) * 256 : 0);
+	}
+
+	//ids follow each other from one range to the next
+	for (j = 0, id = 0; j < font->charmap_compr_len; id += font->charmap_compr[j * 2 + 1], j++)
+	{
+		start = font->charmap_compr[j * 2];
+		end = start + font->charmap_compr[j * 2 + 1];
+		for (ucs = start; ucs < end && ucs < 65536; ucs++)
+		{
+			unsigned short char_id = (unsigned short)(id + ucs - start);
+			if (font->fileType == FILETYPE_PGF)
+				char_id = font->charmap[char_id]; //BWFON has right id already
+			if (char_id < font->n_chars)
+				font->idmap[ucs >> 8][ucs & 255] = char_id;
+		}
+	}
+	return 1;
+}
+
+unsigned short intraFontGetID(intraFont *font, cccUCS2 ucs)
+{
+	if (font->idmap)
+		return font->idmap[ucs >> 8][ucs & 255];
+	return intraFontScanID(font, ucs);
+}
+
+#define INTRAFONT_NO_ADVANCE (-128) //latinAdvance of a char not in the font
+
+//advance of U+0000..U+00FF (needs the id table): most text is measured without looking up its glyphs
+static void intraFontBuildLatinAdvance(intraFont *font)
+{
+	unsigned short ucs, id;
+	for (ucs = 0; ucs < 256; ucs++)
+	{
+		id = font->idmap[0][ucs];
+		font->latinAdvance[ucs] = (id < font->n_chars) ? font->glyph[(font->fileType == FILETYPE_PGF) ? id : 0].advance : INTRAFONT_NO_ADVANCE;
+	}
+}
+
+//width of a char (not '\n') at the current size, from the font or else its alternative fonts
+static float intraFontCharWidth(intraFont *font, cccUCS2 ucs)
+{
+	int advance;
+	if (ucs < 256)
+	{
+		advance = font->latinAdvance[ucs];
+	}
+	else
+	{
+		unsigned short id = intraFontGetID(font, ucs);
+		advance = (id < font->n_chars) ? font->glyph[(font->fileType == FILETYPE_PGF) ? id : 0].advance : INTRAFONT_NO_ADVANCE;
+	}
+	if (advance == INTRAFONT_NO_ADVANCE)
+		return intraFontMeasureTextUCS2Ex(font->altFont, &ucs, 1); //try alternative font if char does not exist in current font
+	return (font->options & INTRAFONT_WIDTH_FIX) ? (font->options & PGF_WIDTH_MASK) * font->size : advance * font->size * 0.25f;
+}
+
 #if defined(_PSP)
 static int  intraFontSwizzle(intraFont *font)
 {
@@ -492,27 +816,37 @@ int intraFontPreCache(intraFont *font, unsigned int options)
 	if (font->texHeight > font->texWidth)
 		font->texHeight = font->texWidth;
 
-	//reduce fontdata
-	int index = 0, j;
-	for (i = 0; i < font->n_chars; i++)
+	//reduce fontdata: only overlay glyphs still use it (a memory file is used in place and has nothing to free)
+	if (font->datablock)
 	{
-		if ((font->glyph[i].flags & PGF_BMP_H_ROWS) && (font->glyph[i].flags & PGF_BMP_V_ROWS))
+		int index = 0, j;
+		for (i = 0; i < font->n_chars; i++)
 		{
-			for (j = 0; j < 6; j++, index++)
+			if ((font->glyph[i].flags & PGF_BMP_H_ROWS) && (font->glyph[i].flags & PGF_BMP_V_ROWS))
+				index += 6;
+		}
+		unsigned char *fontdata = NULL;
+		if (index > 0)
+		{
+			fontdata = (unsigned char *)malloc(index * sizeof(unsigned char));
+			if (!fontdata)
+				return 0;
+		}
+		index = 0;
+		for (i = 0; i < font->n_chars; i++)
+		{
+			if ((font->glyph[i].flags & PGF_BMP_H_ROWS) && (font->glyph[i].flags & PGF_BMP_V_ROWS))
 			{
-				font->fontdata[index] = font->fontdata[(font->glyph[i].ptr) + j];
+				for (j = 0; j < 6; j++, index++)
+				{
+					fontdata[index] = font->fontdata[(font->glyph[i].ptr) + j];
+				}
+				font->glyph[i].ptr = index - j;
 			}
-			font->glyph[i].ptr = index - j;
 		}
-	}
-	if (index == 0)
-	{
-		free(font->fontdata);
-		font->fontdata = NULL;
-	}
-	else
-	{
-		font->fontdata = (unsigned char *)realloc(font->fontdata, index * sizeof(unsigned char));
+		free(font->datablock);
+		font->datablock = fontdata;
+		font->fontdata = fontdata;
 	}
 
 	//swizzle texture
@@ -555,42 +889,54 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 													  0xe864, 1, 0xf92c, 1, 0xf979, 1, 0xf995, 1, 0xf9e7, 1, 0xf9f1, 1, 0xfa0c, 4, 0xfa11, 1,
 													  0xfa13, 2, 0xfa18, 1, 0xfa1f, 3, 0xfa23, 2, 0xfa27, 3, 0xfe30, 2, 0xfe33, 18, 0xfe49, 10,
 													  0xfe54, 4, 0xfe59, 14, 0xfe68, 4, 0xff01, 94, 0xffe0, 6};
-	static const unsigned char bw_shadow[] = {0x10, 0x11, 0x11, 0x01, 0x10, 0x22, 0x22, 0x01, 0x21, 0x43, 0x34, 0x12, 0x31, 0x75, 0x57, 0x13,
-											  0x31, 0x86, 0x68, 0x13, 0x31, 0x86, 0x68, 0x13, 0x31, 0x75, 0x57, 0x13, 0x21, 0x43, 0x34, 0x12,
-											  0x10, 0x22, 0x22, 0x01, 0x10, 0x11, 0x11, 0x01};
 
 	//create font structure
 	intraFont *font = (intraFont *)malloc(sizeof(intraFont));
 	if (!font)
 		return NULL;
+	font->idmap = NULL; //built once the charmap is complete
+	font->cache = NULL; //created once the glyphs are known
+	font->filename = NULL;
+	font->texture = NULL;
+	font->fontdata = NULL;
+	font->datablock = NULL;
+	font->file = NULL;
+	font->text = NULL; //print memory is allocated by the first print
+	font->textSize = 0;
+	font->v = NULL;
+	font->v_size = 0;
+	font->allocations = 0;
 
-	//open pgf file and get file size
-#ifdef _OSLIB_H_
-	const unsigned char *input_free, *input
-	int input_size = 0;
-	VIRTUAL_FILE *f = VirtualFileOpen((void *)filename, 0, VF_AUTO, VF_O_READ);
-	if (!f)
+	//open font file and get file size
+	intraFontFile *file = intraFontFileOpen(filename);
+	if (!file)
+	{
+		free(font);
 		return NULL;
-
-	input = (const unsigned char *)oslReadEntireFileToMemory(f, &input_size);
-	input_free = input;
-	VirtualFileClose(f);
-	FILE *file = fmemopen((void *)input, input_size, "rb");
-#else
-	FILE *file = fopen(filename, "rb"); /* read from the file in binary mode */
+	}
+	intraFontInput input = {NULL, 0, 0};
+	long filesize = intraFontFileSize(file);
+#ifdef _OSLIB_H_
+	if (file->type == VF_MEMORY)
+	{ //memory file: parse it in place, the glyph data is not copied (the memory must outlive the font)
+		input.data = (const unsigned char *)file->ioPtr;
+		filesize = file->maxSize;
+	}
 #endif
-	if (!file)
+	if (filesize < (long)sizeof(PGF_Header))
+	{
+		intraFontFileClose(file);
+		free(font);
 		return NULL;
-	fseek(file, 0, SEEK_END);
-	unsigned long filesize = ftell(file);
-	fseek(file, 0, SEEK_SET);
+	}
+	input.size = filesize;
 
 	//read pgf header
 	static PGF_Header header;
-	if (fread(&header, sizeof(PGF_Header), 1, file) != 1)
+	if (!(input.data ? intraFontRead(&input, &header, sizeof(PGF_Header)) : intraFontFileRead(file, &header, sizeof(PGF_Header))))
 	{
-		fclose(file);
-		OSLIB_FREE((void *)input_free);
+		intraFontFileClose(file);
+		free(font);
 		return NULL;
 	}
 
@@ -607,11 +953,35 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 	}
 	else
 	{
-		fclose(file);
-		OSLIB_FREE((void *)input_free);
+		intraFontFileClose(file);
+		free(font);
 		return NULL;
 	}
 
+	if (!input.data)
+	{
+		if (font->fileType == FILETYPE_PGF)
+		{ //read the whole file at once: tables and glyph data are parsed from memory
+			font->datablock = malloc(filesize);
+			intraFontFileSeek(file, 0);
+			if (!font->datablock || !intraFontFileRead(file, font->datablock, filesize))
+			{
+				free(font->datablock);
+				intraFontFileClose(file);
+				free(font);
+				return NULL;
+			}
+			input.data = (const unsigned char *)font->datablock;
+		}
+		else
+		{ //bwfon: glyphs are read from the file when they are cached
+			font->file = file;
+			file = NULL;
+		}
+	}
+	if (file)
+		intraFontFileClose(file);
+
 	//intitialize font structure
 	if (font->fileType == FILETYPE_PGF)
 	{
@@ -629,8 +999,6 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 		font->charmap = (unsigned short *)malloc(header.charmap_len * sizeof(unsigned short));
 		if (!font->glyph || !font->shadowGlyph || !font->charmap_compr || !font->charmap)
 		{
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
 			intraFontUnload(font);
 			return NULL;
 		}
@@ -647,15 +1015,13 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 		font->n_shadows = 1;
 		font->shadowscale = 24;
 		font->glyph = &bw_glyph;
-		font->glyph[0].shadowID = font->n_chars; //shadow is appended
+		font->glyph[0].shadowID = font->n_chars; //shadow id follows the chars (its data is bw_shadow)
 		font->glyphBW = (GlyphBW *)malloc(font->n_chars * sizeof(GlyphBW));
 		font->shadowGlyph = &bw_shadowGlyph;
 		font->charmap_compr = (unsigned short *)bw_charmap_compr; //static for bwfon
 		font->charmap = NULL;									  //not needed for bwfon
 		if (!font->glyphBW)
 		{
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
 			intraFontUnload(font);
 			return NULL;
 		}
@@ -685,13 +1051,8 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 	font->texture = (unsigned char *)memalign(16, sizeof(unsigned int)*font->texWidth * font->texHeight >> 1);
 	#endif
 	font->textureID = 0;
-	font->v = NULL;
-	font->v_size = 0;
-	font->fontdata = NULL;
 	if (!font->filename || !font->texture)
 	{
-		fclose(file);
-		OSLIB_FREE((void *)input_free);
 		intraFontUnload(font);
 		return NULL;
 	}
@@ -702,31 +1063,26 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 	{
 
 		//read advance table
-		fseek(file, header.header_len + (header.table1_len + header.table2_len + header.table3_len) * 8, SEEK_SET);
-		signed long *advancemap = (signed long *)malloc(header.advance_len * sizeof(signed long) * 2);
+		input.pos = header.header_len + (header.table1_len + header.table2_len + header.table3_len) * 8;
+		signed int *advancemap = (signed int *)malloc(header.advance_len * sizeof(signed int) * 2);
 		if (!advancemap)
 		{
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
 			intraFontUnload(font);
 			return NULL;
 		}
-		if (fread(advancemap, header.advance_len * sizeof(signed long) * 2, 1, file) != 1)
+		if (!intraFontRead(&input, advancemap, header.advance_len * sizeof(signed int) * 2))
 		{
 			free(advancemap);
-			fclose(file);
 			intraFontUnload(font);
 			return NULL;
 		}
 
 		//read shadowmap
-		unsigned long *ucs_shadowmap = intraFontGetTable(file, header.shadowmap_len, header.shadowmap_bpe);
+		unsigned long *ucs_shadowmap = intraFontGetTable(&input, header.shadowmap_len, header.shadowmap_bpe);
 		if (ucs_shadowmap == NULL && (header.shadowmap_len != 0))
 		{
 			/* change logic here to allow zero shadow fonts */
 			free(advancemap);
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
 			intraFontUnload(font);
 			return NULL;
 		}
@@ -734,12 +1090,10 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 		//version 6.3 charmap compression
 		if (header.revision == 3)
 		{
-			if (fread(font->charmap_compr, font->charmap_compr_len * sizeof(unsigned short) * 2, 1, file) != 1)
+			if (!intraFontRead(&input, font->charmap_compr, font->charmap_compr_len * sizeof(unsigned short) * 2))
 			{
 				free(advancemap);
 				free(ucs_shadowmap);
-				fclose(file);
-				OSLIB_FREE((void *)input_free);
 				intraFontUnload(font);
 				return NULL;
 			}
@@ -753,25 +1107,21 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 		//read charmap
 		if (header.charmap_bpe == 16)
 		{ //read directly from file...
-			if (fread(font->charmap, header.charmap_len * sizeof(unsigned short), 1, file) != 1)
+			if (!intraFontRead(&input, font->charmap, header.charmap_len * sizeof(unsigned short)))
 			{
 				free(advancemap);
 				free(ucs_shadowmap);
-				fclose(file);
-				OSLIB_FREE((void *)input_free);
 				intraFontUnload(font);
 				return NULL;
 			}
 		}
 		else
 		{
-			unsigned long *id_charmap = intraFontGetTable(file, header.charmap_len, header.charmap_bpe);
+			unsigned long *id_charmap = intraFontGetTable(&input, header.charmap_len, header.charmap_bpe);
 			if (id_charmap == NULL)
 			{
 				free(advancemap);
 				free(ucs_shadowmap);
-				fclose(file);
-				OSLIB_FREE((void *)input_free);
 				intraFontUnload(font);
 				return NULL;
 			}
@@ -784,45 +1134,17 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 		}
 
 		//read charptr
-		unsigned long *charptr = intraFontGetTable(file, header.charptr_len, header.charptr_bpe);
+		unsigned long *charptr = intraFontGetTable(&input, header.charptr_len, header.charptr_bpe);
 		if (charptr == NULL)
 		{
 			free(advancemap);
 			free(ucs_shadowmap);
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
-			intraFontUnload(font);
-			return NULL;
-		}
-
-		//read raw fontdata
-		unsigned long start_fontdata = ftell(file);
-		unsigned long len_fontdata = filesize - start_fontdata;
-		font->fontdata = (unsigned char *)malloc(len_fontdata * sizeof(unsigned char));
-		if (font->fontdata == NULL)
-		{
-			free(advancemap);
-			free(ucs_shadowmap);
-			free(charptr);
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
-			intraFontUnload(font);
-			return NULL;
-		}
-		if (fread(font->fontdata, len_fontdata * sizeof(unsigned char), 1, file) != 1)
-		{
-			free(advancemap);
-			free(ucs_shadowmap);
-			free(charptr);
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
 			intraFontUnload(font);
 			return NULL;
 		}
 
-		//close file
-		fclose(file);
-		OSLIB_FREE((void *)input_free);
+		//glyph data: used where it is (in the memory file or the block read from the file)
+		font->fontdata = (unsigned char *)input.data + input.pos;
 
 		//count ascii chars and reduce mem required
 		if ((options & PGF_CACHE_MASK) == INTRAFONT_CACHE_ASCII)
@@ -844,6 +1166,7 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 			}
 			font->glyph = (Glyph *)realloc(font->glyph, font->n_chars * sizeof(Glyph));
 			font->charmap_compr[1] = 128 - font->charmap_compr[0];
+			font->charmap_compr_len = 1; //the charmap is cut after the first range
 			font->charmap = (unsigned short *)realloc(font->charmap, font->charmap_compr[1] * sizeof(unsigned short));
 		}
 
@@ -935,28 +1258,8 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 	else
 	{ //FILETYPE_BWFON
 
-		//read raw fontdata
-		fseek(file, 0, SEEK_SET);
-		font->fontdata = (unsigned char *)malloc((filesize + 40) * sizeof(unsigned char));
-		if (font->fontdata == NULL)
-		{
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
-			intraFontUnload(font);
-			return NULL;
-		}
-		if (fread(font->fontdata, filesize * sizeof(unsigned char), 1, file) != 1)
-		{
-			fclose(file);
-			OSLIB_FREE((void *)input_free);
-			intraFontUnload(font);
-			return NULL;
-		}
-		memcpy(font->fontdata + filesize, bw_shadow, 40);
-
-		//close file
-		fclose(file);
-		OSLIB_FREE((void *)input_free);
+		//glyph data: used in place in a memory file, otherwise read from the file when a glyph is cached
+		font->fontdata = (unsigned char *)input.data;
 
 		//count ascii chars and reduce mem required: no ascii chars in bwfon -> abort
 		if ((options & PGF_CACHE_MASK) == INTRAFONT_CACHE_ASCII)
@@ -971,6 +1274,21 @@ intraFont *intraFontLoad(const char *filename, unsigned int options)
 		//cache chars, swizzle texture and free unneeded stuff (if INTRAFONT_CACHE_ALL or _ASCII): not available ->skip
 	}
 
+	//constant time ucs -> id lookup
+	if (!intraFontBuildIDMap(font))
+	{
+		intraFontUnload(font);
+		return NULL;
+	}
+	intraFontBuildLatinAdvance(font);
+
+	//glyph cache for on-demand decoding (unless all glyphs were precached)
+	if (!(font->options & INTRAFONT_CACHE_ASCII) && !intraFontCreateCache(font))
+	{
+		intraFontUnload(font);
+		return NULL;
+	}
+
 #ifdef PSP
 		sceKernelDcacheWritebackAll();
 #endif
@@ -984,10 +1302,20 @@ void intraFontUnload(intraFont *font)
 		return;
 	if (font->filename)
 		free(font->filename);
-	if (font->fontdata)
-		free(font->fontdata);
+	if (font->datablock)
+		free(font->datablock);
+	if (font->file)
+		intraFontFileClose((intraFontFile *)font->file);
 	if (font->texture)
 		free(font->texture);
+	if (font->idmap)
+		free(font->idmap);
+	if (font->cache)
+		free(font->cache);
+	if (font->text)
+		free(font->text);
+	if (font->v)
+		free(font->v);
 	if (font->fileType == FILETYPE_PGF)
 	{
 		if (font->charmap_compr)
@@ -1132,6 +1460,37 @@ void intraFontSetAltFont(intraFont *font, intraFont *altFont)
 	font->altFont = altFont;
 }
 
+static void *intraFontPrintMemory(intraFont *font, void **memory, unsigned long *memorySize, unsigned long size)
+{ //memory kept by the font for its prints: only allocated when a print needs more than all previous ones
+	if (size > *memorySize)
+	{
+		size = (size + 1023) & ~1023; //whole KBs, so slightly longer texts do not reallocate
+		void *data = malloc(size);
+		if (!data)
+			return NULL;
+		if (*memory)
+			free(*memory); //the content is not needed anymore
+		*memory = data;
+		*memorySize = size;
+		font->allocations++;
+	}
+	return *memory;
+}
+
+void intraFontGetPrintStats(intraFont *font, intraFontPrintStats *stats)
+{
+	if (!stats)
+		return;
+	if (!font)
+	{
+		memset(stats, 0, sizeof(intraFontPrintStats));
+		return;
+	}
+	stats->textBytes = font->textSize;
+	stats->vertexBytes = font->v_size;
+	stats->allocations = font->allocations;
+}
+
 float intraFontPrintf(intraFont *font, float x, float y, const char *text, ...)
 {
 	if (!font)
@@ -1174,13 +1533,7 @@ float intraFontPrintColumnEx(intraFont *font, float x, float y, float column, co
 	if (!text || length <= 0 || !font)
 		return x;
 
-#define LOCAL_BUFFER_LENGTH 256
-	cccUCS2 buffer[LOCAL_BUFFER_LENGTH];
-	cccUCS2 *ucs2_text = buffer;
-
-	// Allocate a temporary buffer if too long
-	if (length > LOCAL_BUFFER_LENGTH)
-		ucs2_text = (cccUCS2 *)malloc(length * sizeof(cccUCS2));
+	cccUCS2 *ucs2_text = (cccUCS2 *)intraFontPrintMemory(font, (void **)&font->text, &font->textSize, length * sizeof(cccUCS2));
 	if (!ucs2_text)
 		return x;
 
@@ -1207,10 +1560,6 @@ float intraFontPrintColumnEx(intraFont *font, float x, float y, float column, co
 		x = intraFontMeasureTextUCS2Ex(font, ucs2_text, length); //(hack to share local buffer between intraFontPrint and intraFontMeasure)
 	}
 
-	// Free temporary buffer if allocated
-	if (ucs2_text != buffer)
-		free(ucs2_text);
-
 	return x;
 }
 
@@ -1237,6 +1586,11 @@ float intraFontPrintColumnUCS2Ex(intraFont *font, float x, float y, float column
 	if (!text || length <= 0 || !font)
 		return x;
 
+#ifdef _OSLIB_H_
+	//the sprites OSLib has batched so far are drawn before the text
+	oslFlushSpriteBatch();
+#endif
+
 	//for scrolling: if text contains '\n', replace with spaces and call intraFontColumnUCS2Ex again
 	int i;
 	if (font->options & INTRAFONT_SCROLL_LEFT)
@@ -1244,15 +1598,13 @@ float intraFontPrintColumnUCS2Ex(intraFont *font, float x, float y, float column
 		for (i = 0; i < length; i++)
 		{
 			if (text[i] == '\n')
-			{
-				cccUCS2 *ucs2_text = (cccUCS2 *)malloc(length * sizeof(cccUCS2));
+			{ //(text is not the print memory: intraFontPrintColumnEx already replaced its '\n')
+				cccUCS2 *ucs2_text = (cccUCS2 *)intraFontPrintMemory(font, (void **)&font->text, &font->textSize, length * sizeof(cccUCS2));
 				if (!ucs2_text)
 					return x;
 				for (i = 0; i < length; i++)
 					ucs2_text[i] = (text[i] == '\n') ? ' ' : text[i];
-				x = intraFontPrintColumnUCS2Ex(font, x, y, column, ucs2_text, length);
-				free(ucs2_text);
-				return x;
+				return intraFontPrintColumnUCS2Ex(font, x, y, column, ucs2_text, length);
 			}
 		}
 	}
@@ -1273,84 +1625,62 @@ float intraFontPrintColumnUCS2Ex(intraFont *font, float x, float y, float column
 	} fontVertex;
 	fontVertex *v, *v0, *v1, *v2, *v3, *v4, *v5, *s0, *s1, *s2, *s3, *s4, *s5;
 
-	//count number of glyphs to draw and cache BMPs
-	int j, n_glyphs, last_n_glyphs, n_sglyphs, changed, count = 0;
+	//count number of glyphs to draw and cache BMPs (pinned in the cache until the next print)
+	int j, n_glyphs = 0, last_n_glyphs = 0, n_sglyphs = 0, state = 0, count = 0;
 	unsigned short char_id, subucs2, glyph_id, glyph_ptr, shadowGlyph_ptr;
-	do
+	intraFontCacheBegin(font);
+	for (i = 0; i < length && !(state & GLYPH_MISSING); i++)
 	{
-		changed = 0;
-		n_glyphs = 0;
-		n_sglyphs = 0;
-		last_n_glyphs = 0;
-		for (i = 0; i < length; i++)
-		{
 
-			char_id = intraFontGetID(font, text[i]); //char
-			if (char_id < font->n_chars)
-			{
-				if (font->fileType == FILETYPE_PGF)
-				{ //PGF-file
-					if ((font->glyph[char_id].flags & PGF_BMP_OVERLAY) == PGF_BMP_OVERLAY)
-					{ //overlay glyph?
-						for (j = 0; j < 3; j++)
+		char_id = intraFontGetID(font, text[i]); //char
+		if (char_id < font->n_chars)
+		{
+			if (font->fileType == FILETYPE_PGF)
+			{ //PGF-file
+				if ((font->glyph[char_id].flags & PGF_BMP_OVERLAY) == PGF_BMP_OVERLAY)
+				{ //overlay glyph?
+					for (j = 0; j < 3; j++)
+					{
+						subucs2 = font->fontdata[(font->glyph[char_id].ptr) + j * 2] + font->fontdata[(font->glyph[char_id].ptr) + j * 2 + 1] * 256;
+						if (subucs2)
 						{
-							subucs2 = font->fontdata[(font->glyph[char_id].ptr) + j * 2] + font->fontdata[(font->glyph[char_id].ptr) + j * 2 + 1] * 256;
-							if (subucs2)
+							glyph_id = intraFontGetID(font, subucs2);
+							if (glyph_id < font->n_chars)
 							{
-								glyph_id = intraFontGetID(font, subucs2);
-								if (glyph_id < font->n_chars)
-								{
-									n_glyphs++;
-									if (!(font->glyph[glyph_id].flags & PGF_CACHED))
-									{
-										if (intraFontGetBMP(font, glyph_id, PGF_CHARGLYPH))
-											changed = 1;
-									}
-								}
+								n_glyphs++;
+								state |= intraFontUseGlyph(font, glyph_id, PGF_CHARGLYPH);
 							}
 						}
 					}
-					else
-					{
-						n_glyphs++;
-						if (!(font->glyph[char_id].flags & PGF_CACHED))
-						{
-							if (intraFontGetBMP(font, char_id, PGF_CHARGLYPH))
-								changed = 1;
-						}
-					}
-
-					if (n_glyphs > last_n_glyphs)
-					{
-						n_sglyphs++; //shadow
-						if (!(font->shadowGlyph[font->glyph[char_id].shadowID].flags & PGF_CACHED))
-						{
-							if (intraFontGetBMP(font, font->glyph[char_id].shadowID, PGF_SHADOWGLYPH))
-								changed = 1;
-						}
-						last_n_glyphs = n_glyphs;
-					}
 				}
 				else
-				{ //BWFON-file
+				{
 					n_glyphs++;
-					if (!(font->glyphBW[char_id].flags & PGF_CACHED))
-					{
-						if (intraFontGetBMP(font, char_id, PGF_CHARGLYPH))
-							changed = 1;
-					}
+					state |= intraFontUseGlyph(font, char_id, PGF_CHARGLYPH);
+				}
+
+				if (n_glyphs > last_n_glyphs)
+				{
 					n_sglyphs++; //shadow
-					if (!(font->shadowGlyph[0].flags & PGF_CACHED))
-					{
-						if (intraFontGetBMP(font, font->glyph[0].shadowID, PGF_SHADOWGLYPH))
-							changed = 1;
-					}
+					state |= intraFontUseGlyph(font, font->glyph[char_id].shadowID, PGF_SHADOWGLYPH);
+					last_n_glyphs = n_glyphs;
 				}
 			}
+			else
+			{ //BWFON-file
+				n_glyphs++;
+				state |= intraFontUseGlyph(font, char_id, PGF_CHARGLYPH);
+				n_sglyphs++; //shadow
+				state |= intraFontUseGlyph(font, font->glyph[0].shadowID, PGF_SHADOWGLYPH);
+			}
 		}
-		count++;
-	} while (changed && count <= length);
-	if (changed)
+	}
+	if (state & GLYPH_DECODED)
+	{ //new glyphs: write the texture back and drop the GE's texture cache
+		sceKernelDcacheWritebackAll();
+		sceGuTexFlush();
+	}
+	if (state & GLYPH_MISSING)
 		return x; //not all chars fit into texture -> abort (better solution: split up string and call intraFontPrintUCS2 twice)
 
 	//reserve memory in displaylist (switch between GU_TRIANGLES and GU_SPRITES)
@@ -1783,6 +2113,13 @@ float intraFontPrintColumnUCS2Ex(intraFont *font, float x, float y, float column
 		sceGuDrawArray((font->isRotated ? GU_TRIANGLES : GU_SPRITES), GU_TEXTURE_32BITF | GU_COLOR_8888 | GU_VERTEX_32BITF | GU_TRANSFORM_2D, n_glyphs * (font->isRotated ? 6 : 2), 0, v + (n_sglyphs * (font->isRotated ? 6 : 2)));
 	sceGuEnable(GU_DEPTH_TEST);
 
+#ifdef _OSLIB_H_
+	//OSLib sends its states, texture and palette again, they were changed behind its back
+	oslInvalidateGeState();
+	osl_curTexture = NULL;
+	osl_curPalette = NULL;
+#endif
+
 	if (scroll == 1)
 	{
 		sceGuScissor(0, 0, 480, 272); //reset window to whole screen (test was previously enabled)
@@ -1818,15 +2155,13 @@ float intraFontPrintColumnUCS2Ex(intraFont *font, float x, float y, float column
 		for (i = 0; i < length; i++)
 		{
 			if (text[i] == '\n')
-			{
-				cccUCS2 *ucs2_text = (cccUCS2 *)malloc(length * sizeof(cccUCS2));
+			{ //(text is not the print memory: intraFontPrintColumnEx already replaced its '\n')
+				cccUCS2 *ucs2_text = (cccUCS2 *)intraFontPrintMemory(font, (void **)&font->text, &font->textSize, length * sizeof(cccUCS2));
 				if (!ucs2_text)
 					return x;
 				for (i = 0; i < length; i++)
 					ucs2_text[i] = (text[i] == '\n') ? ' ' : text[i];
-				x = intraFontPrintColumnUCS2Ex(font, x, y, column, ucs2_text, length);
-				free(ucs2_text);
-				return x;
+				return intraFontPrintColumnUCS2Ex(font, x, y, column, ucs2_text, length);
 			}
 		}
 	}
@@ -1847,102 +2182,66 @@ float intraFontPrintColumnUCS2Ex(intraFont *font, float x, float y, float column
 	fontVertex *v0, *v1, *v2, *v3, *v4, *v5;
 	fontVertex *s0, *s1, *s2, *s3, *s4, *s5;
 
-	//count number of glyphs to draw and cache BMPs
-	int j, n_glyphs, last_n_glyphs, n_sglyphs, changed, count = 0;
+	//count number of glyphs to draw and cache BMPs (pinned in the cache until the next print)
+	int j, n_glyphs = 0, last_n_glyphs = 0, n_sglyphs = 0, state = 0, count = 0;
 	unsigned short char_id, subucs2, glyph_id, glyph_ptr, shadowGlyph_ptr;
-
-	do
+	intraFontCacheBegin(font);
+	for (i = 0; i < length && !(state & GLYPH_MISSING); i++)
 	{
-		changed = 0;
-		n_glyphs = 0;
-		n_sglyphs = 0;
-		last_n_glyphs = 0;
-		for (i = 0; i < length; i++)
+		char_id = intraFontGetID(font, text[i]); //char
+		if (char_id < font->n_chars)
 		{
-			char_id = intraFontGetID(font, text[i]); //char
-			if (char_id < font->n_chars)
-			{
-				if (font->fileType == FILETYPE_PGF)
-				{ //PGF-file
-					if ((font->glyph[char_id].flags & PGF_BMP_OVERLAY) == PGF_BMP_OVERLAY)
-					{ //overlay glyph?
-						for (j = 0; j < 3; j++)
+			if (font->fileType == FILETYPE_PGF)
+			{ //PGF-file
+				if ((font->glyph[char_id].flags & PGF_BMP_OVERLAY) == PGF_BMP_OVERLAY)
+				{ //overlay glyph?
+					for (j = 0; j < 3; j++)
+					{
+						subucs2 = font->fontdata[(font->glyph[char_id].ptr) + j * 2] + font->fontdata[(font->glyph[char_id].ptr) + j * 2 + 1] * 256;
+						if (subucs2)
 						{
-							subucs2 = font->fontdata[(font->glyph[char_id].ptr) + j * 2] + font->fontdata[(font->glyph[char_id].ptr) + j * 2 + 1] * 256;
-							if (subucs2)
+							glyph_id = intraFontGetID(font, subucs2);
+							if (glyph_id < font->n_chars)
 							{
-								glyph_id = intraFontGetID(font, subucs2);
-								if (glyph_id < font->n_chars)
-								{
-									n_glyphs++;
-									if (!(font->glyph[glyph_id].flags & PGF_CACHED))
-									{
-										if (intraFontGetBMP(font, glyph_id, PGF_CHARGLYPH))
-											changed = 1;
-									}
-								}
+								n_glyphs++;
+								state |= intraFontUseGlyph(font, glyph_id, PGF_CHARGLYPH);
 							}
 						}
 					}
-					else
-					{
-						n_glyphs++;
-						if (!(font->glyph[char_id].flags & PGF_CACHED))
-						{
-							if (intraFontGetBMP(font, char_id, PGF_CHARGLYPH))
-								changed = 1;
-						}
-					}
-
-					if (n_glyphs > last_n_glyphs)
-					{
-						/* Only add shadows if they exist */
-						n_sglyphs+= !!font->n_shadows; //shadow
-						if (!(font->shadowGlyph[font->glyph[char_id].shadowID].flags & PGF_CACHED))
-						{
-							if (intraFontGetBMP(font, font->glyph[char_id].shadowID, PGF_SHADOWGLYPH))
-								changed = 1;
-						}
-						last_n_glyphs = n_glyphs;
-					}
 				}
 				else
-				{ //BWFON-file
+				{
 					n_glyphs++;
-					if (!(font->glyphBW[char_id].flags & PGF_CACHED))
-					{
-						if (intraFontGetBMP(font, char_id, PGF_CHARGLYPH))
-							changed = 1;
-					}
+					state |= intraFontUseGlyph(font, char_id, PGF_CHARGLYPH);
+				}
+
+				if (n_glyphs > last_n_glyphs)
+				{
 					/* Only add shadows if they exist */
 					n_sglyphs+= !!font->n_shadows; //shadow
-					if (!(font->shadowGlyph[0].flags & PGF_CACHED))
-					{
-						if (intraFontGetBMP(font, font->glyph[0].shadowID, PGF_SHADOWGLYPH))
-							changed = 1;
-					}
+					state |= intraFontUseGlyph(font, font->glyph[char_id].shadowID, PGF_SHADOWGLYPH);
+					last_n_glyphs = n_glyphs;
 				}
 			}
+			else
+			{ //BWFON-file
+				n_glyphs++;
+				state |= intraFontUseGlyph(font, char_id, PGF_CHARGLYPH);
+				/* Only add shadows if they exist */
+				n_sglyphs+= !!font->n_shadows; //shadow
+				state |= intraFontUseGlyph(font, font->glyph[0].shadowID, PGF_SHADOWGLYPH);
+			}
 		}
-		if(changed){
-			font->options |= INTRAFONT_DIRTY;
-			//printf("CharID: %d UCS2: %d\n", char_id, text[i]);
-		}
-		count++;
-	} while (changed && count <= length);
-	if (changed)
+	}
+	if (state & GLYPH_DECODED)
+		font->options |= INTRAFONT_DIRTY;
+	if (state & GLYPH_MISSING)
 		return x; //not all chars fit into texture -> abort (better solution: split up string and call intraFontPrintUCS2 twice)
 
-	//reserve memory in displaylist (switch between GU_TRIANGLES and GU_SPRITES)
-	if((VERTEX_PER_QUAD * (n_glyphs + n_sglyphs) * sizeof(fontVertex)) > font->v_size){
-		if(font->v){
-			free(font->v);
-		}
-		font->v = (struct fontVertex*)malloc(VERTEX_PER_QUAD * (n_glyphs + n_sglyphs) * sizeof(fontVertex));
-		font->v_size = VERTEX_PER_QUAD * (n_glyphs + n_sglyphs) * sizeof(fontVertex);
-		printf("%s font->v size =\t %d\n", font->filename, font->v_size);
-	} 
-	v_buffer = font->v;
+	//vertices go in the print memory of the font
+	v_buffer = (fontVertex *)intraFontPrintMemory(font, (void **)&font->v, &font->v_size, VERTEX_PER_QUAD * (n_glyphs + n_sglyphs) * sizeof(fontVertex));
+	if (!v_buffer && (n_glyphs + n_sglyphs))
+		return x;
 	memset(v_buffer, 0, VERTEX_PER_QUAD * (n_glyphs + n_sglyphs) * sizeof(fontVertex));
 
 
@@ -2407,6 +2706,33 @@ float intraFontMeasureText(intraFont *font, const char *text)
 
 float intraFontMeasureTextEx(intraFont *font, const char *text, int length)
 {
+	if (!text || length <= 0 || !font)
+		return 0.0f;
+
+	//ASCII chars are their own UCS-2 code in UTF-8 and the single byte codepages: measure ASCII text without converting it
+	unsigned char cp = font->options / 0x00010000;
+	if (cp == CCC_CPUTF8 || (cp < CCC_N_CP && cp != CCC_CP932 && cp != CCC_CP936 && cp != CCC_CP949 && cp != CCC_CP950))
+	{
+		const unsigned char *ascii = (const unsigned char *)text;
+		float x = 0.0f;
+		int i;
+		for (i = 0; i < length && ascii[i] && ascii[i] < 0x80; i++)
+		{
+			if (ascii[i] == '\n')
+			{
+				if (!(font->options & INTRAFONT_SCROLL_LEFT))
+					break; //measure until the first newline char
+				x += intraFontCharWidth(font, ' '); //scrolling text shows newlines as spaces
+			}
+			else
+			{
+				x += intraFontCharWidth(font, ascii[i]);
+			}
+		}
+		if (i == length || !ascii[i] || ascii[i] == '\n')
+			return x;
+	}
+
 	return intraFontPrintColumnEx(font, 0.f, 0.f, -1.0f, text, length); //explanation: intraFontPrintColumnEx does the String -> UCS2 conversation,
 																		//but a negative column width triggers measurement without drawing
 }
@@ -2426,17 +2752,20 @@ float intraFontMeasureTextUCS2Ex(intraFont *font, const cccUCS2 *text, int lengt
 
 	for (i = 0; (i < length) && (text[i] != '\n'); i++)
 	{ //measure until end of string or first newline char
-		unsigned short char_id = intraFontGetID(font, text[i]);
-		if (char_id < font->n_chars)
-		{
-			unsigned short glyph_ptr = (font->fileType == FILETYPE_PGF) ? char_id : 0; //for fields not covered in GlyphBW (advance,...)
-			x += (font->options & INTRAFONT_WIDTH_FIX) ? (font->options & PGF_WIDTH_MASK) * font->size : (font->glyph[glyph_ptr].advance) * font->size * 0.25f;
-		}
-		else
-		{
-			x += intraFontMeasureTextUCS2Ex(font->altFont, text + i, 1); //try alternative font if char does not exist in current font
-		}
+		x += intraFontCharWidth(font, text[i]);
 	}
 
 	return x;
 }
+
+void intraFontGetCharWidths(intraFont *font, unsigned short first, int count, float *widths)
+{
+	int i;
+	if (!widths)
+		return;
+	for (i = 0; i < count; i++)
+	{
+		cccUCS2 ucs = first + i;
+		widths[i] = (font && ucs && ucs != '\n') ? intraFontCharWidth(font, ucs) : 0.0f;
+	}
+}
@@ -104,6 +104,59 @@ typedef struct {
   unsigned char flags;
 } GlyphBW;
 
+/**
+ * A cell of the glyph cache texture
+ *
+ * @note This is used internally by ::intraFont and has no other relevance.
+ */
+typedef struct {
+  unsigned long lastUse;    //print that last used the glyph (first cell of a glyph only)
+  unsigned long frame;      //frame of that print (first cell of a glyph only)
+  unsigned short id;        //glyph id (first cell of a glyph only)
+  unsigned short head;      //first cell of the glyph covering this cell
+  unsigned char type;       //PGF_CHARGLYPH or PGF_SHADOWGLYPH, 0 if the cell is free
+  unsigned char span;       //cells covered by the glyph (first cell of a glyph only)
+} GlyphCell;
+
+/**
+ * Glyph cache counters, see intraFontGetCacheStats()
+ */
+typedef struct {
+  unsigned long hits;           /**< Glyphs found in the cache texture */
+  unsigned long misses;         /**< Glyphs not in the cache texture (decoded, or failures) */
+  unsigned long evictions;      /**< Glyphs removed from the cache texture to make room */
+  unsigned long overwrites;     /**< Evicted glyphs that had been drawn in the current frame (the GPU may show the new glyph instead) */
+  unsigned long failures;       /**< Prints not drawn because a glyph found no room */
+  unsigned long cells;          /**< Cells in the cache texture */
+  unsigned long peakFrameCells; /**< Most cells used by the glyphs drawn in one frame */
+} intraFontCacheStats;
+
+/**
+ * Print memory counters, see intraFontGetPrintStats()
+ */
+typedef struct {
+  unsigned long textBytes;      /**< Memory kept for the text converted to UCS-2 (high-water mark: the longest text printed so far) */
+  unsigned long vertexBytes;    /**< Memory kept for the vertices (high-water mark: the largest print so far; always 0 on PSP) */
+  unsigned long allocations;    /**< Times that memory had to grow (stops changing once the longest text has been printed) */
+} intraFontPrintStats;
+
+/**
+ * The glyph cache: the texture is cut into rows of cells, a glyph uses consecutive cells of a row
+ *
+ * @note This is used internally by ::intraFont and has no other relevance.
+ */
+typedef struct {
+  GlyphCell* cells;
+  unsigned short cols;      //cells per row
+  unsigned short rows;
+  unsigned char cellWidth;  //in pixels
+  unsigned short cellHeight; //in pixels
+  unsigned long clock;      //number of prints, glyphs used by the current print are never evicted
+  unsigned long frame;      //frame counted in frameCells
+  unsigned long frameCells; //cells used by the glyphs of that frame
+  intraFontCacheStats stats;
+} GlyphCache;
+
 /**
  * A PGF_Header struct
  *
@@ -113,12 +166,12 @@ typedef struct {
   unsigned short header_start;
   unsigned short header_len;
   char pgf_id[4];
-  unsigned long revision;
-  unsigned long version;
-  unsigned long charmap_len;
-  unsigned long charptr_len;
-  unsigned long charmap_bpe;
-  unsigned long charptr_bpe;
+  unsigned int revision;
+  unsigned int version;
+  unsigned int charmap_len;
+  unsigned int charptr_len;
+  unsigned int charmap_bpe;
+  unsigned int charptr_bpe;
   unsigned char junk00[21];
   unsigned char family[64];
   unsigned char style[64];
@@ -126,17 +179,17 @@ typedef struct {
   unsigned short charmap_min;
   unsigned short charmap_max;
   unsigned char junk02[50];
-  unsigned long fixedsize[2];
+  unsigned int fixedsize[2];
   unsigned char junk03[14];
   unsigned char table1_len;
   unsigned char table2_len;
   unsigned char table3_len;
   unsigned char advance_len;
   unsigned char junk04[102];
-  unsigned long shadowmap_len;
-  unsigned long shadowmap_bpe;
+  unsigned int shadowmap_len;
+  unsigned int shadowmap_bpe;
   unsigned char junk05[4];
-  unsigned long shadowscale[2];
+  unsigned int shadowscale[2];
   //currently no need ;
 } PGF_Header;
 
@@ -148,7 +201,9 @@ typedef struct fontVertex fontVertex;
  */
 typedef struct intraFont {
   char* filename;
-  unsigned char* fontdata;
+  unsigned char* fontdata;         /**< Glyph data (inside a memory file, or inside datablock) */
+  void* datablock;                 /**< Allocation holding fontdata (NULL if fontdata is in a memory file) */
+  void* file;                      /**< Open file the bwfon glyphs are read from (NULL if they are in fontdata) */
   
   unsigned char* texture;          /**< The bitmap data */
   unsigned int textureID;          /**< OpenGL texture id */
@@ -157,12 +212,18 @@ typedef struct intraFont {
 
   unsigned short* charmap_compr;   /**< Compression info on compressed charmap */  
   unsigned short* charmap;         /**< Character map */  
+  unsigned short** idmap;          /**< Glyph id of each ucs, in 256 pages of 256 (built at load) */
+  signed char latinAdvance[256];   /**< Advance of U+0000 to U+00FF in quarterpixels (-128 if not in the font, built at load) */
   Glyph* glyph;                    /**< Character glyphs */
   GlyphBW* glyphBW;
   Glyph* shadowGlyph;              /**<  Shadow glyph(s) */
+  GlyphCache* cache;               /**< On-demand glyph cache (NULL if all glyphs are precached) */
   struct intraFont* altFont;
-  fontVertex *v;
-  unsigned int v_size;
+  cccUCS2* text;                   /**< Text of the prints converted to UCS-2 (reused, grows to the longest text) */
+  unsigned long textSize;          /**< Bytes allocated for text */
+  fontVertex* v;                   /**< Vertices of the prints (reused, grows to the largest print; unused on PSP where they go in the display list) */
+  unsigned long v_size;            /**< Bytes allocated for v */
+  unsigned long allocations;       /**< Times text or v had to grow */
   
   float size;
   unsigned int color;
@@ -200,6 +261,8 @@ void intraFontShutdown(void);
 
 /**
  * Load a pgf font.
+ * With OSLib, the font is opened as a virtual file. The data of a memory file is used in place and must stay
+ * valid until the font is unloaded; bwfon fonts loaded from other sources read their glyphs when they are cached.
  *
  * @param filename - Path to the font
  *
@@ -258,6 +321,45 @@ void intraFontSetEncoding(intraFont *font, unsigned int options);
  */
 void intraFontSetAltFont(intraFont *font, intraFont *altFont);
 
+/**
+ * Start a new frame for the glyph caches.
+ * Glyphs drawn during a frame are kept in the cache texture while other glyphs can be evicted, since the GPU
+ * may not have drawn them yet. Call it once the GPU is done with the previous frame (OSLib does it when drawing ends).
+ * Until it is called, glyphs are only pinned during the print that uses them.
+ *
+ * @param frame - A number that changes every frame (not 0)
+ */
+void intraFontSetCacheFrame(unsigned long frame);
+
+/**
+ * Get the glyph cache counters of a font, to choose the size of the cache texture (INTRAFONT_CACHE_MED or _LARGE).
+ * If peakFrameCells comes close to cells or overwrites is not 0, the texture is too small for the text drawn in a frame.
+ *
+ * @param font - A valid ::intraFont
+ *
+ * @param stats - Receives the counters (all 0 if the font is precached)
+ *
+ * @returns 1 if the font uses an on-demand glyph cache, 0 otherwise
+ */
+int intraFontGetCacheStats(intraFont *font, intraFontCacheStats *stats);
+
+/**
+ * Reset the glyph cache counters of a font (the cached glyphs are kept).
+ *
+ * @param font - A valid ::intraFont
+ */
+void intraFontResetCacheStats(intraFont *font);
+
+/**
+ * Get the print memory counters of a font. Prints reuse the same memory, so a frame of text does no heap
+ * allocation once the longest text has been printed.
+ *
+ * @param font - A valid ::intraFont
+ *
+ * @param stats - Receives the counters (all 0 if font is NULL)
+ */
+void intraFontGetPrintStats(intraFont *font, intraFontPrintStats *stats);
+
 /**
  * Draw UCS-2 encoded text along the baseline starting at x, y.
  *
@@ -353,6 +455,20 @@ float intraFontMeasureTextEx(intraFont *font, const char *text, int length);
 float intraFontMeasureTextUCS2  (intraFont *font, const unsigned short *text); 
 float intraFontMeasureTextUCS2Ex(intraFont *font, const unsigned short *text, int length); 
 
+/**
+ * Get the widths of consecutive UCS-2 chars, as intraFontMeasureTextUCS2 would measure each of them alone
+ * (from the advance table, without building or converting strings)
+ *
+ * @param font - A valid ::intraFont
+ *
+ * @param first - UCS-2 code of the first char
+ *
+ * @param count - Number of chars
+ *
+ * @param widths - Receives count widths (0 for '\0', '\n' and chars missing from the font and its alternative fonts)
+ */
+void intraFontGetCharWidths(intraFont *font, unsigned short first, int count, float *widths);
+
 /** @} */
 
 #ifdef __cplusplus
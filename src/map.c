@@ -132,7 +132,7 @@ void oslDrawMap(OSL_MAP *m) {
 			}
 
 			if (nbVertices > 0)
-				sceGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, nbVertices, 0, vertices);
+				oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, nbVertices, 0, vertices);
 
 			mY++;
 			if (mY >= m->mapSizeY)
@@ -201,7 +201,7 @@ void oslDrawMap(OSL_MAP *m) {
 			}
 
 			if (nbVertices > 0)
-				sceGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, nbVertices, 0, vertices);
+				oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, nbVertices, 0, vertices);
 
 			mY++;
 			if (mY >= m->mapSizeY)
@@ -143,6 +143,15 @@ unsigned int oslMessageBox(const char *text, const char *title, unsigned int fla
 	oslSetFont(ft);
 	oslSetDithering(dither);
 
+#ifndef PSP
+	// Nobody can answer on the headless host: print the message and take the first button
+	Debug("%s\n%s\n", title, text);
+	if (nbButtons && buttons[0].option == OSL_MB_QUIT)
+		oslQuit();
+	oslSetDrawBuffer(curBuf);
+	return nbButtons ? buttons[0].option : 0;
+#endif
+
 	// Event loop
 	while (!osl_quit)
 	{
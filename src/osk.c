@@ -158,6 +158,7 @@ void oslDrawOsk()
 	case PSP_UTILITY_DIALOG_VISIBLE:
 		sceDisplayWaitVblankStart();
 		sceDisplayWaitVblankStart();
+		oslFlushSpriteBatch();
 		sceGuFinish();
 		sceGuSync(0, 0);
 		sceUtilityOskUpdate(2);
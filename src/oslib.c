@@ -227,8 +227,6 @@ void oslVblankInterrupt(int sub, void *parg) {
 int osl_maxFrameskip = 0, osl_vsyncEnabled = 0, osl_frameskip = 0;
 
 void oslInit(int flags) {
-	void *arg = 0;
-
 	osl_keys = &osl_pad;
 	osl_remotekeys = &osl_remote;
 
@@ -250,7 +248,7 @@ void oslInit(int flags) {
 	}
 
 	if (!(flags & OSL_IF_NOVBLANKIRQ)) {
-		sceKernelRegisterSubIntrHandler(PSP_VBLANK_INT, osl_vblInterruptNumber, oslVblankInterrupt, arg);
+		sceKernelRegisterSubIntrHandler(PSP_VBLANK_INT, osl_vblInterruptNumber, oslVblankInterrupt, NULL);
 		sceKernelEnableSubIntr(PSP_VBLANK_INT, osl_vblInterruptNumber);
 	}
 #endif
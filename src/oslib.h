@@ -25,6 +25,7 @@
 #include <malloc.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <time.h>
 #ifdef PSP
@@ -421,7 +422,11 @@ extern void oslFasterMemset(u64 *dst, u64 *src, u32 length);
  *
  * @return Uncached pointer.
  */
+#ifdef PSP
 #define oslGetUncachedPtr(adr) ((void*)((int)(adr) | 0x40000000))
+#else
+#define oslGetUncachedPtr(adr) ((void*)(adr))
+#endif
 
 /** @brief Returns a pointer to cached data.
  *
@@ -431,7 +436,11 @@ extern void oslFasterMemset(u64 *dst, u64 *src, u32 length);
  *
  * @return Cached pointer.
  */
+#ifdef PSP
 #define oslGetCachedPtr(adr) ((void*)((int)(adr) & (~0x40000000)))
+#else
+#define oslGetCachedPtr(adr) ((void*)(adr))
+#endif
 
 #ifdef PSP
 /** @brief Flushes the whole cache.
@@ -869,8 +878,10 @@ extern u8 *OSL_UVRAM_BASE;
  *
  * @param size The size of the memory block to allocate.
  */
+#ifndef alloca
 #define alloca _alloca
 #endif
+#endif
 
 /**
  * @brief Size of the UVRAM (Uncached Video RAM) in bytes.
@@ -888,7 +899,7 @@ extern u8 *OSL_UVRAM_BASE;
  * of the UVRAM to its base address. It is useful for determining the bounds of the video
  * memory area when performing operations that involve the entire UVRAM.
  */
-#define OSL_UVRAM_END ((u8*)((u32)OSL_UVRAM_BASE + OSL_UVRAM_SIZE))
+#define OSL_UVRAM_END (OSL_UVRAM_BASE + OSL_UVRAM_SIZE)
 
 /** @} */ // end of main_misc
 
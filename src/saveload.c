@@ -395,6 +395,7 @@ void oslDrawSaveLoad(){
 	switch(sceUtilitySavedataGetStatus()) {
 	case PSP_UTILITY_DIALOG_INIT:
 	case PSP_UTILITY_DIALOG_VISIBLE:
+		oslFlushSpriteBatch();
 		sceGuFinish();
 		sceGuSync(0,0);
 		sceUtilitySavedataUpdate(1);
@@ -25,297 +25,167 @@ static int _getOffset(OSL_SFONT *sfont, unsigned char ch)
 	return (offset >= sfont->lettersCount) ? -1 : offset;
 }
 
-// Get the next power of 2 for a given width
-static u16 _getNextPower2(u16 width)
-{
-	u16 power = 1;
-
-	// Find the next power of 2 greater than or equal to the width
-	while (power < width)
-	{
-		power *= 2;
-	}
-
-	// Ensure the minimum power of 2 is 16
-	return (power < 16) ? 16 : power;
-}
-
 static void user_warning_fn(png_structp png_ptr, png_const_charp warning_msg) {
 }
 
-// Struct to hold PNG image data
-typedef struct
-{
-	u32 *rawdata;     // Pointer to the raw pixel data
-	u16 sizeX;        // Actual width of the image
-	u16 sizeY;        // Actual height of the image
-	u16 textureSizeX; // Width adjusted to the next power of 2
-	u16 textureSizeY; // Height adjusted to the next power of 2
-} PNG_DATA;
-
-// Load a PNG image (OSLib cannot handle images bigger than 512x512)
-static PNG_DATA* _loadFromPNG(const char *filename) {
-	// Allocate memory for PNG_DATA structure
-	PNG_DATA *pngData = (PNG_DATA*)malloc(sizeof(PNG_DATA));
-	if (!pngData)
-		return NULL;
-
-	// Declare necessary variables
+// Reads the PNG from the virtual file (oslLoadImageFilePNG.c)
+void oslPngReadFn(png_structp png_ptr, png_bytep data, png_size_t length);
+
+///////////////////////////////////////////////////////////////////////////////
+// Public functions
+///////////////////////////////////////////////////////////////////////////////
+OSL_SFONT *oslLoadSFontFile(char *filename, int pixelFormat) {
+	OSL_SFONT *sfont = NULL;
+	VIRTUAL_FILE *f;
 	png_structp png_ptr = NULL;
 	png_infop info_ptr = NULL;
-	FILE *fp = NULL;
-	VIRTUAL_FILE *f = NULL;
-	u8 **rows = NULL;
-	unsigned int sig_read = 0;
-	int bit_depth, color_type, interlace_type;
-	png_uint_32 pw, ph;
-	int passes;
-
-	// Open virtual file
-	f = VirtualFileOpen((void*)filename, 0, VF_AUTO, VF_O_READ);
-	if (!f) {
-		free(pngData);
-		return NULL;
-	}
+	u16 positions[256];
+	int passes, pass, x, y, i;
+	// Decoding buffers, kept out of the setjmp frame
+	u8 * volatile rows = NULL;
+	OSL_SFONT * volatile newFont = NULL;
 
-	// Read file into memory
-	int input_size = 0;
-	const unsigned char *input = (const unsigned char*)oslReadEntireFileToMemory(f, &input_size);
-	const unsigned char *input_free = input;
-	VirtualFileClose(f);
-
-	// Open file in memory
-	fp = fmemopen((void *)input, input_size, "rb");
-	if (!fp) {
-		free((void*)input_free);
-		free(pngData);
-		return NULL;
-	}
+	f = VirtualFileOpen((void*)filename, 0, VF_AUTO, VF_O_READ);
+	if (!f) goto error;
 
-	// Initialize PNG read struct
 	png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, user_warning_fn);
-	if (!png_ptr) {
-		fclose(fp);
-		free((void*)input_free);
-		free(pngData);
-		return NULL;
-	}
+	if (!png_ptr) goto error;
 
-	// Initialize PNG info struct
 	info_ptr = png_create_info_struct(png_ptr);
 	if (!info_ptr) {
 		png_destroy_read_struct(&png_ptr, NULL, NULL);
-		fclose(fp);
-		free((void*)input_free);
-		free(pngData);
-		return NULL;
+		goto error;
 	}
 
-	// Setup error handling for PNG reading
 	if (setjmp(png_jmpbuf(png_ptr))) {
 		png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-		fclose(fp);
-		free((void*)input_free);
-		free(pngData);
-		return NULL;
+		free(rows);
+		oslDeleteSFont(newFont);
+		goto error;
 	}
 
-	// Read the PNG header information
-	png_init_io(png_ptr, fp);
-	png_set_sig_bytes(png_ptr, sig_read);
+	png_set_read_fn(png_ptr, f, oslPngReadFn);
 	png_read_info(png_ptr, info_ptr);
-	png_get_IHDR(png_ptr, info_ptr, &pw, &ph, &bit_depth, &color_type, &interlace_type, NULL, NULL);
 
-	// Set size and texture dimensions
-	pngData->sizeX = (u16)pw;
-	pngData->sizeY = (u16)ph;
-	pngData->textureSizeX = _getNextPower2(pngData->sizeX);
-	pngData->textureSizeY = _getNextPower2(pngData->sizeY);
+	png_uint_32 width = png_get_image_width(png_ptr, info_ptr);
+	png_uint_32 height = png_get_image_height(png_ptr, info_ptr);
+	size_t rowBytes = width * sizeof(u32);
 
-	// Set various PNG transformations
+	// Everything is decoded as RGBA, which is OSL_PF_8888 in memory
 	png_set_strip_16(png_ptr);
 	png_set_packing(png_ptr);
-
-	if (color_type == PNG_COLOR_TYPE_PALETTE)
-		png_set_palette_to_rgb(png_ptr);
-
-	if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
-		png_set_expand_gray_1_2_4_to_8(png_ptr);
-
-	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
-		png_set_tRNS_to_alpha(png_ptr);
-
-	if (interlace_type == PNG_INTERLACE_ADAM7) {
-		passes = png_set_interlace_handling(png_ptr);
-		png_read_update_info(png_ptr, info_ptr);
+	png_set_expand(png_ptr);
+	png_set_gray_to_rgb(png_ptr);
+	png_set_filler(png_ptr, 0xff, PNG_FILLER_AFTER);
+	passes = png_set_interlace_handling(png_ptr);
+	png_read_update_info(png_ptr, info_ptr);
+
+	if (height < 2)
+		png_error(png_ptr, "no letters");
+
+	if (passes > 1) {
+		// Interlaced images need all their rows until the last pass
+		rows = (u8*)malloc(height * rowBytes);
+		if (!rows) png_error(png_ptr, "out of memory");
+		for (pass = 0; pass < passes; pass++) {
+			for (y = 0; y < (int)height; y++)
+				png_read_row(png_ptr, rows + y * rowBytes, NULL);
+		}
 	} else {
-		passes = 1;
-	}
-
-	// Allocate memory for raw image data
-	pngData->rawdata = (u32*)memalign(16, pngData->textureSizeX * pngData->textureSizeY * sizeof(u32));
-	if (!pngData->rawdata) {
-		png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-		fclose(fp);
-		free((void*)input_free);
-		free(pngData);
-		return NULL;
-	}
-
-	// Allocate memory for row pointers
-	rows = (u8**)malloc(pngData->sizeY * sizeof(u8*));
-	if (!rows) {
-		png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-		fclose(fp);
-		free((void*)input_free);
-		free(pngData->rawdata);
-		free(pngData);
-		return NULL;
-	}
-
-	// Set row pointers for reading PNG data
-	for (int y = 0; y < pngData->sizeY; ++y) {
-		rows[y] = (u8*)(pngData->rawdata + y * pngData->textureSizeX);
-	}
-
-	// Read the PNG image data row by row
-	for (int pass = 0; pass < passes; ++pass) {
-		png_read_rows(png_ptr, rows, NULL, pngData->sizeY);
-	}
-
-	// Cleanup
-	free(rows);
-	png_read_end(png_ptr, info_ptr);
-	png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-	fclose(fp);
-	free((void*)input_free);
-
-	return pngData;
-}
-
-// Get a pixel from a PNG image at (x, y)
-static u32 _getPixel(PNG_DATA *pngData, u16 x, u16 y)
-{
-	// Check if coordinates are within bounds
-	if (!pngData || x >= pngData->textureSizeX || y >= pngData->textureSizeY)
-		return 0; // Return a default value (black) if out of bounds or null data
-
-	return pngData->rawdata[y * pngData->textureSizeX + x];
-}
-
-// Delete (free memory) of a PNG image
-static void _deletePngImage(PNG_DATA *pngData)
-{
-	if (!pngData)
-		return;
-
-	// Free the raw data if it's not null
-	if (pngData->rawdata) {
-		free(pngData->rawdata);
-		pngData->rawdata = NULL;
+		// Otherwise a single row is decoded at a time, starting with the markers
+		rows = (u8*)malloc(rowBytes);
+		if (!rows) png_error(png_ptr, "out of memory");
+		png_read_row(png_ptr, rows, NULL);
 	}
 
-	// Free the structure itself
-	free(pngData);
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// Public functions
-///////////////////////////////////////////////////////////////////////////////
-OSL_SFONT *oslLoadSFontFile(char *filename, int pixelFormat) {
-	// Allocate memory for the OSL_SFONT structure
-	OSL_SFONT *sfont = (OSL_SFONT*)malloc(sizeof(OSL_SFONT));
-	if (!sfont) {
-		oslHandleLoadNoFailError(filename);
-		return NULL;
+	// The font and all its letters (in a single block)
+	newFont = (OSL_SFONT*)malloc(sizeof(OSL_SFONT));
+	if (!newFont) png_error(png_ptr, "out of memory");
+	memset(newFont, 0, sizeof(OSL_SFONT));
+	OSL_SFLETTER *letters = (OSL_SFLETTER*)malloc(256 * sizeof(OSL_SFLETTER));
+	if (!letters) png_error(png_ptr, "out of memory");
+	newFont->letters[0] = letters;
+	newFont->height = height - 1;
+
+	// The first row marks the letters: runs of pixels differing from the first one
+	const u32 *markers = (const u32*)rows;
+	u32 refcolor = markers[0] & 0x00FFFFFFU;
+	int letterCount = 0;
+	for (x = 0; x < (int)width && letterCount < 256; ) {
+		if ((markers[x] & 0x00FFFFFFU) == refcolor) {
+			++x;
+			continue;
+		}
+		positions[letterCount] = x;
+		while (x < (int)width && (markers[x] & 0x00FFFFFFU) != refcolor)
+			++x;
+		letters[letterCount].width = x - positions[letterCount];
+		newFont->letters[letterCount] = &letters[letterCount];
+		letterCount++;
 	}
-
-	// Load the PNG image
-	PNG_DATA *img = _loadFromPNG(filename);
-	if (!img) {
-		free(sfont);
-		oslHandleLoadNoFailError(filename);
-		return NULL;
+	newFont->lettersCount = letterCount;
+
+	// Place the letters in rows of an atlas, with a transparent pixel between them (for bilinear filtering). With 4-bit
+	// formats letters start on a whole byte.
+	int align = osl_pixelWidth[pixelFormat] < 8 ? 2 : 1;
+	int atlasWidth = 0, atlasHeight = newFont->height, rowWidth = 0;
+	for (i = 0; i < letterCount; i++) {
+		OSL_SFLETTER *lt = &letters[i];
+		rowWidth = (rowWidth + align - 1) & ~(align - 1);
+		if (rowWidth + (int)lt->width > 512) {
+			rowWidth = 0;
+			atlasHeight += newFont->height + 1;
+		}
+		lt->x = rowWidth;
+		lt->y = atlasHeight - newFont->height;
+		rowWidth += lt->width + 1;
+		atlasWidth = oslMax(atlasWidth, rowWidth - 1);
 	}
 
-	unsigned int refcolor = _getPixel(img, 0, 0) & 0x00FFFFFFU;
-	int letterCount = 0;
-	int x = 0;
-
-	sfont->lettersCount = 0;
-
-	// Process each column in the PNG image to extract font letters
-	while (x < img->sizeX) {
-		int color = _getPixel(img, x, 0);
-
-		if ((color & 0x00FFFFFFU) != refcolor) {
-			int pos = x;
-
-			// Find the width of the current letter by scanning until the reference color is hit
-			while (x < img->sizeX && ((_getPixel(img, x, 0) & 0x00FFFFFFU) != refcolor)) {
-				++x;
-			}
-
-			// Allocate memory for a new letter
-			OSL_SFLETTER *lt = (OSL_SFLETTER*)malloc(sizeof(OSL_SFLETTER));
-			if (!lt) {
-				_deletePngImage(img);
-				oslDeleteSFont(sfont); // Frees all previously allocated letters and sfont
-				oslHandleLoadNoFailError(filename);
-				return NULL;
-			}
-
-			lt->width = x - pos;
-			lt->letter = oslCreateImage(lt->width, img->sizeY - 1, OSL_IN_RAM, pixelFormat);
-			if (!lt->letter) {
-				free(lt);
-				_deletePngImage(img);
-				oslDeleteSFont(sfont);
-				oslHandleLoadNoFailError(filename);
-				return NULL;
-			}
-
-			oslClearImage(lt->letter, RGBA(0, 0, 0, 0));
-			oslLockImage(lt->letter);
-
-			// Copy the image data into the letter
-			for (int dx = pos; dx < pos + lt->width; ++dx) {
-				for (int dy = 1; dy < img->sizeY; ++dy) {
-					int pixel = _getPixel(img, dx, dy);
-					pixel = oslConvertColorEx(lt->letter->palette, lt->letter->pixelFormat, OSL_PF_8888, pixel);
-					oslSetImagePixel(lt->letter, dx - pos, dy - 1, pixel);
-				}
-			}
-
-			oslUnlockImage(lt->letter);
-			oslSwizzleImage(lt->letter);
-
-			// Assign the letter to the font and increment the letter count
-			sfont->letters[letterCount++] = lt;
-		} else {
-			++x;
+	if (letterCount == 0 || atlasWidth > 512 || atlasHeight > 512)
+		png_error(png_ptr, "letters do not fit");
+	newFont->atlas = oslCreateImage(atlasWidth, atlasHeight, OSL_IN_RAM, pixelFormat);
+	if (!newFont->atlas)
+		png_error(png_ptr, "out of memory");
+	memset(newFont->atlas->data, 0, newFont->atlas->totalSize);
+
+	// Convert each decoded row straight into the letters
+	for (y = 1; y < (int)height; y++) {
+		const u8 *src = rows;
+		if (passes > 1)
+			src = rows + y * rowBytes;
+		else
+			png_read_row(png_ptr, rows, NULL);
+		for (i = 0; i < letterCount; i++) {
+			OSL_SFLETTER *lt = &letters[i];
+			oslConvertImageRows(oslGetImagePixelAddr(newFont->atlas, lt->x, lt->y + y - 1), 0, pixelFormat,
+				src + positions[i] * sizeof(u32), 0, OSL_PF_8888, lt->width, 1, NULL);
 		}
 	}
 
-	sfont->height = img->sizeY - 1;
-	sfont->lettersCount = letterCount;
+	png_read_end(png_ptr, NULL);
+	png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+	free(rows);
 
-	// Clean up the image data after processing
-	_deletePngImage(img);
+	// Swizzled once, with all the letters in place
+	oslSwizzleImage(newFont->atlas);
+	oslUncacheImage(newFont->atlas);
+	sfont = newFont;
 
+error:
+	if (f) VirtualFileClose(f);
+	if (!sfont) oslHandleLoadNoFailError(filename);
 	return sfont;
 }
 
 void oslDeleteSFont(OSL_SFONT *sfont) {
 	if (!sfont) return;
 
-	// Free each letter's image
-	for (int i = 0; i < sfont->lettersCount; ++i) {
-		if (sfont->letters[i]) {
-			oslDeleteImage(sfont->letters[i]->letter);
-			free(sfont->letters[i]);
-		}
-	}
+	// The letters are in a single block and a single image
+	if (sfont->atlas)
+		oslDeleteImage(sfont->atlas);
+	if (sfont->letters[0])
+		free(sfont->letters[0]);
 
 	// Free the sfont struct itself
 	free(sfont);
@@ -342,18 +212,53 @@ int oslGetSFontTextWidth(OSL_SFONT *sfont, char *text) {
 int oslSFontDrawText(OSL_SFONT *sfont, int x, int y, char *text) {
 	if (!sfont || !text) return x;
 
-	int currentX = x;
+	OSL_FAST_VERTEX *vertices = NULL;
+	int count = 0, batched = 0, k, offset;
+
+	// Count the letters to draw
+	for (k = 0; text[k] != '\0'; ++k) {
+		if (_getOffset(sfont, (unsigned char)text[k]) >= 0)
+			count++;
+	}
+
+	if (count > 0) {
+		// A single texture for all the letters
+		oslSetTexture(sfont->atlas);
+		vertices = (OSL_FAST_VERTEX*)oslAddBatchSprites(GU_TEXTURE_16BIT | GU_VERTEX_16BIT, sizeof(OSL_FAST_VERTEX), count);
+		batched = (vertices != NULL);
+		if (!batched)
+			vertices = (OSL_FAST_VERTEX*)sceGuGetMemory(count * 2 * sizeof(OSL_FAST_VERTEX));
+	}
 
 	// Iterate through each character of the text
-	for (int k = 0; text[k] != '\0'; ++k) {
-		int offset = _getOffset(sfont, (unsigned char)text[k]);
+	int currentX = x;
+	OSL_FAST_VERTEX *vtx = vertices;
+	for (k = 0; text[k] != '\0'; ++k) {
+		offset = _getOffset(sfont, (unsigned char)text[k]);
 		if (offset < 0)
 			currentX += sfont->letters[0]->width; // Move by the width of the first letter as fallback
 		else {
-			oslDrawImageXY(sfont->letters[offset]->letter, currentX, y);
-			currentX += sfont->letters[offset]->width;
+			OSL_SFLETTER *lt = sfont->letters[offset];
+			vtx[0].u = lt->x;
+			vtx[0].v = lt->y;
+			vtx[0].x = currentX;
+			vtx[0].y = y;
+			vtx[0].z = 0;
+			vtx[1].u = lt->x + lt->width;
+			vtx[1].v = lt->y + sfont->height;
+			vtx[1].x = currentX + lt->width;
+			vtx[1].y = y + sfont->height;
+			vtx[1].z = 0;
+			vtx += 2;
+			currentX += lt->width;
 		}
 	}
 
+	// Draw the letters (unless they are batched)
+	if (count > 0 && !batched) {
+		sceKernelDcacheWritebackRange(vertices, count * 2 * sizeof(OSL_FAST_VERTEX));
+		oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, count * 2, 0, vertices);
+	}
+
 	return currentX;
 }
@@ -23,7 +23,8 @@ extern "C" {
  */
 typedef struct
 {
-	OSL_IMAGE *letter; /**< The image representing the letter. */
+	unsigned short x; /**< X position of the letter in the atlas. */
+	unsigned short y; /**< Y position of the letter in the atlas. */
 	unsigned int width; /**< The letter's width in pixels. */
 } OSL_SFLETTER;
 
@@ -32,7 +33,8 @@ typedef struct
  */
 typedef struct
 {
-	OSL_SFLETTER *letters[256]; /**< Array of pointers to single letters. */
+	OSL_SFLETTER *letters[256]; /**< Array of pointers to single letters (all in one block, starting at letters[0]). */
+	OSL_IMAGE *atlas; /**< Image holding all the letters, so a string is drawn with a single texture. */
 	int height; /**< The height of the font in pixels. */
 	int lettersCount; /**< The total number of letters in the font. */
 } OSL_SFONT;
@@ -42,7 +44,7 @@ typedef struct
  *
  * @param filename The name of the file to load the SFont from.
  * @param pixelFormat The pixel format to use for the SFont.
- * @return A pointer to the loaded OSL_SFONT, or NULL on failure.
+ * @return A pointer to the loaded OSL_SFONT, or NULL on failure (also if the letters do not fit in a 512x512 atlas).
  */
 OSL_SFONT *oslLoadSFontFile(char *filename, int pixelFormat);
 
@@ -65,6 +67,8 @@ int oslGetSFontTextWidth(OSL_SFONT *sfont, char *text);
 /**
  * @brief Print a string using an SFont.
  *
+ * All the letters are drawn in a single draw (or added to the sprite batch when it is enabled).
+ *
  * @param sfont The SFont to use for printing.
  * @param x The X position on the screen to start printing.
  * @param y The Y position on the screen to start printing.
@@ -31,14 +31,10 @@ void oslDrawLine(int x0, int y0, int x1, int y1, OSL_COLOR color) {
 	vertices[1].y = y1;
 	vertices[1].z = 0;
 
-	int wasEnabled = osl_textureEnabled;
 	oslDisableTexturing();
 
-	sceGuDrawArray(GU_LINES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
+	oslGuDrawArray(GU_LINES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
 	sceKernelDcacheWritebackRange(vertices, 2 * sizeof(OSL_LINE_VERTEX));
-	if (wasEnabled) {
-		oslEnableTexturing();
-	}
 }
 
 void oslDrawRect(int x0, int y0, int x1, int y1, OSL_COLOR color) {
@@ -97,14 +93,10 @@ void oslDrawRect(int x0, int y0, int x1, int y1, OSL_COLOR color) {
 	vertices[7].y = y0;
 	vertices[7].z = 0;
 
-	int wasEnabled = osl_textureEnabled;
 	oslDisableTexturing();
 
-	sceGuDrawArray(GU_LINES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 8, 0, vertices);
+	oslGuDrawArray(GU_LINES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 8, 0, vertices);
 	sceKernelDcacheWritebackRange(vertices, 8 * sizeof(OSL_LINE_VERTEX));
-	if (wasEnabled) {
-		oslEnableTexturing();
-	}
 }
 
 void oslDrawFillRect(int x0, int y0, int x1, int y1, OSL_COLOR color) {
@@ -121,14 +113,10 @@ void oslDrawFillRect(int x0, int y0, int x1, int y1, OSL_COLOR color) {
 	vertices[1].y = y1;
 	vertices[1].z = 0;
 
-	int wasEnabled = osl_textureEnabled;
 	oslDisableTexturing();
 
-	sceGuDrawArray(GU_SPRITES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
+	oslGuDrawArray(GU_SPRITES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
 	sceKernelDcacheWritebackRange(vertices, 2 * sizeof(OSL_LINE_VERTEX));
-	if (wasEnabled) {
-		oslEnableTexturing();
-	}
 }
 
 void oslDrawGradientRect(int x0, int y0, int x1, int y1, OSL_COLOR colorTopLeft, OSL_COLOR colorTopRight, OSL_COLOR colorBottomLeft, OSL_COLOR colorBottomRight) {
@@ -160,12 +148,8 @@ void oslDrawGradientRect(int x0, int y0, int x1, int y1, OSL_COLOR colorTopLeft,
 	vertices[3].y = y1;
 	vertices[3].z = 0;
 
-	int wasEnabled = osl_textureEnabled;
 	oslDisableTexturing();
 
-	sceGuDrawArray(GU_TRIANGLE_STRIP, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 4, 0, vertices);
+	oslGuDrawArray(GU_TRIANGLE_STRIP, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 4, 0, vertices);
 	sceKernelDcacheWritebackRange(vertices, 4 * sizeof(OSL_LINE_VERTEX));
-	if (wasEnabled) {
-		oslEnableTexturing();
-	}
 }
@@ -7,7 +7,7 @@
 /*
     Logo data (PNG image format)
 */
-const unsigned long __osl_logo_texte_data[] = {
+const u32 __osl_logo_texte_data[] = {
 	0x474e5089, 0x0a1a0a0d, 0x0d000000, 0x52444849, 0xe0010000, 0x10010000, 0x00000208, 0x3024e700,
 	0x0b0000db, 0x414449c2, 0xedda7854, 0x1b6fbfdd, 0xf1c00365, 0x02fe2bf3, 0x6c132e8a, 0x0b03d80c,
 	0x1d74ad12, 0x74111090, 0x24162570, 0x08648954, 0xc242414b, 0xa9ce9755, 0x0ce4c8c4, 0x94204064,
@@ -106,7 +106,7 @@ const unsigned long __osl_logo_texte_data[] = {
 	0xcf00d020, 0xb7017fbd, 0xb2317455, 0x005fbc65, 0x49000000, 0xae444e45, 0x00826042
 };
 
-const unsigned long __osl_logo_etoile_data[] = {
+const u32 __osl_logo_etoile_data[] = {
 	0x474e5089, 0x0a1a0a0d, 0x0d000000, 0x52444849, 0x10000000, 0x18000000, 0x00000208, 0xeac27c00,
 	0x0000005b, 0x414449d3, 0xadda7854, 0x83123152, 0x185c0840, 0xe969401f, 0x5a9fbd53, 0x02f0955e,
 	0xc1c5c149, 0x4cc97893, 0xd8142876, 0xb0c9015d, 0xa70202e3, 0x769c0079, 0x2b282baf, 0x12aba001,
@@ -122,7 +122,7 @@ const unsigned long __osl_logo_etoile_data[] = {
     Shifts the red value to the alpha channel to create transparency based on the text.
 */
 static void shiftLogoPixels(OSL_IMAGE *img) {
-    unsigned long *data = (unsigned long *)img->data;
+    u32 *data = (u32 *)img->data;
     for (int i = 0; i < (img->totalSize >> 2); i++) {
         *data = (*data) << 24;
         data++;
@@ -163,7 +163,7 @@ static OSL_IMAGE *createLogoBackgroundImage() {
     Creates a rotating color palette for the logo.
 */
 static void createRotatingPalette(OSL_IMAGE *img, int angle) {
-    unsigned long *palette = (unsigned long *)img->palette->data;
+    u32 *palette = (u32 *)img->palette->data;
     int colorValue;
 
     for (int i = 0; i < 239; i++) {
@@ -51,7 +51,7 @@ static void LogoDrawTiles(OSL_IMAGE *img, float positions[TILE_HEIGHT][TILE_WIDT
 
         // Draw the vertices
         if (nbVertices > 0)
-            sceGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, nbVertices, 0, vertices);
+            oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_VERTEX_16BIT | GU_TRANSFORM_2D, nbVertices, 0, vertices);
     }
 }
 
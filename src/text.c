@@ -392,11 +392,11 @@ OSL_FONT *oslLoadFont(OSL_FONTINFO *fi) {
 	// Initialize palette data
 	if (fi->paletteCount) {
 		for (i = 0; i < oslMin(fi->paletteCount, font->img->palette->nElements); i++) {
-			((unsigned long*)font->img->palette->data)[i] = fi->paletteData[i];
+			((u32*)font->img->palette->data)[i] = fi->paletteData[i];
 		}
 	} else {
-		((unsigned long*)font->img->palette->data)[0] = RGBA(255, 255, 255, 0);
-		((unsigned long*)font->img->palette->data)[1] = RGBA(255, 255, 255, 255);
+		((u32*)font->img->palette->data)[0] = RGBA(255, 255, 255, 0);
+		((u32*)font->img->palette->data)[1] = RGBA(255, 255, 255, 255);
 	}
 
 	// Invalidate the palette cache
@@ -435,10 +435,11 @@ int updateIntraFontCharWidth(OSL_FONT *font, intraFont *intra) {
 		}
 	}
 
-	char character[2] = {0, 0}; // Initialize character array with null terminator
+	// Widths of the 256 Latin-1 characters, straight from the advance table of the font
+	float widths[256];
+	intraFontGetCharWidths(intra, 0, 256, widths);
 	for (int i = 0; i < 256; i++) {
-		character[0] = (char)i;
-		font->charWidths[i] = (u8)intraFontMeasureText(intra, character);
+		font->charWidths[i] = (u8)widths[i];
 	}
 
 	return 0;
@@ -538,7 +539,10 @@ OSL_FONT *oslLoadFontFile(const char *filename) {
 				return NULL;
 			}
 			// Verify header
-			if (!strcmp(fh.strVersion, "OSLFont v01")) {
+			if (!strcmp(fh.strVersion, "OSLFont v02")) {
+				// Unicode font, decoded page by page when drawing
+				font = oslLoadUnicodeFont(f, &fh);
+			} else if (!strcmp(fh.strVersion, "OSLFont v01")) {
 				fi.pixelFormat = fh.pixelFormat;
 				// Verify pixel format
 				if (fh.pixelFormat < 1 || fh.pixelFormat > 4) {
@@ -579,10 +583,10 @@ OSL_FONT *oslLoadFontFile(const char *filename) {
 
 					// Check for palette data
 					if (fi.paletteCount > 0) {
-						fi.paletteData = (unsigned long*)malloc(fi.paletteCount * sizeof(unsigned long));
+						fi.paletteData = (u32*)malloc(fi.paletteCount * sizeof(u32));
 						if (fi.paletteData) {
 							// Read palette entries
-							if (VirtualFileRead(fi.paletteData, fi.paletteCount * sizeof(unsigned long), 1, f) == 0) {
+							if (VirtualFileRead(fi.paletteData, fi.paletteCount * sizeof(u32), 1, f) == 0) {
 								fi.paletteCount = 0;
 								free(fi.paletteData);
 								fi.paletteData = NULL;
@@ -626,8 +630,13 @@ void oslDeleteFont(OSL_FONT *f) {
 		intraFontUnload(f->intra);
 		f->intra = NULL;
 	} else if (f->fontType == OSL_FONT_OFT) {
+		// Forget the text boxes laid out with this font
+		oslClearTextLayoutCache();
 		// Delete associated image and free allocated memory for charPositions and charWidths
-		oslDeleteImage(f->img);
+		if (f->img)
+			oslDeleteImage(f->img);
+		oslDeleteFontPages(f->pages);
+		f->pages = NULL;
 		free(f->charPositions);
 		f->charPositions = NULL;
 		free(f->charWidths);
@@ -660,20 +669,14 @@ void oslDrawTextTileBack(int x, int y, int tX, int tY) {
 	vertices[1].y = y + tY;
 	vertices[1].z = 0;
 
-	// Disable texturing if it is currently enabled
-	int wasEnable = osl_textureEnabled;
+	// Disable texturing; the text tile enables it again
 	oslDisableTexturing();
 
 	// Draw the vertices as a sprite
-	sceGuDrawArray(GU_SPRITES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
+	oslGuDrawArray(GU_SPRITES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
 
 	// Writeback the data cache to ensure it is correctly updated in memory
 	sceKernelDcacheWritebackRange(vertices, 2 * sizeof(OSL_LINE_VERTEX_COLOR32));
-
-	// Re-enable texturing if it was previously enabled
-	if (wasEnable) {
-		oslEnableTexturing();
-	}
 }
 
 // Function to draw a tile of the selected texture. Avoid using this outside.
@@ -688,9 +691,14 @@ void oslDrawTextTile(int u, int v, int x, int y, int tX, int tY) {
 	// Add additional space to the width of the tile
 	tX += osl_curFont->addedSpace;
 
-	// Allocate memory for vertex data
+	// Enable texturing (before batching the tile: enabling it may flush the batch)
+	oslEnableTexturing();
+
+	// Add the tile to the batch, or allocate memory for vertex data
 	OSL_FAST_VERTEX_COLOR32 *vertices;
-	vertices = (OSL_FAST_VERTEX_COLOR32*)sceGuGetMemory(2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+	vertices = (OSL_FAST_VERTEX_COLOR32*)oslAddBatchSprite(GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT, sizeof(OSL_FAST_VERTEX_COLOR32));
+	if (vertices == NULL)
+		vertices = (OSL_FAST_VERTEX_COLOR32*)sceGuGetMemory(2 * sizeof(OSL_FAST_VERTEX_COLOR32));
 
 	// Define the vertices for the tile
 	vertices[0].u = u;
@@ -707,22 +715,107 @@ void oslDrawTextTile(int u, int v, int x, int y, int tX, int tY) {
 	vertices[1].y = y + tY;
 	vertices[1].z = 0;
 
-	// Store the previous state of texturing
-	int wasEnabled = osl_textureEnabled;
+	// Draw the tile (batched tiles are drawn later)
+	if (!osl_spriteBatchEnabled) {
+		oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
+
+		// Write back the cache to ensure the data is correctly updated
+		sceKernelDcacheWritebackRange(vertices, 2 * sizeof(OSL_FAST_VERTEX_COLOR32)); //SAKYA
+	}
+}
+
+// Draws the count first characters of str with the current OFT font: one sprite for the whole background, then all the
+// glyphs in a single draw (or in the sprite batch)
+static void oslDrawTextTiles(int x, int y, const unsigned char *str, int count) {
+	OSL_FONT *f = osl_curFont;
+	OSL_FAST_VERTEX_COLOR32 *vertices;
+	int i, u, v, tX, tY = f->charHeight, width = 0, batched;
+	int color = oslBlendColor(osl_textColor);
+
+	if (count <= 0)
+		return;
 
-	// Enable texturing
+	// The character backgrounds are contiguous
+	if (osl_textBkColor & 0xff000000) {
+		for (i = 0; i < count; i++)
+			width += f->charWidths[str[i]];
+		oslDrawTextTileBack(x, y, width, tY);
+	}
+
+	oslSetTexture(f->img);
 	oslEnableTexturing();
 
-	// Draw the tile
-	sceGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, 2, 0, vertices);
+	vertices = (OSL_FAST_VERTEX_COLOR32*)oslAddBatchSprites(GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT, sizeof(OSL_FAST_VERTEX_COLOR32), count);
+	batched = (vertices != NULL);
+	if (!batched)
+		vertices = (OSL_FAST_VERTEX_COLOR32*)sceGuGetMemory(count * 2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+
+	for (i = 0; i < count; i++) {
+		OSL_FAST_VERTEX_COLOR32 *vtx = vertices + i * 2;
+		u = f->charPositions[str[i]] & (OSL_TEXT_TEXWIDTH - 1);
+		v = (f->charPositions[str[i]] >> OSL_TEXT_TEXDECAL) * tY;
+		tX = f->charWidths[str[i]] + f->addedSpace;
+
+		vtx[0].u = u;
+		vtx[0].v = v;
+		vtx[0].color = color;
+		vtx[0].x = x;
+		vtx[0].y = y;
+		vtx[0].z = 0;
+
+		vtx[1].u = u + tX;
+		vtx[1].v = v + tY;
+		vtx[1].color = color;
+		vtx[1].x = x + tX;
+		vtx[1].y = y + tY;
+		vtx[1].z = 0;
+
+		x += f->charWidths[str[i]];
+	}
 
-	// Write back the cache to ensure the data is correctly updated
-	sceKernelDcacheWritebackRange(vertices, 2 * sizeof(OSL_FAST_VERTEX_COLOR32)); //SAKYA
+	// Draw the glyphs (batched glyphs are drawn later)
+	if (!batched) {
+		sceKernelDcacheWritebackRange(vertices, count * 2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+		oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, count * 2, 0, vertices);
+	}
+}
 
-	// Restore the previous state of texturing
-	if (!wasEnabled) {
-		oslDisableTexturing();
+// Unicode fonts: draws the UTF-8 string str, stopping before the first character exceeding maxWidth (if >= 0)
+static void oslDrawFontString(int x, int y, const char *str, int maxWidth) {
+	OSL_FONT *f = osl_curFont;
+	unsigned short glyphs[OSL_FONT_GLYPH_GROUP];
+	short positions[OSL_FONT_GLYPH_GROUP * 2];
+	const char *s;
+	int n = 0, glyph, w, width = 0;
+
+	// The character backgrounds are contiguous
+	if (osl_textBkColor & 0xff000000) {
+		for (s = str; *s; width += w) {
+			w = oslGetFontCharWidth(f, oslReadUtf8(&s));
+			if (maxWidth >= 0 && width + w > maxWidth)
+				break;
+		}
+		if (width > 0)
+			oslDrawTextTileBack(x, y, width, f->charHeight);
+		width = 0;
 	}
+
+	// Glyphs by groups of OSL_FONT_GLYPH_GROUP
+	while (*str) {
+		glyph = oslGetFontGlyph(f, oslReadUtf8(&str));
+		w = f->pages->widths[glyph];
+		if (maxWidth >= 0 && width + w > maxWidth)
+			break;
+		glyphs[n] = glyph;
+		positions[n * 2] = width;
+		positions[n * 2 + 1] = 0;
+		width += w;
+		if (++n == OSL_FONT_GLYPH_GROUP) {
+			oslDrawFontGlyphs(f, x, y, glyphs, positions, n);
+			n = 0;
+		}
+	}
+	oslDrawFontGlyphs(f, x, y, glyphs, positions, n);
 }
 
 void oslDrawChar(int x, int y, unsigned char c) {
@@ -732,7 +825,13 @@ void oslDrawChar(int x, int y, unsigned char c) {
 	}
 
 	// Handle OSL_FONT_OFT font type
-	if (osl_curFont->fontType == OSL_FONT_OFT) {
+	if (osl_curFont->pages) {
+		unsigned short glyph = oslGetFontGlyph(osl_curFont, c);
+		short position[2] = {0, 0};
+		if (osl_textBkColor & 0xff000000)
+			oslDrawTextTileBack(x, y, osl_curFont->pages->widths[glyph], osl_curFont->charHeight);
+		oslDrawFontGlyphs(osl_curFont, x, y, &glyph, position, 1);
+	} else if (osl_curFont->fontType == OSL_FONT_OFT) {
 		oslSetTexture(osl_curFont->img);
 		// Draw the character tile
 		oslDrawTextTile(OSL_TEXT_CHARPOSXY(osl_curFont, c), x, y, osl_curFont->charWidths[c], osl_curFont->charHeight);
@@ -753,15 +852,10 @@ void oslDrawString(int x, int y, const char *str) {
 	}
 
 	// Handle OSL_FONT_OFT font type
-	if (osl_curFont->fontType == OSL_FONT_OFT) {
-		unsigned char c;
-		oslSetTexture(osl_curFont->img);
-
-		while (*str) {
-			c = *(unsigned char*)str++;
-			oslDrawTextTile(OSL_TEXT_CHARPOSXY(osl_curFont, c), x, y, osl_curFont->charWidths[c], osl_curFont->charHeight);
-			x += osl_curFont->charWidths[c];
-		}
+	if (osl_curFont->pages) {
+		oslDrawFontString(x, y, str, -1);
+	} else if (osl_curFont->fontType == OSL_FONT_OFT) {
+		oslDrawTextTiles(x, y, (const unsigned char*)str, strlen(str));
 	}
 	// Handle OSL_FONT_INTRA font type
 	else if (osl_curFont->fontType == OSL_FONT_INTRA) {
@@ -776,25 +870,19 @@ void oslDrawStringLimited(int x, int y, int width, const char *str) {
 		return;
 	}
 
-	int limitX = x + width;
-	unsigned char c;
-
 	// Handle OSL_FONT_OFT font type
-	if (osl_curFont->fontType == OSL_FONT_OFT) {
-		oslSetTexture(osl_curFont->img);
-
-		while (*str) {
-			c = *(unsigned char*)str++;
-
-			// Break if the next character exceeds the limit width
-			if (x + osl_curFont->charWidths[c] > limitX) {
-				break;
-			}
-
-			// Draw the character tile
-			oslDrawTextTile(OSL_TEXT_CHARPOSXY(osl_curFont, c), x, y, osl_curFont->charWidths[c], osl_curFont->charHeight);
-			x += osl_curFont->charWidths[c];
+	if (osl_curFont->pages) {
+		oslDrawFontString(x, y, str, width);
+	} else if (osl_curFont->fontType == OSL_FONT_OFT) {
+		const unsigned char *s = (const unsigned char*)str;
+		int count = 0;
+
+		// Stop before the first character exceeding the limit width
+		while (s[count] && osl_curFont->charWidths[s[count]] <= width) {
+			width -= osl_curFont->charWidths[s[count]];
+			count++;
 		}
+		oslDrawTextTiles(x, y, s, count);
 	}
 	// Handle OSL_FONT_INTRA font type
 	else if (osl_curFont->fontType == OSL_FONT_INTRA) {
@@ -802,110 +890,6 @@ void oslDrawStringLimited(int x, int y, int width, const char *str) {
 	}
 }
 
-void oslDrawTextBox(int x0, int y0, int x1, int y1, const char *text, int format) {
-	// Check if the current font is valid and of type OSL_FONT_OFT
-	if (!osl_curFont || osl_curFont->fontType != OSL_FONT_OFT) {
-		return;
-	}
-
-	int x = x0, y = y0, x2;
-	unsigned char c;
-	const char *text2;
-
-	while (*text) {
-		c = *text;
-
-		// Handle spaces
-		if (c == ' ') {
-			text2 = text;
-			x2 = x;
-			// Measure the width of the word
-			do {
-				x2 += osl_curFont->charWidths[(int)(*text2++)];
-				if (x2 > x1) {
-					text++;
-					goto newline;
-				}
-			} while (*text2 != '\n' && *text2 != ' ' && *text2);
-		}
-
-		// Handle new lines and word wrapping
-		if (x + osl_curFont->charWidths[c] > x1 || *text == '\n') {
-newline:
-			x = x0;
-			y += osl_curFont->charHeight;
-			// Stop if the text exceeds the box height
-			if (y + osl_curFont->charHeight > y1) {
-				break;
-			}
-			// Skip newline characters
-			if (*text == '\n') {
-				text++;
-			}
-			continue;
-		}
-
-		// Draw the character
-		oslDrawChar(x, y, c);
-		x += osl_curFont->charWidths[c];
-		text++;
-	}
-}
-
-void oslDrawTextBoxByWords(int x0, int y0, int x1, int y1, const char *text, int format) {
-	char buffer[50];
-	int charCount;
-	unsigned char c;
-	int x = x0, y = y0, x2;
-	const char *text2 = text;
-
-	while (*text2) {
-		memset(buffer, '\0', sizeof(buffer));
-		charCount = 0;
-		x2 = 0;
-
-		// Extract a word
-		while (*text2 != '\n' && *text2 != ' ' && *text2) {
-			charCount++;
-			text2++;
-		}
-
-		if (charCount > 0) {
-			strncpy(buffer, text, charCount);
-			x2 = oslGetStringWidth(buffer);
-
-			// Check if the word fits in the current line, else move to the next line
-			if ((x + x2) > x1) {
-				x = x0;
-				y += osl_curFont->charHeight;
-				if (y > y1) break;
-			}
-
-			// Draw the word
-			oslDrawString(x, y, buffer);
-			text += charCount;
-			x += x2;
-		}
-
-		// Handle spaces
-		if (*text2 == ' ') {
-			c = *text;
-			x += osl_curFont->charWidths[c];
-			text2++;
-			text++;
-		}
-
-		// Handle newlines
-		if (*text2 == '\n') {
-			x = x0;
-			y += osl_curFont->charHeight;
-			if (y > y1) break;
-			text2++;
-			text++;
-		}
-	}
-}
-
 void oslInitConsole() {
 	// Load and set the system font if it is not already loaded
 	if (!osl_sceFont) {
@@ -920,8 +904,8 @@ void oslInitConsole() {
 }
 
 void oslMoveMem(void *dst, const void *src, int size) {
-	unsigned long *fdst = (unsigned long *)dst;
-	const unsigned long *fsrc = (const unsigned long *)src;
+	u32 *fdst = (u32 *)dst;
+	const u32 *fsrc = (const u32 *)src;
 
 	// Copy memory in chunks of 4 bytes
 	while (size > 0) {
@@ -966,7 +950,7 @@ void oslConsolePrint(const char *str) {
 				oslMoveMem(
 					oslAddVramPrefixPtr(oslGetImageLine(osl_curBuf, 0)),
 					oslAddVramPrefixPtr(oslGetImageLine(osl_curBuf, osl_curFont->charHeight)),
-					osl_curBuf->totalSize - (int)oslGetImageLine(osl_curBuf, osl_curFont->charHeight)
+					osl_curBuf->totalSize - (int)(uintptr_t)oslGetImageLine(osl_curBuf, osl_curFont->charHeight)
 					);
 
 				// Clear the bottom line of the buffer
@@ -1002,7 +986,12 @@ int oslGetStringWidth(const char *str) {
 	u32 width = 0;
 
 	// Calculate string width based on font type
-	if (osl_curFont->fontType == OSL_FONT_OFT) {
+	if (osl_curFont->pages) {
+		// Unicode fonts: UTF-8 characters
+		while (*str) {
+			width += oslGetFontCharWidth(osl_curFont, oslReadUtf8(&str));
+		}
+	} else if (osl_curFont->fontType == OSL_FONT_OFT) {
 		// Iterate over each character in the string
 		while (*str) {
 			unsigned char c = (unsigned char)*str++;
@@ -1022,30 +1011,30 @@ int oslGetTextBoxHeight(int width, int maxHeight, const char *text, int format)
 		return 0;
 	}
 
-	int x = 0, y = 0, x2;
-	unsigned char c;
-	const char *text2;
+	int x = 0, y = 0, x2, c;
+	const char *text2, *next;
 	int newLine = 1;
 
-	// Iterate over each character in the text
+	// Iterate over each character in the text (UTF-8 with Unicode fonts)
 	while (*text) {
-		c = *text;
+		next = text;
+		c = oslReadFontChar(osl_curFont, &next);
 
 		// Handle spaces and line wrapping
 		if (c == ' ') {
 			text2 = text;
 			x2 = x;
 			do {
-				x2 += osl_curFont->charWidths[(int)(*text2++)];
+				x2 += oslGetFontCharWidth(osl_curFont, oslReadFontChar(osl_curFont, &text2));
 				if (x2 > width) {
-					text++;
+					text = next;
 					goto newline;
 				}
 			} while (*text2 != '\n' && *text2 != ' ' && *text2);
 		}
 
 		// Handle new lines and line wrapping
-		if (x + osl_curFont->charWidths[c] > width || *text == '\n') {
+		if (x + oslGetFontCharWidth(osl_curFont, c) > width || *text == '\n') {
 newline:
 			x = 0;
 			if (newLine && *text == '\n') {
@@ -1070,8 +1059,8 @@ newline:
 			y += osl_curFont->charHeight;
 		}
 
-		x += osl_curFont->charWidths[c];
-		text++;
+		x += oslGetFontCharWidth(osl_curFont, c);
+		text = next;
 	}
 
 	return y;
@@ -1120,7 +1109,8 @@ float oslIntraFontPrintColumn(OSL_FONT *font, float x, float y, float width, con
 		y += (float)font->charHeight / 2.0f + 1.0f;
 
 		// Print the text in a column using intraFont
-		return intraFontPrintColumn(font->intra, x, y, width, text);
+		x = intraFontPrintColumn(font->intra, x, y, width, text);
+		return x;
 	}
 	return 0;
 }
@@ -22,6 +22,39 @@
  *  @{
  */
 
+/** @brief Number of glyphs in a page of a Unicode font. */
+#define OSL_FONT_PAGE_SIZE 64
+/** @brief Number of glyphs placed in the atlas of a Unicode font at once (internal). */
+#define OSL_FONT_GLYPH_GROUP 256
+
+/** @brief Slot of the glyph atlas of a Unicode font (internal). */
+typedef struct {
+	int page;                              //!< Page decoded in the slot, -1 if none.
+	int lastUse;                           //!< For the replacement of the least recently used page.
+	int stamp;                             //!< Equal to OSL_FONT_PAGES::stamp while glyphs not sent yet use the slot.
+	u32 epoch;                             //!< Value of #osl_residencyEpoch when last used.
+} OSL_FONT_PAGE_SLOT;
+
+/** @brief Glyphs of a Unicode font (.oft v02, internal).
+ *
+ *  The glyph bitmaps are kept packed, and decoded by pages of #OSL_FONT_PAGE_SIZE glyphs into the slots of the font
+ *  image the first time they are drawn.
+ */
+typedef struct {
+	int glyphCount, pageCount;             //!< Number of glyphs and of pages.
+	u32 *codes;                            //!< Code point of each glyph (ascending).
+	u8 *widths;                            //!< Width of each glyph.
+	u8 *data;                              //!< Packed glyph bitmaps (glyphSize bytes each).
+	int glyphSize, pixelFormat, lineWidth; //!< Format of the bitmaps, as in the file.
+	unsigned short latinGlyphs[256];       //!< Glyph of each code point below 256.
+	int defaultGlyph;                      //!< Glyph drawn for missing code points ('?').
+	int cellWidth, cellsPerLine;           //!< Placement of the glyphs of a page in its slot.
+	int slotHeight, slotCount;             //!< Size and number of the page slots in the image.
+	short *pageSlots;                      //!< Slot of each page, -1 if not decoded.
+	OSL_FONT_PAGE_SLOT *slots;             //!< Page slots.
+	int clock, stamp;                      //!< Counters for the page replacement.
+} OSL_FONT_PAGES;
+
 /** @brief Loaded font structure.
  *
  *  This struct represents a loaded font in OSLib, holding its image, character widths,
@@ -38,6 +71,7 @@ typedef struct {
 	unsigned char addedSpace;              //!< Space added between characters on the texture (allows making characters bigger than indicated by charWidths).
 	int fontType;                          //!< Font type (OSL_FONT_OFT or OSL_FONT_INTRA).
 	intraFont *intra;                      //!< IntraFont data.
+	OSL_FONT_PAGES *pages;                 //!< Glyph pages of a Unicode font (NULL for 256-character fonts).
 } OSL_FONT;
 
 /** @brief Font information type.
@@ -55,7 +89,7 @@ typedef struct {
 	int recentrage;                        //!< Added to text positions for drawing text (recentering).
 	unsigned char addedSpace;              //!< Space added between characters on the texture.
 	unsigned short paletteCount;           //!< Palette count.
-	unsigned long *paletteData;            //!< Palette data.
+	u32 *paletteData;                      //!< Palette data.
 } OSL_FONTINFO;
 
 /** @brief Header of a .oft file (Oslib FonT).
@@ -73,6 +107,42 @@ typedef struct {
 	unsigned char reserved[29];            //!< Must be null (reserved).
 } OSL_FONT_FORMAT_HEADER;
 
+/** @brief Unicode .oft files.
+ *
+ *  A font with "OSLFont v02" in its header holds any number of glyphs (up to 65536), identified by their Unicode code
+ *  point. Strings drawn with it are UTF-8. After the header (same fields as for v01) come:
+ *  - the number of glyphs (32-bit),
+ *  - the code point of each glyph (32-bit each, in ascending order),
+ *  - the width of each glyph (1 byte each) if variableWidth is set,
+ *  - the glyph data (lineWidth * charHeight bytes per glyph, in the same order),
+ *  - the palette (paletteCount entries of 4 bytes).
+ *
+ *  The glyphs are not all drawn in a texture at load time: they are decoded by pages of 64 (in code point order) into
+ *  a shared image of #osl_fontAtlasSize bytes at most, the first time a glyph of the page is drawn. When the image is
+ *  full, the least recently used page is replaced. Text boxes, oslDrawString and oslGetStringWidth all work the same
+ *  way as with other OFT fonts. Code points missing from the font are drawn as '?'.
+ */
+
+/** @brief Maximum size in bytes of the glyph image of the Unicode fonts loaded afterwards (64 kB by default, 512x256
+ *  4-bit texels). It should be able to hold the pages used by a frame: a page replaced while drawing a frame is decoded
+ *  again at each frame. The image is also limited to 512 lines.
+ */
+extern int osl_fontAtlasSize;
+
+/** @brief Sets #osl_fontAtlasSize. */
+#define oslSetFontAtlasSize(size) (osl_fontAtlasSize = (size))
+
+/** @brief Maximum number of display list bytes spent per frame on replacing pages of the Unicode fonts (64 kB by
+ *  default). A page replaced while the GE may still be reading its slot is uploaded through the display list, which
+ *  takes 256 bytes per line of the page (8 kB for a 16-pixel CJK font). When the next upload would go over this size,
+ *  OSLib calls #oslSyncDrawing instead and decodes the page in place: the frame stalls until the GE is done, but the
+ *  display list cannot overflow. Keep it well below the display list size.
+ */
+extern int osl_fontPageUploadSize;
+
+/** @brief Sets #osl_fontPageUploadSize. */
+#define oslSetFontPageUploadSize(size) (osl_fontPageUploadSize = (size))
+
 /** Current font.
  *
  *  This pointer holds the currently selected font for text rendering.
@@ -80,6 +150,12 @@ typedef struct {
  */
 extern OSL_FONT *osl_curFont;
 
+/** @brief Current text and background colors.
+ *
+ *  You can read them, but use #oslSetTextColor and #oslSetBkColor to modify them.
+ */
+extern OSL_COLOR osl_textColor, osl_textBkColor;
+
 /** @brief Sets the current font.
  *
  *  Sets the current font to the specified font. Use this function instead of
@@ -126,7 +202,8 @@ extern void oslInitConsole();
 
 /** @brief Loads a font from a file.
  *
- *  Loads a font file (.oft format) from the specified file path.
+ *  Loads a font file (.oft format) from the specified file path. Unicode .oft files ("OSLFont v02") are loaded
+ *  too; their glyphs are decoded when first drawn (see #osl_fontAtlasSize).
  *
  *  @param filename The path to the .oft font file.
  *  @return A pointer to the loaded font.
@@ -162,7 +239,8 @@ extern void oslDrawChar(int x, int y, unsigned char c);
 
 /** @brief Draws a string literal at the specified position.
  *
- *  This function draws a string at the given coordinates (x, y).
+ *  This function draws a string at the given coordinates (x, y). With OFT fonts, all the glyphs of the string are
+ *  sent in a single draw command, plus one sprite for the background if the background color is not transparent.
  *
  *  @param x X position on the screen.
  *  @param y Y position on the screen.
@@ -235,7 +313,11 @@ extern void oslSetBkColor(OSL_COLOR color);
 /** @brief Draws a text box with automatic line wrapping.
  *
  *  Draws text within a rectangle defined by (x0, y0) and (x1, y1). The text will automatically wrap
- *  at the end of a line and move to the next line.
+ *  at the end of a line and move to the next line. Only OFT fonts are supported.
+ *
+ *  The layout of the box is computed once and cached (see #oslClearTextLayoutCache): drawing the same text in a
+ *  box of the same size again, even at another position, only sends the prepared glyphs (one draw command, plus
+ *  one for the background).
  *
  *  @param x0 X position of the top-left corner.
  *  @param y0 Y position of the top-left corner.
@@ -248,7 +330,8 @@ extern void oslDrawTextBox(int x0, int y0, int x1, int y1, const char *text, int
 
 /** @brief Draws a text box with automatic word wrapping.
  *
- *  Similar to oslDrawTextBox, but wraps the text by words instead of characters.
+ *  Similar to oslDrawTextBox, but wraps the text by words instead of characters. A word wider than the box is cut
+ *  where it reaches the border. With OFT fonts, the layout is cached like for oslDrawTextBox.
  *
  *  @param x0 X position of the top-left corner.
  *  @param y0 Y position of the top-left corner.
@@ -259,6 +342,43 @@ extern void oslDrawTextBox(int x0, int y0, int x1, int y1, const char *text, int
  */
 extern void oslDrawTextBoxByWords(int x0, int y0, int x1, int y1, const char *text, int format);
 
+/** @brief Reads a character of a UTF-8 string and moves the pointer past it.
+ *
+ *  Bytes that don't start a valid sequence are returned alone (as Latin-1).
+ *
+ *  @param str Pointer to the string pointer.
+ *  @return The Unicode code point.
+ */
+extern int oslReadUtf8(const char **str);
+
+/** @brief Reads a character of a string for the font f: a UTF-8 sequence with Unicode fonts, a byte otherwise. */
+extern int oslReadFontChar(OSL_FONT *f, const char **str);
+
+/** @brief Returns the width of a character (code point) of an OFT font. */
+extern int oslGetFontCharWidth(OSL_FONT *f, int code);
+
+/** @brief Returns the glyph of a Unicode font for a code point (internal). */
+extern int oslGetFontGlyph(OSL_FONT *f, int code);
+
+/** @brief Draws count glyphs of a Unicode font, glyph i at (x + positions[2i], y + positions[2i + 1]) (internal). */
+extern void oslDrawFontGlyphs(OSL_FONT *f, int x, int y, const unsigned short *glyphs, const short *positions, int count);
+
+/** @brief Loads the rest of a Unicode .oft file once its header has been read (internal, use #oslLoadFontFile). */
+extern OSL_FONT *oslLoadUnicodeFont(VIRTUAL_FILE *f, const OSL_FONT_FORMAT_HEADER *fh);
+
+/** @brief Frees the glyph pages of a Unicode font (internal, called by #oslDeleteFont). */
+extern void oslDeleteFontPages(OSL_FONT_PAGES *p);
+
+/** @brief Draws a glyph from packed font data into an image (internal). */
+extern void oslDrawChar1BitToImage(OSL_IMAGE *img, int x0, int y0, int w, int h, int width, int bitPlanes, int imagePlanes, const unsigned char *font);
+
+/** @brief Frees the cached text box layouts.
+ *
+ *  The last 16 text boxes are kept ready to draw. The cache is cleared automatically when an OFT font is deleted;
+ *  call this to free the memory or after changing the character widths of a font.
+ */
+extern void oslClearTextLayoutCache();
+
 /** @brief Deletes a font.
  *
  *  Deletes the specified font. Ensure that the font to be deleted is not currently selected
@@ -0,0 +1,390 @@
+#include "oslib.h"
+
+/*
+    Text box layout cache.
+    Laying out a text box (measuring words, finding line breaks) is done once for a given font, box size, wrapping mode
+    and text. The result is kept as ready-made glyph sprites relative to the top-left corner of the box, plus the runs
+    of contiguous characters which get a background; drawing the box again only translates them. Boxes are identified by
+    a hash of all of this, checked against the stored text.
+    With Unicode fonts, the text is UTF-8 and the glyph pages may move in the atlas: glyph numbers and positions are
+    kept instead of sprites.
+*/
+
+#define OSL_TEXT_LAYOUT_CACHE_SIZE 16
+
+typedef struct {
+    u32 hash;
+    OSL_FONT *font;
+    int width, height, byWords;
+    char *text;
+    int nGlyphs, maxGlyphs;
+    OSL_FAST_VERTEX_COLOR32 *glyphs;     // Two vertices per glyph, relative to the box (color is set when drawing)
+    unsigned short *glyphIds;            // Unicode fonts: glyph numbers
+    short *positions;                    // and x, y of each glyph instead
+    int nRuns, maxRuns;
+    short *runs;                         // x, y, width of each run of contiguous characters
+    int lastUse;
+} OSL_TEXT_LAYOUT;
+
+static OSL_TEXT_LAYOUT osl_textLayouts[OSL_TEXT_LAYOUT_CACHE_SIZE];
+static int osl_textLayoutClock = 0;
+
+static void oslFreeTextLayout(OSL_TEXT_LAYOUT *l) {
+    free(l->text);
+    free(l->glyphs);
+    free(l->glyphIds);
+    free(l->positions);
+    free(l->runs);
+    memset(l, 0, sizeof(*l));
+}
+
+void oslClearTextLayoutCache() {
+    int i;
+
+    for (i = 0; i < OSL_TEXT_LAYOUT_CACHE_SIZE; i++)
+        oslFreeTextLayout(&osl_textLayouts[i]);
+}
+
+static u32 oslHashTextLayout(OSL_FONT *font, int width, int height, int byWords, const char *text) {
+    // FNV-1a
+    u32 hash = 2166136261u;
+
+    hash = (hash ^ (u32)(uintptr_t)font) * 16777619u;
+    hash = (hash ^ (u32)width) * 16777619u;
+    hash = (hash ^ (u32)height) * 16777619u;
+    hash = (hash ^ (u32)byWords) * 16777619u;
+    while (*text)
+        hash = (hash ^ (u8)*text++) * 16777619u;
+    return hash;
+}
+
+// Returns 0 if there is not enough memory (the glyph isn't added)
+static int oslAddLayoutGlyph(OSL_TEXT_LAYOUT *l, int c, int x, int y) {
+    OSL_FONT *f = l->font;
+    OSL_FAST_VERTEX_COLOR32 *vtx;
+    int u, v, tX, tY = f->charHeight, width = oslGetFontCharWidth(f, c);
+
+    if (l->nGlyphs >= l->maxGlyphs) {
+        int maxGlyphs = l->maxGlyphs ? l->maxGlyphs * 2 : 64;
+        // The arrays are only replaced once they have grown, so the layout stays valid if one of them can't
+        if (f->pages) {
+            unsigned short *glyphIds = (unsigned short*)realloc(l->glyphIds, maxGlyphs * sizeof(unsigned short));
+            short *positions;
+            if (!glyphIds)
+                return 0;
+            l->glyphIds = glyphIds;
+            positions = (short*)realloc(l->positions, maxGlyphs * 2 * sizeof(short));
+            if (!positions)
+                return 0;
+            l->positions = positions;
+        } else {
+            vtx = (OSL_FAST_VERTEX_COLOR32*)realloc(l->glyphs, maxGlyphs * 2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+            if (!vtx)
+                return 0;
+            l->glyphs = vtx;
+        }
+        l->maxGlyphs = maxGlyphs;
+    }
+
+    if (f->pages) {
+        l->glyphIds[l->nGlyphs] = oslGetFontGlyph(f, c);
+        l->positions[l->nGlyphs * 2] = x;
+        l->positions[l->nGlyphs * 2 + 1] = y;
+    } else {
+        u = f->charPositions[c] & (OSL_TEXT_TEXWIDTH - 1);
+        v = (f->charPositions[c] >> OSL_TEXT_TEXDECAL) * tY;
+        tX = width + f->addedSpace;
+
+        vtx = l->glyphs + l->nGlyphs * 2;
+        vtx[0].u = u;
+        vtx[0].v = v;
+        vtx[0].x = x;
+        vtx[0].y = y;
+        vtx[0].z = 0;
+        vtx[1].u = u + tX;
+        vtx[1].v = v + tY;
+        vtx[1].x = x + tX;
+        vtx[1].y = y + tY;
+        vtx[1].z = 0;
+    }
+    l->nGlyphs++;
+
+    // Extend the current background run or start a new one
+    if (l->nRuns && l->runs[(l->nRuns - 1) * 3 + 1] == y && l->runs[(l->nRuns - 1) * 3] + l->runs[(l->nRuns - 1) * 3 + 2] == x) {
+        l->runs[(l->nRuns - 1) * 3 + 2] += width;
+        return 1;
+    }
+    if (l->nRuns >= l->maxRuns) {
+        int maxRuns = l->maxRuns ? l->maxRuns * 2 : 16;
+        short *runs = (short*)realloc(l->runs, maxRuns * 3 * sizeof(short));
+        if (!runs)
+            return 0;
+        l->runs = runs;
+        l->maxRuns = maxRuns;
+    }
+    l->runs[l->nRuns * 3] = x;
+    l->runs[l->nRuns * 3 + 1] = y;
+    l->runs[l->nRuns * 3 + 2] = width;
+    l->nRuns++;
+    return 1;
+}
+
+// Wraps at any character (oslDrawTextBox); the box is (0, 0)-(x1, y1). Returns 0 if out of memory.
+static int oslLayoutTextBox(OSL_TEXT_LAYOUT *l, const char *text, int x1, int y1) {
+    OSL_FONT *f = l->font;
+    int x = 0, y = 0, x2, c, width;
+    const char *text2, *next;
+
+    while (*text) {
+        next = text;
+        c = oslReadFontChar(f, &next);
+
+        // At a space, go to the next line if the following word doesn't fit (the space is skipped)
+        if (c == ' ') {
+            text2 = text;
+            x2 = x;
+            do {
+                x2 += oslGetFontCharWidth(f, oslReadFontChar(f, &text2));
+                if (x2 > x1) {
+                    text = next;
+                    goto newline;
+                }
+            } while (*text2 != '\n' && *text2 != ' ' && *text2);
+        }
+
+        width = oslGetFontCharWidth(f, c);
+        if (x + width > x1 || c == '\n') {
+newline:
+            x = 0;
+            y += f->charHeight;
+            // Stop if the text exceeds the box height
+            if (y + f->charHeight > y1)
+                break;
+            if (*text == '\n')
+                text++;
+            continue;
+        }
+
+        if (!oslAddLayoutGlyph(l, c, x, y))
+            return 0;
+        x += width;
+        text = next;
+    }
+    return 1;
+}
+
+// Wraps at spaces (oslDrawTextBoxByWords); a word wider than the whole box is cut where it reaches the border. Returns 0
+// if out of memory.
+static int oslLayoutTextBoxByWords(OSL_TEXT_LAYOUT *l, const char *text, int x1, int y1) {
+    OSL_FONT *f = l->font;
+    int x = 0, y = 0, wordWidth, c, width;
+    const char *end;
+
+    while (*text) {
+        // Measure a word
+        wordWidth = 0;
+        for (end = text; *end != '\n' && *end != ' ' && *end; )
+            wordWidth += oslGetFontCharWidth(f, oslReadFontChar(f, &end));
+
+        if (end > text) {
+            // Move the word to the next line if it doesn't fit in the current one
+            if (x + wordWidth > x1 && x > 0) {
+                x = 0;
+                y += f->charHeight;
+                if (y > y1)
+                    return 1;
+            }
+
+            while (text < end) {
+                c = oslReadFontChar(f, &text);
+                width = oslGetFontCharWidth(f, c);
+                if (x > 0 && x + width > x1 && wordWidth > x1) {
+                    x = 0;
+                    y += f->charHeight;
+                    if (y > y1)
+                        return 1;
+                }
+                if (!oslAddLayoutGlyph(l, c, x, y))
+                    return 0;
+                x += width;
+            }
+        }
+
+        // Spaces only move the position
+        if (*text == ' ') {
+            x += oslGetFontCharWidth(f, ' ');
+            text++;
+        }
+
+        if (*text == '\n') {
+            x = 0;
+            y += f->charHeight;
+            if (y > y1)
+                return 1;
+            text++;
+        }
+    }
+    return 1;
+}
+
+static OSL_TEXT_LAYOUT *oslGetTextLayout(const char *text, int width, int height, int byWords) {
+    OSL_FONT *font = osl_curFont;
+    u32 hash = oslHashTextLayout(font, width, height, byWords, text);
+    OSL_TEXT_LAYOUT *l, *oldest = &osl_textLayouts[0];
+    int i;
+
+    osl_textLayoutClock++;
+    for (i = 0; i < OSL_TEXT_LAYOUT_CACHE_SIZE; i++) {
+        l = &osl_textLayouts[i];
+        if (l->text && l->hash == hash && l->font == font && l->width == width && l->height == height
+                && l->byWords == byWords && !strcmp(l->text, text)) {
+            l->lastUse = osl_textLayoutClock;
+            return l;
+        }
+        if (!l->text || (oldest->text && l->lastUse < oldest->lastUse))
+            oldest = l;
+    }
+
+    // Not in the cache: lay it out in place of the least recently used layout
+    l = oldest;
+    oslFreeTextLayout(l);
+    l->text = strdup(text);
+    if (!l->text)
+        return NULL;
+    l->hash = hash;
+    l->font = font;
+    l->width = width;
+    l->height = height;
+    l->byWords = byWords;
+    l->lastUse = osl_textLayoutClock;
+    // Out of memory: the box is not drawn, and not cached either
+    if (!(byWords ? oslLayoutTextBoxByWords(l, text, width, height) : oslLayoutTextBox(l, text, width, height))) {
+        oslFreeTextLayout(l);
+        return NULL;
+    }
+    return l;
+}
+
+static void oslDrawTextLayout(OSL_TEXT_LAYOUT *l, int x0, int y0) {
+    OSL_FAST_VERTEX_COLOR32 *vertices;
+    int i, batched, color;
+
+    if (!l || !l->nGlyphs)
+        return;
+
+    // Backgrounds: one sprite per run of characters, all in a single draw
+    if (osl_textBkColor & 0xff000000) {
+        OSL_LINE_VERTEX_COLOR32 *back = (OSL_LINE_VERTEX_COLOR32*)sceGuGetMemory(l->nRuns * 2 * sizeof(OSL_LINE_VERTEX_COLOR32));
+        color = oslBlendColor(osl_textBkColor);
+        for (i = 0; i < l->nRuns; i++) {
+            short *run = l->runs + i * 3;
+            back[i * 2].color = color;
+            back[i * 2].x = x0 + run[0];
+            back[i * 2].y = y0 + run[1];
+            back[i * 2].z = 0;
+            back[i * 2 + 1].color = color;
+            back[i * 2 + 1].x = x0 + run[0] + run[2] + l->font->addedSpace;
+            back[i * 2 + 1].y = y0 + run[1] + l->font->charHeight;
+            back[i * 2 + 1].z = 0;
+        }
+        oslDisableTexturing();
+        sceKernelDcacheWritebackRange(back, l->nRuns * 2 * sizeof(OSL_LINE_VERTEX_COLOR32));
+        oslGuDrawArray(GU_SPRITES, GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, l->nRuns * 2, 0, back);
+    }
+
+    // Unicode fonts: the glyphs are placed in the atlas now
+    if (l->font->pages) {
+        oslDrawFontGlyphs(l->font, x0, y0, l->glyphIds, l->positions, l->nGlyphs);
+        return;
+    }
+
+    oslSetTexture(l->font->img);
+    oslEnableTexturing();
+
+    vertices = (OSL_FAST_VERTEX_COLOR32*)oslAddBatchSprites(GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT, sizeof(OSL_FAST_VERTEX_COLOR32), l->nGlyphs);
+    batched = (vertices != NULL);
+    if (!batched)
+        vertices = (OSL_FAST_VERTEX_COLOR32*)sceGuGetMemory(l->nGlyphs * 2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+
+    // Replay the glyphs at the position of the box
+    color = oslBlendColor(osl_textColor);
+    for (i = 0; i < l->nGlyphs * 2; i++) {
+        vertices[i].u = l->glyphs[i].u;
+        vertices[i].v = l->glyphs[i].v;
+        vertices[i].color = color;
+        vertices[i].x = l->glyphs[i].x + x0;
+        vertices[i].y = l->glyphs[i].y + y0;
+        vertices[i].z = 0;
+    }
+
+    if (!batched) {
+        sceKernelDcacheWritebackRange(vertices, l->nGlyphs * 2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+        oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, l->nGlyphs * 2, 0, vertices);
+    }
+}
+
+void oslDrawTextBox(int x0, int y0, int x1, int y1, const char *text, int format) {
+    // Only OFT fonts are supported
+    if (!osl_curFont || osl_curFont->fontType != OSL_FONT_OFT)
+        return;
+
+    oslDrawTextLayout(oslGetTextLayout(text, x1 - x0, y1 - y0, 0), x0, y0);
+}
+
+void oslDrawTextBoxByWords(int x0, int y0, int x1, int y1, const char *text, int format) {
+    char buffer[64], *word;
+    int charCount, x = x0, y = y0, wordWidth;
+
+    if (!osl_curFont)
+        return;
+
+    if (osl_curFont->fontType == OSL_FONT_OFT) {
+        oslDrawTextLayout(oslGetTextLayout(text, x1 - x0, y1 - y0, 1), x0, y0);
+        return;
+    }
+
+    // intraFont: measure and draw word by word
+    while (*text) {
+        for (charCount = 0; text[charCount] != '\n' && text[charCount] != ' ' && text[charCount]; charCount++);
+
+        if (charCount > 0) {
+            // Long words don't fit in the buffer
+            word = (charCount < (int)sizeof(buffer)) ? buffer : (char*)malloc(charCount + 1);
+            if (!word)
+                return;
+            memcpy(word, text, charCount);
+            word[charCount] = '\0';
+            wordWidth = oslGetStringWidth(word);
+
+            // Move the word to the next line if it doesn't fit in the current one
+            if (x + wordWidth > x1 && x > x0) {
+                x = x0;
+                y += osl_curFont->charHeight;
+                if (y > y1) {
+                    if (word != buffer)
+                        free(word);
+                    return;
+                }
+            }
+
+            oslDrawString(x, y, word);
+            if (word != buffer)
+                free(word);
+            text += charCount;
+            x += wordWidth;
+        }
+
+        if (*text == ' ') {
+            x += osl_curFont->charWidths[' '];
+            text++;
+        }
+
+        if (*text == '\n') {
+            x = x0;
+            y += osl_curFont->charHeight;
+            if (y > y1)
+                return;
+            text++;
+        }
+    }
+}
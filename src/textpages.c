@@ -0,0 +1,381 @@
+#include "oslib.h"
+
+/*
+    Unicode OFT fonts ("OSLFont v02").
+    These fonts can hold thousands of glyphs, far too many to be rasterized in a texture when the font is loaded. The
+    glyph bitmaps stay packed in RAM as they are in the file, and the glyphs are decoded by pages of 64 (in code point
+    order) into a shared atlas of a few page slots, the first time one of them is drawn. When all the slots are taken,
+    the least recently used page is replaced.
+    A slot the GE may still be reading (used since the last oslEndDrawing / oslSyncDrawing) is not written by the CPU:
+    the page is decoded in the display list and uploaded with a GE transfer. The glyphs sent before still see the old
+    page and the ones sent after see the new one, so pages can be replaced in the middle of a frame.
+    The display list bytes taken by these uploads are capped by osl_fontPageUploadSize until the list is reset. Past the
+    cap, the GE is synced instead (oslSyncDrawing), which resets the list and lets the CPU write the slot.
+*/
+
+int osl_fontAtlasSize = 64 * 1024;
+int osl_fontPageUploadSize = 64 * 1024;
+
+// Display list bytes taken by page uploads since the list was last reset (osl_residencyEpoch changes with it)
+static int osl_fontPageUploadBytes;
+static u32 osl_fontPageUploadEpoch;
+
+static int oslFindFontGlyph(OSL_FONT_PAGES *p, int code) {
+    int lo = 0, hi = p->glyphCount - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) >> 1;
+        if (p->codes[mid] == (u32)code)
+            return mid;
+        if (p->codes[mid] < (u32)code)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+int oslReadUtf8(const char **str) {
+    const u8 *s = (const u8*)*str;
+    int c = s[0], length, i;
+
+    if (c < 0x80)
+        length = 1;
+    else if ((c & 0xe0) == 0xc0)
+        length = 2, c &= 0x1f;
+    else if ((c & 0xf0) == 0xe0)
+        length = 3, c &= 0x0f;
+    else if ((c & 0xf8) == 0xf0)
+        length = 4, c &= 0x07;
+    else
+        length = 0;
+
+    for (i = 1; i < length && (s[i] & 0xc0) == 0x80; i++)
+        c = (c << 6) | (s[i] & 0x3f);
+
+    // Not a valid sequence: take the byte alone (Latin-1)
+    if (i < length || length == 0) {
+        (*str)++;
+        return s[0];
+    }
+    *str += length;
+    return c;
+}
+
+int oslReadFontChar(OSL_FONT *f, const char **str) {
+    if (f->pages)
+        return oslReadUtf8(str);
+    return *(const u8*)(*str)++;
+}
+
+int oslGetFontGlyph(OSL_FONT *f, int code) {
+    OSL_FONT_PAGES *p = f->pages;
+    int glyph;
+
+    if (code >= 0 && code < 256)
+        return p->latinGlyphs[code];
+    glyph = oslFindFontGlyph(p, code);
+    return glyph >= 0 ? glyph : p->defaultGlyph;
+}
+
+int oslGetFontCharWidth(OSL_FONT *f, int code) {
+    if (f->pages)
+        return f->pages->widths[oslGetFontGlyph(f, code)];
+    return f->charWidths[code & 0xff];
+}
+
+// Decodes a page into a slot of the atlas
+static void oslLoadFontPage(OSL_FONT *f, int page, int slot) {
+    OSL_FONT_PAGES *p = f->pages;
+    OSL_IMAGE target = *f->img;
+    const int pixelPlaneWidth[4] = {3, 2, 2, 1};
+    int lineSize = f->img->realSizeX >> 1;
+    int size = lineSize * p->slotHeight;
+    int i, cell, first = page * OSL_FONT_PAGE_SIZE, last = oslMin(first + OSL_FONT_PAGE_SIZE, p->glyphCount);
+    int inFlight = p->slots[slot].page >= 0 && p->slots[slot].epoch == osl_residencyEpoch;
+    u8 *buffer;
+
+    if (osl_fontPageUploadEpoch != osl_residencyEpoch) {
+        osl_fontPageUploadEpoch = osl_residencyEpoch;
+        osl_fontPageUploadBytes = 0;
+    }
+    if (inFlight && osl_fontPageUploadBytes + size + 15 > osl_fontPageUploadSize) {
+        // Upload budget spent: wait for the GE, which also empties the display list, and write the slot directly.
+        // The glyphs placed in this pass are sent after the sync, so their slots are still in flight.
+        oslSyncDrawing();
+        osl_fontPageUploadEpoch = osl_residencyEpoch;
+        osl_fontPageUploadBytes = 0;
+        for (i = 0; i < p->slotCount; i++) {
+            if (p->slots[i].stamp == p->stamp)
+                p->slots[i].epoch = osl_residencyEpoch;
+        }
+        inFlight = 0;
+    }
+
+    if (inFlight) {
+        // Draws already sent may still read the slot: decode in the display list and let the GE copy the page when it
+        // gets there. Glyphs waiting in the batch are sent first. The transfer wants a 16-byte aligned source.
+        oslFlushSpriteBatch();
+        buffer = (u8*)sceGuGetMemory(size + 15);
+        buffer += -(uintptr_t)buffer & 15;
+        osl_fontPageUploadBytes += size + 15;
+    } else
+        // The GE is done with the slot
+        buffer = (u8*)f->img->data + slot * size;
+
+    memset(buffer, 0, size);
+    target.data = buffer;
+    for (i = first; i < last; i++) {
+        cell = i - first;
+        oslDrawChar1BitToImage(&target, (cell % p->cellsPerLine) * p->cellWidth, (cell / p->cellsPerLine) * f->charHeight,
+                               p->widths[i] + f->addedSpace, f->charHeight, p->lineWidth << pixelPlaneWidth[p->pixelFormat - 1],
+                               p->pixelFormat, 4, p->data + i * p->glyphSize);
+    }
+    sceKernelDcacheWritebackRange(buffer, size);
+
+    // 4-bit texels moved as 16-bit pixels. The glyphs sent next must not sample the slot before the transfer is over.
+    if (inFlight) {
+        sceGuCopyImage(GU_PSM_4444, 0, 0, lineSize / 2, p->slotHeight, lineSize / 2, buffer, 0, slot * p->slotHeight, lineSize / 2, f->img->data);
+        sceGuTexSync();
+    }
+    sceGuTexFlush();
+
+    if (p->slots[slot].page >= 0)
+        p->pageSlots[p->slots[slot].page] = -1;
+    p->slots[slot].page = page;
+    p->pageSlots[page] = slot;
+}
+
+// Finds the glyph in the atlas, decoding its page if needed. Returns 0 if that would replace a page used by glyphs not
+// sent yet.
+static int oslGetGlyphTile(OSL_FONT *f, int glyph, int *u, int *v) {
+    OSL_FONT_PAGES *p = f->pages;
+    int page = glyph / OSL_FONT_PAGE_SIZE, cell = glyph % OSL_FONT_PAGE_SIZE;
+    int slot = p->pageSlots[page], i;
+
+    if (slot < 0) {
+        slot = 0;
+        for (i = 1; i < p->slotCount; i++) {
+            if (p->slots[i].lastUse < p->slots[slot].lastUse)
+                slot = i;
+        }
+        if (p->slots[slot].stamp == p->stamp)
+            return 0;
+        oslLoadFontPage(f, page, slot);
+    }
+
+    p->slots[slot].lastUse = ++p->clock;
+    p->slots[slot].stamp = p->stamp;
+    p->slots[slot].epoch = osl_residencyEpoch;
+    *u = (cell % p->cellsPerLine) * p->cellWidth;
+    *v = slot * p->slotHeight + (cell / p->cellsPerLine) * f->charHeight;
+    return 1;
+}
+
+static void oslSendFontGlyphs(OSL_FONT *f, int x, int y, const unsigned short *glyphs, const short *positions,
+                              const unsigned short *indices, const short *tiles, int count) {
+    OSL_FAST_VERTEX_COLOR32 *vertices;
+    int color = oslBlendColor(osl_textColor);
+    int i, k, tX, tY = f->charHeight, batched;
+
+    oslSetTexture(f->img);
+    oslEnableTexturing();
+
+    vertices = (OSL_FAST_VERTEX_COLOR32*)oslAddBatchSprites(GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT, sizeof(OSL_FAST_VERTEX_COLOR32), count);
+    batched = (vertices != NULL);
+    if (!batched)
+        vertices = (OSL_FAST_VERTEX_COLOR32*)sceGuGetMemory(count * 2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+
+    for (i = 0; i < count; i++) {
+        OSL_FAST_VERTEX_COLOR32 *vtx = vertices + i * 2;
+        k = indices[i];
+        tX = f->pages->widths[glyphs[k]] + f->addedSpace;
+
+        vtx[0].u = tiles[i * 2];
+        vtx[0].v = tiles[i * 2 + 1];
+        vtx[0].color = color;
+        vtx[0].x = x + positions[k * 2];
+        vtx[0].y = y + positions[k * 2 + 1];
+        vtx[0].z = 0;
+
+        vtx[1].u = tiles[i * 2] + tX;
+        vtx[1].v = tiles[i * 2 + 1] + tY;
+        vtx[1].color = color;
+        vtx[1].x = vtx[0].x + tX;
+        vtx[1].y = vtx[0].y + tY;
+        vtx[1].z = 0;
+    }
+
+    if (!batched) {
+        sceKernelDcacheWritebackRange(vertices, count * 2 * sizeof(OSL_FAST_VERTEX_COLOR32));
+        oslGuDrawArray(GU_SPRITES, GU_TEXTURE_16BIT | GU_COLOR_8888 | GU_VERTEX_16BIT | GU_TRANSFORM_2D, count * 2, 0, vertices);
+    }
+}
+
+void oslDrawFontGlyphs(OSL_FONT *f, int x, int y, const unsigned short *glyphs, const short *positions, int count) {
+    OSL_FONT_PAGES *p = f->pages;
+    unsigned short waiting[OSL_FONT_GLYPH_GROUP], placed[OSL_FONT_GLYPH_GROUP];
+    short tiles[OSL_FONT_GLYPH_GROUP * 2];
+    int i, n, u, v, nWaiting, nPlaced, nLeft;
+
+    while (count > 0) {
+        n = oslMin(count, OSL_FONT_GLYPH_GROUP);
+        for (i = 0; i < n; i++)
+            waiting[i] = i;
+        nWaiting = n;
+
+        // Place the glyphs whose page is in the atlas or can be decoded in a free slot, and send them; the others wait
+        // for the next pass, when these slots can be replaced. The glyphs of a page are placed together, so a page is
+        // decoded at most once per group even if the atlas is too small.
+        while (nWaiting > 0) {
+            nPlaced = nLeft = 0;
+            for (i = 0; i < nWaiting; i++) {
+                if (oslGetGlyphTile(f, glyphs[waiting[i]], &u, &v)) {
+                    placed[nPlaced] = waiting[i];
+                    tiles[nPlaced * 2] = u;
+                    tiles[nPlaced * 2 + 1] = v;
+                    nPlaced++;
+                } else
+                    waiting[nLeft++] = waiting[i];
+            }
+            oslSendFontGlyphs(f, x, y, glyphs, positions, placed, tiles, nPlaced);
+            nWaiting = nLeft;
+
+            // These glyphs are sent (or batched, and a page load flushes the batch first): their pages may be replaced
+            p->stamp++;
+        }
+
+        glyphs += n;
+        positions += n * 2;
+        count -= n;
+    }
+}
+
+void oslDeleteFontPages(OSL_FONT_PAGES *p) {
+    if (!p)
+        return;
+    free(p->codes);
+    free(p->widths);
+    free(p->data);
+    free(p->pageSlots);
+    free(p->slots);
+    free(p);
+}
+
+OSL_FONT *oslLoadUnicodeFont(VIRTUAL_FILE *f, const OSL_FONT_FORMAT_HEADER *fh) {
+    OSL_FONT *font;
+    OSL_FONT_PAGES *p;
+    u32 glyphCount;
+    int i, maxWidth = 0, lines, slotCount;
+
+    if (fh->pixelFormat < 1 || fh->pixelFormat > 4 || fh->charHeight <= 0 || fh->lineWidth <= 0)
+        return NULL;
+    // Glyph numbers are 16-bit
+    if (VirtualFileRead(&glyphCount, sizeof(glyphCount), 1, f) == 0 || glyphCount == 0 || glyphCount > 65536)
+        return NULL;
+
+    font = (OSL_FONT*)malloc(sizeof(OSL_FONT));
+    if (!font)
+        return NULL;
+    memset(font, 0, sizeof(OSL_FONT));
+    font->fontType = OSL_FONT_OFT;
+    font->charWidth = fh->charWidth;
+    font->charHeight = fh->charHeight;
+    font->addedSpace = fh->addedSpace;
+    font->isCharWidthConstant = !fh->variableWidth;
+
+    p = font->pages = (OSL_FONT_PAGES*)malloc(sizeof(OSL_FONT_PAGES));
+    if (!p)
+        goto _error;
+    memset(p, 0, sizeof(OSL_FONT_PAGES));
+    p->glyphCount = glyphCount;
+    p->pageCount = (glyphCount + OSL_FONT_PAGE_SIZE - 1) / OSL_FONT_PAGE_SIZE;
+    p->pixelFormat = fh->pixelFormat;
+    p->lineWidth = fh->lineWidth;
+    p->glyphSize = fh->lineWidth * fh->charHeight;
+
+    p->codes = (u32*)malloc(glyphCount * sizeof(u32));
+    p->widths = (u8*)malloc(glyphCount);
+    p->data = (u8*)malloc(glyphCount * p->glyphSize);
+    font->charWidths = (u8*)malloc(256);
+    if (!p->codes || !p->widths || !p->data || !font->charWidths)
+        goto _error;
+
+    // Code points (ascending), widths, glyph bitmaps, palette
+    if (VirtualFileRead(p->codes, glyphCount * sizeof(u32), 1, f) == 0)
+        goto _error;
+    if (fh->variableWidth) {
+        if (VirtualFileRead(p->widths, glyphCount, 1, f) == 0)
+            goto _error;
+    } else
+        memset(p->widths, fh->charWidth, glyphCount);
+    if (VirtualFileRead(p->data, glyphCount * p->glyphSize, 1, f) == 0)
+        goto _error;
+    for (i = 0; i < (int)glyphCount; i++) {
+        if (i > 0 && p->codes[i] <= p->codes[i - 1])
+            goto _error;
+        maxWidth = oslMax(maxWidth, p->widths[i]);
+    }
+
+    // Missing characters are drawn as '?' (or the first glyph)
+    p->defaultGlyph = oslMax(oslFindFontGlyph(p, '?'), 0);
+    for (i = 0; i < 256; i++) {
+        int glyph = oslFindFontGlyph(p, i);
+        p->latinGlyphs[i] = glyph >= 0 ? glyph : p->defaultGlyph;
+        font->charWidths[i] = p->widths[p->latinGlyphs[i]];
+    }
+
+    // Page slots: a page is a block of cells as wide as the widest glyph. There are as many slots as the atlas size
+    // allows, within the 512 lines of a texture.
+    p->cellWidth = maxWidth + font->addedSpace;
+    if (p->cellWidth <= 0 || p->cellWidth > OSL_TEXT_TEXWIDTH)
+        goto _error;
+    p->cellsPerLine = oslMin(OSL_TEXT_TEXWIDTH / p->cellWidth, OSL_FONT_PAGE_SIZE);
+    lines = (OSL_FONT_PAGE_SIZE + p->cellsPerLine - 1) / p->cellsPerLine;
+    p->slotHeight = lines * font->charHeight;
+    slotCount = oslMin(osl_fontAtlasSize / (OSL_TEXT_TEXWIDTH / 2 * p->slotHeight), 512 / p->slotHeight);
+    p->slotCount = oslMax(oslMin(slotCount, p->pageCount), 1);
+    if (p->slotHeight > 512)
+        goto _error;
+
+    p->pageSlots = (short*)malloc(p->pageCount * sizeof(short));
+    p->slots = (OSL_FONT_PAGE_SLOT*)malloc(p->slotCount * sizeof(OSL_FONT_PAGE_SLOT));
+    if (!p->pageSlots || !p->slots)
+        goto _error;
+    for (i = 0; i < p->pageCount; i++)
+        p->pageSlots[i] = -1;
+    for (i = 0; i < p->slotCount; i++) {
+        p->slots[i].page = -1;
+        p->slots[i].lastUse = 0;
+        p->slots[i].stamp = 0;
+        p->slots[i].epoch = 0;
+    }
+    p->stamp = 1;
+
+    font->img = oslCreateImage(OSL_TEXT_TEXWIDTH, p->slotCount * p->slotHeight, OSL_IN_RAM, OSL_PF_4BIT);
+    if (!font->img)
+        goto _error;
+    font->img->palette = oslCreatePalette(16, OSL_PF_8888);
+    if (!font->img->palette)
+        goto _error;
+    if (fh->paletteCount) {
+        u32 entry;
+        for (i = 0; i < fh->paletteCount; i++) {
+            if (VirtualFileRead(&entry, sizeof(entry), 1, f) == 0)
+                break;
+            if (i < font->img->palette->nElements)
+                ((u32*)font->img->palette->data)[i] = entry;
+        }
+    } else {
+        ((u32*)font->img->palette->data)[0] = RGBA(255, 255, 255, 0);
+        ((u32*)font->img->palette->data)[1] = RGBA(255, 255, 255, 255);
+    }
+    sceKernelDcacheWritebackInvalidateRange(font->img->palette->data, 16 * 4);
+    memset(font->img->data, 0, font->img->totalSize);
+    sceKernelDcacheWritebackInvalidateRange(font->img->data, font->img->totalSize);
+    return font;
+
+_error:
+    oslDeleteFont(font);
+    return NULL;
+}
@@ -292,44 +292,95 @@ void VirtualFileInit() {
     osl_tempFile.type = NULL;
 }
 
-// Read an entire file into memory
-void *oslReadEntireFileToMemory(VIRTUAL_FILE *f, int *fileSize) {
-    void *block = NULL;
-    int add = 0;
-    int size = 0, readSize, finalSize = 0;
+int VirtualFileGetSize(VIRTUAL_FILE *f) {
+    VIRTUAL_FILE_SOURCE *source = VirtualFileGetSource(f);
+    int position, size;
 
-    do {
-        size += BLOCK_SIZE;
+    if (!source->fSeek || !source->fTell)
+        return -1;
 
-        if (block == NULL) {
-            // First allocation with malloc
-            block = malloc(size);
-        } else {
-            // Use realloc to expand the memory block
-            void *temp = realloc(block, size);
+    position = source->fTell(f);
+    if (position < 0)
+        return -1;
+    source->fSeek(f, 0, SEEK_END);
+    size = source->fTell(f);
+    source->fSeek(f, position, SEEK_SET);
+    return size >= position ? size : -1;
+}
+
+// Number of bytes left to read, -1 if unknown
+static int oslGetRemainingFileSize(VIRTUAL_FILE *f) {
+    int size = VirtualFileGetSize(f);
+    return size >= 0 ? size - VirtualFileTell(f) : -1;
+}
+
+// Read an entire file into memory
+void *oslReadEntireFileToMemory(VIRTUAL_FILE *f, int *fileSize) {
+    char *block, *temp;
+    int size = 0, capacity, readSize;
+
+    // When the source knows the size, a single allocation is enough (one more byte to see the end of the file without growing)
+    capacity = oslGetRemainingFileSize(f);
+    capacity = capacity >= 0 ? capacity + 1 : BLOCK_SIZE;
+
+    block = (char*)malloc(capacity);
+    if (!block)
+        return NULL;
+
+    for (;;) {
+        // Unknown or wrong size: double the block
+        if (size == capacity) {
+            capacity *= 2;
+            temp = (char*)realloc(block, capacity);
             if (!temp) {
                 free(block);
                 return NULL;
             }
-            block = temp;  // Update the block pointer only after successful realloc
+            block = temp;
         }
 
-        if (!block) {
-            return NULL;
-        }
+        readSize = VirtualFileRead(block + size, 1, capacity - size, f);
+        if (readSize <= 0)
+            break;
+        size += readSize;
+    }
 
-        readSize = VirtualFileRead((char*)block + add, 1, BLOCK_SIZE, f);
-        add += BLOCK_SIZE;
-        finalSize += readSize;
-    } while (readSize >= BLOCK_SIZE);
+    // Give back what the doubling left unused
+    if (capacity - size >= BLOCK_SIZE) {
+        temp = (char*)realloc(block, oslMax(size, 1));
+        if (temp)
+            block = temp;
+    }
 
     if (fileSize) {
-        *fileSize = finalSize;
+        *fileSize = size;
     }
 
     return block;
 }
 
+int oslReadEntireFileToBuffer(VIRTUAL_FILE *f, void *buffer, int bufferSize) {
+    int size = 0, readSize, remaining;
+    char extra;
+
+    // Don't read anything if we know it won't fit
+    remaining = oslGetRemainingFileSize(f);
+    if (remaining > bufferSize)
+        return -1;
+
+    while (size < bufferSize) {
+        readSize = VirtualFileRead((char*)buffer + size, 1, bufferSize - size, f);
+        if (readSize <= 0)
+            return size;
+        size += readSize;
+    }
+
+    // The buffer is full: the file must end here
+    if (VirtualFileRead(&extra, 1, 1, f) > 0)
+        return -1;
+    return size;
+}
+
 void oslSetTempFileData(void *data, int size, int *type) {
     osl_tempFile.data = data;
     osl_tempFile.size = size;
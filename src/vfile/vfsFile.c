@@ -7,7 +7,7 @@
 #define FLAG_EOF 1
 int VF_FILE = -1;
 
-#define _file_ ((SceUID)f->ioPtr)
+#define _file_ ((SceUID)(intptr_t)f->ioPtr)
 
 int vfsFileOpen(void *param1, int param2, int type, int mode, VIRTUAL_FILE* f) {
     int stdMode = PSP_O_RDONLY;
@@ -21,8 +21,8 @@ int vfsFileOpen(void *param1, int param2, int type, int mode, VIRTUAL_FILE* f) {
             break;
     }
 
-    f->ioPtr = (void*)sceIoOpen((char*)param1, stdMode, 0777);
-    return (s32)f->ioPtr >= 0;  // Return true if file descriptor is valid
+    f->ioPtr = (void*)(intptr_t)sceIoOpen((char*)param1, stdMode, 0777);
+    return _file_ >= 0;  // Return true if file descriptor is valid
 }
 
 int vfsFileClose(VIRTUAL_FILE *f) {
@@ -125,6 +125,8 @@ float oslSin(float angle, float dist) {
 
 #include <math.h>
 
+#define DEG_TO_RAD 0.0174532925f
+
 float vfpu_sini(int f1, int f2) {
 	return sinf(f1 * DEG_TO_RAD) * f2;
 }
@@ -133,22 +135,22 @@ float vfpu_cosi(int f1, int f2) {
 	return cosf(f1 * DEG_TO_RAD) * f2;
 }
 
-float vfpu_cosf(float f1, float f2) {
+float oslVfpu_cosf(float f1, float f2) {
 	return cosf(f1) * f2;
 }
 
-float vfpu_sinf(float f1, float f2) {
+float oslVfpu_sinf(float f1, float f2) {
 	return sinf(f1) * f2;
 }
 
 // Cosine function wrapper for non-PSP
 float oslCos(float angle, float dist) {
-	return vfpu_cosf(angle * DEG_TO_RAD, dist);
+	return oslVfpu_cosf(angle * DEG_TO_RAD, dist);
 }
 
 // Sine function wrapper for non-PSP
 float oslSin(float angle, float dist) {
-	return vfpu_sinf(angle * DEG_TO_RAD, dist);
+	return oslVfpu_sinf(angle * DEG_TO_RAD, dist);
 }
 
 #endif
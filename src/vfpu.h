@@ -58,6 +58,26 @@ extern float oslVfpu_sinf(float angle, float rayon);
  */
 extern float oslVfpu_cosf(float angle, float rayon);
 
+/**
+ * @brief Copies 16 bytes with a single VFPU quadword load and store.
+ *
+ * Both addresses must be aligned on 16 bytes. Used by the texture (un)swizzling routines.
+ *
+ * @param dst Destination address.
+ * @param src Source address.
+ */
+static inline void oslVfpuCopyQuad(void *dst, const void *src)
+{
+#ifdef PSP
+	__asm__ volatile (
+		"lv.q    C000, %1\n"
+		"sv.q    C000, %0\n"
+		: "=m"(*(u32 (*)[4])dst) : "m"(*(const u32 (*)[4])src));
+#else
+	memcpy(dst, src, 16);
+#endif
+}
+
 /** @} */ // end of vfpu
 
 #ifdef __cplusplus
@@ -1,39 +1,269 @@
 #include "oslib.h"
 
 //We're beginning at the VRAM base
-u32 osl_vramBase = 0x40000000;
+uintptr_t osl_vramBase = 0x40000000;
 //2 MBytes
 int osl_vramSize = 2 << 20;
 //Use it or not?
 int osl_useVramManager = 1;
-u32 osl_currentVramPtr;
+uintptr_t osl_currentVramPtr;
 
 #define DEFAULT_TABLE_SIZE 1024
 
-int osl_vramBlocksMax = 0, osl_vramBlocksNb = 0;
+/*
+        Blocks are kept in a descriptor pool and linked in two ways:
+        - physically, in address order (prevPhys / nextPhys), so that a freed block can be merged with its neighbours in O(1)
+        - free blocks are also linked in segregated lists (prevFree / nextFree), one per size class, TLSF-style: the first level is
+          log2(size), the second level splits each power of two in VRAM_SL_COUNT ranges. Two bitmaps tell which lists are not empty,
+          so finding a block large enough is just a couple of bit scans.
+        Allocated blocks are found back from their address through a small hash table (nextHash).
+        All sizes and offsets are in bytes and always multiples of 16.
+ */
+#define VRAM_NONE                       (-1)
+#define VRAM_SL_LOG2            2
+#define VRAM_SL_COUNT           (1 << VRAM_SL_LOG2)
+#define VRAM_FL_COUNT           32
 
 typedef struct          {
 	u32 offset, size;
+	int prevPhys, nextPhys;
+	//For free blocks: links in the size class list. For unused descriptors, nextFree links the pool free list.
+	int prevFree, nextFree;
+	int nextHash;
+	u8 free;
+	//Allocated blocks only: who to notify when oslVramMgrCompact moves the block (NULL = the block can't be moved)
+	void *owner;
+	OSL_VRAM_RELOCATE_CALLBACK relocate;
 } OSL_VRAMBLOCK;
 
-#define isBlockFree(i)                          (osl_vramBlocks[i].size & 0x80000000)
-#define getBlockSize(i)                         (osl_vramBlocks[i].size & 0x7fffffff)
-#define getBlockOffset(i)                       (osl_vramBlocks[i].offset)
+int osl_vramBlocksMax = 0, osl_vramBlocksNb = 0;
+OSL_VRAMBLOCK *osl_vramBlocks;
 
-#define setBlockFree(i, free)           (osl_vramBlocks[i].size = (osl_vramBlocks[i].size & ((free)? 0xffffffff : 0x7fffffff)) | ((free)? 0x80000000 : 0))
-#define setBlockSize(i, nsize)          (osl_vramBlocks[i].size = (osl_vramBlocks[i].size & ~0x7fffffff) | (nsize))
-#define setBlockOffset(i, noffset)      (osl_vramBlocks[i].offset = noffset)
+//First unused descriptor, and the block with the highest address (the one resized by oslVramMgrSetParameters)
+static int osl_vramUnusedBlock = VRAM_NONE, osl_vramLastBlock = VRAM_NONE;
+//Segregated free lists
+static u32 osl_vramFlBitmap, osl_vramSlBitmap[VRAM_FL_COUNT];
+static int osl_vramFreeLists[VRAM_FL_COUNT][VRAM_SL_COUNT];
+//Address -> allocated block
+static int *osl_vramHash;
+static u32 osl_vramHashBits;
 
-OSL_VRAMBLOCK *osl_vramBlocks;
+#define vramBlock(i)                            (osl_vramBlocks[i])
+
+static inline int vramFls(u32 value)            {
+	return 31 - __builtin_clz(value);
+}
+
+static inline int vramFfs(u32 value)            {
+	return __builtin_ctz(value);
+}
+
+//Size class where a block of this size is stored
+static void vramMappingInsert(u32 size, int *fl, int *sl)               {
+	u32 units = size >> 4;
+	if (units < VRAM_SL_COUNT)              {
+		*fl = 0;
+		*sl = units;
+	}
+	else            {
+		int f = vramFls(units);
+		*sl = (units >> (f - VRAM_SL_LOG2)) ^ VRAM_SL_COUNT;
+		*fl = f - VRAM_SL_LOG2 + 1;
+	}
+}
+
+//Smallest size class where every block is large enough for this size
+static void vramMappingSearch(u32 size, int *fl, int *sl)               {
+	u32 units = size >> 4;
+	if (units >= VRAM_SL_COUNT)
+		units += (1 << (vramFls(units) - VRAM_SL_LOG2)) - 1;
+	vramMappingInsert(units << 4, fl, sl);
+}
+
+static void vramInsertFree(int i)               {
+	int fl, sl, head;
+	vramMappingInsert(vramBlock(i).size, &fl, &sl);
+	head = osl_vramFreeLists[fl][sl];
+	vramBlock(i).free = 1;
+	vramBlock(i).prevFree = VRAM_NONE;
+	vramBlock(i).nextFree = head;
+	if (head != VRAM_NONE)
+		vramBlock(head).prevFree = i;
+	osl_vramFreeLists[fl][sl] = i;
+	osl_vramFlBitmap |= 1 << fl;
+	osl_vramSlBitmap[fl] |= 1 << sl;
+}
+
+static void vramRemoveFree(int i)               {
+	int fl, sl;
+	int prev = vramBlock(i).prevFree, next = vramBlock(i).nextFree;
+	vramMappingInsert(vramBlock(i).size, &fl, &sl);
+	if (next != VRAM_NONE)
+		vramBlock(next).prevFree = prev;
+	if (prev != VRAM_NONE)
+		vramBlock(prev).nextFree = next;
+	else            {
+		osl_vramFreeLists[fl][sl] = next;
+		if (next == VRAM_NONE)          {
+			osl_vramSlBitmap[fl] &= ~(1 << sl);
+			if (!osl_vramSlBitmap[fl])
+				osl_vramFlBitmap &= ~(1 << fl);
+		}
+	}
+	vramBlock(i).free = 0;
+}
+
+//Returns a free block of at least size bytes, or VRAM_NONE
+static int vramFindFree(u32 size)               {
+	int fl, sl;
+	u32 slMap, flMap;
+	int i;
+	vramMappingSearch(size, &fl, &sl);
+	if (fl < VRAM_FL_COUNT)         {
+		slMap = osl_vramSlBitmap[fl] & (~0u << sl);
+		if (!slMap)             {
+			flMap = (fl + 1 < VRAM_FL_COUNT) ? (osl_vramFlBitmap & (~0u << (fl + 1))) : 0;
+			if (flMap)              {
+				fl = vramFfs(flMap);
+				slMap = osl_vramSlBitmap[fl];
+			}
+		}
+		if (slMap)
+			return osl_vramFreeLists[fl][vramFfs(slMap)];
+	}
+	//Nothing in the upper classes: the only candidates left are in the class of the size itself (e.g. a block of exactly this size)
+	vramMappingInsert(size, &fl, &sl);
+	for (i = osl_vramFreeLists[fl][sl]; i != VRAM_NONE; i = vramBlock(i).nextFree)          {
+		if (vramBlock(i).size >= size)
+			return i;
+	}
+	return VRAM_NONE;
+}
+
+static inline u32 vramHashKey(u32 offset)               {
+	return ((offset >> 4) * 2654435761u) >> (32 - osl_vramHashBits);
+}
+
+static void vramHashInsert(int i)               {
+	u32 key = vramHashKey(vramBlock(i).offset);
+	vramBlock(i).nextHash = osl_vramHash[key];
+	osl_vramHash[key] = i;
+}
+
+//Finds an allocated block by offset and removes it from the hash table
+static int vramHashRemove(u32 offset)           {
+	int *link = &osl_vramHash[vramHashKey(offset)];
+	while (*link != VRAM_NONE)              {
+		int i = *link;
+		if (vramBlock(i).offset == offset)              {
+			*link = vramBlock(i).nextHash;
+			return i;
+		}
+		link = &vramBlock(i).nextHash;
+	}
+	return VRAM_NONE;
+}
+
+//The hash table is sized after the descriptor pool, so that chains stay short
+static int vramHashResize()             {
+	int i, *oldHash = osl_vramHash;
+	u32 bits = 1, oldBits = osl_vramHashBits;
+	while ((1 << bits) < osl_vramBlocksMax)
+		bits++;
+	osl_vramHash = (int*)malloc(sizeof(int) << bits);
+	if (!osl_vramHash)              {
+		osl_vramHash = oldHash;
+		return 0;
+	}
+	osl_vramHashBits = bits;
+	for (i = 0; i < (1 << bits); i++)
+		osl_vramHash[i] = VRAM_NONE;
+	//Move the existing entries to the new table
+	if (oldHash)            {
+		for (i = 0; i < (1 << oldBits); i++)            {
+			int j = oldHash[i];
+			while (j != VRAM_NONE)          {
+				int next = vramBlock(j).nextHash;
+				vramHashInsert(j);
+				j = next;
+			}
+		}
+		free(oldHash);
+	}
+	return 1;
+}
+
+//Adds descriptors [first, osl_vramBlocksMax) to the pool of unused ones
+static void vramAddUnusedBlocks(int first)              {
+	int i;
+	for (i = osl_vramBlocksMax - 1; i >= first; i--)                {
+		vramBlock(i).size = 0xffffffff;
+		vramBlock(i).free = 0;
+		vramBlock(i).nextFree = osl_vramUnusedBlock;
+		osl_vramUnusedBlock = i;
+	}
+}
+
+static int vramNewBlock()               {
+	int i;
+	if (osl_vramUnusedBlock == VRAM_NONE)           {
+		// No more memory for the array? Let's expand it
+		OSL_VRAMBLOCK *newBlocks = (OSL_VRAMBLOCK*)realloc(osl_vramBlocks, (osl_vramBlocksMax + DEFAULT_TABLE_SIZE) * sizeof(OSL_VRAMBLOCK));
+		if (!newBlocks)
+			return VRAM_NONE;
+		osl_vramBlocks = newBlocks;
+		osl_vramBlocksMax += DEFAULT_TABLE_SIZE;
+		vramAddUnusedBlocks(osl_vramBlocksMax - DEFAULT_TABLE_SIZE);
+		//Not fatal if it fails, the chains will just be longer
+		vramHashResize();
+	}
+	i = osl_vramUnusedBlock;
+	osl_vramUnusedBlock = vramBlock(i).nextFree;
+	vramBlock(i).free = 0;
+	vramBlock(i).prevPhys = vramBlock(i).nextPhys = VRAM_NONE;
+	vramBlock(i).prevFree = vramBlock(i).nextFree = VRAM_NONE;
+	vramBlock(i).nextHash = VRAM_NONE;
+	vramBlock(i).owner = NULL;
+	vramBlock(i).relocate = NULL;
+	osl_vramBlocksNb++;
+	return i;
+}
+
+static void vramReleaseBlock(int i)             {
+	vramBlock(i).size = 0xffffffff;
+	vramBlock(i).free = 0;
+	vramBlock(i).nextFree = osl_vramUnusedBlock;
+	osl_vramUnusedBlock = i;
+	osl_vramBlocksNb--;
+}
+
+//Merges block j (which must directly follow i) into i. j must not be in a free list anymore.
+static void vramAbsorbNext(int i, int j)                {
+	int next = vramBlock(j).nextPhys;
+	vramBlock(i).size += vramBlock(j).size;
+	vramBlock(i).nextPhys = next;
+	if (next != VRAM_NONE)
+		vramBlock(next).prevPhys = i;
+	else
+		osl_vramLastBlock = i;
+	vramReleaseBlock(j);
+}
 
 void oslVramMgrInit() {
+	int i, j;
+
 	// If we don't use it OR it has already been initialized
 	if (!osl_useVramManager || osl_vramBlocksMax > 0)
 		return;
 
-	osl_vramBlocksMax = DEFAULT_TABLE_SIZE;
-	osl_vramBlocksNb = 1;
-	osl_vramBlocks = (OSL_VRAMBLOCK*)malloc(osl_vramBlocksMax * sizeof(OSL_VRAMBLOCK));
+	osl_vramBlocks = (OSL_VRAMBLOCK*)malloc(DEFAULT_TABLE_SIZE * sizeof(OSL_VRAMBLOCK));
+	if (osl_vramBlocks)             {
+		osl_vramBlocksMax = DEFAULT_TABLE_SIZE;
+		if (!vramHashResize())          {
+			free(osl_vramBlocks);
+			osl_vramBlocks = NULL;
+		}
+	}
 	if (!osl_vramBlocks) {
 		osl_useVramManager = 0;
 		osl_vramBlocksMax = 0;
@@ -41,31 +271,37 @@ void oslVramMgrInit() {
 		return;
 	}
 
-	// Initialize the first block's size to 0
-	osl_vramBlocks[0].size = 0;
+	osl_vramBlocksNb = 0;
+	osl_vramUnusedBlock = VRAM_NONE;
+	vramAddUnusedBlocks(0);
+	osl_vramFlBitmap = 0;
+	for (i = 0; i < VRAM_FL_COUNT; i++)             {
+		osl_vramSlBitmap[i] = 0;
+		for (j = 0; j < VRAM_SL_COUNT; j++)
+			osl_vramFreeLists[i][j] = VRAM_NONE;
+	}
 
 	// First block: free, total size of VRAM, address 0
-	setBlockOffset(0, 0);
-	// The block size must be divided by 16 because we don't use bytes; otherwise, it would be impossible to encode all of VRAM in 16 bits
-	setBlockSize(0, osl_vramSize);
-	setBlockFree(0, 1);
+	i = vramNewBlock();
+	vramBlock(i).offset = 0;
+	vramBlock(i).size = osl_vramSize;
+	vramInsertFree(i);
+	osl_vramLastBlock = i;
 }
 
 void *oslVramMgrAllocBlock(int blockSize) {
-	int i;
+	int i, rest;
 
-	osl_skip = osl_vramBlocks[0].size;
 	// The block cannot be of zero or negative size
 	if (blockSize <= 0)
 		return NULL;
 
 	// The size is always a multiple of 16 - round up to the next block
-	if (blockSize & 15)
-		blockSize += 16;
+	blockSize = (blockSize + 15) & ~15;
 
 	// Without the manager, it's simpler...
 	if (!osl_useVramManager) {
-		int ptr = osl_currentVramPtr;
+		uintptr_t ptr = osl_currentVramPtr;
 		// Memory overflow?
 		if (osl_currentVramPtr + blockSize >= osl_vramBase + osl_vramSize)
 			return NULL;
@@ -73,67 +309,50 @@ void *oslVramMgrAllocBlock(int blockSize) {
 		return (void*)ptr;
 	}
 
-	for (i = 0; i < osl_vramBlocksNb; i++) {
-		// Is this block sufficient?
-		if (isBlockFree(i) && getBlockSize(i) >= blockSize)
-			break;
-	}
-
+	i = vramFindFree(blockSize);
 	// No free block
-	if (i >= osl_vramBlocksNb)
+	if (i == VRAM_NONE)
 		return NULL;
 
-	// Exactly the needed memory? - not handled, the last block must always be marked as free (even if 0 bytes are left) for ulSetTexVramParameters
-	if (getBlockSize(i) == blockSize && i != osl_vramBlocksNb - 1) {
-		// It is no longer free
-		setBlockFree(i, 0);
-	} else {
-		// We will add a new block
-		osl_vramBlocksNb++;
+	vramRemoveFree(i);
 
-		// No more memory for the array? Let's expand it
-		if (osl_vramBlocksNb >= osl_vramBlocksMax) {
-			OSL_VRAMBLOCK *oldBlock = osl_vramBlocks;
-			osl_vramBlocksMax += DEFAULT_TABLE_SIZE;
-			osl_vramBlocks = (OSL_VRAMBLOCK*)realloc(osl_vramBlocks, osl_vramBlocksMax);
-
-			// Check that memory allocation was successful
-			if (!osl_vramBlocks) {
-				osl_vramBlocks = oldBlock;
-				osl_vramBlocksMax -= DEFAULT_TABLE_SIZE;
-				// Not enough memory
-				return NULL;
-			}
+	// Split the block if there is some memory left
+	if (vramBlock(i).size > (u32)blockSize)         {
+		rest = vramNewBlock();
+		if (rest == VRAM_NONE)          {
+			// Not enough memory to describe the remaining part
+			vramInsertFree(i);
+			return NULL;
 		}
-
-		// Shift to insert our new element
-		memmove(osl_vramBlocks + i + 1, osl_vramBlocks + i, sizeof(OSL_VRAMBLOCK) * (osl_vramBlocksNb - i - 1));
-
-		// Fill our new block
-		setBlockSize(i, blockSize);
-		// It has the address of the block that was there before
-		setBlockOffset(i, getBlockOffset(i + 1));
-		// It is not free
-		setBlockFree(i, 0);
-
-		// For the next one, its size decreases
-		setBlockSize(i + 1, getBlockSize(i + 1) - blockSize);
-		// WARNING: offset calculation
-		setBlockOffset(i + 1, getBlockOffset(i + 1) + blockSize);
+		vramBlock(rest).offset = vramBlock(i).offset + blockSize;
+		vramBlock(rest).size = vramBlock(i).size - blockSize;
+		vramBlock(rest).prevPhys = i;
+		vramBlock(rest).nextPhys = vramBlock(i).nextPhys;
+		if (vramBlock(rest).nextPhys != VRAM_NONE)
+			vramBlock(vramBlock(rest).nextPhys).prevPhys = rest;
+		else
+			osl_vramLastBlock = rest;
+		vramBlock(i).nextPhys = rest;
+		vramBlock(i).size = blockSize;
+		vramInsertFree(rest);
 	}
 
+	vramBlock(i).owner = NULL;
+	vramBlock(i).relocate = NULL;
+	vramHashInsert(i);
+
 	// Note: the offset must be translated into a real address
-	return (void*)(getBlockOffset(i) + osl_vramBase);
+	return (void*)(vramBlock(i).offset + osl_vramBase);
 }
 
 // Note: we need to translate a real address into an offset
 int oslVramMgrFreeBlock(void *blockAddress, int blockSize) {
-	int i, j, updateNeeded;
-	int blockOffset = (u32)blockAddress - (u32)osl_vramBase;
+	int i, neighbour;
+	u32 blockOffset = (uintptr_t)blockAddress - osl_vramBase;
 
 	// Without the manager, it's simpler...
 	if (!osl_useVramManager) {
-		osl_currentVramPtr -= blockSize;
+		osl_currentVramPtr -= (blockSize + 15) & ~15;
 		// Not really useful, just here to ensure we never exceed the allocated space
 		if (osl_currentVramPtr < osl_vramBase)
 			osl_currentVramPtr = osl_vramBase;
@@ -141,65 +360,174 @@ int oslVramMgrFreeBlock(void *blockAddress, int blockSize) {
 	}
 
 	// Let's find the correct block
-	for (i = 0; i < osl_vramBlocksNb; i++) {
-		if (getBlockOffset(i) == blockOffset)
-			break;
-	}
+	i = vramHashRemove(blockOffset);
 
 	// Unable to find the block
-	if (i >= osl_vramBlocksNb)
+	if (i == VRAM_NONE)
 		return 0;
 
-	// The block is now free ^^
-	setBlockFree(i, 1);
-
 	// Now let's "merge" adjacent free blocks
-	do {
-		updateNeeded = 0;
-		for (j = 0; j < osl_vramBlocksNb - 1; j++) {
-			// Let's look for two adjacent blocks
-			if ((isBlockFree(j) && isBlockFree(j + 1))
-			    || (isBlockFree(j) && getBlockSize(j) == 0)) {
-				// Merge these blocks now
-				int newSize = getBlockSize(j) + getBlockSize(j + 1), newAdd = getBlockOffset(j);
-				memmove(osl_vramBlocks + j, osl_vramBlocks + j + 1, sizeof(OSL_VRAMBLOCK) * (osl_vramBlocksNb - j - 1));
-				setBlockOffset(j, newAdd);
-				setBlockSize(j, newSize);
-				// The block in between is removed
-				osl_vramBlocksNb--;
-				// Note: We will need another pass to check if new blocks were created
-				updateNeeded = 1;
-			}
-		}
-
-	} while (updateNeeded);
+	neighbour = vramBlock(i).nextPhys;
+	if (neighbour != VRAM_NONE && vramBlock(neighbour).free)                {
+		vramRemoveFree(neighbour);
+		vramAbsorbNext(i, neighbour);
+	}
+	neighbour = vramBlock(i).prevPhys;
+	if (neighbour != VRAM_NONE && vramBlock(neighbour).free)                {
+		vramRemoveFree(neighbour);
+		vramAbsorbNext(neighbour, i);
+		i = neighbour;
+	}
 
+	// The block is now free ^^
+	vramInsertFree(i);
 	return 1;
 }
 
 int oslVramMgrSetParameters(void *baseAddr, int size) {
-	int curVramSize = osl_vramSize;
-	int blockNum = osl_vramBlocksNb - 1;
+	int i = osl_vramLastBlock;
 	int sizeDiff;
 
 	if (!osl_useVramManager)
 		return 0;
 	// The size is always a multiple of 16 - round up to the next block
-	if (size & 15)
-		size += 16;
+	size = (size + 15) & ~15;
 
 	// Size difference (negative for reduction, positive for increase)
-	sizeDiff = size - curVramSize;
+	sizeDiff = size - osl_vramSize;
 
-	// The last block is ALWAYS free, even if there are 0 bytes left. See the workaround in ulTexVramAlloc
-	if (isBlockFree(blockNum) && getBlockSize(blockNum) + sizeDiff >= 0) {
-		setBlockSize(blockNum, getBlockSize(blockNum) + sizeDiff);
-		osl_vramBase = (u32)baseAddr;
-		osl_vramSize = size;
-		// For those who do not want to use the manager...
-		osl_currentVramPtr = osl_vramBase;
+	if (vramBlock(i).free && (int)vramBlock(i).size + sizeDiff >= 0) {
+		// The last block is free: just resize it
+		vramRemoveFree(i);
+		vramBlock(i).size += sizeDiff;
+		vramInsertFree(i);
 	}
-	else
+	else if (!vramBlock(i).free && sizeDiff > 0)            {
+		// The last block is used: add a free block after it
+		int newBlock = vramNewBlock();
+		if (newBlock == VRAM_NONE)
+			return 0;
+		vramBlock(newBlock).offset = vramBlock(i).offset + vramBlock(i).size;
+		vramBlock(newBlock).size = sizeDiff;
+		vramBlock(newBlock).prevPhys = i;
+		vramBlock(i).nextPhys = newBlock;
+		osl_vramLastBlock = newBlock;
+		vramInsertFree(newBlock);
+	}
+	else if (sizeDiff != 0)
 		return 0;
+
+	osl_vramBase = (uintptr_t)baseAddr;
+	osl_vramSize = size;
+	// For those who do not want to use the manager...
+	osl_currentVramPtr = osl_vramBase;
 	return 1;
 }
+
+int oslVramMgrSetBlockOwner(void *blockAddress, void *owner, OSL_VRAM_RELOCATE_CALLBACK relocate)           {
+	int i;
+	u32 blockOffset = (uintptr_t)blockAddress - osl_vramBase;
+
+	if (!osl_useVramManager)
+		return 0;
+
+	// Look up the block (and put it back, it stays allocated)
+	i = vramHashRemove(blockOffset);
+	if (i == VRAM_NONE)
+		return 0;
+	vramHashInsert(i);
+
+	vramBlock(i).owner = owner;
+	vramBlock(i).relocate = relocate;
+	return 1;
+}
+
+int oslVramMgrGetLargestFreeBlock()             {
+	int fl, sl, i;
+	u32 largest = 0;
+
+	if (!osl_useVramManager)
+		return osl_vramBase + osl_vramSize - osl_currentVramPtr;
+	if (!osl_vramFlBitmap)
+		return 0;
+
+	// The largest block is in the highest non-empty class, but that class covers a range of sizes
+	fl = vramFls(osl_vramFlBitmap);
+	sl = vramFls(osl_vramSlBitmap[fl]);
+	for (i = osl_vramFreeLists[fl][sl]; i != VRAM_NONE; i = vramBlock(i).nextFree)          {
+		if (vramBlock(i).size > largest)
+			largest = vramBlock(i).size;
+	}
+	return largest;
+}
+
+/*
+        Slides every movable block down into the free space that precedes it, so that free space gathers into larger blocks.
+        Blocks without an owner (palettes, blocks allocated directly by the user) stay where they are.
+ */
+int oslVramMgrCompact()         {
+	int i, hole, before, after, moved = 0;
+
+	if (!osl_useVramManager || osl_vramLastBlock == VRAM_NONE)
+		return 0;
+
+	// The GE must not be reading the data we are about to move
+	oslSyncDrawing();
+
+	// Blocks are only linked with their neighbours, find the first one
+	i = osl_vramLastBlock;
+	while (vramBlock(i).prevPhys != VRAM_NONE)
+		i = vramBlock(i).prevPhys;
+
+	while (i != VRAM_NONE)          {
+		hole = vramBlock(i).prevPhys;
+		if (vramBlock(i).free || !vramBlock(i).relocate || hole == VRAM_NONE || !vramBlock(hole).free)          {
+			i = vramBlock(i).nextPhys;
+			continue;
+		}
+
+		{
+			u32 oldOffset = vramBlock(i).offset, newOffset = vramBlock(hole).offset, size = vramBlock(i).size;
+			void *oldAddress = (void*)(oldOffset + osl_vramBase), *newAddress = (void*)(newOffset + osl_vramBase);
+
+			// Same copy path as oslMoveImageTo, except that both areas may overlap
+			oslUncacheData(oldAddress, size);
+			memmove(newAddress, oldAddress, size);
+			oslUncacheData(newAddress, oldOffset + size - newOffset);
+
+			// Swap the block and the hole: [before] [hole] [i] [after] -> [before] [i] [hole] [after]
+			vramHashRemove(oldOffset);
+			vramRemoveFree(hole);
+			before = vramBlock(hole).prevPhys;
+			after = vramBlock(i).nextPhys;
+			vramBlock(i).offset = newOffset;
+			vramBlock(i).prevPhys = before;
+			vramBlock(i).nextPhys = hole;
+			vramBlock(hole).offset = newOffset + size;
+			vramBlock(hole).prevPhys = i;
+			vramBlock(hole).nextPhys = after;
+			if (before != VRAM_NONE)
+				vramBlock(before).nextPhys = i;
+			if (after != VRAM_NONE)
+				vramBlock(after).prevPhys = hole;
+			else
+				osl_vramLastBlock = hole;
+			vramHashInsert(i);
+
+			// The hole may now touch another free block
+			if (after != VRAM_NONE && vramBlock(after).free)                {
+				vramRemoveFree(after);
+				vramAbsorbNext(hole, after);
+			}
+			vramInsertFree(hole);
+
+			vramBlock(i).relocate(vramBlock(i).owner, oldAddress, newAddress);
+			moved++;
+		}
+
+		// Continue with the block following the hole, it will slide down as well
+		i = vramBlock(hole).nextPhys;
+	}
+
+	return moved;
+}
@@ -44,7 +44,16 @@ extern int osl_useVramManager;
  *
  * This pointer keeps track of the current position in VRAM where the next allocation can be made.
  */
-extern u32 osl_currentVramPtr;
+extern uintptr_t osl_currentVramPtr;
+
+/**
+ * @brief Callback notified when oslVramMgrCompact moves a block.
+ *
+ * @param owner The owner given to oslVramMgrSetBlockOwner().
+ * @param oldAddress Previous address of the block.
+ * @param newAddress New address of the block. The data has already been copied there.
+ */
+typedef void (*OSL_VRAM_RELOCATE_CALLBACK)(void *owner, void *oldAddress, void *newAddress);
 
 /**
  * @brief Initializes the VRAM manager.
@@ -57,7 +66,8 @@ extern void oslVramMgrInit();
 /**
  * @brief Allocates a block of VRAM.
  *
- * This function allocates a block of VRAM of the specified size.
+ * This function allocates a block of VRAM of the specified size. Free blocks are kept in
+ * segregated lists by size class, so the allocation time does not depend on the number of blocks.
  *
  * @param blockSize The size of the block to allocate, in bytes.
  * @return A pointer to the allocated block of VRAM, or NULL if the allocation fails.
@@ -68,9 +78,10 @@ extern void *oslVramMgrAllocBlock(int blockSize);
  * @brief Frees a previously allocated block of VRAM.
  *
  * This function frees a block of VRAM that was previously allocated using oslVramMgrAllocBlock().
+ * The block is found back from its address and merged with its free neighbours in constant time.
  *
  * @param blockAddress The address of the block to free.
- * @param blockSize The size of the block to free, in bytes.
+ * @param blockSize The size of the block to free, in bytes (only used when the VRAM manager is disabled).
  * @return 0 if the block was successfully freed, or a negative value if an error occurred.
  */
 extern int oslVramMgrFreeBlock(void *blockAddress, int blockSize);
@@ -87,6 +98,47 @@ extern int oslVramMgrFreeBlock(void *blockAddress, int blockSize);
  */
 extern int oslVramMgrSetParameters(void *adrStart, int size);
 
+/**
+ * @brief Registers the owner of a VRAM block, allowing the block to be moved by oslVramMgrCompact().
+ *
+ * Blocks without an owner are never moved. Images allocated in VRAM by OSLib register themselves automatically.
+ *
+ * @param blockAddress Address returned by oslVramMgrAllocBlock().
+ * @param owner Value passed back to the callback (e.g. the structure holding the pointer to the block).
+ * @param relocate Function called after the block has been moved, to patch the pointers to it. NULL makes the block unmovable again.
+ * @return 1 if the block was found, 0 otherwise.
+ */
+extern int oslVramMgrSetBlockOwner(void *blockAddress, void *owner, OSL_VRAM_RELOCATE_CALLBACK relocate);
+
+/**
+ * @brief Returns the size of the largest free block of VRAM, i.e. the largest allocation that can currently succeed.
+ *
+ * @return The size in bytes.
+ */
+extern int oslVramMgrGetLargestFreeBlock();
+
+/**
+ * @brief Defragments VRAM.
+ *
+ * Every movable block (see oslVramMgrSetBlockOwner) is slid down into the free space that precedes it, so that the free space
+ * is gathered in larger blocks. Use it when an allocation in VRAM fails although there is enough free memory in total, for example:
+ *
+ * \code
+ * img = oslCreateImage(512, 512, OSL_IN_VRAM, OSL_PF_8888);
+ * if (!img) {
+ *     oslVramMgrCompact();
+ *     img = oslCreateImage(512, 512, OSL_IN_VRAM, OSL_PF_8888);
+ * }
+ * \endcode
+ *
+ * @note Moving images changes their data pointer: don't keep pointers to the data of VRAM images across this call. Images that tiles
+ * were made from with oslCreateImageTile() are not moved, as the tiles share their data. If drawing has been started, the pending
+ * commands are executed first.
+ *
+ * @return The number of blocks moved.
+ */
+extern int oslVramMgrCompact();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,341 @@
+#include "oslib.h"
+#include <time.h>
+
+/*
+	Scales a 512x512 atlas with oslScaleImage and with the netpbm pnmscale port it replaced (kept below, only renamed and
+	with its comments trimmed), and reports the time of each. On a smooth image, the box filter must give the same colors
+	within 2/255 in 32 bits, or one step of a 5-bit component in 16 bits.
+	Large shrink ratios, which the pnmscale port doesn't handle well either, are checked against an exact area average of
+	a noise image instead.
+*/
+
+#define ROUNDS 5
+
+/* source from pnmscale.c in netpbm
+**
+** modified by Kevin (sosaria at empal.com)
+**
+** blow is original copyright of netpbm
+** Copyright (C) 1989, 1991 by Jef Poskanzer.
+**
+** Permission to use, copy, modify, and distribute this software and its
+** documentation for any purpose and without fee is hereby granted, provided
+** that the above copyright notice appear in all copies and that both that
+** copyright notice and this permission notice appear in supporting
+** documentation.  This software is provided "as is" without express or
+** implied warranty.
+**
+*/
+
+#define RGBA_GETR(pixel)	((pixel)&0xff)
+#define RGBA_GETG(pixel)	(((pixel)>>8)&0xff)
+#define RGBA_GETB(pixel)	(((pixel)>>16)&0xff)
+#define RGBA_GETA(pixel)	(((pixel)>>24)&0xff)
+#ifndef MIN
+#define MIN(a, b)	((a) < (b) ? (a) : (b))
+#endif
+
+static void readRow(OSL_IMAGE *img, int row, unsigned int *xelrow)
+{
+	int x;
+	int pixel;
+	for( x = 0; x < img->sizeX; x++ ) {
+		pixel = oslGetImagePixel(img, x, row);
+		xelrow[x] = (unsigned int)oslConvertColor(OSL_PF_8888, img->pixelFormat, pixel );
+	}
+}
+
+static void writeRow(OSL_IMAGE *img, unsigned int *xelrow, int startx, int row, int width)
+{
+	int x;
+	int pixel;
+	for( x = 0; x < width; x++ ) {
+		pixel = oslConvertColor(img->pixelFormat, OSL_PF_8888, xelrow[x]);
+		oslSetImagePixel(img, x+startx, row, pixel);
+	}
+}
+
+static void zeroAccum(int col, float rs[], float gs[], float bs[], float as[])
+{
+	int x;
+	for( x = 0; x < col; x++ ) {
+		rs[x] = gs[x] = bs[x] = as[x] = 0.0;
+	}
+}
+static void accumOutputRow(unsigned int* const xelrow, float const fraction,
+					float rs[], float gs[], float bs[], float as[], int const cols)
+{
+	int x;
+
+	for( x = 0; x < cols; x++ ) {
+		rs[x] += fraction * RGBA_GETR(xelrow[x]);
+		gs[x] += fraction * RGBA_GETG(xelrow[x]);
+		bs[x] += fraction * RGBA_GETB(xelrow[x]);
+		as[x] += fraction * RGBA_GETA(xelrow[x]);
+	}
+}
+
+static void horizontalScale(const float rs[], const float gs[], const float bs[], const float as[],
+							unsigned int newxelrow[], const int cols, const int newcols, const float xscale)
+{
+    float r, g, b, a;
+    float fraccoltofill, fraccolleft;
+    unsigned int col;
+    unsigned int newcol;
+
+    newcol = 0;
+    fraccoltofill = 1.0;  /* Output column is "empty" now */
+    r = g = b = a = 0;          /* initial value */
+    for (col = 0; col < cols; ++col) {
+        fraccolleft = xscale;
+        while (fraccolleft >= fraccoltofill) {
+			r += fraccoltofill * rs[col];
+			g += fraccoltofill * gs[col];
+			b += fraccoltofill * bs[col];
+			a += fraccoltofill * as[col];
+			newxelrow[newcol] = RGBA( MIN(0xff, (int)(r + 0.5) ),
+               						  MIN(0xff, (int)(g + 0.5) ),
+               						  MIN(0xff, (int)(b + 0.5) ),
+               						  MIN(0xff, (int)(a + 0.5) ) );
+            fraccolleft -= fraccoltofill;
+            newcol++;
+            fraccoltofill = 1.0;
+            r = g = b = 0.0;
+        }
+        if (fraccolleft > 0.0) {
+			r += fraccolleft * rs[col];
+			g += fraccolleft * gs[col];
+			b += fraccolleft * bs[col];
+			a += fraccolleft * as[col];
+            fraccoltofill -= fraccolleft;
+        }
+    }
+
+    if (newcol < newcols ) {
+		r += fraccoltofill * rs[cols-1];
+		g += fraccoltofill * gs[cols-1];
+		b += fraccoltofill * bs[cols-1];
+		a += fraccoltofill * as[cols-1];
+		newxelrow[newcol] = RGBA( MIN(0xff, (int)(r + 0.5) ),
+								  MIN(0xff, (int)(g + 0.5) ),
+								  MIN(0xff, (int)(b + 0.5) ),
+								  MIN(0xff, (int)(a + 0.5) ) );
+	}
+}
+
+static void pnmScaleImage(OSL_IMAGE *dstImg, OSL_IMAGE *srcImg, int newX, int newY, int newWidth, int newHeight)
+{
+	float rowsleft;
+	float fracrowtofill;
+	int rowsread;
+	int row;
+
+	unsigned int* orgxelrow;
+	unsigned int* newxelrow;
+	float* rs;
+	float* gs;
+	float* bs;
+	float* as;
+
+	float xscale = (float)newWidth / srcImg->sizeX;
+	float yscale = (float)newHeight / srcImg->sizeY;
+
+	rowsread = 0;
+	rowsleft = 0.0;
+	fracrowtofill = 1.0;
+
+	orgxelrow = malloc( srcImg->sizeX * sizeof(orgxelrow[0]) );
+	rs = malloc( srcImg->sizeX * sizeof(rs[0]) );
+	gs = malloc( srcImg->sizeX * sizeof(gs[0]) );
+	bs = malloc( srcImg->sizeX * sizeof(bs[0]) );
+	as = malloc( srcImg->sizeX * sizeof(bs[0]) );
+	newxelrow = malloc( newWidth * sizeof(newxelrow[0]) );
+
+	for( row = 0; row < newHeight; ++row ) {
+		if ( newHeight == srcImg->sizeY ) { /* shortcut Y scaling if possible */
+			readRow( srcImg, row, orgxelrow );
+		}
+		else {
+			zeroAccum(srcImg->sizeX, rs, gs, bs, as);
+			while (fracrowtofill > 0) {
+				if (rowsleft <= 0.0) {
+					if (rowsread < srcImg->sizeY) {
+						readRow( srcImg, rowsread, orgxelrow );
+						++rowsread;
+					}
+					rowsleft = yscale;
+				}
+				if (rowsleft < fracrowtofill) {
+					accumOutputRow(orgxelrow, rowsleft, rs, gs, bs, as, srcImg->sizeX);
+					fracrowtofill -= rowsleft;
+					rowsleft = 0.0;
+				}
+				else {
+					accumOutputRow(orgxelrow, fracrowtofill, rs, gs, bs, as, srcImg->sizeX);
+					rowsleft = rowsleft - fracrowtofill;
+					fracrowtofill = 0.0;
+				}
+			}
+			fracrowtofill = 1.0;
+		}
+
+		horizontalScale(rs, gs, bs, as, newxelrow, srcImg->sizeX, newWidth, xscale);
+		writeRow(dstImg, newxelrow, newX, newY + row, newWidth);
+
+	}
+	free( newxelrow );
+	free( as );
+	free( bs );
+	free( gs );
+	free( rs );
+	free( orgxelrow );
+
+	return;
+}
+
+/*
+	Benchmark
+*/
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double timeScale(void (*scale)(OSL_IMAGE*, OSL_IMAGE*, int, int, int, int), OSL_IMAGE *dst, OSL_IMAGE *src) {
+	double start = now();
+	int i;
+	for (i = 0; i < ROUNDS; i++)
+		scale(dst, src, 0, 0, dst->sizeX, dst->sizeY);
+	return (now() - start) / ROUNDS;
+}
+
+static int filterUsed;
+
+static void scaleFiltered(OSL_IMAGE *dst, OSL_IMAGE *src, int x, int y, int width, int height) {
+	oslScaleImageEx(dst, src, x, y, width, height, filterUsed);
+}
+
+static int maxDifference(OSL_IMAGE *a, OSL_IMAGE *b) {
+	int x, y, k, diff = 0;
+	for (y = 0; y < a->sizeY; y++) {
+		for (x = 0; x < a->sizeX; x++) {
+			u32 ca = oslGetImagePixel(a, x, y), cb = oslGetImagePixel(b, x, y);
+			//Only the color: the pnmscale port forgets to reset its alpha sum between pixels
+			for (k = 0; k < 24; k += 8)
+				diff = oslMax(diff, abs((int)((ca >> k) & 0xff) - (int)((cb >> k) & 0xff)));
+		}
+	}
+	return diff;
+}
+
+//Exact average of the source area covered by each destination pixel, compared with the box filter
+static int maxAreaDifference(OSL_IMAGE *dst, OSL_IMAGE *src) {
+	double scaleX = (double)src->sizeX / dst->sizeX, scaleY = (double)src->sizeY / dst->sizeY;
+	int x, y, sx, sy, k, diff = 0;
+
+	for (y = 0; y < dst->sizeY; y++) {
+		double top = y * scaleY, bottom = (y + 1) * scaleY;
+		for (x = 0; x < dst->sizeX; x++) {
+			double left = x * scaleX, right = (x + 1) * scaleX, sum[4] = {0, 0, 0, 0};
+			u32 c = oslGetImagePixel(dst, x, y);
+
+			for (sy = (int)top; sy < bottom && sy < src->sizeY; sy++) {
+				double h = oslMin(sy + 1, bottom) - oslMax(sy, top);
+				for (sx = (int)left; sx < right && sx < src->sizeX; sx++) {
+					double area = h * (oslMin(sx + 1, right) - oslMax(sx, left));
+					u32 s = oslGetImagePixel(src, sx, sy);
+					for (k = 0; k < 4; k++)
+						sum[k] += area * ((s >> (k * 8)) & 0xff);
+				}
+			}
+			for (k = 0; k < 4; k++) {
+				int exact = (int)(sum[k] / (scaleX * scaleY) + 0.5);
+				diff = oslMax(diff, abs(exact - (int)((c >> (k * 8)) & 0xff)));
+			}
+		}
+	}
+	return diff;
+}
+
+int main() {
+	static const struct {
+		int width, height, pixelFormat;
+	} targets[] = {
+		{256, 256, OSL_PF_8888}, {384, 384, OSL_PF_8888}, {511, 511, OSL_PF_8888}, {256, 256, OSL_PF_5650},
+	};
+	static const int formats[] = {OSL_PF_8888, OSL_PF_5650};
+	static const int shrinkSizes[] = {64, 17, 9, 3, 1};
+	static const char *filterNames[] = {"box", "bilinear", "bicubic", "lanczos2"};
+	unsigned int seed = 1;
+	OSL_IMAGE *noise;
+	int i, t, f, x, y, failures = 0;
+
+	for (i = 0; i < 2; i++) {
+		int pixelFormat = formats[i];
+		OSL_IMAGE *src = oslCreateImage(512, 512, OSL_IN_RAM, pixelFormat);
+
+		//Smooth image, so that the rounding differences between both versions stay small
+		for (y = 0; y < 512; y++) {
+			for (x = 0; x < 512; x++)
+				oslSetImagePixel(src, x, y, oslConvertColor(pixelFormat, OSL_PF_8888, RGBA(x / 2, y / 2, (x + y) / 4, 255 - x / 4)));
+		}
+
+		for (t = 0; t < (int)(sizeof(targets) / sizeof(targets[0])); t++) {
+			OSL_IMAGE *ref, *dst;
+			double pnm, box;
+			int diff, tolerance = pixelFormat == OSL_PF_8888 ? 2 : 8;
+
+			if (targets[t].pixelFormat != pixelFormat)
+				continue;
+			ref = oslCreateImage(targets[t].width, targets[t].height, OSL_IN_RAM, pixelFormat);
+			dst = oslCreateImage(targets[t].width, targets[t].height, OSL_IN_RAM, pixelFormat);
+
+			pnm = timeScale(pnmScaleImage, ref, src);
+			box = timeScale(oslScaleImage, dst, src);
+			diff = maxDifference(ref, dst);
+			printf("512x512 -> %dx%d, %s: pnmscale port %6.2f ms, oslScaleImage %5.2f ms (%.1fx faster, max difference %d)\n",
+				targets[t].width, targets[t].height, pixelFormat == OSL_PF_8888 ? "32-bit" : "16-bit", pnm * 1e3, box * 1e3, pnm / box, diff);
+			if (diff > tolerance) {
+				printf("FAIL: the box filter differs from the pnmscale port\n");
+				failures++;
+			}
+
+			for (f = OSL_SCALE_BILINEAR; f <= OSL_SCALE_LANCZOS2; f++) {
+				filterUsed = f;
+				printf("  %-8s %5.2f ms\n", filterNames[f], timeScale(scaleFiltered, dst, src) * 1e3);
+			}
+
+			oslDeleteImage(ref);
+			oslDeleteImage(dst);
+		}
+		oslDeleteImage(src);
+	}
+
+	//Large shrink ratios: many source pixels per destination pixel, each with a small weight
+	noise = oslCreateImage(512, 512, OSL_IN_RAM, OSL_PF_8888);
+	for (y = 0; y < 512; y++) {
+		for (x = 0; x < 512; x++) {
+			seed = seed * 1103515245 + 12345;
+			oslSetImagePixel(noise, x, y, seed >> 4);
+		}
+	}
+	for (t = 0; t < (int)(sizeof(shrinkSizes) / sizeof(shrinkSizes[0])); t++) {
+		int size = shrinkSizes[t], diff;
+		OSL_IMAGE *dst = oslCreateImage(size, size, OSL_IN_RAM, OSL_PF_8888);
+
+		oslScaleImage(dst, noise, 0, 0, size, size);
+		diff = maxAreaDifference(dst, noise);
+		printf("512x512 -> %dx%d noise: max difference with the exact area average %d\n", size, size, diff);
+		if (diff > 2) {
+			printf("FAIL: the box filter is not the average of the area\n");
+			failures++;
+		}
+		oslDeleteImage(dst);
+	}
+	oslDeleteImage(noise);
+
+	if (failures)
+		printf("%d failures\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,111 @@
+#include "oslib.h"
+
+/*
+	intraFont with a BWFON font generated in memory (the size of the firmware's jpn0.bwfon, 36 bytes per 16x18 glyph):
+	the font is used in place from a memory virtual file. Each frame prints a different set of CJK glyphs through the
+	256x256 glyph cache, so that glyphs of the previous frames are evicted, with batched sprites between the prints.
+	Greek and Cyrillic text is measured and underlined with a bar of the measured width. The same font is also used as
+	an OSL_FONT for strings and a text box cut by words.
+*/
+
+#define BWFON_SIZE 1023372
+#define BWFON_GLYPH 36
+
+static u8 bwfon[BWFON_SIZE];
+static OSL_VIRTUALFILENAME fontFiles[] = {
+	{"generated.bwfon", bwfon, sizeof(bwfon), &VF_MEMORY},
+};
+
+static void buildFont() {
+	int glyph, row;
+
+	//A frame with a few bars that differ from one glyph to the next, 16 bits per row
+	for (glyph = 0; glyph < BWFON_SIZE / BWFON_GLYPH; glyph++) {
+		u8 *g = bwfon + glyph * BWFON_GLYPH;
+		for (row = 0; row < 18; row++) {
+			u16 bits = row == 1 || row == 16 ? 0x7ffe : row == 0 || row == 17 ? 0 : 0x4002;
+			if (row >= 3 && row <= 14 && ((glyph * 37) >> (row / 2)) & 1)
+				bits |= (row & 1) ? 0x0ff0 : 0x3c3c;
+			g[row * 2] = bits >> 8;
+			g[row * 2 + 1] = bits & 0xff;
+		}
+	}
+}
+
+static void fillCjk(unsigned short *text, int first, int count) {
+	int i;
+	for (i = 0; i < count; i++)
+		text[i] = first + i * 3;
+	text[count] = 0;
+}
+
+int main() {
+	static const char *greek = "\xce\x91\xce\xb2\xce\xb3\xce\xb4 \xce\xa9\xcf\x89", *cyrillic = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82";
+	unsigned short cjk[25 + 1];
+	OSL_IMAGE *sprite;
+	intraFont *font;
+	OSL_FONT *oslFont;
+	int frame = 0, row, x, y;
+	float width;
+
+	oslInit(0);
+	oslInitGfx(OSL_PF_8888, 1);
+	oslSetSpriteBatching(1);
+
+	sprite = oslCreateImage(16, 16, OSL_IN_RAM, OSL_PF_8888);
+	for (y = 0; y < 16; y++) {
+		for (x = 0; x < 16; x++)
+			oslSetImagePixel(sprite, x, y, RGBA(x * 16, y * 16, 255, 255));
+	}
+
+	buildFont();
+	oslAddVirtualFileList(fontFiles, oslNumberof(fontFiles));
+	oslIntraFontInit(INTRAFONT_CACHE_MED | INTRAFONT_STRING_UTF8);
+	font = intraFontLoad("generated.bwfon", INTRAFONT_CACHE_MED | INTRAFONT_STRING_UTF8);
+	oslFont = oslLoadIntraFontFile("generated.bwfon", INTRAFONT_CACHE_MED | INTRAFONT_STRING_UTF8);
+	if (!font || !oslFont) {
+		printf("FAIL: the font could not be loaded\n");
+		return 1;
+	}
+
+	while (!osl_quit) {
+		oslStartDrawing();
+		oslClearScreen(RGBA(20, 40, 60, 255));
+
+		intraFontSetStyle(font, 1.0f, 0xFFFFFFFF, 0xFF000000, 0.0f, 0);
+		for (row = 0; row < 6; row++) {
+			fillCjk(cjk, 0x4e00 + (frame * 6 + row) * 100, 25);
+			//Batched sprites between the prints
+			oslDrawImageXY(sprite, 420 + (row & 1) * 20, 10 + row * 22);
+			intraFontPrintUCS2(font, 10, 24 + row * 22, cjk);
+		}
+
+		intraFontSetStyle(font, 1.0f, 0xFF80FFFF, 0, 0.0f, INTRAFONT_STRING_UTF8);
+		width = intraFontMeasureText(font, greek);
+		oslDrawFillRect(10, 168, 10 + (int)width, 170, RGBA(255, 0, 0, 255));
+		intraFontPrint(font, 10, 160, greek);
+		intraFontSetStyle(font, 0.75f, 0xFFFF8080, 0, 0.0f, INTRAFONT_STRING_UTF8);
+		width = intraFontMeasureText(font, cyrillic);
+		oslDrawFillRect(200, 168, 200 + (int)width, 170, RGBA(255, 0, 0, 255));
+		intraFontPrint(font, 200, 160, cyrillic);
+
+		oslSetFont(oslFont);
+		oslIntraFontSetStyle(oslFont, 1.0f, RGBA(255, 255, 0, 255), RGBA(0, 0, 0, 255), 0.0f, INTRAFONT_STRING_UTF8);
+		oslDrawStringf(10, 184, "%s %s", greek, cyrillic);
+		oslDrawFillRect(10, 206, 10 + oslGetStringWidth(cyrillic), 208, RGBA(0, 255, 0, 255));
+		oslDrawTextBoxByWords(10, 214, 200, 268, "\xd0\x90\xd0\x91\xd0\x92\xd0\x93 \xd0\x94\xd0\x95\xd0\x96\xd0\x97 \xd0\x98\xd0\x99\xd0\x9a \xd0\x9b\xd0\x9c\xd0\x9d\xd0\x9e \xce\xb1\xce\xb2\xce\xb3\xce\xb4\xce\xb5 \xce\xb6\xce\xb7\xce\xb8", 0);
+		oslSetFont(osl_sceFont);
+
+		oslEndDrawing();
+		oslSyncFrame();
+		frame++;
+	}
+
+	oslDeleteImage(sprite);
+	intraFontUnload(font);
+	oslDeleteFont(oslFont);
+	oslIntraFontShutdown();
+	oslEndGfx();
+	sceKernelExitGame();
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "oslib.h"
+#include "sfont.h"
+
+/*
+	SFont fonts made in memory: the letter sheets are written as PNG files in RAM and loaded back with oslLoadSFontFile,
+	in 32-bit and 16-bit. The larger font has letters for the characters above 160 and doesn't fit in a single atlas
+	row. Strings are drawn batched, partly off screen, and over a shape.
+*/
+
+static u8 pngFile[64 << 10];
+
+//First row: the marker color between the letters; below it, letters with a frame and a few bars of their own
+static OSL_SFONT *createSFont(int letterCount, int minWidth, int maxWidth, int height, int pixelFormat) {
+	OSL_IMAGE *sheet;
+	OSL_SFONT *font;
+	int i, x, y, sheetWidth = 1;
+
+	for (i = 0; i < letterCount; i++)
+		sheetWidth += minWidth + i % (maxWidth - minWidth + 1) + 1;
+	sheet = oslCreateImage(sheetWidth, height + 1, OSL_IN_RAM, OSL_PF_8888);
+	oslClearImage(sheet, RGBA(255, 0, 255, 255));
+	for (i = 0, x = 1; i < letterCount; i++) {
+		int width = minWidth + i % (maxWidth - minWidth + 1), dx;
+		for (dx = 0; dx < width; dx++, x++) {
+			oslSetImagePixel(sheet, x, 0, RGBA(255, 255, 255, 255));
+			for (y = 1; y <= height; y++) {
+				int edge = dx == 0 || dx == width - 1 || y == 1 || y == height;
+				int bar = ((i * 7) >> (y / 3)) & 1;
+				oslSetImagePixel(sheet, x, y, edge ? RGBA(255, 255, 255, 255) : bar ? RGBA(255, 160, 0, 128) : RGBA(0, 0, 0, 0));
+			}
+		}
+		x++;
+	}
+
+	oslSetTempFileData(pngFile, sizeof(pngFile), &VF_MEMORY);
+	oslWriteImageFilePNG(sheet, oslGetTempFileName(), OSL_WRI_ALPHA);
+	oslDeleteImage(sheet);
+	oslSetTempFileData(pngFile, sizeof(pngFile), &VF_MEMORY);
+	font = oslLoadSFontFile(oslGetTempFileName(), pixelFormat);
+	if (!font) {
+		printf("FAIL: the font could not be loaded\n");
+		exit(1);
+	}
+	return font;
+}
+
+int main() {
+	char ascii[96], latin[100];
+	OSL_SFONT *small, *large;
+	int frame = 0, i, row, width;
+
+	oslInit(0);
+	oslInitGfx(OSL_PF_8888, 1);
+	oslSetSpriteBatching(1);
+
+	small = createSFont(95, 3, 5, 12, OSL_PF_8888);
+	large = createSFont(190, 8, 14, 20, OSL_PF_4444);
+	for (i = 0; i < 95; i++)
+		ascii[i] = 33 + i;
+	ascii[95] = 0;
+	for (i = 0; i < 99; i++)
+		latin[i] = 160 + (i * 7) % 96;
+	latin[99] = 0;
+
+	while (!osl_quit) {
+		oslStartDrawing();
+		oslClearScreen(RGBA(20, 40, 60, 255));
+		oslSetAlpha(OSL_FX_ALPHA, 255);
+
+		oslSFontDrawText(small, 2 + frame, 5, ascii);
+		width = oslGetSFontTextWidth(small, "Score: 0012345");
+		oslDrawFillRect(10, 232, 10 + width, 234, RGBA(0, 255, 0, 255));
+		oslSFontDrawText(small, 10, 220, "Score: 0012345");
+		for (row = 0; row < 8; row++)
+			oslSFontDrawText(large, 2 - row * 200, 24 + row * 24, row < 4 ? ascii : latin);
+		oslDrawFillRect(300, 236, 340, 262, RGBA(255, 0, 0, 255));
+		oslSFontDrawText(large, 300, 240, "A B");
+
+		oslEndDrawing();
+		oslSyncFrame();
+		frame++;
+	}
+
+	oslDeleteSFont(small);
+	oslDeleteSFont(large);
+	oslEndGfx();
+	sceKernelExitGame();
+	return 0;
+}
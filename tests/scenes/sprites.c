@@ -0,0 +1,128 @@
+#include "oslib.h"
+
+/*
+	Sprites, shapes and blending through the reference rasterizer: 32-bit, 16-bit and paletted images (swizzled or not),
+	rotated and mirrored images, alpha modes, alpha test, color key, and an image used as a draw buffer. The GE state
+	cache and the sprite batching are both active. Run with OSL_EMU_GOLDEN to compare the frames with tests/golden.
+*/
+
+static OSL_IMAGE *createGradient(int width, int height, int pixelFormat) {
+	OSL_IMAGE *img = oslCreateImage(width, height, OSL_IN_RAM, pixelFormat);
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++)
+			oslSetImagePixel(img, x, y, oslConvertColor(pixelFormat, OSL_PF_8888,
+				RGBA(x * 255 / width, y * 255 / height, ((x / 8 + y / 8) & 1) ? 224 : 64, (x + y) * 255 / (width + height))));
+	}
+	return img;
+}
+
+static OSL_IMAGE *createPaletted(int width, int height, int pixelFormat) {
+	OSL_IMAGE *img = oslCreateImage(width, height, OSL_IN_RAM, pixelFormat);
+	int colors = 1 << osl_paletteSizes[pixelFormat], x, y, i;
+	u32 *palette;
+
+	img->palette = oslCreatePalette(colors, OSL_PF_8888);
+	palette = (u32*)img->palette->data;
+	for (i = 0; i < colors; i++)
+		palette[i] = RGBA(i * 255 / colors, 255 - i * 255 / colors, i & 1 ? 255 : 0, i == 0 ? 0 : 255);
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++)
+			oslSetImagePixel(img, x, y, ((x + y) / 3) % colors);
+	}
+	oslUncacheImage(img);
+	return img;
+}
+
+int main() {
+	OSL_IMAGE *rgba, *rgb16, *pal4, *pal8, *target;
+	int frame = 0, i;
+
+	oslInit(0);
+	oslInitGfx(OSL_PF_8888, 1);
+	oslSetSpriteBatching(1);
+
+	rgba = createGradient(48, 32, OSL_PF_8888);
+	rgb16 = createGradient(64, 64, OSL_PF_5650);
+	pal4 = createPaletted(32, 32, OSL_PF_4BIT);
+	pal8 = createPaletted(64, 32, OSL_PF_8BIT);
+	oslSwizzleImage(rgb16);
+	oslSwizzleImage(pal8);
+	target = oslCreateImage(64, 64, OSL_IN_VRAM, OSL_PF_8888);
+
+	while (!osl_quit) {
+		oslStartDrawing();
+
+		//Render to an image, drawn afterwards like any other
+		oslSetDrawBuffer(target);
+		oslClearScreen(RGBA(0, 0, 64, 255));
+		oslDrawGradientRect(4, 4, 60, 60, RGBA(255, 0, 0, 255), RGBA(0, 255, 0, 255), RGBA(0, 0, 255, 255), RGBA(255, 255, 255, 255));
+		oslDrawImageXY(pal4, 16 + frame * 4, 16);
+		oslSetDrawBuffer(OSL_DEFAULT_BUFFER);
+
+		oslClearScreen(RGBA(20, 40, 60, 255));
+
+		//Images in every format, between shapes so that texturing is switched off and on
+		for (i = 0; i < 6; i++) {
+			oslDrawImageXY(rgba, 8 + i * 52, 8);
+			oslDrawFillRect(8 + i * 52, 42, 56 + i * 52, 46, RGBA(255, 64 * i, 0, 255));
+		}
+		oslDrawImageXY(rgb16, 8, 52);
+		oslDrawImageXY(pal4, 80, 52);
+		oslDrawImageXY(pal8, 120, 52);
+		//The alpha of a draw buffer is its stencil, left at 0 by oslClearScreen
+		oslSetAlpha(OSL_FX_OPAQUE, 0);
+		oslDrawImageXY(target, 192, 52);
+		oslSetAlpha(OSL_FX_DEFAULT, 0);
+		oslDrawRect(190, 50, 258, 118, RGBA(255, 255, 0, 255));
+		for (i = 0; i < 8; i++)
+			oslDrawLine(268 + i * 6, 52, 300 + i * 20, 116 - i * 4, RGBA(255, 255 - i * 32, i * 32, 255));
+
+		//Rotated, stretched and mirrored images
+		rgba->centerX = 24;
+		rgba->centerY = 16;
+		for (i = 0; i < 8; i++) {
+			rgba->angle = i * 45 + frame * 10;
+			oslDrawImageXY(rgba, 36 + i * 56, 150);
+		}
+		rgba->stretchX = 96;
+		rgba->angle = 30;
+		oslDrawImageXY(rgba, 60, 210);
+		oslMirrorImageH(rgba);
+		oslDrawImageXY(rgba, 180, 210);
+		oslMirrorImageH(rgba);
+		rgba->stretchX = 48;
+		rgba->angle = 0;
+		rgba->centerX = rgba->centerY = 0;
+
+		//Blending, alpha test and color key
+		oslSetAlpha(OSL_FX_ALPHA, 128);
+		oslDrawImageXY(rgb16, 260, 180);
+		oslSetAlpha2(OSL_FX_ADD, 255, 255);
+		oslDrawImageXY(pal8, 300, 200);
+		oslSetAlpha(OSL_FX_TINT, RGBA(255, 128, 0, 160));
+		oslDrawImageXY(pal4, 380, 180);
+		oslSetAlpha(OSL_FX_DEFAULT, 0);
+		oslSetAlphaTest(OSL_FXAT_GREATER, 100);
+		oslDrawImageXY(rgba, 420, 180);
+		oslDisableAlphaTest();
+		oslSetTransparentColor(RGBA(0, 255, 0, 255));
+		oslDrawImageXY(pal4, 420, 220);
+		oslDisableTransparentColor();
+		oslDrawGradientRect(260, 240, 470, 264, RGBA(0, 0, 0, 255), RGBA(255, 255, 255, 255), RGBA(0, 0, 0, 255), RGBA(255, 255, 255, 255));
+
+		oslEndDrawing();
+		oslSyncFrame();
+		frame++;
+	}
+
+	oslDeleteImage(rgba);
+	oslDeleteImage(rgb16);
+	oslDeleteImage(pal4);
+	oslDeleteImage(pal8);
+	oslDeleteImage(target);
+	oslEndGfx();
+	sceKernelExitGame();
+	return 0;
+}
@@ -0,0 +1,52 @@
+#include "oslib.h"
+
+/*
+	Text drawn with the built-in OFT font: strings with and without a background color, limited strings and text boxes
+	(cut anywhere or by words), drawn with the same text at every frame so that the cached layouts are replayed.
+*/
+
+static const char *dialog = "The quick brown fox jumps over the lazy dog. Static dialog text\nis laid out again every frame, sixty times a second, unless cached.\n\nEnd of dialog.";
+
+int main() {
+	int frame = 0, i;
+
+	oslInit(0);
+	oslInitGfx(OSL_PF_8888, 1);
+	oslSetSpriteBatching(1);
+
+	while (!osl_quit) {
+		oslStartDrawing();
+		oslClearScreen(RGBA(20, 40, 60, 255));
+
+		for (i = 0; i < 8; i++) {
+			oslSetTextColor(RGBA(255, 255 - i * 24, i * 30, 255));
+			oslSetBkColor((i & 1) ? RGBA(0, 0, 128, 255) : RGBA(0, 0, 0, 0));
+			oslDrawStringf(4 + (i % 3), i * 10, "HUD line %d: score %05d frame %d", i, i * 1234, frame);
+		}
+		oslSetBkColor(RGBA(100, 0, 0, 160));
+		oslDrawStringLimited(300, 4, 90, "Limited string that is long");
+		oslSetBkColor(RGBA(0, 0, 0, 0));
+		oslDrawStringLimited(300, 14, 90, "Limited string that is long");
+		oslDrawChar(300, 24, 'Q');
+
+		oslSetTextColor(RGBA(255, 255, 255, 255));
+		oslSetBkColor(RGBA(0, 0, 128, 255));
+		oslDrawTextBox(10, 90, 200, 180, dialog, 0);
+		oslSetBkColor(RGBA(0, 0, 0, 0));
+		oslSetTextColor(RGBA(255, 255, 0, 255));
+		oslDrawTextBox(220 + frame, 90, 470, 140, dialog, 0);
+		oslSetBkColor(RGBA(128, 0, 0, 255));
+		oslDrawTextBoxByWords(10, 185, 200, 268, dialog, 0);
+		oslSetBkColor(RGBA(0, 0, 0, 0));
+		oslDrawTextBoxByWords(220, 150, 470, 200, dialog, 0);
+		oslDrawTextBoxByWords(220, 210, 300, 268, "Short then averyveryveryveryveryveryveryverylongwordthatoverflows end", 0);
+
+		oslEndDrawing();
+		oslSyncFrame();
+		frame++;
+	}
+
+	oslEndGfx();
+	sceKernelExitGame();
+	return 0;
+}
@@ -0,0 +1,136 @@
+#include "oslib.h"
+
+/*
+	A Unicode (v02) OFT font built in memory: the 256 characters of the built-in font followed by 600 generated glyphs
+	at U+4E00. The atlas only holds two pages of glyphs, so pages are replaced while a frame is drawn. Strings, limited
+	strings and text boxes mix Latin text, CJK glyphs and code points missing from the font.
+	An argument sets the display list budget of the page uploads: with 0, every replacement syncs the GE instead, and the
+	frames must stay the same.
+*/
+
+#define CJK_GLYPHS 600
+
+extern const unsigned char osl_sceFont_data[];
+
+//Header, glyph count, code points, widths, 8-byte glyphs
+static u8 fontFile[sizeof(OSL_FONT_FORMAT_HEADER) + 4 + (256 + CJK_GLYPHS) * (4 + 1 + 8)];
+static OSL_VIRTUALFILENAME fontFiles[] = {
+	{"unicode.oft", fontFile, sizeof(fontFile), &VF_MEMORY},
+};
+
+static void buildFont() {
+	OSL_FONT_FORMAT_HEADER header;
+	u8 *p = fontFile;
+	u32 count = 256 + CJK_GLYPHS, code;
+	int i, row;
+
+	memset(&header, 0, sizeof(header));
+	strcpy(header.strVersion, "OSLFont v02");
+	header.pixelFormat = 1;
+	header.variableWidth = 1;
+	header.charWidth = 7;
+	header.charHeight = 8;
+	header.lineWidth = 1;
+	memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+	memcpy(p, &count, 4);
+	p += 4;
+	for (i = 0; i < (int)count; i++) {
+		code = i < 256 ? i : 0x4e00 + i - 256;
+		memcpy(p, &code, 4);
+		p += 4;
+	}
+	for (i = 0; i < (int)count; i++)
+		*p++ = i < 256 ? 7 : 8;
+	memcpy(p, osl_sceFont_data, 256 * 8);
+	p += 256 * 8;
+	//A frame with a few bars that differ from one glyph to the next
+	for (i = 0; i < CJK_GLYPHS; i++) {
+		for (row = 0; row < 8; row++)
+			*p++ = row == 0 ? 0xfe : row == 7 ? 0 : 0x82 | (((i * 37) >> row) & 1 ? 0x7c : 0) | (i >> (row + 2) & 1 ? 0x10 : 0);
+	}
+}
+
+static char *putUtf8(char *p, int c) {
+	if (c < 0x80)
+		*p++ = c;
+	else if (c < 0x800) {
+		*p++ = 0xc0 | (c >> 6);
+		*p++ = 0x80 | (c & 0x3f);
+	}
+	else {
+		*p++ = 0xe0 | (c >> 12);
+		*p++ = 0x80 | ((c >> 6) & 0x3f);
+		*p++ = 0x80 | (c & 0x3f);
+	}
+	return p;
+}
+
+int main(int argc, char *argv[]) {
+	static char lines[8][200], mixed[1200];
+	OSL_FONT *font;
+	char *p;
+	int frame = 0, line, i;
+
+	oslInit(0);
+	oslInitGfx(OSL_PF_8888, 1);
+	oslSetSpriteBatching(1);
+
+	buildFont();
+	oslAddVirtualFileList(fontFiles, oslNumberof(fontFiles));
+	oslSetFontAtlasSize(2 * 8 * OSL_TEXT_TEXWIDTH / 2);
+	if (argc > 1)
+		oslSetFontPageUploadSize(atoi(argv[1]));
+	font = oslLoadFontFile("unicode.oft");
+	if (!font) {
+		printf("FAIL: the font could not be loaded\n");
+		return 1;
+	}
+
+	for (line = 0; line < 8; line++) {
+		p = lines[line];
+		for (i = 0; i < 50; i++)
+			p = putUtf8(p, 0x4e00 + (i * 37 + line * 11) % CJK_GLYPHS);
+		*p = 0;
+	}
+	p = mixed;
+	for (i = 0; i < 300; i++) {
+		//Some code points are missing from the font
+		p = putUtf8(p, 0x4e00 + (i * 53) % (CJK_GLYPHS + 20));
+		if (i % 9 == 8)
+			*p++ = ' ';
+		if (i % 71 == 70)
+			*p++ = '\n';
+	}
+	*p = 0;
+
+	while (!osl_quit) {
+		oslStartDrawing();
+		oslClearScreen(RGBA(20, 40, 60, 255));
+		oslSetFont(font);
+
+		oslSetTextColor(RGBA(255, 255, 255, 255));
+		oslSetBkColor(RGBA(0, 0, 128, 255));
+		oslDrawTextBox(10, 10, 200, 130, "Latin text in a Unicode font: caf\xc3\xa9, na\xc3\xafve, \xc3\xa9t\xc3\xa9.\nSecond paragraph.", 0);
+		oslSetBkColor(RGBA(0, 0, 0, 0));
+		oslDrawStringf(10, 140, "Frame %d, string width %d", frame, oslGetStringWidth(lines[0]));
+
+		oslSetTextColor(RGBA(255, 255, 0, 255));
+		for (line = 0; line < 8; line++)
+			oslDrawString(220, 10 + line * 9, lines[(line + frame) % 8]);
+		oslSetBkColor(RGBA(0, 80, 0, 255));
+		oslDrawStringLimited(220, 90, 100, lines[3]);
+		oslDrawTextBox(220, 105, 470, 180, mixed, 0);
+		oslSetBkColor(RGBA(80, 0, 0, 255));
+		oslDrawTextBoxByWords(220, 190, 470, 268, mixed, 0);
+
+		oslEndDrawing();
+		oslSyncFrame();
+		frame++;
+	}
+
+	oslDeleteFont(font);
+	oslEndGfx();
+	sceKernelExitGame();
+	return 0;
+}
@@ -0,0 +1,222 @@
+#include "oslib.h"
+#include <time.h>
+
+/*
+	Swizzles and unswizzles a 512x512 image in several pixel formats, with oslSwizzleImage / oslUnswizzleImage (in place,
+	one band of 8 rows of scratch memory) and with the previous implementation (copy of the whole image, 32-bit moves).
+	Reports the throughput and the peak scratch memory of each, and fails if both don't give the same result.
+
+	The scratch memory is measured by wrapping malloc, memalign and free (see CMakeLists.txt).
+*/
+
+#define SIZE 512
+#define ROUNDS 50
+#define MAX_ALLOCS 64
+
+static struct {
+	void *ptr;
+	size_t size;
+} allocs[MAX_ALLOCS];
+static size_t liveBytes, peakBytes;
+
+void *__real_malloc(size_t size);
+void *__real_memalign(size_t alignment, size_t size);
+void __real_free(void *ptr);
+
+static void *trackAlloc(void *ptr, size_t size) {
+	int i;
+	for (i = 0; ptr && i < MAX_ALLOCS; i++) {
+		if (!allocs[i].ptr) {
+			allocs[i].ptr = ptr;
+			allocs[i].size = size;
+			liveBytes += size;
+			if (liveBytes > peakBytes)
+				peakBytes = liveBytes;
+			break;
+		}
+	}
+	return ptr;
+}
+
+void *__wrap_malloc(size_t size) {
+	return trackAlloc(__real_malloc(size), size);
+}
+
+void *__wrap_memalign(size_t alignment, size_t size) {
+	return trackAlloc(__real_memalign(alignment, size), size);
+}
+
+void __wrap_free(void *ptr) {
+	int i;
+	for (i = 0; ptr && i < MAX_ALLOCS; i++) {
+		if (allocs[i].ptr == ptr) {
+			liveBytes -= allocs[i].size;
+			allocs[i].ptr = NULL;
+			break;
+		}
+	}
+	__real_free(ptr);
+}
+
+/*
+	Previous implementation
+*/
+static void oldSwizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int height) {
+	unsigned int blockx, blocky, j;
+	unsigned int width_blocks = width / 16;
+	unsigned int height_blocks = height / 8;
+	unsigned int src_pitch = (width - 16) / 4;
+	unsigned int src_row = width * 8;
+	const u8* ysrc = in;
+	u32* dst = (u32*)out;
+
+	for (blocky = 0; blocky < height_blocks; ++blocky) {
+		const u8* xsrc = ysrc;
+		for (blockx = 0; blockx < width_blocks; ++blockx) {
+			const u32* src = (const u32*)xsrc;
+			for (j = 0; j < 8; ++j) {
+				*(dst++) = *(src++);
+				*(dst++) = *(src++);
+				*(dst++) = *(src++);
+				*(dst++) = *(src++);
+				src += src_pitch;
+			}
+			xsrc += 16;
+		}
+		ysrc += src_row;
+	}
+}
+
+static void oldUnswizzleTexture(u8* out, const u8* in, unsigned int width, unsigned int height) {
+	unsigned int blockX, blockY, rowOffset;
+	unsigned int widthBlocks = width / 16;
+	unsigned int heightBlocks = height / 8;
+	unsigned int dstPitch = (width - 16) / 4;
+	unsigned int dstRowSize = width * 8;
+	const u32* src = (const u32*)in;
+	u8* destRow = out;
+
+	for (blockY = 0; blockY < heightBlocks; ++blockY) {
+		u8* destBlock = destRow;
+		for (blockX = 0; blockX < widthBlocks; ++blockX) {
+			u32* dest = (u32*)destBlock;
+			for (rowOffset = 0; rowOffset < 8; ++rowOffset) {
+				*(dest++) = *(src++);
+				*(dest++) = *(src++);
+				*(dest++) = *(src++);
+				*(dest++) = *(src++);
+				dest += dstPitch;
+			}
+			destBlock += 16;
+		}
+		destRow += dstRowSize;
+	}
+}
+
+static void oldSwizzleImage(OSL_IMAGE *img) {
+	void *block = malloc(img->totalSize);
+	memcpy(block, img->data, img->totalSize);
+	oldSwizzleTexture((u8*)img->data, (u8*)block, (img->realSizeX * osl_pixelWidth[img->pixelFormat]) >> 3, img->realSizeY);
+	free(block);
+	oslImageIsSwizzledSet(img, 1);
+}
+
+static void oldUnswizzleImage(OSL_IMAGE *img) {
+	void *block = malloc(img->totalSize);
+	memcpy(block, img->data, img->totalSize);
+	oldUnswizzleTexture((u8*)img->data, (u8*)block, (img->realSizeX * osl_pixelWidth[img->pixelFormat]) >> 3, img->realSizeY);
+	free(block);
+	oslImageIsSwizzledSet(img, 0);
+}
+
+typedef struct {
+	double seconds;
+	size_t scratch;
+} RUN;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//Runs fn on the image ROUNDS times, alternating with undo (not timed) to get back to the original state
+static RUN measure(OSL_IMAGE *img, void (*fn)(OSL_IMAGE*), void (*undo)(OSL_IMAGE*)) {
+	RUN run = {0, 0};
+	int i;
+
+	for (i = 0; i < ROUNDS; i++) {
+		size_t before = liveBytes;
+		double start;
+		peakBytes = liveBytes;
+		start = now();
+		fn(img);
+		run.seconds += now() - start;
+		if (peakBytes - before > run.scratch)
+			run.scratch = peakBytes - before;
+		undo(img);
+	}
+	return run;
+}
+
+static void report(const char *what, RUN newRun, RUN oldRun, int totalSize) {
+	double mb = (double)totalSize * ROUNDS / (1 << 20);
+	printf("  %-10s in place: %7.0f MB/s, %4u kB scratch   full copy: %7.0f MB/s, %4u kB scratch\n", what,
+		mb / newRun.seconds, (unsigned)(newRun.scratch >> 10), mb / oldRun.seconds, (unsigned)(oldRun.scratch >> 10));
+}
+
+int main() {
+	static const struct {
+		int pixelFormat;
+		const char *name;
+	} formats[] = {
+		{OSL_PF_4BIT, "4-bit"}, {OSL_PF_8BIT, "8-bit"}, {OSL_PF_5650, "16-bit"}, {OSL_PF_8888, "32-bit"},
+	};
+	int f, i, failures = 0;
+
+	for (f = 0; f < (int)(sizeof(formats) / sizeof(formats[0])); f++) {
+		OSL_IMAGE *img = oslCreateImage(SIZE, SIZE, OSL_IN_RAM, formats[f].pixelFormat);
+		u8 *original = (u8*)malloc(img->totalSize), *swizzled = (u8*)malloc(img->totalSize);
+		unsigned int seed = 1;
+		RUN newRun, oldRun;
+
+		for (i = 0; i < img->totalSize; i++) {
+			seed = seed * 1103515245 + 12345;
+			original[i] = seed >> 16;
+		}
+		memcpy(img->data, original, img->totalSize);
+
+		//Same result as before, both ways
+		oldSwizzleImage(img);
+		memcpy(swizzled, img->data, img->totalSize);
+		memcpy(img->data, original, img->totalSize);
+		oslImageIsSwizzledSet(img, 0);
+		oslSwizzleImage(img);
+		if (memcmp(img->data, swizzled, img->totalSize)) {
+			printf("FAIL %s: oslSwizzleImage differs from the previous implementation\n", formats[f].name);
+			failures++;
+		}
+		oslUnswizzleImage(img);
+		if (memcmp(img->data, original, img->totalSize)) {
+			printf("FAIL %s: oslUnswizzleImage does not give the original image back\n", formats[f].name);
+			failures++;
+		}
+
+		printf("%s, %d kB:\n", formats[f].name, img->totalSize >> 10);
+		newRun = measure(img, oslSwizzleImage, oslUnswizzleImage);
+		oldRun = measure(img, oldSwizzleImage, oldUnswizzleImage);
+		report("swizzle", newRun, oldRun, img->totalSize);
+		oslSwizzleImage(img);
+		newRun = measure(img, oslUnswizzleImage, oslSwizzleImage);
+		oldRun = measure(img, oldUnswizzleImage, oldSwizzleImage);
+		report("unswizzle", newRun, oldRun, img->totalSize);
+
+		free(original);
+		free(swizzled);
+		oslDeleteImage(img);
+	}
+
+	if (failures)
+		printf("%d failures\n", failures);
+	return failures != 0;
+}
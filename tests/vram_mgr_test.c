@@ -0,0 +1,258 @@
+#include "oslib.h"
+#include <time.h>
+
+/*
+	Replays alloc/free traces against the VRAM manager.
+	The first pass checks every allocation against a map of the VRAM (no two live blocks may overlap) and that freeing
+	everything merges the VRAM back into a single free block. The second pass replays the same trace without the checks
+	and reports the time per operation.
+*/
+
+#define VRAM_UNIT 16
+#define VRAM_UNITS (OSL_VRAM_SIZE / VRAM_UNIT)
+
+typedef struct {
+	int size;               //Size to allocate, or 0 to free the block allocated by operation 'index'
+	int index;
+} TRACE_OP;
+
+typedef struct {
+	const char *name;
+	TRACE_OP *ops;
+	int count;
+	int allocs;
+} TRACE;
+
+static unsigned int seed;
+static int failures;
+static u8 vramMap[VRAM_UNITS];
+
+static unsigned int traceRandom(unsigned int max) {
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xffffff) % max;
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void check(int condition, const char *trace, const char *message, int op) {
+	if (!condition) {
+		printf("FAIL %s: %s (operation %d)\n", trace, message, op);
+		failures++;
+	}
+}
+
+/*
+	Level loads: a batch of sprite sheets, font pages and palettes is loaded, then most of it is released before the next
+	level, so the blocks that survive are scattered all over the VRAM.
+*/
+static void traceLevelLoads(TRACE *t, int levels, int perLevel) {
+	int *live = (int*)malloc(levels * perLevel * sizeof(int)), nLive = 0;
+	int i, j;
+
+	t->ops = (TRACE_OP*)malloc(levels * perLevel * 2 * sizeof(TRACE_OP));
+	t->count = 0;
+	for (i = 0; i < levels; i++) {
+		for (j = 0; j < perLevel; j++) {
+			int kind = traceRandom(10), size;
+			if (kind < 4)
+				size = 4096 << traceRandom(5);                  //Sprite sheets, 4 to 64 kB
+			else if (kind < 7)
+				size = 16384 + traceRandom(49152);              //Font pages
+			else
+				size = 64 + traceRandom(2048);                  //Palettes and small images
+			live[nLive++] = t->count;
+			t->ops[t->count].size = size;
+			t->ops[t->count].index = 0;
+			t->count++;
+		}
+		//Keep about a quarter of the blocks for the next level
+		for (j = 0; j < nLive; ) {
+			if (traceRandom(4)) {
+				t->ops[t->count].size = 0;
+				t->ops[t->count].index = live[j];
+				t->count++;
+				live[j] = live[--nLive];
+			}
+			else
+				j++;
+		}
+	}
+	//Unload everything
+	while (nLive > 0) {
+		t->ops[t->count].size = 0;
+		t->ops[t->count].index = live[--nLive];
+		t->count++;
+	}
+	free(live);
+}
+
+/*
+	Many small blocks with random lifetimes: the manager has to handle thousands of live blocks.
+*/
+static void traceChurn(TRACE *t, int maxLive, int steps) {
+	int *live = (int*)malloc(maxLive * sizeof(int)), nLive = 0;
+	int i;
+
+	t->ops = (TRACE_OP*)malloc((steps + maxLive) * sizeof(TRACE_OP));
+	t->count = 0;
+	for (i = 0; i < steps; i++) {
+		if (nLive < maxLive && (nLive < maxLive / 2 || traceRandom(2))) {
+			live[nLive++] = t->count;
+			t->ops[t->count].size = 16 + traceRandom(496);
+			t->ops[t->count].index = 0;
+		}
+		else {
+			int j = traceRandom(nLive);
+			t->ops[t->count].size = 0;
+			t->ops[t->count].index = live[j];
+			live[j] = live[--nLive];
+		}
+		t->count++;
+	}
+	while (nLive > 0) {
+		t->ops[t->count].size = 0;
+		t->ops[t->count].index = live[--nLive];
+		t->count++;
+	}
+	free(live);
+}
+
+static void markBlock(void *block, int size, int used, const char *trace, int op) {
+	int first = ((u8*)block - OSL_UVRAM_BASE) / VRAM_UNIT, count = (size + VRAM_UNIT - 1) / VRAM_UNIT, i;
+
+	check(first >= 0 && first + count <= VRAM_UNITS, trace, "block outside of the VRAM", op);
+	if (first < 0 || first + count > VRAM_UNITS)
+		return;
+	for (i = first; i < first + count; i++) {
+		if (used && vramMap[i]) {
+			check(0, trace, "block overlaps a live block", op);
+			return;
+		}
+		vramMap[i] = used;
+	}
+}
+
+static void replayChecked(TRACE *t) {
+	void **blocks = (void**)calloc(t->count, sizeof(void*));
+	int i;
+
+	memset(vramMap, 0, sizeof(vramMap));
+	t->allocs = 0;
+	for (i = 0; i < t->count; i++) {
+		TRACE_OP *op = &t->ops[i];
+		if (op->size) {
+			blocks[i] = oslVramMgrAllocBlock(op->size);
+			//The VRAM may be full, the trace frees nothing in that case
+			if (blocks[i]) {
+				check(((uintptr_t)blocks[i] & 15) == 0, t->name, "block not aligned to 16 bytes", i);
+				markBlock(blocks[i], op->size, 1, t->name, i);
+				t->allocs++;
+			}
+		}
+		else if (blocks[op->index]) {
+			markBlock(blocks[op->index], t->ops[op->index].size, 0, t->name, i);
+			check(oslVramMgrFreeBlock(blocks[op->index], t->ops[op->index].size), t->name, "free failed", i);
+		}
+	}
+	check(oslVramMgrGetLargestFreeBlock() == OSL_VRAM_SIZE, t->name, "free blocks not merged back", t->count);
+	free(blocks);
+}
+
+static double replayTimed(TRACE *t, int rounds) {
+	void **blocks = (void**)calloc(t->count, sizeof(void*));
+	double start = now();
+	int r, i;
+
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < t->count; i++) {
+			TRACE_OP *op = &t->ops[i];
+			if (op->size)
+				blocks[i] = oslVramMgrAllocBlock(op->size);
+			else if (blocks[op->index])
+				oslVramMgrFreeBlock(blocks[op->index], t->ops[op->index].size);
+		}
+	}
+	free(blocks);
+	return (now() - start) / rounds;
+}
+
+typedef struct {
+	u8 *data;
+	int moves;
+} OWNER;
+
+static void relocateOwner(void *owner, void *oldAddress, void *newAddress) {
+	OWNER *o = (OWNER*)owner;
+	check(o->data == oldAddress, "compaction", "callback with the wrong old address", o->moves);
+	o->data = (u8*)newAddress;
+	o->moves++;
+}
+
+/*
+	Frees every other block, pins one of the remaining ones as a tiled image would, and compacts: the owned blocks must
+	keep their contents at their new address and the pinned block must stay in place.
+*/
+static void testCompact() {
+	enum { BLOCKS = 8, SIZE = 64 << 10 };
+	OWNER owners[BLOCKS];
+	u8 *pinned;
+	int i, j, largest, moved;
+
+	for (i = 0; i < BLOCKS; i++) {
+		owners[i].data = (u8*)oslVramMgrAllocBlock(SIZE);
+		owners[i].moves = 0;
+		memset(owners[i].data, i + 1, SIZE);
+		oslVramMgrSetBlockOwner(owners[i].data, &owners[i], relocateOwner);
+	}
+	for (i = 0; i < BLOCKS; i += 2)
+		oslVramMgrFreeBlock(owners[i].data, SIZE);
+	pinned = owners[5].data;
+	oslVramMgrSetBlockOwner(pinned, NULL, NULL);
+
+	largest = oslVramMgrGetLargestFreeBlock();
+	moved = oslVramMgrCompact();
+	check(moved == 3, "compaction", "blocks 1, 3 and 7 should have moved", moved);
+	check(oslVramMgrGetLargestFreeBlock() > largest, "compaction", "largest free block did not grow", 0);
+	check(owners[5].data == pinned && owners[5].moves == 0, "compaction", "pinned block moved", 5);
+	for (i = 1; i < BLOCKS; i += 2) {
+		for (j = 0; j < SIZE && owners[i].data[j] == i + 1; j++);
+		check(j == SIZE, "compaction", "block contents lost", i);
+		oslVramMgrFreeBlock(owners[i].data, SIZE);
+	}
+	check(oslVramMgrGetLargestFreeBlock() == OSL_VRAM_SIZE, "compaction", "free blocks not merged back", 0);
+	printf("compaction: %d blocks moved\n", moved);
+}
+
+int main() {
+	TRACE traces[3];
+	int i;
+
+	oslVramMgrInit();
+	oslVramMgrSetParameters(OSL_UVRAM_BASE, OSL_VRAM_SIZE);
+
+	seed = 1;
+	traces[0].name = "level loads";
+	traceLevelLoads(&traces[0], 50, 40);
+	traces[1].name = "churn, 1000 live blocks";
+	traceChurn(&traces[1], 1000, 20000);
+	traces[2].name = "churn, 3500 live blocks";
+	traceChurn(&traces[2], 3500, 50000);
+
+	for (i = 0; i < 3; i++) {
+		double t;
+		replayChecked(&traces[i]);
+		t = replayTimed(&traces[i], 20);
+		printf("%-24s %6d operations (%5d allocations succeeded): %7.3f ms, %6.1f ns/operation\n",
+			traces[i].name, traces[i].count, traces[i].allocs, t * 1e3, t * 1e9 / traces[i].count);
+		free(traces[i].ops);
+	}
+	testCompact();
+
+	if (failures)
+		printf("%d failures\n", failures);
+	return failures != 0;
+}